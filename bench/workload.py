@@ -0,0 +1,451 @@
+#!/usr/bin/env python3
+"""
+Reproducible mixed static/dynamic workload for the webserver.
+
+Used as the PGO training run (see WEBSERVER_PGO in CMakeLists.txt) and as a
+benchmark: every executable given via --executable is started, driven with the
+same deterministic request sequence and stopped with SIGTERM, so profile data
+is written on exit.
+
+With --train the run also covers what the plain benchmark leaves out, so the
+profile has data for it: values stored with --compress, HTTP/2 with prior
+knowledge, and a second server with --tls-cert serving HTTP/1.1 and h2 over
+TLS (skipped without the openssl command or a TLS build).
+
+With --accounting the executable must be webserver_accounting (see
+WEBSERVER_ACCOUNTING): steady-state request sequences are replayed and the heap
+and syscall counts from /admin/stats are checked against ACCOUNTING_BUDGET.
+
+    python3 bench/workload.py --executable build/webserver --requests 50000
+    python3 bench/workload.py --executable build/webserver_instrumented --train
+    python3 bench/workload.py --executable ref/webserver --executable pgo/webserver
+    python3 bench/workload.py --executable build/webserver_accounting --accounting
+"""
+
+import argparse
+import os
+import random
+import shutil
+import signal
+import socket
+import ssl
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+STATIC_HITS = ['/static/foo', '/static/bar', '/static/baz']
+STATIC_MISSES = ['/static/other', '/static/index.html']
+
+# More keys than STORE_CAPACITY, so 507 is trained as well
+KEYSPACE = 1200
+BODY_SIZES = [0, 16, 64, 256, 1024, 4096]
+REQUESTS_PER_CONNECTION = 64
+
+# Share of the training requests sent once more over TLS
+TLS_SHARE = 0.2
+
+H2_PREFACE = b'PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n'
+H2_DATA, H2_HEADERS, H2_RST_STREAM, H2_SETTINGS, H2_WINDOW_UPDATE = 0, 1, 3, 4, 8
+H2_END_STREAM, H2_END_HEADERS = 0x1, 0x4
+H2_MAX_WINDOW = 2**31 - 1
+
+# Steady-state cost of one connection carrying n requests: accept after poll,
+# one recv for the requests and one for the EOF, one send per response, no
+# heap calls. Raise a budget only together with the change that needs it.
+ACCOUNTING_BUDGET = {
+    'accept': (1, 0),
+    'poll': (1, 0),
+    'recv': (2, 0),
+    'send': (0, 1),
+    'setsockopt': (0, 0),
+    'close': (1, 0),
+    'malloc': (0, 0),
+    'free': (0, 0),
+}
+ACCOUNTING_SCENARIOS = [
+    ('static GET', [b'GET /static/foo HTTP/1.1\r\n\r\n']),
+    ('dynamic GET', [b'GET /dynamic/accounted HTTP/1.1\r\nAccept: */*\r\n\r\n']),
+    ('dynamic PUT', [b'PUT /dynamic/accounted HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody']),
+    ('create + DELETE', [b'PUT /dynamic/created HTTP/1.1\r\nContent-Length: 4\r\n\r\nbody',
+                         b'DELETE /dynamic/created HTTP/1.1\r\n\r\n']),
+    ('miss', [b'GET /dynamic/missing HTTP/1.1\r\n\r\n']),
+    ('pipelined GET', [b'GET /dynamic/accounted HTTP/1.1\r\n\r\n'] * 16),
+]
+ACCOUNTING_REPEAT = 20
+
+
+def build_requests(count, seed):
+    """Return a deterministic list of (raw_request, pipelined) tuples."""
+
+    rng = random.Random(seed)
+    requests = []
+    for _ in range(count):
+        roll = rng.random()
+        key = f'/dynamic/key{rng.randrange(KEYSPACE)}'
+        if roll < 0.25:
+            path = rng.choice(STATIC_HITS if rng.random() < 0.8 else STATIC_MISSES)
+            raw = f'GET {path} HTTP/1.1\r\nHost: localhost\r\n\r\n'.encode()
+        elif roll < 0.55:
+            encoding = 'gzip, deflate' if rng.random() < 0.5 else 'identity'
+            raw = (f'GET {key} HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n'
+                   f'Accept-Encoding: {encoding}\r\n\r\n').encode()
+        elif roll < 0.80:
+            body = random_body(rng)
+            raw = (f'PUT {key} HTTP/1.1\r\nHost: localhost\r\n'
+                   f'Content-Type: application/octet-stream\r\n'
+                   f'Content-Length: {len(body)}\r\n\r\n').encode() + body
+        elif roll < 0.90:
+            raw = f'DELETE {key} HTTP/1.1\r\nHost: localhost\r\n\r\n'.encode()
+        elif roll < 0.94:
+            raw = f'POST /static/foo HTTP/1.1\r\nContent-Length: 0\r\n\r\n'.encode()
+        elif roll < 0.97:
+            raw = f'HEAD {key} HTTP/1.1\r\n\r\n'.encode()
+        else:
+            raw = b'Request\r\n\r\n'
+        # Only small requests are pipelined, a burst must fit into BUFFER_SIZE
+        requests.append((raw, len(raw) < 256 and rng.random() < 0.2))
+    return requests
+
+
+def random_body(rng):
+    """Half random bytes, half text that gzip and --compress can shrink."""
+
+    size = rng.choice(BODY_SIZES)
+    if rng.random() < 0.5:
+        return (f'{{"sensor": {rng.randrange(100)}, "unit": "celsius"}}\n' * size)[:size].encode()
+    return rng.randbytes(size) if hasattr(rng, 'randbytes') \
+        else bytes(rng.randrange(256) for _ in range(size))
+
+
+def read_response(conn, pending):
+    """Read one response from `conn`, returns (status, remaining buffer)."""
+
+    while b'\r\n\r\n' not in pending:
+        chunk = conn.recv(65536)
+        if not chunk:
+            raise ConnectionError('server closed connection')
+        pending += chunk
+    head, _, rest = pending.partition(b'\r\n\r\n')
+    lines = head.split(b'\r\n')
+    status = int(lines[0].split()[1])
+    length = 0
+    for line in lines[1:]:
+        name, _, value = line.partition(b':')
+        if name.strip().lower() == b'content-length':
+            length = int(value)
+    while len(rest) < length:
+        chunk = conn.recv(65536)
+        if not chunk:
+            raise ConnectionError('server closed connection')
+        rest += chunk
+    return status, rest[length:]
+
+
+def connect(port, context=None, alpn='http/1.1'):
+    """Plain or TLS connection to the server at `port`."""
+
+    conn = socket.create_connection(('127.0.0.1', port))
+    conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    if context is None:
+        return conn
+    context.set_alpn_protocols([alpn])
+    return context.wrap_socket(conn, server_hostname='localhost')
+
+
+def run_workload(port, requests, context=None):
+    """Drive the server at `port` with `requests`, returns status histogram."""
+
+    statuses = {}
+    for start in range(0, len(requests), REQUESTS_PER_CONNECTION):
+        batch = requests[start:start + REQUESTS_PER_CONNECTION]
+        with connect(port, context) as conn:
+            pending = b''
+            i = 0
+            while i < len(batch):
+                # Pipelined requests go out together with their successors
+                burst = [batch[i][0]]
+                while batch[i][1] and i + 1 < len(batch):
+                    i += 1
+                    burst.append(batch[i][0])
+                i += 1
+                conn.sendall(b''.join(burst))
+                for _ in burst:
+                    status, pending = read_response(conn, pending)
+                    statuses[status] = statuses.get(status, 0) + 1
+    return statuses
+
+
+def h2_frame(frame_type, flags, stream_id, payload=b''):
+    return struct.pack('>I', len(payload))[1:] + struct.pack('>BBI', frame_type, flags, stream_id) + payload
+
+
+def hpack_literal(name, value):
+    """Literal header field without indexing, no Huffman coding."""
+
+    def string(text):
+        data = text.encode()
+        if len(data) < 127:
+            return bytes([len(data)]) + data
+        length, out = len(data) - 127, [127]
+        while length >= 0x80:
+            out.append(0x80 | length & 0x7f)
+            length >>= 7
+        return bytes(out + [length]) + data
+    return b'\x00' + string(name) + string(value)
+
+
+def build_h2_requests(count, seed):
+    """Return a deterministic list of (method, path, headers, body) for HTTP/2."""
+
+    rng = random.Random(seed)
+    requests = []
+    for _ in range(count):
+        roll = rng.random()
+        key = f'/dynamic/key{rng.randrange(KEYSPACE)}'
+        if roll < 0.25:
+            requests.append(('GET', rng.choice(STATIC_HITS), [], b''))
+        elif roll < 0.60:
+            encoding = 'gzip' if rng.random() < 0.5 else 'identity'
+            requests.append(('GET', key, [('accept-encoding', encoding)], b''))
+        elif roll < 0.90:
+            requests.append(('PUT', key, [], random_body(rng)))
+        else:
+            requests.append(('DELETE', key, [], b''))
+    return requests
+
+
+def run_h2(port, requests, context=None):
+    """Send `requests` as HTTP/2 streams (prior knowledge, or ALPN h2 over TLS),
+    returns a histogram of completed and reset streams."""
+
+    statuses = {}
+    for start in range(0, len(requests), REQUESTS_PER_CONNECTION):
+        batch = requests[start:start + REQUESTS_PER_CONNECTION]
+        with connect(port, context, 'h2') as conn:
+            # Large windows, so no response waits for a WINDOW_UPDATE
+            frames = [H2_PREFACE,
+                      h2_frame(H2_SETTINGS, 0, 0, struct.pack('>HI', 4, H2_MAX_WINDOW)),
+                      h2_frame(H2_WINDOW_UPDATE, 0, 0, struct.pack('>I', H2_MAX_WINDOW - 65535))]
+            for i, (method, path, headers, body) in enumerate(batch):
+                stream_id = 2 * i + 1
+                block = b''.join(hpack_literal(name, value) for name, value in
+                                 [(':method', method), (':scheme', 'http'),
+                                  (':path', path), (':authority', 'localhost')] + headers)
+                if body:
+                    frames.append(h2_frame(H2_HEADERS, H2_END_HEADERS, stream_id, block))
+                    frames.append(h2_frame(H2_DATA, H2_END_STREAM, stream_id, body))
+                else:
+                    frames.append(h2_frame(H2_HEADERS, H2_END_HEADERS | H2_END_STREAM,
+                                           stream_id, block))
+            conn.sendall(b''.join(frames))
+
+            pending = b''
+            open_streams = len(batch)
+            while open_streams:
+                while len(pending) < 9 or len(pending) < 9 + int.from_bytes(pending[:3], 'big'):
+                    chunk = conn.recv(65536)
+                    if not chunk:
+                        raise ConnectionError('server closed connection')
+                    pending += chunk
+                length = int.from_bytes(pending[:3], 'big')
+                frame_type, flags, stream_id = struct.unpack('>BBI', pending[3:9])
+                pending = pending[9 + length:]
+                if stream_id and (frame_type == H2_RST_STREAM or
+                                  frame_type in (H2_HEADERS, H2_DATA) and flags & H2_END_STREAM):
+                    outcome = 'h2 reset' if frame_type == H2_RST_STREAM else 'h2'
+                    statuses[outcome] = statuses.get(outcome, 0) + 1
+                    open_streams -= 1
+    return statuses
+
+
+def exchange(port, raw_requests):
+    """Send requests on one connection, half-close it, return the reply bytes."""
+
+    with socket.create_connection(('127.0.0.1', port)) as conn:
+        # Corked, the FIN goes out in the same segment as the requests. The
+        # server then finds the end of the connection with its next recv()
+        # instead of waiting for it in poll(), which would depend on timing.
+        conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_CORK, 1)
+        conn.sendall(b''.join(raw_requests))
+        conn.shutdown(socket.SHUT_WR)
+        reply = b''
+        while True:
+            chunk = conn.recv(65536)
+            if not chunk:
+                return reply
+            reply += chunk
+
+
+def read_stats(port):
+    body = exchange(port, [b'GET /admin/stats HTTP/1.1\r\n\r\n']).partition(b'\r\n\r\n')[2]
+    return {name.decode(): int(value) for name, value in
+            (line.split() for line in body.splitlines())}
+
+
+def run_accounting(port):
+    """Check every scenario against ACCOUNTING_BUDGET, returns the violations."""
+
+    violations = []
+    exchange(port, [ACCOUNTING_SCENARIOS[2][1][0]])
+    for name, raw_requests in ACCOUNTING_SCENARIOS:
+        for _ in range(3):
+            exchange(port, raw_requests)
+        # The stats connection counts itself, two in a row give its share
+        before = read_stats(port)
+        start = read_stats(port)
+        if 'malloc' not in start:
+            raise RuntimeError('server was not built with WEBSERVER_ACCOUNTING')
+        for _ in range(ACCOUNTING_REPEAT):
+            exchange(port, raw_requests)
+        end = read_stats(port)
+
+        per_connection = {counter: (end[counter] - 2 * start[counter] + before[counter]) /
+                          ACCOUNTING_REPEAT for counter in end}
+        assert per_connection['requests'] == len(raw_requests)
+        print(f'{name}: ' + ', '.join(f'{counter}={per_connection[counter]:g}'
+                                      for counter in ACCOUNTING_BUDGET))
+        for counter, (fixed, per_request) in ACCOUNTING_BUDGET.items():
+            budget = fixed + per_request * len(raw_requests)
+            if per_connection[counter] > budget:
+                violations.append(f'{name}: {per_connection[counter]:g} {counter} '
+                                  f'per connection, budget {budget}')
+    return violations
+
+
+def wait_for_port(port, server, timeout=5.0):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if server.poll() is not None:
+            raise ChildProcessError(f'server exited with {server.returncode} on startup')
+        try:
+            socket.create_connection(('127.0.0.1', port)).close()
+            return
+        except OSError:
+            time.sleep(.05)
+    raise TimeoutError(f'server did not listen on port {port}')
+
+
+def run_executable(executable, port, drive, options=()):
+    """Start `executable` with `options`, call drive(port), stop it with SIGTERM."""
+
+    server = subprocess.Popen([executable, '127.0.0.1', str(port), *options],
+                              stdout=subprocess.DEVNULL)
+    try:
+        wait_for_port(port, server)
+        begin = time.perf_counter()
+        statuses = drive(port)
+        elapsed = time.perf_counter() - begin
+    finally:
+        server.send_signal(signal.SIGTERM)
+        try:
+            server.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            server.kill()
+            raise
+    if server.returncode != 0:
+        raise RuntimeError(f'{executable} exited with {server.returncode}')
+    return elapsed, statuses
+
+
+def merge(statuses, more):
+    for status, count in more.items():
+        statuses[status] = statuses.get(status, 0) + count
+    return statuses
+
+
+def train(executable, port, requests, seed):
+    """PGO training: the benchmark plus HTTP/2 with --compress, then a share of
+    both over TLS. Returns (phase, elapsed, statuses) per server run."""
+
+    h2_requests = build_h2_requests(len(requests) // 4, seed)
+    phases = [('plain', *run_executable(
+        executable, port,
+        lambda port: merge(run_workload(port, requests), run_h2(port, h2_requests)),
+        ['--compress']))]
+
+    if not shutil.which('openssl'):
+        print('TLS training skipped: no openssl command', file=sys.stderr)
+        return phases
+    with tempfile.TemporaryDirectory() as directory:
+        cert, key = os.path.join(directory, 'cert.pem'), os.path.join(directory, 'key.pem')
+        subprocess.run(['openssl', 'req', '-x509', '-newkey', 'rsa:2048', '-nodes', '-days', '1',
+                        '-subj', '/CN=localhost', '-keyout', key, '-out', cert],
+                       check=True, capture_output=True)
+        context = ssl.create_default_context(cafile=cert)
+        tls_requests = requests[:int(len(requests) * TLS_SHARE)]
+        tls_h2_requests = h2_requests[:int(len(h2_requests) * TLS_SHARE)]
+        try:
+            phases.append(('tls', *run_executable(
+                executable, port,
+                lambda port: merge(run_workload(port, tls_requests, context),
+                                   run_h2(port, tls_h2_requests, context)),
+                ['--tls-cert', cert, '--tls-key', key])))
+        except ChildProcessError as error:
+            # Built without WEBSERVER_TLS
+            print(f'TLS training skipped: {error}', file=sys.stderr)
+    return phases
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('--executable', action='append', default=[],
+                        help='server binary to start (repeat to compare builds)')
+    parser.add_argument('--port', type=int, default=4712)
+    parser.add_argument('--connect', action='store_true',
+                        help='drive an already running server at --port')
+    parser.add_argument('--requests', type=int, default=20000)
+    parser.add_argument('--seed', type=int, default=4711)
+    parser.add_argument('--accounting', action='store_true',
+                        help='check heap and syscall budgets instead of timing')
+    parser.add_argument('--train', action='store_true',
+                        help='PGO training: also drive --compress, HTTP/2 and TLS')
+    args = parser.parse_args()
+
+    if not args.executable and not args.connect:
+        parser.error('need --executable or --connect')
+
+    if args.accounting:
+        violations = []
+        if args.connect:
+            violations += run_accounting(args.port)
+        for executable in args.executable:
+            violations += run_executable(executable, args.port, run_accounting)[1]
+        for violation in violations:
+            print(f'over budget: {violation}', file=sys.stderr)
+        return 1 if violations else 0
+
+    requests = build_requests(args.requests, args.seed)
+    if args.train:
+        for executable in args.executable:
+            for phase, elapsed, statuses in train(executable, args.port, requests, args.seed):
+                print(f'{executable} ({phase}): {elapsed:.2f}s, ' +
+                      ', '.join(f'{s}={n}' for s, n in sorted(statuses.items(), key=str)))
+        return 0
+
+    results = []
+    if args.connect:
+        begin = time.perf_counter()
+        statuses = run_workload(args.port, requests)
+        results.append(('127.0.0.1:%d' % args.port, time.perf_counter() - begin, statuses))
+    for executable in args.executable:
+        elapsed, statuses = run_executable(executable, args.port,
+                                           lambda port: run_workload(port, requests))
+        results.append((executable, elapsed, statuses))
+
+    baseline = None
+    for name, elapsed, statuses in results:
+        rate = len(requests) / elapsed
+        line = f'{name}: {len(requests)} requests in {elapsed:.2f}s, {rate:.0f} req/s'
+        if baseline is None:
+            baseline = rate
+        else:
+            line += f' ({rate / baseline:.2f}x)'
+        print(line)
+        print('  statuses: ' + ', '.join(f'{s}={n}' for s, n in sorted(statuses.items())))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,48 @@
+# Trainingslauf fuer WEBSERVER_PGO, wird per "cmake -P" aus dem Build gestartet.
+#
+# Erwartet: PYTHON, WORKLOAD, EXECUTABLE, REQUESTS, PORT, COMPILER_ID, STAMP
+# GNU:   PROFILE_SRC_DIR (Objektverzeichnis des instrumentierten Targets),
+#        PROFILE_DST_DIR (Objektverzeichnis des optimierten Targets)
+# Clang: PROFILE_DIR, PROFDATA, LLVM_PROFDATA
+
+if(COMPILER_ID STREQUAL "GNU")
+    # Zaehler alter Laeufe verwerfen, gcda-Dateien werden sonst aufsummiert
+    file(GLOB_RECURSE old_profiles "${PROFILE_SRC_DIR}/*.gcda")
+    if(old_profiles)
+        file(REMOVE ${old_profiles})
+    endif()
+else()
+    file(REMOVE_RECURSE "${PROFILE_DIR}")
+    file(MAKE_DIRECTORY "${PROFILE_DIR}")
+    set(ENV{LLVM_PROFILE_FILE} "${PROFILE_DIR}/webserver-%p.profraw")
+endif()
+
+execute_process(
+    COMMAND "${PYTHON}" "${WORKLOAD}" --executable "${EXECUTABLE}" --train
+            --requests "${REQUESTS}" --port "${PORT}"
+    RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "PGO training workload failed: ${result}")
+endif()
+
+if(COMPILER_ID STREQUAL "GNU")
+    # -fprofile-use sucht <objekt>.gcda neben dem Objekt des optimierten Targets
+    file(GLOB_RECURSE profiles RELATIVE "${PROFILE_SRC_DIR}" "${PROFILE_SRC_DIR}/*.gcda")
+    if(NOT profiles)
+        message(FATAL_ERROR "PGO training produced no profile data")
+    endif()
+    foreach(profile ${profiles})
+        get_filename_component(dir "${PROFILE_DST_DIR}/${profile}" DIRECTORY)
+        file(COPY "${PROFILE_SRC_DIR}/${profile}" DESTINATION "${dir}")
+    endforeach()
+else()
+    file(GLOB raw_profiles "${PROFILE_DIR}/*.profraw")
+    execute_process(
+        COMMAND "${LLVM_PROFDATA}" merge -o "${PROFDATA}" ${raw_profiles}
+        RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "llvm-profdata merge failed: ${result}")
+    endif()
+endif()
+
+file(TOUCH "${STAMP}")
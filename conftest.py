@@ -5,6 +5,8 @@ def pytest_addoption(parser):
     parser.addoption('--executable', action='store', default='build/webserver')
     parser.addoption('--port', action='store', default=4711)
     parser.addoption('--debug_own', action='store_true', default=False)
+    parser.addoption('--stress-clients', action='store', type=int, default=1000)
+    parser.addoption('--soak-seconds', action='store', type=int, default=0)
 
 
 @pytest.fixture
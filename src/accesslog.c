@@ -0,0 +1,336 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "accesslog.h"
+
+// Groesse der Thread-Puffer; geschrieben wird, wenn er voll oder aelter als
+// ACCESS_LOG_FLUSH_US ist. Letzteres prueft auch ein eigener Thread alle
+// ACCESS_LOG_TICK_US, damit ruhende Threads ihre Records nicht zurueckhalten.
+#define ACCESS_LOG_BUFFER_SIZE (64 * 1024)
+#define ACCESS_LOG_FLUSH_US 1000000
+#define ACCESS_LOG_TICK_US 250000
+#define ACCESS_LOG_SEEN_SIZE 1024
+#define ACCESS_LOG_KEEP 4
+
+typedef struct AccessLogBuffer {
+    struct AccessLogBuffer *next;           // Liste aller Puffer (buffers_lock)
+    pthread_mutex_t lock;                   // Besitzer-Thread gegen Flusher
+    char data[ACCESS_LOG_BUFFER_SIZE];
+    size_t length;
+    uint64_t oldest_us;
+    unsigned generation;
+    uint64_t seen[ACCESS_LOG_SEEN_SIZE];    // bereits definierte Pfad-Hashes
+} AccessLogBuffer;
+
+typedef struct {
+    char *filename;
+    int fd;
+    size_t size;
+    size_t rotate_bytes;
+    unsigned generation;                    // zaehlt bei jeder Rotation hoch
+    pthread_mutex_t lock;
+    pthread_key_t buffer_key;
+    
+    // Lock-Reihenfolge: buffers_lock, Puffer, lock
+    AccessLogBuffer *buffers;
+    pthread_mutex_t buffers_lock;
+    pthread_cond_t stop;
+    bool stopping;
+    bool flusher_running;
+    pthread_t flusher;
+} AccessLog;
+
+static AccessLog access_log = {
+    .fd = -1,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .buffers_lock = PTHREAD_MUTEX_INITIALIZER,
+    .stop = PTHREAD_COND_INITIALIZER,
+};
+
+static uint64_t clock_us(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t access_log_hash_path(const char *path, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)path[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash ? hash : 1;
+}
+
+static int write_fully(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+// Oeffnet eine neue Datei und schreibt den Kopf; Aufrufer haelt den Lock
+static int open_log_file(void) {
+    access_log.fd = open(access_log.filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (access_log.fd < 0) {
+        perror("Error: cannot open access log");
+        return -1;
+    }
+    
+    off_t size = lseek(access_log.fd, 0, SEEK_END);
+    access_log.size = size > 0 ? (size_t)size : 0;
+    if (access_log.size == 0) {
+        AccessLogHeader header = {ACCESS_LOG_MAGIC, 1, sizeof(AccessLogRecord)};
+        if (write_fully(access_log.fd, (const char *)&header, sizeof(header)) < 0) {
+            perror("Error: cannot write access log header");
+            return -1;
+        }
+        access_log.size = sizeof(header);
+    }
+    return 0;
+}
+
+// FILE -> FILE.1 -> ... -> FILE.ACCESS_LOG_KEEP; Aufrufer haelt den Lock
+static void rotate_log_file(void) {
+    size_t name_length = strlen(access_log.filename) + 16;
+    char from[name_length], to[name_length];
+    
+    close(access_log.fd);
+    for (int i = ACCESS_LOG_KEEP - 1; i >= 1; i--) {
+        snprintf(from, name_length, "%s.%d", access_log.filename, i);
+        snprintf(to, name_length, "%s.%d", access_log.filename, i + 1);
+        rename(from, to);
+    }
+    snprintf(to, name_length, "%s.1", access_log.filename);
+    rename(access_log.filename, to);
+    
+    access_log.generation++;
+    if (open_log_file() < 0) {
+        access_log.fd = -1;
+    }
+}
+
+// Aufrufer haelt buffer->lock
+static void flush_buffer(AccessLogBuffer *buffer) {
+    if (buffer->length == 0) return;
+    
+    pthread_mutex_lock(&access_log.lock);
+    if (access_log.fd >= 0) {
+        if (write_fully(access_log.fd, buffer->data, buffer->length) < 0) {
+            perror("Error: access log write failed");
+        } else {
+            access_log.size += buffer->length;
+            if (access_log.size >= access_log.rotate_bytes) {
+                rotate_log_file();
+            }
+        }
+    }
+    pthread_mutex_unlock(&access_log.lock);
+    buffer->length = 0;
+}
+
+static void access_log_thread_exit(void *arg) {
+    AccessLogBuffer *buffer = arg;
+    pthread_mutex_lock(&access_log.buffers_lock);
+    AccessLogBuffer **link = &access_log.buffers;
+    while (*link != buffer) link = &(*link)->next;
+    *link = buffer->next;
+    pthread_mutex_unlock(&access_log.buffers_lock);
+    
+    flush_buffer(buffer);
+    pthread_mutex_destroy(&buffer->lock);
+    free(buffer);
+}
+
+static AccessLogBuffer *thread_buffer(void) {
+    AccessLogBuffer *buffer = pthread_getspecific(access_log.buffer_key);
+    if (!buffer) {
+        buffer = calloc(1, sizeof(AccessLogBuffer));
+        if (!buffer) return NULL;
+        pthread_mutex_init(&buffer->lock, NULL);
+        pthread_setspecific(access_log.buffer_key, buffer);
+        
+        pthread_mutex_lock(&access_log.buffers_lock);
+        buffer->next = access_log.buffers;
+        access_log.buffers = buffer;
+        pthread_mutex_unlock(&access_log.buffers_lock);
+    }
+    return buffer;
+}
+
+// Schreibt alle Puffer, die aelter als max_age_us sind (0: alle)
+static void flush_buffers(uint64_t max_age_us) {
+    uint64_t now = clock_us(CLOCK_MONOTONIC);
+    pthread_mutex_lock(&access_log.buffers_lock);
+    for (AccessLogBuffer *buffer = access_log.buffers; buffer; buffer = buffer->next) {
+        pthread_mutex_lock(&buffer->lock);
+        if (buffer->length > 0 && now - buffer->oldest_us >= max_age_us) {
+            flush_buffer(buffer);
+        }
+        pthread_mutex_unlock(&buffer->lock);
+    }
+    pthread_mutex_unlock(&access_log.buffers_lock);
+}
+
+static void *access_log_flusher_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&access_log.buffers_lock);
+    while (!access_log.stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += ACCESS_LOG_TICK_US * 1000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&access_log.stop, &access_log.buffers_lock, &deadline);
+        if (access_log.stopping) break;
+        
+        pthread_mutex_unlock(&access_log.buffers_lock);
+        flush_buffers(ACCESS_LOG_FLUSH_US);
+        pthread_mutex_lock(&access_log.buffers_lock);
+    }
+    pthread_mutex_unlock(&access_log.buffers_lock);
+    return NULL;
+}
+
+static void append(AccessLogBuffer *buffer, const void *data, size_t length) {
+    if (buffer->length + length > ACCESS_LOG_BUFFER_SIZE) {
+        flush_buffer(buffer);
+    }
+    if (buffer->length == 0) {
+        buffer->oldest_us = clock_us(CLOCK_MONOTONIC);
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+}
+
+// Schreibt einmal pro Thread und Datei den Pfad zu einem Hash
+static void define_path(AccessLogBuffer *buffer, uint64_t hash, const char *path, size_t length) {
+    if (buffer->generation != access_log.generation) {
+        memset(buffer->seen, 0, sizeof(buffer->seen));
+        buffer->generation = access_log.generation;
+    }
+    
+    size_t slot = hash & (ACCESS_LOG_SEEN_SIZE - 1);
+    if (buffer->seen[slot] == hash) return;
+    buffer->seen[slot] = hash;
+    
+    if (length > UINT16_MAX) length = UINT16_MAX;
+    size_t padded = (length + 7) & ~(size_t)7;
+    AccessLogRecord record = {0};
+    record.type = ACCESS_LOG_PATH;
+    record.path_hash = hash;
+    record.path_length = length;
+    
+    char padding[8] = {0};
+    append(buffer, &record, sizeof(record));
+    append(buffer, path, length);
+    append(buffer, padding, padded - length);
+}
+
+static AccessLogMethod method_id(const char *method) {
+    for (int id = ACCESS_METHOD_GET; id < ACCESS_METHOD_COUNT; id++) {
+        if (strcasecmp(method, access_log_method_names[id]) == 0) return id;
+    }
+    return ACCESS_METHOD_OTHER;
+}
+
+int access_log_open(const char *filename, size_t rotate_bytes) {
+    access_log.filename = strdup(filename);
+    access_log.rotate_bytes = rotate_bytes;
+    if (!access_log.filename ||
+        pthread_key_create(&access_log.buffer_key, access_log_thread_exit) != 0) {
+        fprintf(stderr, "Error: cannot set up access log\n");
+        return -1;
+    }
+    if (open_log_file() < 0) return -1;
+    
+    // SIGINT/SIGTERM muessen beim Hauptthread ankommen, nicht beim Flusher
+    sigset_t blocked, previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    int result = pthread_create(&access_log.flusher, NULL, access_log_flusher_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    
+    if (result != 0) {
+        fprintf(stderr, "Error: cannot start access log flusher\n");
+        close(access_log.fd);
+        access_log.fd = -1;
+        return -1;
+    }
+    access_log.flusher_running = true;
+    return 0;
+}
+
+bool access_log_enabled(void) {
+    return access_log.fd >= 0;
+}
+
+void access_log_request(const struct sockaddr_in *client, const char *method,
+                        const char *path, int status, size_t request_bytes,
+                        size_t response_bytes, uint64_t latency_us) {
+    if (access_log.fd < 0) return;
+    AccessLogBuffer *buffer = thread_buffer();
+    if (!buffer) return;
+    pthread_mutex_lock(&buffer->lock);
+    
+    size_t path_length = strlen(path);
+    uint64_t hash = access_log_hash_path(path, path_length);
+    define_path(buffer, hash, path, path_length);
+    
+    AccessLogRecord record = {0};
+    record.type = ACCESS_LOG_REQUEST;
+    record.timestamp_us = clock_us(CLOCK_REALTIME);
+    record.path_hash = hash;
+    record.client_addr = client ? client->sin_addr.s_addr : 0;
+    record.client_port = client ? ntohs(client->sin_port) : 0;
+    record.method = method_id(method);
+    record.status = status;
+    record.latency_us = latency_us > UINT32_MAX ? UINT32_MAX : latency_us;
+    record.request_bytes = request_bytes > UINT32_MAX ? UINT32_MAX : request_bytes;
+    record.response_bytes = response_bytes > UINT32_MAX ? UINT32_MAX : response_bytes;
+    append(buffer, &record, sizeof(record));
+    
+    if (clock_us(CLOCK_MONOTONIC) - buffer->oldest_us >= ACCESS_LOG_FLUSH_US) {
+        flush_buffer(buffer);
+    }
+    pthread_mutex_unlock(&buffer->lock);
+}
+
+void access_log_close(void) {
+    if (access_log.fd < 0) return;
+    
+    if (access_log.flusher_running) {
+        pthread_mutex_lock(&access_log.buffers_lock);
+        access_log.stopping = true;
+        pthread_cond_signal(&access_log.stop);
+        pthread_mutex_unlock(&access_log.buffers_lock);
+        pthread_join(access_log.flusher, NULL);
+        access_log.flusher_running = false;
+    }
+    flush_buffers(0);
+    
+    pthread_mutex_lock(&access_log.lock);
+    close(access_log.fd);
+    access_log.fd = -1;
+    pthread_mutex_unlock(&access_log.lock);
+}
@@ -0,0 +1,71 @@
+#ifndef WEBSERVER_ACCESSLOG_H
+#define WEBSERVER_ACCESSLOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+// Binaeres Access-Log: Dateikopf, danach Records fester Groesse in
+// Host-Byteorder. Pfade stehen nur als Hash im Request-Record; beim ersten
+// Auftreten eines Hashes pro Thread und Datei wird vorher ein Pfad-Record
+// geschrieben, dem path_length Bytes Pfad (auf 8 Byte aufgefuellt) folgen.
+
+#define ACCESS_LOG_MAGIC "TKNALOG1"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+} AccessLogHeader;
+
+enum {
+    ACCESS_LOG_REQUEST = 1,
+    ACCESS_LOG_PATH = 2,
+};
+
+typedef enum {
+    ACCESS_METHOD_OTHER,
+    ACCESS_METHOD_GET,
+    ACCESS_METHOD_PUT,
+    ACCESS_METHOD_DELETE,
+    ACCESS_METHOD_HEAD,
+    ACCESS_METHOD_POST,
+    ACCESS_METHOD_COUNT
+} AccessLogMethod;
+
+static const char *const access_log_method_names[ACCESS_METHOD_COUNT] = {
+    "OTHER", "GET", "PUT", "DELETE", "HEAD", "POST"
+};
+
+typedef struct {
+    uint64_t timestamp_us;      // CLOCK_REALTIME bei Abschluss des Requests
+    uint64_t path_hash;         // FNV-1a 64 ueber den Pfad
+    uint32_t client_addr;       // IPv4, Netzwerk-Byteorder
+    uint32_t latency_us;
+    uint32_t request_bytes;
+    uint32_t response_bytes;    // nur Body
+    uint16_t client_port;
+    uint16_t status;
+    uint8_t type;               // ACCESS_LOG_REQUEST / ACCESS_LOG_PATH
+    uint8_t method;             // AccessLogMethod
+    uint16_t path_length;       // nur ACCESS_LOG_PATH
+} AccessLogRecord;
+
+uint64_t access_log_hash_path(const char *path, size_t length);
+
+// Oeffnet FILE; ab rotate_bytes wird nach FILE.1 .. FILE.4 rotiert
+int access_log_open(const char *filename, size_t rotate_bytes);
+
+bool access_log_enabled(void);
+
+// Haengt einen Record an den Puffer des aufrufenden Threads an; ein
+// Hintergrund-Thread schreibt Puffer, die aelter als eine Sekunde sind
+void access_log_request(const struct sockaddr_in *client, const char *method,
+                        const char *path, int status, size_t request_bytes,
+                        size_t response_bytes, uint64_t latency_us);
+
+// Schreibt die Puffer aller Threads und schliesst die Datei
+void access_log_close(void);
+
+#endif
@@ -0,0 +1,210 @@
+// Wandelt das binaere Access-Log (--access-log) in Text oder JSONL um
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+#include "accesslog.h"
+
+// Hash -> Pfad aus den Pfad-Records aller Dateien
+typedef struct {
+    uint64_t hash;
+    char *path;
+} PathEntry;
+
+typedef struct {
+    PathEntry *entries;
+    size_t capacity;
+    size_t count;
+} PathTable;
+
+static PathEntry *path_table_slot(PathTable *table, uint64_t hash) {
+    size_t mask = table->capacity - 1;
+    size_t slot = hash & mask;
+    while (table->entries[slot].hash != 0 && table->entries[slot].hash != hash) {
+        slot = (slot + 1) & mask;
+    }
+    return &table->entries[slot];
+}
+
+static void path_table_insert(PathTable *table, uint64_t hash, const char *path, size_t length) {
+    if ((table->count + 1) * 2 > table->capacity) {
+        PathTable grown = {calloc(table->capacity ? table->capacity * 2 : 1024, sizeof(PathEntry)),
+                           table->capacity ? table->capacity * 2 : 1024, 0};
+        if (!grown.entries) {
+            perror("Error: out of memory");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (table->entries[i].hash != 0) {
+                *path_table_slot(&grown, table->entries[i].hash) = table->entries[i];
+                grown.count++;
+            }
+        }
+        free(table->entries);
+        *table = grown;
+    }
+    
+    PathEntry *entry = path_table_slot(table, hash);
+    if (entry->hash == hash) return;
+    entry->hash = hash;
+    entry->path = strndup(path, length);
+    table->count++;
+}
+
+static const char *path_table_lookup(PathTable *table, uint64_t hash) {
+    if (table->capacity == 0) return NULL;
+    PathEntry *entry = path_table_slot(table, hash);
+    return entry->hash == hash ? entry->path : NULL;
+}
+
+static FILE *open_log(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        perror(filename);
+        return NULL;
+    }
+    
+    AccessLogHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, ACCESS_LOG_MAGIC, sizeof(header.magic)) != 0 ||
+        header.record_size != sizeof(AccessLogRecord)) {
+        fprintf(stderr, "%s: not an access log of this version\n", filename);
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+// Liest den naechsten Record; bei Pfad-Records auch den Pfad nach path
+static bool read_record(FILE *file, AccessLogRecord *record, char *path) {
+    if (fread(record, sizeof(*record), 1, file) != 1) return false;
+    if (record->type == ACCESS_LOG_PATH) {
+        size_t padded = ((size_t)record->path_length + 7) & ~(size_t)7;
+        if (fread(path, 1, padded, file) != padded) return false;
+        path[record->path_length] = '\0';
+    }
+    return true;
+}
+
+static void print_json_string(const char *str) {
+    putchar('"');
+    for (const unsigned char *c = (const unsigned char *)str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            printf("\\%c", *c);
+        } else if (*c < 0x20 || *c >= 0x7f) {
+            printf("\\u%04x", *c);
+        } else {
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+static void print_record(const AccessLogRecord *record, const char *path, bool json) {
+    char client[INET_ADDRSTRLEN];
+    struct in_addr addr = {record->client_addr};
+    inet_ntop(AF_INET, &addr, client, sizeof(client));
+    
+    time_t seconds = record->timestamp_us / 1000000;
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    char timestamp[64];
+    size_t length = strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(timestamp + length, sizeof(timestamp) - length, ".%06uZ",
+             (unsigned)(record->timestamp_us % 1000000));
+    
+    const char *method = record->method < ACCESS_METHOD_COUNT ?
+                         access_log_method_names[record->method] : "OTHER";
+    char unknown_path[32];
+    if (!path) {
+        snprintf(unknown_path, sizeof(unknown_path), "#%016llx",
+                 (unsigned long long)record->path_hash);
+        path = unknown_path;
+    }
+    
+    if (json) {
+        printf("{\"time\": \"%s\", \"timestamp_us\": %llu, \"client\": \"%s:%u\", "
+               "\"method\": \"%s\", \"path\": ",
+               timestamp, (unsigned long long)record->timestamp_us, client,
+               record->client_port, method);
+        print_json_string(path);
+        printf(", \"status\": %u, \"request_bytes\": %u, \"response_bytes\": %u, "
+               "\"latency_us\": %u}\n",
+               record->status, record->request_bytes, record->response_bytes,
+               record->latency_us);
+    } else {
+        printf("%s %s:%u %s %s %u %u %u %uus\n", timestamp, client, record->client_port,
+               method, path, record->status, record->request_bytes,
+               record->response_bytes, record->latency_us);
+    }
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--json] <access.log>...\n", program);
+    fprintf(stderr,
+        "  Text: Zeit Client Methode Pfad Status Request-Bytes Response-Bytes Latenz\n"
+        "  --json    eine JSON-Zeile pro Request\n");
+}
+
+int main(int argc, char *argv[]) {
+    bool json = false;
+    
+    static const struct option long_options[] = {
+        {"json", no_argument, NULL, 'j'},
+        {NULL, 0, NULL, 0}
+    };
+    
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        if (option != 'j') {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        json = true;
+    }
+    if (optind == argc) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    // Erst alle Pfad-Records einsammeln: nach einer Rotation kann die
+    // Definition in einer anderen Datei stehen als der Request
+    PathTable paths = {0};
+    AccessLogRecord record;
+    static char path[UINT16_MAX + 8];
+    int status = EXIT_SUCCESS;
+    
+    for (int i = optind; i < argc; i++) {
+        FILE *file = open_log(argv[i]);
+        if (!file) {
+            status = EXIT_FAILURE;
+            continue;
+        }
+        while (read_record(file, &record, path)) {
+            if (record.type == ACCESS_LOG_PATH) {
+                path_table_insert(&paths, record.path_hash, path, record.path_length);
+            }
+        }
+        fclose(file);
+    }
+    
+    for (int i = optind; i < argc; i++) {
+        FILE *file = open_log(argv[i]);
+        if (!file) continue;
+        while (read_record(file, &record, path)) {
+            if (record.type == ACCESS_LOG_REQUEST) {
+                print_record(&record, path_table_lookup(&paths, record.path_hash), json);
+            }
+        }
+        fclose(file);
+    }
+    
+    return status;
+}
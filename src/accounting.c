@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "accounting.h"
+
+static const char *counter_names[ACCOUNT_COUNT] = {
+    [ACCOUNT_REQUESTS] = "requests",
+    [ACCOUNT_CONNECTIONS] = "connections",
+    [ACCOUNT_MALLOC] = "malloc",
+    [ACCOUNT_FREE] = "free",
+    [ACCOUNT_ACCEPT] = "accept",
+    [ACCOUNT_POLL] = "poll",
+    [ACCOUNT_RECV] = "recv",
+    [ACCOUNT_SEND] = "send",
+    [ACCOUNT_SETSOCKOPT] = "setsockopt",
+    [ACCOUNT_CLOSE] = "close",
+};
+
+// Jeder Thread zaehlt fuer sich; ausgegeben werden die des Hauptthreads
+static __thread uint64_t counts[ACCOUNT_COUNT];
+
+void account(AccountCounter counter) {
+    counts[counter]++;
+}
+
+bool accounting_enabled(void) {
+#ifdef WEBSERVER_ACCOUNTING
+    return true;
+#else
+    return false;
+#endif
+}
+
+int accounting_format(char *buffer, size_t size) {
+    size_t length = 0;
+    int count = accounting_enabled() ? ACCOUNT_COUNT : ACCOUNT_MALLOC;
+    for (int counter = 0; counter < count; counter++) {
+        int written = snprintf(buffer + length, length < size ? size - length : 0, "%s %llu\n",
+                               counter_names[counter], (unsigned long long)counts[counter]);
+        if (written < 0) return -1;
+        length += written;
+    }
+    return length;
+}
+
+#ifdef WEBSERVER_ACCOUNTING
+// Wrapper fuer -Wl,--wrap=<name> (siehe WEBSERVER_ACCOUNTING in CMakeLists.txt)
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+void __real_free(void *pointer);
+int __real_accept(int fd, struct sockaddr *address, socklen_t *length);
+int __real_poll(struct pollfd *fds, nfds_t count, int timeout);
+ssize_t __real_recv(int fd, void *buffer, size_t length, int flags);
+ssize_t __real_send(int fd, const void *buffer, size_t length, int flags);
+ssize_t __real_sendmsg(int fd, const struct msghdr *message, int flags);
+ssize_t __real_writev(int fd, const struct iovec *iov, int count);
+ssize_t __real_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+ssize_t __real_splice(int in_fd, loff_t *in_offset, int out_fd, loff_t *out_offset,
+                      size_t length, unsigned int flags);
+int __real_setsockopt(int fd, int level, int name, const void *value, socklen_t length);
+int __real_close(int fd);
+
+void *__wrap_malloc(size_t size) {
+    counts[ACCOUNT_MALLOC]++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+    counts[ACCOUNT_MALLOC]++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size) {
+    counts[ACCOUNT_MALLOC]++;
+    return __real_realloc(pointer, size);
+}
+
+void __wrap_free(void *pointer) {
+    // free(NULL) ist kein Heap-Aufruf
+    if (pointer) counts[ACCOUNT_FREE]++;
+    __real_free(pointer);
+}
+
+int __wrap_accept(int fd, struct sockaddr *address, socklen_t *length) {
+    counts[ACCOUNT_ACCEPT]++;
+    return __real_accept(fd, address, length);
+}
+
+int __wrap_poll(struct pollfd *fds, nfds_t count, int timeout) {
+    counts[ACCOUNT_POLL]++;
+    return __real_poll(fds, count, timeout);
+}
+
+ssize_t __wrap_recv(int fd, void *buffer, size_t length, int flags) {
+    counts[ACCOUNT_RECV]++;
+    return __real_recv(fd, buffer, length, flags);
+}
+
+ssize_t __wrap_send(int fd, const void *buffer, size_t length, int flags) {
+    counts[ACCOUNT_SEND]++;
+    return __real_send(fd, buffer, length, flags);
+}
+
+ssize_t __wrap_sendmsg(int fd, const struct msghdr *message, int flags) {
+    counts[ACCOUNT_SEND]++;
+    return __real_sendmsg(fd, message, flags);
+}
+
+ssize_t __wrap_writev(int fd, const struct iovec *iov, int count) {
+    counts[ACCOUNT_SEND]++;
+    return __real_writev(fd, iov, count);
+}
+
+ssize_t __wrap_sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    counts[ACCOUNT_SEND]++;
+    return __real_sendfile(out_fd, in_fd, offset, count);
+}
+
+ssize_t __wrap_splice(int in_fd, loff_t *in_offset, int out_fd, loff_t *out_offset,
+                      size_t length, unsigned int flags) {
+    counts[ACCOUNT_SEND]++;
+    return __real_splice(in_fd, in_offset, out_fd, out_offset, length, flags);
+}
+
+int __wrap_setsockopt(int fd, int level, int name, const void *value, socklen_t length) {
+    counts[ACCOUNT_SETSOCKOPT]++;
+    return __real_setsockopt(fd, level, name, value, length);
+}
+
+int __wrap_close(int fd) {
+    counts[ACCOUNT_CLOSE]++;
+    return __real_close(fd);
+}
+#endif
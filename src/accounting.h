@@ -0,0 +1,37 @@
+#ifndef WEBSERVER_ACCOUNTING_H
+#define WEBSERVER_ACCOUNTING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Zaehler fuer GET /admin/stats. Requests und Verbindungen zaehlt jeder
+// Build; der Instrumentierungs-Build (-DWEBSERVER_ACCOUNTING=ON) zaehlt
+// zusaetzlich Heap-Aufrufe und Systemaufrufe. Deren Wrapper setzt der
+// Linker per --wrap ein, es zaehlen also nur Aufrufe aus unserem Code
+// (nicht aus libc, OpenSSL oder zlib) und nur die des Hauptthreads, der die
+// Requests bedient.
+
+typedef enum {
+    ACCOUNT_REQUESTS,
+    ACCOUNT_CONNECTIONS,
+    ACCOUNT_MALLOC,                     // malloc, calloc, realloc
+    ACCOUNT_FREE,
+    ACCOUNT_ACCEPT,
+    ACCOUNT_POLL,
+    ACCOUNT_RECV,
+    ACCOUNT_SEND,                       // send, sendmsg, writev, sendfile, splice
+    ACCOUNT_SETSOCKOPT,
+    ACCOUNT_CLOSE,
+    ACCOUNT_COUNT
+} AccountCounter;
+
+// Nur im Hauptthread aufrufen
+void account(AccountCounter counter);
+
+bool accounting_enabled(void);
+
+// Schreibt "name wert\n" je Zaehler (ohne die Heap- und Systemaufrufe,
+// wenn accounting_enabled() false ist); Laenge wie snprintf()
+int accounting_format(char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,648 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "archive.h"
+#include "bulk.h"
+#include "store.h"
+
+// Export: Groesse der Schreibpuffer
+#define ARCHIVE_CHUNK (64 * 1024)
+
+// Import: Eintraege pro Batch und Obergrenze fuer einen einzelnen Eintrag
+#define ARCHIVE_BATCH 64
+#define ARCHIVE_MAX_ENTRY (16 * 1024 * 1024)
+
+// Laengste Keys, die als Request-Pfad noch ankommen koennen
+#define ARCHIVE_MAX_KEY 255
+
+#define ARCHIVE_PREFIX "/dynamic/"
+
+typedef struct {
+    uint32_t key_length;
+    uint32_t value_length;
+} ArchiveFrame;
+
+typedef struct {
+    char data[ARCHIVE_CHUNK];
+    size_t length;
+    ArchiveWrite write;
+    void *context;
+    int error;
+} ExportBuffer;
+
+static void export_flush(ExportBuffer *out) {
+    if (out->length > 0 && !out->error && out->write(out->context, out->data, out->length) < 0) {
+        out->error = -1;
+    }
+    out->length = 0;
+}
+
+static void export_append(ExportBuffer *out, const char *data, size_t length) {
+    if (out->length + length > ARCHIVE_CHUNK) {
+        export_flush(out);
+        // Grosse Werte nicht erst umkopieren
+        if (length > ARCHIVE_CHUNK / 2) {
+            if (!out->error && out->write(out->context, data, length) < 0) out->error = -1;
+            return;
+        }
+    }
+    memcpy(out->data + out->length, data, length);
+    out->length += length;
+}
+
+// Bytes eines JSON-Strings ohne Anfuehrungszeichen
+static void export_escaped(ExportBuffer *out, const char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = data[i];
+        char escaped[8];
+        switch (c) {
+        case '"':  export_append(out, "\\\"", 2); break;
+        case '\\': export_append(out, "\\\\", 2); break;
+        case '\n': export_append(out, "\\n", 2); break;
+        case '\r': export_append(out, "\\r", 2); break;
+        case '\t': export_append(out, "\\t", 2); break;
+        default:
+            if (c < 0x20 || c >= 0x7f) {
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                export_append(out, escaped, 6);
+            } else {
+                if (out->length == ARCHIVE_CHUNK) export_flush(out);
+                out->data[out->length++] = c;
+            }
+        }
+    }
+}
+
+// Byte-String als JSON-String (wie capture_write_string)
+static void export_string(ExportBuffer *out, const char *data, size_t length) {
+    export_append(out, "\"", 1);
+    export_escaped(out, data, length);
+    export_append(out, "\"", 1);
+}
+
+typedef struct {
+    ArchiveFormat format;
+    ExportBuffer *out;
+} ExportState;
+
+static int export_entry(void *context, const char *key, size_t key_length,
+                        const char *value, size_t value_length) {
+    ExportState *state = context;
+    ExportBuffer *out = state->out;
+    
+    if (state->format == ARCHIVE_BINARY) {
+        ArchiveFrame frame = {key_length, value_length};
+        export_append(out, (const char *)&frame, sizeof(frame));
+        export_append(out, key, key_length);
+        export_append(out, value, value_length);
+    } else {
+        export_append(out, "{\"key\": ", 8);
+        export_string(out, key, key_length);
+        export_append(out, ", \"value\": ", 11);
+        export_string(out, value, value_length);
+        export_append(out, "}\n", 2);
+    }
+    return out->error;
+}
+
+// Grosse Werte (bulk.h) wie export_entry, die Datei wird stueckweise gelesen
+static int export_bulk_entry(void *context, const char *key, size_t key_length,
+                             const BulkValue *value) {
+    ExportState *state = context;
+    ExportBuffer *out = state->out;
+    
+    if (state->format == ARCHIVE_BINARY) {
+        if (value->length > UINT32_MAX) {
+            fprintf(stderr, "Error: %.*s is too large for a binary archive\n", (int)key_length, key);
+            return -1;
+        }
+        ArchiveFrame frame = {key_length, value->length};
+        export_append(out, (const char *)&frame, sizeof(frame));
+        export_append(out, key, key_length);
+    } else {
+        export_append(out, "{\"key\": ", 8);
+        export_string(out, key, key_length);
+        export_append(out, ", \"value\": \"", 12);
+    }
+    
+    char *chunk = malloc(ARCHIVE_CHUNK);
+    if (!chunk) return -1;
+    for (size_t done = 0; done < value->length && !out->error;) {
+        size_t length = value->length - done < ARCHIVE_CHUNK ? value->length - done : ARCHIVE_CHUNK;
+        ssize_t bytes_read = pread(value->fd, chunk, length, value->offset + done);
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read <= 0) {
+            fprintf(stderr, "Error: cannot read %.*s: %s\n", (int)key_length, key,
+                    bytes_read < 0 ? strerror(errno) : "file truncated");
+            out->error = -1;
+            break;
+        }
+        if (state->format == ARCHIVE_BINARY) {
+            export_append(out, chunk, bytes_read);
+        } else {
+            export_escaped(out, chunk, bytes_read);
+        }
+        done += bytes_read;
+    }
+    free(chunk);
+    
+    if (state->format == ARCHIVE_NDJSON) {
+        export_append(out, "\"}\n", 3);
+    }
+    return out->error;
+}
+
+long archive_export(ArchiveFormat format, const char *prefix, ArchiveWrite write, void *context) {
+    ExportBuffer *out = malloc(sizeof(ExportBuffer));
+    if (!out) return -1;
+    out->length = 0;
+    out->write = write;
+    out->context = context;
+    out->error = 0;
+    
+    if (format == ARCHIVE_BINARY) {
+        export_append(out, ARCHIVE_MAGIC, 8);
+    }
+    ExportState state = {format, out};
+    long count = store_scan(prefix, export_entry, &state);
+    if (count >= 0 && bulk_enabled()) {
+        long bulk_count = bulk_scan(prefix, export_bulk_entry, &state);
+        count = bulk_count < 0 ? -1 : count + bulk_count;
+    }
+    if (format == ARCHIVE_BINARY) {
+        ArchiveFrame end = {0, 0};
+        export_append(out, (const char *)&end, sizeof(end));
+    }
+    export_flush(out);
+    
+    int error = out->error;
+    free(out);
+    return error || count < 0 ? -1 : count;
+}
+
+typedef struct {
+    size_t key_offset;
+    size_t key_length;
+    size_t value_offset;
+    size_t value_length;
+} BatchEntry;
+
+struct ArchiveReader {
+    int format;                 // ArchiveFormat oder -1, solange unbekannt
+    bool ended;                 // Endmarke des Binaerformats gelesen
+    size_t max_value_length;
+    ArchiveChanged changed;
+    void *context;
+    
+    // Unvollstaendiger Eintrag vom Ende des letzten Stuecks
+    char *pending;
+    size_t pending_length;
+    size_t pending_capacity;
+    
+    // Dekodierte Eintraege, die noch nicht im Store sind
+    BatchEntry batch[ARCHIVE_BATCH];
+    size_t batch_count;
+    char *batch_data;
+    size_t batch_length;
+    size_t batch_capacity;
+    
+    ArchiveStats stats;
+};
+
+static int reserve(char **data, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) return 0;
+    size_t grown = *capacity ? *capacity : 4096;
+    while (grown < needed) grown *= 2;
+    char *resized = realloc(*data, grown);
+    if (!resized) return -1;
+    *data = resized;
+    *capacity = grown;
+    return 0;
+}
+
+static void flush_batch(ArchiveReader *reader) {
+    StoreItem items[ARCHIVE_BATCH];
+    for (size_t i = 0; i < reader->batch_count; i++) {
+        const BatchEntry *entry = &reader->batch[i];
+        items[i].key = reader->batch_data + entry->key_offset;
+        items[i].key_length = entry->key_length;
+        items[i].value = reader->batch_data + entry->value_offset;
+        items[i].value_length = entry->value_length;
+    }
+    
+    if (!reader->stats.full) {
+        size_t stored = store_put_batch(items, reader->batch_count);
+        for (size_t i = 0; i < stored; i++) {
+            // Importierte Keys ersetzen gleichnamige grosse Werte
+            if (bulk_enabled()) bulk_remove(items[i].key, items[i].key_length);
+            if (reader->changed) reader->changed(reader->context, items[i].key, items[i].key_length);
+        }
+        reader->stats.imported += stored;
+        reader->stats.full = stored < reader->batch_count;
+    }
+    reader->batch_count = 0;
+    reader->batch_length = 0;
+}
+
+// Reserviert Platz fuer einen Eintrag mit hoechstens length Bytes
+static char *batch_reserve(ArchiveReader *reader, size_t length) {
+    if (reader->batch_count == ARCHIVE_BATCH) {
+        flush_batch(reader);
+    }
+    if (reserve(&reader->batch_data, &reader->batch_capacity, reader->batch_length + length) < 0) {
+        return NULL;
+    }
+    return reader->batch_data + reader->batch_length;
+}
+
+// Legt einen Wert ab max_value_length als Datei ab (bulk.h), wie ein
+// grosser PUT; die Eintraege davor kommen zuerst in den Store
+static void import_bulk(ArchiveReader *reader, size_t key_length, size_t value_offset,
+                        size_t value_length) {
+    // flush_batch() gibt den Puffer nicht frei, der Eintrag bleibt lesbar
+    const char *key = reader->batch_data + reader->batch_length;
+    flush_batch(reader);
+    
+    BulkUpload upload;
+    if (bulk_create(&upload, key, key_length, value_length) < 0) {
+        perror("Error: cannot create bulk value");
+        reader->stats.skipped++;
+        return;
+    }
+    if (bulk_write(&upload, key + value_offset, value_length) < 0) {
+        perror("Error: cannot write bulk value");
+        bulk_abort(&upload);
+        reader->stats.skipped++;
+        return;
+    }
+    if (bulk_commit(&upload, store_next_version()) < 0) {
+        reader->stats.skipped++;
+        return;
+    }
+    // Der Key liegt jetzt nur noch als Datei vor
+    int slot = store_find(key, key_length);
+    if (slot != -1) store_remove(slot);
+    reader->stats.imported++;
+    if (reader->changed) reader->changed(reader->context, key, key_length);
+}
+
+// Uebernimmt den zuletzt reservierten Eintrag oder verwirft ihn
+static void batch_commit(ArchiveReader *reader, size_t key_length, size_t value_offset,
+                         size_t value_length) {
+    if (key_length < strlen(ARCHIVE_PREFIX) || key_length > ARCHIVE_MAX_KEY ||
+        memcmp(reader->batch_data + reader->batch_length, ARCHIVE_PREFIX,
+               strlen(ARCHIVE_PREFIX)) != 0 ||
+        memchr(reader->batch_data + reader->batch_length, '\0', key_length) ||
+        (value_length >= reader->max_value_length && !bulk_enabled())) {
+        reader->stats.skipped++;
+        return;
+    }
+    if (value_length >= reader->max_value_length) {
+        import_bulk(reader, key_length, value_offset, value_length);
+        return;
+    }
+    
+    BatchEntry *entry = &reader->batch[reader->batch_count++];
+    entry->key_offset = reader->batch_length;
+    entry->key_length = key_length;
+    entry->value_offset = reader->batch_length + value_offset;
+    entry->value_length = value_length;
+    reader->batch_length += value_offset + value_length;
+}
+
+// Binaerformat: liefert die verbrauchten Bytes oder -1
+static long parse_binary(ArchiveReader *reader, const char *data, size_t length) {
+    size_t position = 0;
+    
+    while (!reader->ended && length - position >= sizeof(ArchiveFrame)) {
+        ArchiveFrame frame;
+        memcpy(&frame, data + position, sizeof(frame));
+        if (frame.key_length == 0) {
+            reader->ended = true;
+            position += sizeof(frame);
+            break;
+        }
+        
+        size_t entry_length = (size_t)frame.key_length + frame.value_length;
+        if (entry_length > ARCHIVE_MAX_ENTRY) {
+            reader->stats.error = "Archive entry too large";
+            return -1;
+        }
+        if (length - position - sizeof(frame) < entry_length) break;
+        
+        char *out = batch_reserve(reader, entry_length);
+        if (!out) {
+            reader->stats.error = "Out of memory";
+            return -1;
+        }
+        memcpy(out, data + position + sizeof(frame), entry_length);
+        batch_commit(reader, frame.key_length, frame.key_length, frame.value_length);
+        position += sizeof(frame) + entry_length;
+    }
+    
+    if (reader->ended && position < length) {
+        reader->stats.error = "Data after end of archive";
+        return -1;
+    }
+    return position;
+}
+
+static const char *skip_space(const char *pos, const char *end) {
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r')) pos++;
+    return pos;
+}
+
+// Dekodiert einen JSON-String ab dem Anfuehrungszeichen nach out (hoechstens
+// so lang wie die Eingabe); Position hinter dem String oder NULL
+static const char *decode_string(const char *pos, const char *end, char *out, size_t *length) {
+    if (pos == end || *pos != '"') return NULL;
+    pos++;
+    
+    size_t written = 0;
+    while (pos < end && *pos != '"') {
+        if (*pos != '\\') {
+            out[written++] = *pos++;
+            continue;
+        }
+        if (++pos == end) return NULL;
+        switch (*pos++) {
+        case '"':  out[written++] = '"'; break;
+        case '\\': out[written++] = '\\'; break;
+        case '/':  out[written++] = '/'; break;
+        case 'b':  out[written++] = '\b'; break;
+        case 'f':  out[written++] = '\f'; break;
+        case 'n':  out[written++] = '\n'; break;
+        case 'r':  out[written++] = '\r'; break;
+        case 't':  out[written++] = '\t'; break;
+        case 'u': {
+            if (end - pos < 4) return NULL;
+            char hex[5] = {pos[0], pos[1], pos[2], pos[3], '\0'};
+            char *hex_end;
+            unsigned long code = strtoul(hex, &hex_end, 16);
+            if (hex_end != hex + 4) return NULL;
+            pos += 4;
+            // Bis 0xff ein Byte (Byte-String), sonst UTF-8
+            if (code < 0x100) {
+                out[written++] = code;
+            } else if (code < 0x800) {
+                out[written++] = 0xc0 | (code >> 6);
+                out[written++] = 0x80 | (code & 0x3f);
+            } else {
+                out[written++] = 0xe0 | (code >> 12);
+                out[written++] = 0x80 | ((code >> 6) & 0x3f);
+                out[written++] = 0x80 | (code & 0x3f);
+            }
+            break;
+        }
+        default:
+            return NULL;
+        }
+    }
+    if (pos == end) return NULL;
+    *length = written;
+    return pos + 1;
+}
+
+// Eine NDJSON-Zeile: {"key": "...", "value": "..."}, andere String-Felder
+// werden ignoriert
+static int parse_line(ArchiveReader *reader, const char *line, const char *end) {
+    const char *pos = skip_space(line, end);
+    if (pos == end) return 0;
+    
+    // Key, Wert und sonstige Strings landen in drei Bereichen des Batches,
+    // jeder so gross wie die Zeile
+    size_t area = end - line;
+    char *out = batch_reserve(reader, 3 * area);
+    if (!out) {
+        reader->stats.error = "Out of memory";
+        return -1;
+    }
+    char *value = out + area;
+    char *scratch = value + area;
+    size_t key_length = 0, value_length = 0;
+    bool has_key = false, has_value = false;
+    
+    if (*pos++ != '{') return -1;
+    pos = skip_space(pos, end);
+    while (pos < end && *pos != '}') {
+        const char *name = scratch;
+        size_t name_length;
+        pos = decode_string(pos, end, scratch, &name_length);
+        if (!pos) return -1;
+        pos = skip_space(pos, end);
+        if (pos == end || *pos++ != ':') return -1;
+        pos = skip_space(pos, end);
+        
+        if (name_length == 3 && memcmp(name, "key", 3) == 0) {
+            pos = decode_string(pos, end, out, &key_length);
+            has_key = true;
+        } else if (name_length == 5 && memcmp(name, "value", 5) == 0) {
+            pos = decode_string(pos, end, value, &value_length);
+            has_value = true;
+        } else {
+            size_t ignored;
+            pos = decode_string(pos, end, scratch, &ignored);
+        }
+        if (!pos) return -1;
+        
+        pos = skip_space(pos, end);
+        if (pos < end && *pos == ',') pos = skip_space(pos + 1, end);
+    }
+    if (pos == end || !has_key || !has_value) return -1;
+    
+    // Wert direkt hinter den Key ruecken, damit der Batch dicht bleibt
+    memmove(out + key_length, value, value_length);
+    batch_commit(reader, key_length, key_length, value_length);
+    return 0;
+}
+
+// NDJSON: verarbeitet alle vollstaendigen Zeilen (bei last auch den Rest)
+static long parse_ndjson(ArchiveReader *reader, const char *data, size_t length, bool last) {
+    size_t position = 0;
+    
+    while (position < length) {
+        const char *line = data + position;
+        const char *newline = memchr(line, '\n', length - position);
+        if (!newline && !last) {
+            if (length - position > ARCHIVE_MAX_ENTRY) {
+                reader->stats.error = "Archive line too long";
+                return -1;
+            }
+            break;
+        }
+        const char *end = newline ? newline : data + length;
+        
+        if (parse_line(reader, line, end) < 0) {
+            if (!reader->stats.error) reader->stats.error = "Invalid archive line";
+            return -1;
+        }
+        position = end - data + (newline ? 1 : 0);
+    }
+    return position;
+}
+
+static long parse_entries(ArchiveReader *reader, const char *data, size_t length, bool last) {
+    size_t position = 0;
+    
+    if (reader->format == -1) {
+        if (length < 8 && !last && memcmp(data, ARCHIVE_MAGIC, length) == 0) return 0;
+        if (length >= 8 && memcmp(data, ARCHIVE_MAGIC, 8) == 0) {
+            reader->format = ARCHIVE_BINARY;
+            position = 8;
+        } else if (length > 0) {
+            reader->format = ARCHIVE_NDJSON;
+        } else {
+            return 0;
+        }
+    }
+    
+    long consumed = reader->format == ARCHIVE_BINARY ?
+                    parse_binary(reader, data + position, length - position) :
+                    parse_ndjson(reader, data + position, length - position, last);
+    return consumed < 0 ? -1 : (long)position + consumed;
+}
+
+ArchiveReader *archive_reader_new(size_t max_value_length, ArchiveChanged changed, void *context) {
+    ArchiveReader *reader = calloc(1, sizeof(ArchiveReader));
+    if (!reader) return NULL;
+    reader->format = -1;
+    reader->max_value_length = max_value_length;
+    reader->changed = changed;
+    reader->context = context;
+    return reader;
+}
+
+int archive_reader_feed(ArchiveReader *reader, const char *data, size_t length) {
+    if (reader->stats.error) return -1;
+    
+    // Ohne Rest vom letzten Stueck direkt aus den Eingabedaten lesen
+    if (reader->pending_length == 0) {
+        long consumed = parse_entries(reader, data, length, false);
+        if (consumed < 0) return -1;
+        data += consumed;
+        length -= consumed;
+        if (reserve(&reader->pending, &reader->pending_capacity, length) < 0) {
+            reader->stats.error = "Out of memory";
+            return -1;
+        }
+        memcpy(reader->pending, data, length);
+        reader->pending_length = length;
+        return 0;
+    }
+    
+    if (reserve(&reader->pending, &reader->pending_capacity, reader->pending_length + length) < 0) {
+        reader->stats.error = "Out of memory";
+        return -1;
+    }
+    memcpy(reader->pending + reader->pending_length, data, length);
+    reader->pending_length += length;
+    
+    long consumed = parse_entries(reader, reader->pending, reader->pending_length, false);
+    if (consumed < 0) return -1;
+    memmove(reader->pending, reader->pending + consumed, reader->pending_length - consumed);
+    reader->pending_length -= consumed;
+    return 0;
+}
+
+ArchiveStats archive_reader_finish(ArchiveReader *reader) {
+    if (!reader->stats.error) {
+        long consumed = parse_entries(reader, reader->pending, reader->pending_length, true);
+        if (consumed >= 0 && reader->format == ARCHIVE_BINARY &&
+            (!reader->ended || (size_t)consumed < reader->pending_length)) {
+            reader->stats.error = "Truncated archive";
+        }
+    }
+    flush_batch(reader);
+    
+    ArchiveStats stats = reader->stats;
+    free(reader->pending);
+    free(reader->batch_data);
+    free(reader);
+    return stats;
+}
+
+int archive_import_file(const char *filename, size_t max_value_length, ArchiveStats *stats) {
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        perror("Error: cannot open archive");
+        return -1;
+    }
+    
+    ArchiveReader *reader = archive_reader_new(max_value_length, NULL, NULL);
+    char *chunk = malloc(ARCHIVE_CHUNK);
+    if (!reader || !chunk) {
+        fprintf(stderr, "Error: out of memory\n");
+        free(reader);
+        free(chunk);
+        close(fd);
+        return -1;
+    }
+    
+    ssize_t bytes_read;
+    while ((bytes_read = read(fd, chunk, ARCHIVE_CHUNK)) != 0) {
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            perror("Error: cannot read archive");
+            break;
+        }
+        if (archive_reader_feed(reader, chunk, bytes_read) < 0) break;
+    }
+    
+    *stats = archive_reader_finish(reader);
+    free(chunk);
+    close(fd);
+    if (bytes_read < 0 || stats->error) {
+        fprintf(stderr, "Error: %s: %s\n", filename, stats->error ? stats->error : "read failed");
+        return -1;
+    }
+    return 0;
+}
+
+static int write_file(void *context, const char *data, size_t length) {
+    int fd = *(int *)context;
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+int archive_export_file(const char *filename) {
+    size_t name_length = strlen(filename);
+    ArchiveFormat format = ARCHIVE_BINARY;
+    if ((name_length > 7 && strcmp(filename + name_length - 7, ".ndjson") == 0) ||
+        (name_length > 6 && strcmp(filename + name_length - 6, ".jsonl") == 0)) {
+        format = ARCHIVE_NDJSON;
+    }
+    
+    // Erst vollstaendig schreiben, dann umbenennen: ein altes Backup bleibt
+    // bis dahin gueltig
+    char temporary[name_length + 8];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", filename);
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror("Error: cannot create archive");
+        return -1;
+    }
+    
+    long count = archive_export(format, ARCHIVE_PREFIX, write_file, &fd);
+    if (count < 0 || fsync(fd) < 0 || close(fd) < 0 || rename(temporary, filename) < 0) {
+        perror("Error: cannot write archive");
+        unlink(temporary);
+        return -1;
+    }
+    printf("Exported %ld entries to %s\n", count, filename);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef WEBSERVER_ARCHIVE_H
+#define WEBSERVER_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Archiv des dynamischen Stores zum Sichern und Befuellen, in zwei Formaten:
+//
+// Binaer: "TKNARCH1", dann pro Eintrag uint32 Key-Laenge, uint32
+// Wert-Laenge (Host-Byteorder), Key, Wert; ein Eintrag mit Key-Laenge 0
+// beendet das Archiv.
+//
+// NDJSON: eine Zeile pro Eintrag, {"key": "/dynamic/x", "value": "..."};
+// Strings sind Byte-Strings wie beim Mitschnitt (\u00XX fuer Bytes >= 0x80).
+
+#define ARCHIVE_MAGIC "TKNARCH1"
+
+typedef enum {
+    ARCHIVE_BINARY,
+    ARCHIVE_NDJSON,
+} ArchiveFormat;
+
+// Schreibt Daten weiter (Socket oder Datei); -1 bricht den Export ab
+typedef int (*ArchiveWrite)(void *context, const char *data, size_t length);
+
+// Exportiert alle Keys mit dem Praefix, auch grosse Werte (bulk.h); Anzahl
+// Eintraege oder -1. Ein grosser Wert ueber 4 GiB bricht den Export im
+// Binaerformat ab
+long archive_export(ArchiveFormat format, const char *prefix, ArchiveWrite write, void *context);
+
+typedef struct {
+    size_t imported;
+    size_t skipped;             // Key ausserhalb von /dynamic/, Wert zu gross (ohne --bulk-dir)
+    bool full;                  // Store voll, Rest verworfen
+    const char *error;          // Formatfehler, NULL wenn keiner
+} ArchiveStats;
+
+typedef struct ArchiveReader ArchiveReader;
+
+// Wird nach jedem importierten Key aufgerufen, z.B. fuer Watcher
+typedef void (*ArchiveChanged)(void *context, const char *key, size_t key_length);
+
+// Liest ein Archiv in Stuecken beliebiger Groesse; das Format wird am
+// Anfang erkannt. Eintraege mit Werten ab max_value_length werden als
+// grosse Werte gespeichert (bulk.h) oder, ohne --bulk-dir, verworfen.
+// changed darf NULL sein.
+ArchiveReader *archive_reader_new(size_t max_value_length, ArchiveChanged changed, void *context);
+
+// Verarbeitet die naechsten Bytes; -1 nach einem Formatfehler
+int archive_reader_feed(ArchiveReader *reader, const char *data, size_t length);
+
+// Schreibt den Rest in den Store, prueft das Archivende und gibt den Leser frei
+ArchiveStats archive_reader_finish(ArchiveReader *reader);
+
+// Importiert eine Archivdatei (beim Start, es wartet noch niemand)
+int archive_import_file(const char *filename, size_t max_value_length, ArchiveStats *stats);
+
+// Exportiert den ganzen Store in eine Datei (".ndjson"/".jsonl": NDJSON)
+int archive_export_file(const char *filename);
+
+#endif
@@ -0,0 +1,136 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "arena.h"
+
+// Standardgroesse auf x86-64 und arm64 (4K-Granule)
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static ArenaOptions arena_options;
+
+typedef struct {
+    char *base;
+    size_t size;
+    char **free_buffers;        // Stapel freier Puffer
+    size_t free_count;
+    pthread_mutex_t lock;
+} BufferPool;
+
+static BufferPool buffer_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+void arena_configure(const ArenaOptions *options) {
+    arena_options = *options;
+}
+
+static size_t round_up(size_t size, size_t alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Transparente Huge Pages gibt es nur fuer ausgerichtete 2-MiB-Bereiche:
+// mehr mappen und die Raender wieder freigeben
+static void *map_aligned(size_t size, size_t alignment) {
+    char *memory = mmap(NULL, size + alignment, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED || alignment == 0) return memory;
+    
+    char *aligned = (char *)round_up((size_t)memory, alignment);
+    if (aligned > memory) {
+        munmap(memory, aligned - memory);
+    }
+    munmap(aligned + size, memory + alignment - aligned);
+    return aligned;
+}
+
+void *arena_map(size_t size, const char *name) {
+    ArenaPages pages = arena_options.pages;
+    void *memory = MAP_FAILED;
+    
+    if (pages == ARENA_PAGES_EXPLICIT) {
+        size = round_up(size, HUGE_PAGE_SIZE);
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED) {
+            fprintf(stderr, "Warning: no explicit huge pages for %s arena (%s), "
+                    "using transparent huge pages\n", name, strerror(errno));
+            pages = ARENA_PAGES_TRANSPARENT;
+        }
+    }
+    
+    if (memory == MAP_FAILED) {
+        if (pages == ARENA_PAGES_TRANSPARENT) {
+            size = round_up(size, HUGE_PAGE_SIZE);
+        } else {
+            size = round_up(size, sysconf(_SC_PAGESIZE));
+        }
+        memory = map_aligned(size, pages == ARENA_PAGES_TRANSPARENT ? HUGE_PAGE_SIZE : 0);
+        if (memory == MAP_FAILED) {
+            perror("Error: cannot map arena");
+            return NULL;
+        }
+        if (pages == ARENA_PAGES_TRANSPARENT && madvise(memory, size, MADV_HUGEPAGE) < 0) {
+            perror("Warning: madvise(MADV_HUGEPAGE) failed");
+        }
+    }
+    
+    // Erst nach madvise anfassen, sonst entstehen normale Seiten. Jede
+    // kleine Seite anfassen: liefert der Kernel keine grosse Seite, waeren
+    // sonst nur die ersten 4 KiB jedes 2-MiB-Bereichs vorbelegt
+    if (arena_options.prefault) {
+        size_t step = sysconf(_SC_PAGESIZE);
+        for (size_t offset = 0; offset < size; offset += step) {
+            ((volatile char *)memory)[offset] = 0;
+        }
+    }
+    
+    if (arena_options.lock && mlock(memory, size) < 0) {
+        fprintf(stderr, "Warning: cannot mlock %s arena (%s)\n", name, strerror(errno));
+    }
+    
+    printf("Arena %s: %zu KiB%s%s%s\n", name, size / 1024,
+           pages == ARENA_PAGES_EXPLICIT ? ", explicit huge pages" :
+           pages == ARENA_PAGES_TRANSPARENT ? ", transparent huge pages" : "",
+           arena_options.prefault ? ", prefaulted" : "",
+           arena_options.lock ? ", locked" : "");
+    return memory;
+}
+
+int buffer_pool_init(size_t count, size_t size) {
+    buffer_pool.base = arena_map(count * size, "buffers");
+    buffer_pool.free_buffers = malloc(count * sizeof(char *));
+    if (!buffer_pool.base || !buffer_pool.free_buffers) {
+        fprintf(stderr, "Error: cannot set up buffer pool\n");
+        return -1;
+    }
+    
+    buffer_pool.size = size;
+    for (size_t i = 0; i < count; i++) {
+        buffer_pool.free_buffers[i] = buffer_pool.base + (count - 1 - i) * size;
+    }
+    buffer_pool.free_count = count;
+    return 0;
+}
+
+char *buffer_pool_acquire(void) {
+    char *buffer = NULL;
+    pthread_mutex_lock(&buffer_pool.lock);
+    if (buffer_pool.free_count > 0) {
+        buffer = buffer_pool.free_buffers[--buffer_pool.free_count];
+    }
+    pthread_mutex_unlock(&buffer_pool.lock);
+    return buffer;
+}
+
+void buffer_pool_release(char *buffer) {
+    pthread_mutex_lock(&buffer_pool.lock);
+    buffer_pool.free_buffers[buffer_pool.free_count++] = buffer;
+    pthread_mutex_unlock(&buffer_pool.lock);
+}
@@ -0,0 +1,38 @@
+#ifndef WEBSERVER_ARENA_H
+#define WEBSERVER_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Speicherbereiche, die beim Start einmal gemappt werden: Wert-Arena,
+// Store-Index und Verbindungspuffer. Optional mit Huge Pages, vorab
+// eingelagert (prefault) und gesperrt (mlock), damit im laufenden Betrieb
+// keine Page Faults mehr auftreten.
+
+typedef enum {
+    ARENA_PAGES_NORMAL,
+    ARENA_PAGES_TRANSPARENT,    // madvise(MADV_HUGEPAGE)
+    ARENA_PAGES_EXPLICIT,       // MAP_HUGETLB, sonst transparent
+} ArenaPages;
+
+typedef struct {
+    ArenaPages pages;
+    bool prefault;
+    bool lock;
+} ArenaOptions;
+
+// Gilt fuer alle folgenden arena_map()-Aufrufe
+void arena_configure(const ArenaOptions *options);
+
+// Mappt size Bytes (genullt, seitenausgerichtet); NULL bei Fehler
+void *arena_map(size_t size, const char *name);
+
+// Pool von count Puffern zu je size Bytes in einer Arena
+int buffer_pool_init(size_t count, size_t size);
+
+// Freier Puffer oder NULL, wenn alle vergeben sind
+char *buffer_pool_acquire(void);
+
+void buffer_pool_release(char *buffer);
+
+#endif
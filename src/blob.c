@@ -0,0 +1,298 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "arena.h"
+#include "blob.h"
+#include "lz.h"
+
+// Anzahl Buckets (Zweierpotenz); die Tabelle waechst nicht, die Ketten
+// bleiben bei einigen hundert Werten aber kurz
+#define BLOB_BUCKETS 1024
+
+// Groessenklassen der Arena: 64, 128, ... Bytes
+#define BLOB_MIN_CHUNK 64
+#define BLOB_CLASSES 24
+
+typedef struct FreeChunk {
+    struct FreeChunk *next;
+} FreeChunk;
+
+typedef struct {
+    Blob *buckets[BLOB_BUCKETS];
+    size_t count;
+    size_t bytes;
+    size_t stored_bytes;
+    size_t variant_bytes;
+    size_t compress_min;        // 0: nicht komprimieren
+    
+    // Wert-Arena: neue Chunks vom Anfang, freigegebene je Klasse in einer
+    // Liste; reicht sie nicht, wird auf malloc ausgewichen
+    char *arena;
+    size_t arena_size;
+    size_t arena_used;
+    FreeChunk *free_chunks[BLOB_CLASSES];
+    
+    pthread_mutex_t lock;
+} BlobTable;
+
+static BlobTable blobs = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+int blob_arena_init(size_t bytes, size_t max_length) {
+    // Die Groessenklassen runden hoechstens auf das Doppelte auf; dazu ein
+    // Wert maximaler Groesse, der gerade empfangen wird. Liegen Chunks
+    // ungenutzt in der Freiliste einer anderen Klasse, kommt der Rest von
+    // malloc
+    size_t largest = BLOB_MIN_CHUNK;
+    while (largest < sizeof(Blob) + max_length) largest *= 2;
+    
+    blobs.arena_size = 2 * bytes + largest;
+    blobs.arena = arena_map(blobs.arena_size, "values");
+    return blobs.arena ? 0 : -1;
+}
+
+void blob_configure_compression(size_t min_length) {
+    blobs.compress_min = min_length;
+}
+
+static int blob_chunk_class(size_t size) {
+    int chunk_class = 0;
+    while (((size_t)BLOB_MIN_CHUNK << chunk_class) < size) chunk_class++;
+    return chunk_class;
+}
+
+// Aufrufer haelt den Lock
+static Blob *blob_alloc(size_t size) {
+    int chunk_class = blob_chunk_class(size);
+    size_t chunk_size = (size_t)BLOB_MIN_CHUNK << chunk_class;
+    
+    if (chunk_class < BLOB_CLASSES && blobs.free_chunks[chunk_class]) {
+        FreeChunk *chunk = blobs.free_chunks[chunk_class];
+        blobs.free_chunks[chunk_class] = chunk->next;
+        return (Blob *)chunk;
+    }
+    if (chunk_class < BLOB_CLASSES && blobs.arena_used + chunk_size <= blobs.arena_size) {
+        Blob *blob = (Blob *)(blobs.arena + blobs.arena_used);
+        blobs.arena_used += chunk_size;
+        return blob;
+    }
+    return malloc(size);
+}
+
+// Aufrufer haelt den Lock
+static void blob_free(Blob *blob) {
+    char *address = (char *)blob;
+    if (address < blobs.arena || address >= blobs.arena + blobs.arena_size) {
+        free(blob);
+        return;
+    }
+    
+    int chunk_class = blob_chunk_class(sizeof(Blob) + blob->stored_length);
+    FreeChunk *chunk = (FreeChunk *)blob;
+    chunk->next = blobs.free_chunks[chunk_class];
+    blobs.free_chunks[chunk_class] = chunk;
+}
+
+static uint64_t blob_mix(uint64_t hash) {
+    hash ^= hash >> 32;
+    hash *= 0xd6e8feb86659fd93ULL;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Verarbeitet 8 Bytes pro Schritt; memcpy vermeidet unausgerichtete Zugriffe
+uint64_t blob_hash(const char *data, size_t length) {
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+    size_t i = 0;
+    
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+        hash = (hash << 29) | (hash >> 35);
+    }
+    
+    uint64_t tail = 0;
+    memcpy(&tail, data + i, length - i);
+    hash = (hash ^ tail) * 0xff51afd7ed558ccdULL;
+    return blob_mix(hash);
+}
+
+// Aufrufer haelt den Lock; vorhandener Blob mit diesem Inhalt oder NULL
+static Blob *blob_find(uint64_t hash, size_t length, const char *stored, size_t stored_length) {
+    for (Blob *blob = blobs.buckets[hash & (BLOB_BUCKETS - 1)]; blob; blob = blob->next) {
+        if (blob->hash == hash && blob->length == length &&
+            blob->stored_length == stored_length &&
+            memcmp(blob->data, stored, stored_length) == 0) {
+            return blob;
+        }
+    }
+    return NULL;
+}
+
+// Aufrufer haelt den Lock; haengt einen fertig befuellten Blob ein
+static void blob_add(Blob *blob, uint64_t hash) {
+    Blob **bucket = &blobs.buckets[hash & (BLOB_BUCKETS - 1)];
+    memset(blob->variants, 0, sizeof(blob->variants));
+    blob->hash = hash;
+    blob->refcount = 1;
+    blob->next = *bucket;
+    *bucket = blob;
+    blobs.count++;
+    blobs.bytes += blob->length;
+    blobs.stored_bytes += blob->stored_length;
+}
+
+Blob *blob_intern(const char *data, size_t length) {
+    uint64_t hash = blob_hash(data, length);
+    
+    // Nur behalten, wenn es mindestens ein Achtel spart; sonst kostet das
+    // Entpacken beim Lesen mehr, als die kleinere Groessenklasse bringt.
+    // Der Codec ist deterministisch, gleiche Inhalte ergeben also gleiche
+    // komprimierte Bytes und werden weiter zusammengelegt.
+    const char *stored = data;
+    size_t stored_length = length;
+    char *packed = NULL;
+    if (blobs.compress_min && length >= blobs.compress_min && length <= UINT32_MAX) {
+        packed = malloc(length);
+        size_t packed_length = packed ? lz_compress(data, length, packed, length - length / 8) : 0;
+        if (packed_length > 0) {
+            stored = packed;
+            stored_length = packed_length;
+        }
+    }
+    
+    pthread_mutex_lock(&blobs.lock);
+    Blob *blob = blob_find(hash, length, stored, stored_length);
+    if (blob) {
+        blob->refcount++;
+    } else if ((blob = blob_alloc(sizeof(Blob) + stored_length))) {
+        blob->stored_length = stored_length;
+        blob->length = length;
+        memcpy(blob->data, stored, stored_length);
+        blob_add(blob, hash);
+    }
+    pthread_mutex_unlock(&blobs.lock);
+    free(packed);
+    return blob;
+}
+
+Blob *blob_reserve(size_t length) {
+    if (length > UINT32_MAX) return NULL;
+    pthread_mutex_lock(&blobs.lock);
+    Blob *reserved = blob_alloc(sizeof(Blob) + length);
+    pthread_mutex_unlock(&blobs.lock);
+    if (reserved) {
+        reserved->stored_length = length;
+        reserved->length = length;
+    }
+    return reserved;
+}
+
+Blob *blob_commit(Blob *reserved) {
+    // Komprimiert wird in einen eigenen Chunk der kleineren Klasse
+    if (blobs.compress_min && reserved->length >= blobs.compress_min) {
+        Blob *blob = blob_intern(reserved->data, reserved->length);
+        blob_cancel(reserved);
+        return blob;
+    }
+    
+    uint64_t hash = blob_hash(reserved->data, reserved->length);
+    pthread_mutex_lock(&blobs.lock);
+    Blob *blob = blob_find(hash, reserved->length, reserved->data, reserved->length);
+    if (blob) {
+        blob->refcount++;
+        blob_free(reserved);
+    } else {
+        blob = reserved;
+        blob_add(blob, hash);
+    }
+    pthread_mutex_unlock(&blobs.lock);
+    return blob;
+}
+
+void blob_cancel(Blob *reserved) {
+    if (!reserved) return;
+    pthread_mutex_lock(&blobs.lock);
+    blob_free(reserved);
+    pthread_mutex_unlock(&blobs.lock);
+}
+
+Blob *blob_ref(Blob *blob) {
+    pthread_mutex_lock(&blobs.lock);
+    blob->refcount++;
+    pthread_mutex_unlock(&blobs.lock);
+    return blob;
+}
+
+void blob_release(Blob *blob) {
+    if (!blob) return;
+    
+    pthread_mutex_lock(&blobs.lock);
+    if (--blob->refcount > 0) {
+        pthread_mutex_unlock(&blobs.lock);
+        return;
+    }
+    
+    Blob **link = &blobs.buckets[blob->hash & (BLOB_BUCKETS - 1)];
+    while (*link != blob) {
+        link = &(*link)->next;
+    }
+    *link = blob->next;
+    blobs.count--;
+    blobs.bytes -= blob->length;
+    blobs.stored_bytes -= blob->stored_length;
+    for (int i = 0; i < BLOB_VARIANTS; i++) {
+        if (blob->variants[i]) blobs.variant_bytes -= blob->variants[i]->length;
+        free(blob->variants[i]);
+    }
+    blob_free(blob);
+    pthread_mutex_unlock(&blobs.lock);
+}
+
+const char *blob_contents(const Blob *blob, char *scratch) {
+    if (!blob_compressed(blob)) return blob->data;
+    if (!scratch) return NULL;
+    if (lz_decompress(blob->data, blob->stored_length, scratch, blob->length) < 0) {
+        fprintf(stderr, "Error: corrupt compressed value\n");
+        return NULL;
+    }
+    return scratch;
+}
+
+const BlobVariant *blob_variant(Blob *blob, int index) {
+    pthread_mutex_lock(&blobs.lock);
+    const BlobVariant *variant = blob->variants[index];
+    pthread_mutex_unlock(&blobs.lock);
+    return variant;
+}
+
+const BlobVariant *blob_set_variant(Blob *blob, int index, BlobVariant *variant) {
+    pthread_mutex_lock(&blobs.lock);
+    if (blob->variants[index]) {
+        free(variant);
+        variant = blob->variants[index];
+    } else if (blobs.variant_bytes + variant->length > BLOB_VARIANT_BYTES) {
+        free(variant);
+        variant = NULL;
+    } else {
+        blob->variants[index] = variant;
+        blobs.variant_bytes += variant->length;
+    }
+    pthread_mutex_unlock(&blobs.lock);
+    return variant;
+}
+
+void blob_stats(size_t *count, size_t *bytes, size_t *stored_bytes, size_t *variant_bytes) {
+    pthread_mutex_lock(&blobs.lock);
+    *count = blobs.count;
+    *bytes = blobs.bytes;
+    *stored_bytes = blobs.stored_bytes;
+    *variant_bytes = blobs.variant_bytes;
+    pthread_mutex_unlock(&blobs.lock);
+}
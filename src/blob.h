@@ -0,0 +1,86 @@
+#ifndef WEBSERVER_BLOB_H
+#define WEBSERVER_BLOB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Inhaltsadressierte, unveraenderliche Werte: gleiche Bodies werden nur
+// einmal gespeichert und ueber einen Referenzzaehler geteilt. Gesucht wird
+// ueber einen 64-Bit-Hash, bei Treffern wird der Inhalt verglichen.
+// Mit blob_configure_compression werden groessere Werte LZ-komprimiert
+// abgelegt, wenn sie dadurch schrumpfen.
+
+// Anzahl Plaetze fuer kodierte Varianten (Index: ContentEncoding)
+#define BLOB_VARIANTS 3
+
+// Obergrenze fuer alle Varianten zusammen; sie liegen neben der Arena und
+// zaehlen zu keiner Collection, da mehrere Keys einen Blob teilen
+#define BLOB_VARIANT_BYTES (8 * 1024 * 1024)
+
+// Einmal erzeugte Kodierung eines Blobs, z.B. gzip fuer Antworten
+typedef struct {
+    size_t length;
+    char data[];
+} BlobVariant;
+
+typedef struct Blob {
+    struct Blob *next;          // Kette im Hash-Bucket
+    BlobVariant *variants[BLOB_VARIANTS];
+    uint64_t hash;              // ueber den unkomprimierten Inhalt
+    uint32_t refcount;
+    uint32_t stored_length;     // Bytes in data, kleiner als length wenn komprimiert
+    size_t length;              // unkomprimierte Laenge
+    char data[];
+} Blob;
+
+static inline bool blob_compressed(const Blob *blob) {
+    return blob->stored_length < blob->length;
+}
+
+// Legt die Wert-Arena fuer Werte mit zusammen bytes gespeicherten Bytes an,
+// jeder bis max_length Bytes
+int blob_arena_init(size_t bytes, size_t max_length);
+
+// Komprimiert neue Werte ab min_length Bytes; 0 schaltet ab
+void blob_configure_compression(size_t min_length);
+
+uint64_t blob_hash(const char *data, size_t length);
+
+// Liefert einen Blob mit diesem Inhalt (vorhanden oder neu) mit einer
+// zusaetzlichen Referenz; NULL, wenn kein Speicher frei ist
+Blob *blob_intern(const char *data, size_t length);
+
+// Direktempfang: reserviert Platz fuer length Bytes in der Wert-Arena, den
+// der Aufrufer ueber data fuellt (z.B. per recv()); NULL, wenn kein
+// Speicher frei ist. blob_commit() macht daraus einen Blob wie
+// blob_intern() (die Reservierung ist danach verbraucht, auch bei NULL),
+// blob_cancel() gibt sie unbenutzt zurueck.
+Blob *blob_reserve(size_t length);
+Blob *blob_commit(Blob *reserved);
+void blob_cancel(Blob *reserved);
+
+// Weitere Referenz auf einen Blob, den der Aufrufer bereits haelt
+Blob *blob_ref(Blob *blob);
+
+// Gibt eine Referenz frei; die letzte gibt den Speicher frei
+void blob_release(Blob *blob);
+
+// Unkomprimierter Inhalt: data selbst oder nach scratch (mindestens
+// length Bytes) entpackt; NULL bei beschaedigten Daten
+const char *blob_contents(const Blob *blob, char *scratch);
+
+// Zwischengespeicherte Variante oder NULL. Da Blobs unveraenderlich sind,
+// gilt eine Variante fuer alle Versionen mit diesem Inhalt.
+const BlobVariant *blob_variant(Blob *blob, int index);
+
+// Uebernimmt variant (per malloc) als Variante; hat ein anderer Thread
+// schon eine abgelegt, wird variant freigegeben und jene geliefert. NULL
+// (variant freigegeben), wenn sie BLOB_VARIANT_BYTES ueberschreiten wuerde.
+const BlobVariant *blob_set_variant(Blob *blob, int index, BlobVariant *variant);
+
+// Anzahl gespeicherter Blobs, deren unkomprimierte und belegte Bytes sowie
+// die Bytes ihrer Varianten
+void blob_stats(size_t *count, size_t *bytes, size_t *stored_bytes, size_t *variant_bytes);
+
+#endif
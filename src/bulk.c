@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "blob.h"
+#include "bulk.h"
+
+#define BULK_MAGIC "TKNBLK01"
+
+// Groessere Pipe, weniger splice()-Paare pro Upload (darf fehlschlagen)
+#define BULK_PIPE_SIZE (1024 * 1024)
+
+// Steht vor den Daten jeder Datei
+typedef struct {
+    char magic[8];
+    uint64_t version;
+    uint64_t length;
+    uint32_t key_length;
+    char key[BULK_MAX_KEY];
+} BulkHeader;
+
+typedef struct {
+    char *directory;
+    int pipe[2];                // splice() Socket -> pipe[1], pipe[0] -> Datei
+    size_t pipe_size;
+    unsigned next_upload;
+} BulkStore;
+
+static BulkStore bulk = {NULL, {-1, -1}, 0, 0};
+
+static int read_fully(int fd, void *data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t bytes_read = pread(fd, data, length, offset);
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read <= 0) return -1;
+        data = (char *)data + bytes_read;
+        length -= bytes_read;
+        offset += bytes_read;
+    }
+    return 0;
+}
+
+static int write_fully(int fd, const void *data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data = (const char *)data + written;
+        length -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+static void value_path(char *path, uint64_t hash) {
+    snprintf(path, PATH_MAX, "%s/%016llx.val", bulk.directory, (unsigned long long)hash);
+}
+
+static void upload_path(char *path, unsigned number) {
+    snprintf(path, PATH_MAX, "%s/upload-%u.tmp", bulk.directory, number);
+}
+
+// Kopf der Datei fd, wenn sie zu key gehoert (key NULL: zu irgendeinem)
+static int read_header(int fd, const char *key, size_t key_length, BulkHeader *header) {
+    if (read_fully(fd, header, sizeof(*header), 0) < 0 ||
+        memcmp(header->magic, BULK_MAGIC, sizeof(header->magic)) != 0 ||
+        header->key_length >= BULK_MAX_KEY) {
+        return -1;
+    }
+    if (key && (header->key_length != key_length || memcmp(header->key, key, key_length) != 0)) {
+        return 0;
+    }
+    return 1;
+}
+
+static int open_pipe(void) {
+    if (pipe2(bulk.pipe, O_CLOEXEC) < 0) {
+        perror("Error: cannot create pipe");
+        return -1;
+    }
+    int size = fcntl(bulk.pipe[1], F_SETPIPE_SZ, BULK_PIPE_SIZE);
+    if (size < 0) size = fcntl(bulk.pipe[1], F_GETPIPE_SZ);
+    bulk.pipe_size = size > 0 ? size : 65536;
+    return 0;
+}
+
+// Nach einem Fehler koennen noch Daten in der Pipe stecken
+static void reset_pipe(void) {
+    close(bulk.pipe[0]);
+    close(bulk.pipe[1]);
+    open_pipe();
+}
+
+int bulk_open(const char *directory, uint64_t *last_version) {
+    bulk.directory = strdup(directory);
+    if (!bulk.directory || (mkdir(directory, 0755) < 0 && errno != EEXIST)) {
+        perror("Error: cannot create bulk directory");
+        return -1;
+    }
+    
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        perror("Error: cannot open bulk directory");
+        return -1;
+    }
+    size_t count = 0;
+    *last_version = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        size_t name_length = strlen(entry->d_name);
+        if (name_length > 4 && strcmp(entry->d_name + name_length - 4, ".tmp") == 0) {
+            // Vor dem Neustart nicht abgeschlossen
+            unlink(path);
+            continue;
+        }
+        if (name_length != 20 || strcmp(entry->d_name + 16, ".val") != 0) continue;
+        
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        BulkHeader header;
+        if (fd >= 0 && read_header(fd, NULL, 0, &header) == 1) {
+            if (header.version > *last_version) *last_version = header.version;
+            count++;
+        }
+        if (fd >= 0) close(fd);
+    }
+    closedir(dir);
+    
+    if (open_pipe() < 0) return -1;
+    printf("Bulk values %s: %zu files\n", directory, count);
+    return 0;
+}
+
+bool bulk_enabled(void) {
+    return bulk.directory != NULL;
+}
+
+int bulk_get(const char *key, size_t key_length, BulkValue *value) {
+    char path[PATH_MAX];
+    value_path(path, blob_hash(key, key_length));
+    value->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (value->fd < 0) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    
+    BulkHeader header;
+    int found = read_header(value->fd, key, key_length, &header);
+    if (found != 1) {
+        bulk_close(value);
+        return found;
+    }
+    value->offset = sizeof(header);
+    value->length = header.length;
+    value->version = header.version;
+    return 1;
+}
+
+void bulk_close(BulkValue *value) {
+    if (value->fd >= 0) close(value->fd);
+    value->fd = -1;
+}
+
+long bulk_scan(const char *prefix, BulkScan callback, void *context) {
+    DIR *dir = opendir(bulk.directory);
+    if (!dir) {
+        perror("Error: cannot open bulk directory");
+        return -1;
+    }
+    size_t prefix_length = strlen(prefix);
+    long count = 0;
+    int result = 0;
+    struct dirent *entry;
+    while (result == 0 && (entry = readdir(dir))) {
+        size_t name_length = strlen(entry->d_name);
+        if (name_length != 20 || strcmp(entry->d_name + 16, ".val") != 0) continue;
+        
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", bulk.directory, entry->d_name);
+        BulkHeader header;
+        BulkValue value = {open(path, O_RDONLY | O_CLOEXEC), sizeof(header), 0, 0};
+        // Zwischendurch ersetzte oder geloeschte Dateien fehlen einfach
+        if (value.fd < 0) continue;
+        if (read_header(value.fd, NULL, 0, &header) == 1 && header.key_length >= prefix_length &&
+            memcmp(header.key, prefix, prefix_length) == 0) {
+            value.length = header.length;
+            value.version = header.version;
+            result = callback(context, header.key, header.key_length, &value);
+            count++;
+        }
+        bulk_close(&value);
+    }
+    closedir(dir);
+    return result < 0 ? -1 : count;
+}
+
+uint64_t bulk_version(const char *key, size_t key_length) {
+    BulkValue value;
+    if (bulk_get(key, key_length, &value) != 1) return 0;
+    bulk_close(&value);
+    return value.version;
+}
+
+int bulk_remove(const char *key, size_t key_length) {
+    BulkValue value;
+    if (bulk_get(key, key_length, &value) != 1) return 0;
+    bulk_close(&value);
+    
+    char path[PATH_MAX];
+    value_path(path, blob_hash(key, key_length));
+    return unlink(path) == 0 ? 1 : 0;
+}
+
+int bulk_create(BulkUpload *upload, const char *key, size_t key_length, size_t length) {
+    if (key_length >= BULK_MAX_KEY) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    
+    // Die Datei eines anderen Keys mit gleichem Hash nicht ueberschreiben
+    upload->hash = blob_hash(key, key_length);
+    char path[PATH_MAX];
+    value_path(path, upload->hash);
+    int existing = open(path, O_RDONLY | O_CLOEXEC);
+    if (existing >= 0) {
+        BulkHeader header;
+        int same_key = read_header(existing, key, key_length, &header);
+        close(existing);
+        if (same_key == 0) {
+            errno = EEXIST;
+            return -1;
+        }
+    }
+    
+    upload->number = bulk.next_upload++;
+    upload_path(path, upload->number);
+    upload->fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (upload->fd < 0) return -1;
+    upload->length = length;
+    upload->written = 0;
+    upload->key_length = key_length;
+    memcpy(upload->key, key, key_length);
+    
+    // Platz vorab belegen: eine volle Platte faellt vor dem Empfang auf
+    int error = posix_fallocate(upload->fd, 0, sizeof(BulkHeader) + length);
+    if (error != 0 && error != EOPNOTSUPP && error != EINVAL) {
+        bulk_abort(upload);
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+int bulk_write(BulkUpload *upload, const char *data, size_t length) {
+    if (length > upload->length - upload->written) length = upload->length - upload->written;
+    if (write_fully(upload->fd, data, length, sizeof(BulkHeader) + upload->written) < 0) {
+        return -1;
+    }
+    upload->written += length;
+    return 0;
+}
+
+ssize_t bulk_splice(BulkUpload *upload, int socket_fd) {
+    size_t remaining = upload->length - upload->written;
+    ssize_t moved = splice(socket_fd, NULL, bulk.pipe[1], NULL,
+                           remaining < bulk.pipe_size ? remaining : bulk.pipe_size,
+                           SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (moved <= 0) return moved;
+    
+    // Pipe vollstaendig in die Datei leeren, bevor wieder gelesen wird
+    for (size_t pending = moved; pending > 0;) {
+        loff_t offset = sizeof(BulkHeader) + upload->written;
+        ssize_t written = splice(bulk.pipe[0], NULL, upload->fd, &offset, pending, SPLICE_F_MOVE);
+        if (written <= 0) {
+            if (written < 0 && errno == EINTR) continue;
+            int error = written < 0 ? errno : EIO;
+            reset_pipe();
+            errno = error;
+            return -1;
+        }
+        upload->written += written;
+        pending -= written;
+    }
+    return moved;
+}
+
+int bulk_commit(BulkUpload *upload, uint64_t version) {
+    BulkHeader header = {BULK_MAGIC, version, upload->length, upload->key_length, {0}};
+    memcpy(header.key, upload->key, upload->key_length);
+    
+    char temp[PATH_MAX], path[PATH_MAX];
+    upload_path(temp, upload->number);
+    value_path(path, upload->hash);
+    bool complete = upload->written == upload->length &&
+                    write_fully(upload->fd, &header, sizeof(header), 0) == 0;
+    if (close(upload->fd) < 0) complete = false;
+    if (!complete || rename(temp, path) < 0) {
+        perror("Error: cannot store bulk value");
+        unlink(temp);
+        return -1;
+    }
+    return 0;
+}
+
+void bulk_abort(BulkUpload *upload) {
+    char path[PATH_MAX];
+    upload_path(path, upload->number);
+    close(upload->fd);
+    unlink(path);
+}
@@ -0,0 +1,75 @@
+#ifndef WEBSERVER_BULK_H
+#define WEBSERVER_BULK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Grosse Werte als Dateien: PUT-Bodies, die nicht in den Verbindungspuffer
+// passen, laufen per splice() vom Socket ueber eine Pipe in eine Datei
+// unter DIR, GET liefert sie per sendfile() aus. Die Daten kommen dabei nie
+// in den Userspace. Pro Key eine Datei (DIR/<Key-Hash>.val), ein Kopf vor
+// den Daten haelt Key und Version. Ein Key liegt entweder im Store oder
+// hier, nie in beiden.
+
+#define BULK_MAX_KEY 256
+
+// Laufender Upload in eine temporaere Datei, erst bulk_commit() macht ihn
+// sichtbar
+typedef struct {
+    int fd;
+    unsigned number;            // DIR/upload-NNN.tmp
+    uint64_t hash;
+    size_t length;
+    size_t written;
+    uint32_t key_length;
+    char key[BULK_MAX_KEY];
+} BulkUpload;
+
+// Geoeffneter Wert: length Bytes ab offset in fd
+typedef struct {
+    int fd;
+    off_t offset;
+    size_t length;
+    uint64_t version;
+} BulkValue;
+
+// Oeffnet oder legt DIR an; abgebrochene Uploads werden entfernt.
+// last_version ist die hoechste gespeicherte Version.
+int bulk_open(const char *directory, uint64_t *last_version);
+
+bool bulk_enabled(void);
+
+// 1: gefunden (mit bulk_close schliessen), 0: nicht vorhanden, -1: Lesefehler
+int bulk_get(const char *key, size_t key_length, BulkValue *value);
+void bulk_close(BulkValue *value);
+
+// Ruft callback fuer jeden Wert mit dem Praefix auf (value wird danach
+// geschlossen); -1 vom Callback bricht ab. Anzahl Werte oder -1
+typedef int (*BulkScan)(void *context, const char *key, size_t key_length,
+                        const BulkValue *value);
+long bulk_scan(const char *prefix, BulkScan callback, void *context);
+
+// Version des Keys, 0 wenn nicht vorhanden
+uint64_t bulk_version(const char *key, size_t key_length);
+
+// 1: entfernt, 0: nicht vorhanden
+int bulk_remove(const char *key, size_t key_length);
+
+// Legt die temporaere Datei fuer length Bytes an; -1 mit errno (ENOSPC,
+// ENAMETOOLONG, EEXIST bei Hash-Kollision mit einem anderen Key)
+int bulk_create(BulkUpload *upload, const char *key, size_t key_length, size_t length);
+
+// Haengt Bytes an, die schon im Userspace liegen (z.B. Rest im Puffer)
+int bulk_write(BulkUpload *upload, const char *data, size_t length);
+
+// Bewegt bis zum Ende des Bodys, was der Socket gerade liefert, in die
+// Datei; Rueckgabe wie recv()
+ssize_t bulk_splice(BulkUpload *upload, int socket_fd);
+
+// Ersetzt einen vorhandenen Wert atomar (rename)
+int bulk_commit(BulkUpload *upload, uint64_t version);
+void bulk_abort(BulkUpload *upload);
+
+#endif
@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <signal.h>
+
+#include "capture.h"
+
+// Maximal ausstehende Eintraege; ist die Queue voll, wird verworfen
+#define CAPTURE_QUEUE_SIZE 1024
+
+typedef struct {
+    char *request;
+    size_t length;
+    uint64_t timestamp_us;
+} CaptureEntry;
+
+typedef struct {
+    FILE *file;
+    unsigned sample_every;
+    unsigned long seen;
+    unsigned long written;
+    unsigned long dropped;
+    uint64_t last_timestamp_us;
+    
+    CaptureEntry queue[CAPTURE_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    bool stopping;
+    
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_t writer;
+} Capture;
+
+static Capture capture = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .not_empty = PTHREAD_COND_INITIALIZER,
+};
+
+static uint64_t capture_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Schreibt ein Byte-Array als JSON-String
+static void capture_write_string(FILE *out, const char *data, size_t length) {
+    fputc('"', out);
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = data[i];
+        switch (c) {
+        case '"':  fputs("\\\"", out); break;
+        case '\\': fputs("\\\\", out); break;
+        case '\n': fputs("\\n", out); break;
+        case '\r': fputs("\\r", out); break;
+        case '\t': fputs("\\t", out); break;
+        default:
+            if (c < 0x20 || c >= 0x7f) {
+                fprintf(out, "\\u%04x", c);
+            } else {
+                fputc(c, out);
+            }
+        }
+    }
+    fputc('"', out);
+}
+
+// Zerlegt den Request in Request-Zeile, Header und Body und schreibt eine Zeile
+static void capture_write_entry(FILE *out, unsigned long id, const CaptureEntry *entry,
+                                uint64_t gap_us) {
+    const char *request = entry->request;
+    const char *end = request + entry->length;
+    const char *line_end = memmem(request, entry->length, "\r\n", 2);
+    if (!line_end) line_end = end;
+    
+    const char *method_end = memchr(request, ' ', line_end - request);
+    if (!method_end) method_end = line_end;
+    const char *path = method_end < line_end ? method_end + 1 : line_end;
+    const char *path_end = memchr(path, ' ', line_end - path);
+    if (!path_end) path_end = line_end;
+    
+    fprintf(out, "{\"request_id\": \"capture-%lu\", \"method\": ", id);
+    capture_write_string(out, request, method_end - request);
+    fputs(", \"path\": ", out);
+    capture_write_string(out, path, path_end - path);
+    fputs(", \"headers\": [", out);
+    
+    const char *body = end;
+    const char *line = line_end < end ? line_end + 2 : end;
+    bool first = true;
+    while (line < end) {
+        const char *next = memmem(line, end - line, "\r\n", 2);
+        if (!next) next = end;
+        if (next == line) {
+            body = next + 2 <= end ? next + 2 : end;
+            break;
+        }
+        const char *colon = memchr(line, ':', next - line);
+        if (colon) {
+            const char *value = colon + 1;
+            while (value < next && (*value == ' ' || *value == '\t')) value++;
+            fputs(first ? "[" : ", [", out);
+            capture_write_string(out, line, colon - line);
+            fputs(", ", out);
+            capture_write_string(out, value, next - value);
+            fputc(']', out);
+            first = false;
+        }
+        line = next + 2;
+    }
+    
+    fputs("], \"body\": ", out);
+    capture_write_string(out, body, end - body);
+    fprintf(out, ", \"gap_us\": %llu}\n", (unsigned long long)gap_us);
+}
+
+static void *capture_writer_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&capture.lock);
+    while (1) {
+        while (capture.count == 0 && !capture.stopping) {
+            // Nichts zu tun: gepufferte Zeilen rausschreiben, dann warten
+            pthread_mutex_unlock(&capture.lock);
+            fflush(capture.file);
+            pthread_mutex_lock(&capture.lock);
+            if (capture.count == 0 && !capture.stopping) {
+                pthread_cond_wait(&capture.not_empty, &capture.lock);
+            }
+        }
+        if (capture.count == 0 && capture.stopping) break;
+        
+        CaptureEntry entry = capture.queue[capture.head];
+        capture.head = (capture.head + 1) % CAPTURE_QUEUE_SIZE;
+        capture.count--;
+        pthread_mutex_unlock(&capture.lock);
+        
+        uint64_t gap_us = capture.written ? entry.timestamp_us - capture.last_timestamp_us : 0;
+        capture.last_timestamp_us = entry.timestamp_us;
+        capture_write_entry(capture.file, ++capture.written, &entry, gap_us);
+        free(entry.request);
+        
+        pthread_mutex_lock(&capture.lock);
+    }
+    pthread_mutex_unlock(&capture.lock);
+    fflush(capture.file);
+    return NULL;
+}
+
+int capture_open(const char *filename, unsigned sample_every) {
+    capture.file = fopen(filename, "a");
+    if (!capture.file) {
+        perror("Error: cannot open capture file");
+        return -1;
+    }
+    capture.sample_every = sample_every ? sample_every : 1;
+    
+    // SIGINT/SIGTERM muessen beim Hauptthread ankommen, nicht beim Writer
+    sigset_t blocked, previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+    int result = pthread_create(&capture.writer, NULL, capture_writer_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    
+    if (result != 0) {
+        fprintf(stderr, "Error: cannot start capture writer\n");
+        fclose(capture.file);
+        capture.file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+bool capture_enabled(void) {
+    return capture.file != NULL;
+}
+
+void capture_request(const char *request, size_t length) {
+    if (!capture.file) return;
+    
+    uint64_t now = capture_now_us();
+    pthread_mutex_lock(&capture.lock);
+    if (capture.seen++ % capture.sample_every != 0) {
+        pthread_mutex_unlock(&capture.lock);
+        return;
+    }
+    if (capture.count == CAPTURE_QUEUE_SIZE) {
+        capture.dropped++;
+        pthread_mutex_unlock(&capture.lock);
+        return;
+    }
+    pthread_mutex_unlock(&capture.lock);
+    
+    // Kopie ausserhalb des Locks, der Writer blockiert so nie den Request
+    char *copy = malloc(length);
+    if (!copy) return;
+    memcpy(copy, request, length);
+    
+    pthread_mutex_lock(&capture.lock);
+    if (capture.count == CAPTURE_QUEUE_SIZE) {
+        capture.dropped++;
+        pthread_mutex_unlock(&capture.lock);
+        free(copy);
+        return;
+    }
+    size_t tail = (capture.head + capture.count) % CAPTURE_QUEUE_SIZE;
+    capture.queue[tail] = (CaptureEntry){copy, length, now};
+    capture.count++;
+    pthread_cond_signal(&capture.not_empty);
+    pthread_mutex_unlock(&capture.lock);
+}
+
+void capture_close(void) {
+    if (!capture.file) return;
+    
+    pthread_mutex_lock(&capture.lock);
+    capture.stopping = true;
+    pthread_cond_signal(&capture.not_empty);
+    pthread_mutex_unlock(&capture.lock);
+    pthread_join(capture.writer, NULL);
+    
+    if (capture.dropped) {
+        fprintf(stderr, "Capture: %lu requests dropped (queue full)\n", capture.dropped);
+    }
+    fclose(capture.file);
+    capture.file = NULL;
+}
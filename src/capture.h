@@ -0,0 +1,26 @@
+#ifndef WEBSERVER_CAPTURE_H
+#define WEBSERVER_CAPTURE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Mitschnitt eingehender Requests als JSONL (eine Zeile pro Request):
+//   {"request_id": "capture-1", "method": "PUT", "path": "/dynamic/x",
+//    "headers": [["Content-Length", "3"]], "body": "abc", "gap_us": 1520}
+//
+// Strings sind Byte-Strings: Bytes >= 0x80 und Steuerzeichen werden als
+// \u00XX kodiert. gap_us ist der Abstand zum vorherigen mitgeschnittenen
+// Request. Formatiert und geschrieben wird in einem eigenen Thread.
+
+// Startet den Writer-Thread; jeder sample_every-te Request wird mitgeschnitten
+int capture_open(const char *filename, unsigned sample_every);
+
+// Reiht einen vollstaendigen Request ein (kopiert die Bytes, blockiert nie)
+void capture_request(const char *request, size_t length);
+
+// Schreibt ausstehende Eintraege und beendet den Writer-Thread
+void capture_close(void);
+
+bool capture_enabled(void);
+
+#endif
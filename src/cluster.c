@@ -0,0 +1,124 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cluster.h"
+#include "httpclient.h"
+
+#define MAX_POINT_NAME 160
+
+typedef struct {
+    uint64_t hash;
+    int node;
+} RingPoint;
+
+static HttpPeer nodes[CLUSTER_MAX_NODES];   // name wie in der Peer-Liste
+static size_t node_count;
+static int self_node = -1;
+static RingPoint ring[CLUSTER_MAX_NODES * CLUSTER_VIRTUAL_NODES];
+static size_t ring_size;
+
+// FNV-1a mit Nachmischung (splitmix64), damit auch aehnliche Namen wie
+// "host:4711#1" und "host:4711#2" gleichmaessig ueber den Ring streuen
+static uint64_t ring_hash(const char *data, size_t length) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+    return hash ^ (hash >> 31);
+}
+
+static int compare_points(const void *a, const void *b) {
+    const RingPoint *left = a;
+    const RingPoint *right = b;
+    if (left->hash != right->hash) return left->hash < right->hash ? -1 : 1;
+    // Gleicher Hash (sehr selten): Reihenfolge unabhaengig von der Peer-Liste
+    return strcmp(nodes[left->node].name, nodes[right->node].name);
+}
+
+static int add_node(const char *name, size_t length) {
+    if (node_count == CLUSTER_MAX_NODES) return -1;
+    HttpPeer *node = &nodes[node_count];
+    if (http_peer_init(node, name, length, CLUSTER_TIMEOUT_SECONDS) < 0) return -1;
+    for (size_t i = 0; i < node_count; i++) {
+        if (strcmp(nodes[i].name, node->name) == 0) return -1;
+    }
+    
+    // Die Punkte haengen nur am Namen: ein neuer Knoten uebernimmt nur die
+    // Abschnitte vor seinen eigenen Punkten
+    for (int i = 0; i < CLUSTER_VIRTUAL_NODES; i++) {
+        char point[MAX_POINT_NAME];
+        int point_length = snprintf(point, sizeof(point), "%s#%d", node->name, i);
+        ring[ring_size++] = (RingPoint){ring_hash(point, point_length), (int)node_count};
+    }
+    node_count++;
+    return 0;
+}
+
+int cluster_init(const char *list, const char *self) {
+    for (const char *pos = list; *pos;) {
+        const char *end = strchr(pos, ',');
+        size_t length = end ? (size_t)(end - pos) : strlen(pos);
+        if (add_node(pos, length) < 0) {
+            fprintf(stderr, "Error: invalid cluster node '%.*s' (expected unique HOST:PORT)\n",
+                    (int)length, pos);
+            return -1;
+        }
+        pos += length + (end ? 1 : 0);
+    }
+    qsort(ring, ring_size, sizeof(RingPoint), compare_points);
+    
+    for (size_t i = 0; i < node_count; i++) {
+        if (strcmp(nodes[i].name, self) == 0) self_node = i;
+    }
+    if (self_node < 0) {
+        fprintf(stderr, "Error: this node (%s) is not in the cluster node list\n", self);
+        return -1;
+    }
+    return 0;
+}
+
+bool cluster_enabled(void) {
+    return node_count > 0;
+}
+
+int cluster_owner(const char *key, size_t key_length) {
+    uint64_t hash = ring_hash(key, key_length);
+    
+    // Erster Punkt mit hash >= Key-Hash, hinter dem letzten wieder der erste
+    size_t low = 0;
+    size_t high = ring_size;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (ring[middle].hash < hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return ring[low == ring_size ? 0 : low].node;
+}
+
+int cluster_self(void) {
+    return self_node;
+}
+
+const char *cluster_node_name(int node) {
+    return nodes[node].name;
+}
+
+int cluster_forward(int node, const char *request, size_t length, HttpResponse *response) {
+    return http_peer_exchange(&nodes[node], request, length, response);
+}
+
+void cluster_cleanup(void) {
+    for (size_t i = 0; i < node_count; i++) {
+        http_peer_close(&nodes[i]);
+    }
+}
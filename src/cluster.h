@@ -0,0 +1,42 @@
+#ifndef WEBSERVER_CLUSTER_H
+#define WEBSERVER_CLUSTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "httpclient.h"
+
+// Cluster-Modus: die dynamischen Keys verteilen sich ueber einen
+// Consistent-Hash-Ring mit virtuellen Knoten auf alle Knoten der
+// Peer-Liste. Kommt ein Request beim falschen Knoten an, antwortet dieser
+// mit einer Umleitung (307) zum Eigentuemer oder, auf Wunsch
+// (--cluster-forward), leitet ihn ueber eine gepoolte Keep-Alive-Verbindung
+// weiter. Das Weiterleiten blockiert den Knoten bis zur Antwort des
+// Eigentuemers (hoechstens CLUSTER_TIMEOUT_SECONDS); deren Kopf ist auf
+// HTTP_MAX_HEAD begrenzt. Kommt ein Knoten hinzu oder faellt weg,
+// wechseln nur etwa 1/N der Keys den Eigentuemer.
+
+#define CLUSTER_MAX_NODES 32
+#define CLUSTER_VIRTUAL_NODES 160       // Punkte pro Knoten auf dem Ring
+#define CLUSTER_TIMEOUT_SECONDS 2
+
+// Markiert weitergeleitete Requests; der Empfaenger bedient sie selbst
+#define CLUSTER_FORWARDED_HEADER "X-Cluster-Forwarded"
+
+// nodes: "host:port,host:port,..."; self muss darin vorkommen
+int cluster_init(const char *nodes, const char *self);
+bool cluster_enabled(void);
+
+// Knoten, dem der Key gehoert
+int cluster_owner(const char *key, size_t key_length);
+int cluster_self(void);
+const char *cluster_node_name(int node);
+
+// Schickt einen vollstaendigen HTTP/1.1-Request an node ueber eine gepoolte
+// Verbindung und liest die Antwort; -1 bei Verbindungsfehler oder Timeout
+int cluster_forward(int node, const char *request, size_t length, HttpResponse *response);
+
+// Schliesst die gepoolten Verbindungen
+void cluster_cleanup(void);
+
+#endif
@@ -0,0 +1,859 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "coldtier.h"
+
+// Ein Segment wird versiegelt, sobald eine der Grenzen erreicht ist
+#define COLD_SEGMENT_BYTES (64 * 1024 * 1024)
+#define COLD_SEGMENT_ENTRIES 65536
+
+// Ab so vielen versiegelten Segmenten werden sie beim Versiegeln des
+// naechsten zu wenigen mit nur dem neuesten Record pro Key verdichtet
+#define COLD_MAX_SEGMENTS 8
+
+// Im Speicher bleibt jeder so vielte Hash des Verzeichnisses (4 KiB Block)
+#define COLD_FENCE_INTERVAL 256
+
+// 10 Bit pro Key und 7 Hashfunktionen: ca. 1% falsch positive
+#define COLD_BLOOM_BITS_PER_KEY 10
+#define COLD_BLOOM_HASHES 7
+
+#define COLD_RECORD_MAGIC 0x524e4b54    // "TKNR"
+#define COLD_SEGMENT_MAGIC "TKNSEG01"
+#define COLD_TOMBSTONE UINT32_MAX
+
+// Groesster Record, der beim Lesen akzeptiert wird
+#define COLD_MAX_RECORD (16 * 1024 * 1024)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t key_length;
+    uint32_t value_length;      // COLD_TOMBSTONE: Loeschmarke
+    uint32_t checksum;          // FNV-1a ueber Key und Wert
+    uint64_t version;
+} ColdRecord;
+
+typedef struct {
+    uint64_t hash;
+    uint64_t offset;
+} ColdDirEntry;
+
+typedef struct {
+    uint64_t directory_offset;  // count ColdDirEntry, nach (hash, offset) sortiert
+    uint64_t bloom_offset;
+    uint64_t count;
+    uint64_t bloom_words;
+    uint64_t last_version;
+    char magic[8];
+} ColdFooter;
+
+typedef struct {
+    int fd;
+    unsigned number;
+    uint64_t size;              // Ende der Records
+    size_t count;
+    uint64_t *bloom;
+    size_t bloom_words;         // Zweierpotenz
+    
+    // Versiegelt: Verzeichnis auf der Platte, davon jeder
+    // COLD_FENCE_INTERVAL-te Hash im Speicher
+    uint64_t directory_offset;
+    uint64_t *fences;
+    size_t fence_count;
+    
+    // Aktiv: Verzeichnis im Speicher, Ketten pro Hash-Bucket
+    ColdDirEntry *entries;
+    uint32_t *buckets;          // Index + 1 des neuesten Eintrags, 0 = leer
+    uint32_t *chain;
+} Segment;
+
+typedef struct {
+    char *directory;
+    Segment **segments;         // aelteste zuerst, das letzte ist aktiv
+    size_t count;
+    size_t capacity;
+    uint64_t last_version;
+    size_t compact_at;          // Segmentzahl fuer die naechste Verdichtung
+} ColdTier;
+
+static ColdTier cold;
+
+static uint32_t record_checksum(const char *key, size_t key_length,
+                                const char *value, size_t value_length) {
+    uint32_t hash = 0x811c9dc5;
+    for (size_t i = 0; i < key_length; i++) {
+        hash = (hash ^ (unsigned char)key[i]) * 0x01000193;
+    }
+    for (size_t i = 0; i < value_length; i++) {
+        hash = (hash ^ (unsigned char)value[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+static void bloom_add(uint64_t *bloom, size_t words, uint64_t hash) {
+    uint64_t step = (hash >> 33) | 1;
+    uint64_t mask = words * 64 - 1;
+    for (int i = 0; i < COLD_BLOOM_HASHES; i++) {
+        uint64_t bit = (hash + i * step) & mask;
+        bloom[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+static bool bloom_test(const uint64_t *bloom, size_t words, uint64_t hash) {
+    uint64_t step = (hash >> 33) | 1;
+    uint64_t mask = words * 64 - 1;
+    for (int i = 0; i < COLD_BLOOM_HASHES; i++) {
+        uint64_t bit = (hash + i * step) & mask;
+        if (!(bloom[bit / 64] & (1ULL << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+static size_t bloom_words_for(size_t count) {
+    size_t words = 1;
+    while (words * 64 < count * COLD_BLOOM_BITS_PER_KEY) words *= 2;
+    return words;
+}
+
+static int read_fully(int fd, void *data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t bytes_read = pread(fd, data, length, offset);
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read <= 0) return -1;
+        data = (char *)data + bytes_read;
+        length -= bytes_read;
+        offset += bytes_read;
+    }
+    return 0;
+}
+
+static int write_fully(int fd, const void *data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data = (const char *)data + written;
+        length -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+static char *segment_path(unsigned number) {
+    char *path;
+    if (asprintf(&path, "%s/segment-%06u.seg", cold.directory, number) < 0) return NULL;
+    return path;
+}
+
+// Segment, das die Verdichtung gerade schreibt
+static char *compact_path(unsigned number) {
+    char *path;
+    if (asprintf(&path, "%s/compact-%06u.tmp", cold.directory, number) < 0) return NULL;
+    return path;
+}
+
+static void segment_free(Segment *segment) {
+    if (segment->fd >= 0) close(segment->fd);
+    free(segment->fences);
+    free(segment->bloom);
+    free(segment->entries);
+    free(segment->buckets);
+    free(segment->chain);
+    free(segment);
+}
+
+// Legt die Strukturen eines aktiven Segments an
+static Segment *segment_new_active(int fd, unsigned number) {
+    Segment *segment = calloc(1, sizeof(Segment));
+    if (!segment) return NULL;
+    segment->fd = fd;
+    segment->number = number;
+    segment->bloom_words = bloom_words_for(COLD_SEGMENT_ENTRIES);
+    segment->bloom = calloc(segment->bloom_words, sizeof(uint64_t));
+    segment->entries = malloc(COLD_SEGMENT_ENTRIES * sizeof(ColdDirEntry));
+    segment->buckets = calloc(COLD_SEGMENT_ENTRIES, sizeof(uint32_t));
+    segment->chain = malloc(COLD_SEGMENT_ENTRIES * sizeof(uint32_t));
+    if (!segment->bloom || !segment->entries || !segment->buckets || !segment->chain) {
+        segment->fd = -1;
+        segment_free(segment);
+        return NULL;
+    }
+    return segment;
+}
+
+static void segment_index(Segment *segment, uint64_t hash, uint64_t offset) {
+    size_t index = segment->count++;
+    size_t bucket = hash & (COLD_SEGMENT_ENTRIES - 1);
+    segment->entries[index].hash = hash;
+    segment->entries[index].offset = offset;
+    segment->chain[index] = segment->buckets[bucket];
+    segment->buckets[bucket] = index + 1;
+    bloom_add(segment->bloom, segment->bloom_words, hash);
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const ColdDirEntry *left = a, *right = b;
+    if (left->hash != right->hash) return left->hash < right->hash ? -1 : 1;
+    return left->offset < right->offset ? -1 : left->offset > right->offset;
+}
+
+// Aus dem sortierten Verzeichnis
+static int build_fences(Segment *segment, const ColdDirEntry *entries) {
+    segment->fence_count = (segment->count + COLD_FENCE_INTERVAL - 1) / COLD_FENCE_INTERVAL;
+    segment->fences = malloc((segment->fence_count ? segment->fence_count : 1) * sizeof(uint64_t));
+    if (!segment->fences) return -1;
+    for (size_t i = 0; i < segment->fence_count; i++) {
+        segment->fences[i] = entries[i * COLD_FENCE_INTERVAL].hash;
+    }
+    return 0;
+}
+
+// Schreibt Verzeichnis, Bloom-Filter und Footer hinter die Records
+static int segment_seal(Segment *segment) {
+    qsort(segment->entries, segment->count, sizeof(ColdDirEntry), compare_entries);
+    
+    size_t words = bloom_words_for(segment->count);
+    uint64_t *bloom = calloc(words, sizeof(uint64_t));
+    if (!bloom || build_fences(segment, segment->entries) < 0) {
+        free(bloom);
+        return -1;
+    }
+    for (size_t i = 0; i < segment->count; i++) {
+        bloom_add(bloom, words, segment->entries[i].hash);
+    }
+    
+    ColdFooter footer = {0};
+    footer.directory_offset = segment->size;
+    footer.bloom_offset = segment->size + segment->count * sizeof(ColdDirEntry);
+    footer.count = segment->count;
+    footer.bloom_words = words;
+    footer.last_version = cold.last_version;
+    memcpy(footer.magic, COLD_SEGMENT_MAGIC, sizeof(footer.magic));
+    
+    if (write_fully(segment->fd, segment->entries, segment->count * sizeof(ColdDirEntry),
+                    footer.directory_offset) < 0 ||
+        write_fully(segment->fd, bloom, words * sizeof(uint64_t), footer.bloom_offset) < 0 ||
+        write_fully(segment->fd, &footer, sizeof(footer),
+                    footer.bloom_offset + words * sizeof(uint64_t)) < 0 ||
+        fdatasync(segment->fd) < 0) {
+        perror("Error: cannot seal segment");
+        free(bloom);
+        return -1;
+    }
+    
+    free(segment->bloom);
+    free(segment->entries);
+    free(segment->buckets);
+    free(segment->chain);
+    segment->entries = NULL;
+    segment->buckets = segment->chain = NULL;
+    segment->bloom = bloom;
+    segment->bloom_words = words;
+    segment->directory_offset = footer.directory_offset;
+    return 0;
+}
+
+// Liest die Records eines unversiegelten Segments bis zum ersten
+// unvollstaendigen oder beschaedigten und versiegelt es
+static Segment *segment_recover(int fd, unsigned number) {
+    Segment *segment = segment_new_active(fd, number);
+    if (!segment) return NULL;
+    
+    char *data = malloc(COLD_MAX_RECORD);
+    ColdRecord record;
+    while (data && segment->count < COLD_SEGMENT_ENTRIES &&
+           read_fully(fd, &record, sizeof(record), segment->size) == 0) {
+        size_t value_length = record.value_length == COLD_TOMBSTONE ? 0 : record.value_length;
+        size_t length = (size_t)record.key_length + value_length;
+        if (record.magic != COLD_RECORD_MAGIC || length > COLD_MAX_RECORD ||
+            read_fully(fd, data, length, segment->size + sizeof(record)) < 0 ||
+            record.checksum != record_checksum(data, record.key_length,
+                                               data + record.key_length, value_length)) {
+            break;
+        }
+        
+        segment_index(segment, blob_hash(data, record.key_length), segment->size);
+        if (record.version > cold.last_version) cold.last_version = record.version;
+        segment->size += sizeof(record) + length;
+    }
+    free(data);
+    
+    fprintf(stderr, "Warning: recovered %zu records from unsealed segment %u\n",
+            segment->count, number);
+    if (ftruncate(fd, segment->size) < 0 || segment_seal(segment) < 0) {
+        segment_free(segment);
+        return NULL;
+    }
+    return segment;
+}
+
+static Segment *segment_load(unsigned number) {
+    char *path = segment_path(number);
+    int fd = path ? open(path, O_RDWR | O_CLOEXEC) : -1;
+    free(path);
+    if (fd < 0) {
+        perror("Error: cannot open segment");
+        return NULL;
+    }
+    
+    ColdFooter footer;
+    off_t end = lseek(fd, 0, SEEK_END);
+    if (end < (off_t)sizeof(footer) ||
+        read_fully(fd, &footer, sizeof(footer), end - sizeof(footer)) < 0 ||
+        memcmp(footer.magic, COLD_SEGMENT_MAGIC, sizeof(footer.magic)) != 0) {
+        return segment_recover(fd, number);
+    }
+    
+    Segment *segment = calloc(1, sizeof(Segment));
+    if (!segment) {
+        close(fd);
+        return NULL;
+    }
+    segment->fd = fd;
+    segment->number = number;
+    segment->size = footer.directory_offset;
+    segment->count = footer.count;
+    segment->directory_offset = footer.directory_offset;
+    segment->bloom_words = footer.bloom_words;
+    segment->bloom = malloc(footer.bloom_words * sizeof(uint64_t));
+    ColdDirEntry *entries = malloc((footer.count ? footer.count : 1) * sizeof(ColdDirEntry));
+    if (!segment->bloom || !entries ||
+        read_fully(fd, segment->bloom, footer.bloom_words * sizeof(uint64_t), footer.bloom_offset) < 0 ||
+        read_fully(fd, entries, footer.count * sizeof(ColdDirEntry), footer.directory_offset) < 0 ||
+        build_fences(segment, entries) < 0) {
+        perror("Error: cannot read segment");
+        free(entries);
+        segment_free(segment);
+        return NULL;
+    }
+    free(entries);
+    if (footer.last_version > cold.last_version) cold.last_version = footer.last_version;
+    return segment;
+}
+
+static int add_segment(Segment *segment) {
+    if (cold.count == cold.capacity) {
+        size_t capacity = cold.capacity ? cold.capacity * 2 : 16;
+        Segment **segments = realloc(cold.segments, capacity * sizeof(Segment *));
+        if (!segments) return -1;
+        cold.segments = segments;
+        cold.capacity = capacity;
+    }
+    cold.segments[cold.count++] = segment;
+    return 0;
+}
+
+static int start_active_segment(unsigned number) {
+    char *path = segment_path(number);
+    int fd = path ? open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+    free(path);
+    if (fd < 0) {
+        perror("Error: cannot create segment");
+        return -1;
+    }
+    
+    Segment *segment = segment_new_active(fd, number);
+    if (!segment || add_segment(segment) < 0) {
+        fprintf(stderr, "Error: out of memory\n");
+        if (segment) segment_free(segment);
+        else close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+static int compare_numbers(const void *a, const void *b) {
+    unsigned left = *(const unsigned *)a, right = *(const unsigned *)b;
+    return left < right ? -1 : left > right;
+}
+
+int cold_open(const char *directory, uint64_t *last_version) {
+    cold.directory = strdup(directory);
+    cold.compact_at = COLD_MAX_SEGMENTS;
+    if (!cold.directory || (mkdir(directory, 0755) < 0 && errno != EEXIST)) {
+        perror("Error: cannot create data directory");
+        return -1;
+    }
+    
+    DIR *dir = opendir(directory);
+    if (!dir) {
+        perror("Error: cannot open data directory");
+        return -1;
+    }
+    unsigned *numbers = NULL;
+    size_t count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        unsigned number;
+        char suffix[8];
+        if (sscanf(entry->d_name, "compact-%u.%7s", &number, suffix) == 2) {
+            // Abgebrochene Verdichtung; die alten Segmente gelten noch
+            char *path = compact_path(number);
+            if (path) unlink(path);
+            free(path);
+            continue;
+        }
+        if (sscanf(entry->d_name, "segment-%u.%7s", &number, suffix) != 2 ||
+            strcmp(suffix, "seg") != 0) {
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            unsigned *grown = realloc(numbers, capacity * sizeof(unsigned));
+            if (!grown) break;
+            numbers = grown;
+        }
+        numbers[count++] = number;
+    }
+    closedir(dir);
+    qsort(numbers, count, sizeof(unsigned), compare_numbers);
+    
+    unsigned next_number = 1;
+    for (size_t i = 0; i < count; i++) {
+        Segment *segment = segment_load(numbers[i]);
+        if (!segment || add_segment(segment) < 0) {
+            free(numbers);
+            return -1;
+        }
+        next_number = numbers[i] + 1;
+    }
+    free(numbers);
+    
+    if (start_active_segment(next_number) < 0) return -1;
+    printf("Cold tier %s: %zu segments\n", directory, cold.count - 1);
+    *last_version = cold.last_version;
+    return 0;
+}
+
+bool cold_enabled(void) {
+    return cold.count > 0;
+}
+
+// Liest den Record bei offset, wenn er zum Key gehoert: 1 (value/version
+// gesetzt, value NULL bei Loeschmarke), 0 anderer Key, -1 Fehler
+static int read_record(const Segment *segment, uint64_t offset, const char *key,
+                       size_t key_length, Blob **value, uint64_t *version) {
+    ColdRecord record;
+    if (read_fully(segment->fd, &record, sizeof(record), offset) < 0 ||
+        record.magic != COLD_RECORD_MAGIC) {
+        return -1;
+    }
+    if (record.key_length != key_length) return 0;
+    
+    size_t value_length = record.value_length == COLD_TOMBSTONE ? 0 : record.value_length;
+    size_t length = key_length + value_length;
+    if (length > COLD_MAX_RECORD) return -1;
+    char *data = malloc(length ? length : 1);
+    if (!data || read_fully(segment->fd, data, length, offset + sizeof(record)) < 0) {
+        free(data);
+        return -1;
+    }
+    if (memcmp(data, key, key_length) != 0) {
+        free(data);
+        return 0;
+    }
+    
+    *version = record.version;
+    *value = NULL;
+    if (record.value_length != COLD_TOMBSTONE) {
+        *value = blob_intern(data + key_length, value_length);
+        if (!*value) {
+            free(data);
+            return -1;
+        }
+    }
+    free(data);
+    return 1;
+}
+
+// Sucht den neuesten Record des Keys in einem Segment (Rueckgabe wie read_record)
+static int segment_get(const Segment *segment, uint64_t hash, const char *key,
+                       size_t key_length, Blob **value, uint64_t *version) {
+    if (segment->buckets) {
+        size_t bucket = hash & (COLD_SEGMENT_ENTRIES - 1);
+        for (uint32_t index = segment->buckets[bucket]; index != 0; index = segment->chain[index - 1]) {
+            const ColdDirEntry *entry = &segment->entries[index - 1];
+            if (entry->hash != hash) continue;
+            int result = read_record(segment, entry->offset, key, key_length, value, version);
+            if (result != 0) return result;
+        }
+        return 0;
+    }
+    
+    // Versiegelt: die Zaeune im Speicher bestimmen den Block mit dem
+    // letzten Eintrag dieses Hashs; von dort rueckwaerts durch alle mit
+    // gleichem Hash (der neueste liegt hinten), meist in nur einem Block
+    size_t low = 0, high = segment->fence_count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (segment->fences[middle] <= hash) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    
+    ColdDirEntry entries[COLD_FENCE_INTERVAL];
+    for (size_t block = low; block-- > 0;) {
+        size_t first = block * COLD_FENCE_INTERVAL;
+        size_t count = segment->count - first < COLD_FENCE_INTERVAL ?
+                       segment->count - first : COLD_FENCE_INTERVAL;
+        if (read_fully(segment->fd, entries, count * sizeof(ColdDirEntry),
+                       segment->directory_offset + first * sizeof(ColdDirEntry)) < 0) {
+            return -1;
+        }
+        while (count > 0 && entries[count - 1].hash > hash) count--;
+        while (count-- > 0) {
+            if (entries[count].hash != hash) return 0;
+            int result = read_record(segment, entries[count].offset, key, key_length, value, version);
+            if (result != 0) return result;
+        }
+    }
+    return 0;
+}
+
+int cold_get(const char *key, size_t key_length, Blob **value, uint64_t *version) {
+    uint64_t hash = blob_hash(key, key_length);
+    
+    for (size_t i = cold.count; i-- > 0;) {
+        const Segment *segment = cold.segments[i];
+        if (!bloom_test(segment->bloom, segment->bloom_words, hash)) continue;
+        
+        int result = segment_get(segment, hash, key, key_length, value, version);
+        if (result < 0) {
+            fprintf(stderr, "Error: cannot read segment %u\n", segment->number);
+            return -1;
+        }
+        if (result > 0) return *value ? 1 : 0;
+    }
+    return 0;
+}
+
+static int segment_append(Segment *segment, const char *key, size_t key_length,
+                          const char *value, uint32_t value_length, uint64_t version) {
+    size_t stored_length = value_length == COLD_TOMBSTONE ? 0 : value_length;
+    
+    ColdRecord record = {COLD_RECORD_MAGIC, key_length, value_length,
+                         record_checksum(key, key_length, value, stored_length), version};
+    struct iovec parts[3] = {
+        {&record, sizeof(record)},
+        {(void *)key, key_length},
+        {(void *)value, stored_length},
+    };
+    size_t total = sizeof(record) + key_length + stored_length;
+    ssize_t written = pwritev(segment->fd, parts, 3, segment->size);
+    if (written >= 0 && (size_t)written < total) {
+        // Selten: kurzer Schreibvorgang, den Rest einzeln nachschreiben
+        char *flat = malloc(total);
+        if (!flat) return -1;
+        memcpy(flat, &record, sizeof(record));
+        memcpy(flat + sizeof(record), key, key_length);
+        memcpy(flat + sizeof(record) + key_length, value, stored_length);
+        int result = write_fully(segment->fd, flat + written, total - written,
+                                 segment->size + written);
+        free(flat);
+        if (result < 0) written = -1;
+    }
+    if (written < 0) {
+        perror("Error: cannot write segment");
+        return -1;
+    }
+    
+    segment_index(segment, blob_hash(key, key_length), segment->size);
+    segment->size += total;
+    return 0;
+}
+
+// Liefert pro Key den neuesten Record dieses Segments
+static int segment_scan(const Segment *segment, ColdScan callback, void *context) {
+    ColdDirEntry *entries = malloc((segment->count ? segment->count : 1) * sizeof(ColdDirEntry));
+    char *data = malloc(COLD_MAX_RECORD);
+    int result = 0;
+    if (!entries || !data) {
+        result = -1;
+    } else if (segment->entries) {
+        memcpy(entries, segment->entries, segment->count * sizeof(ColdDirEntry));
+        qsort(entries, segment->count, sizeof(ColdDirEntry), compare_entries);
+    } else if (read_fully(segment->fd, entries, segment->count * sizeof(ColdDirEntry),
+                          segment->directory_offset) < 0) {
+        result = -1;
+    }
+    
+    // Gleiche Hashes von hinten: so kommt jeder Key zuerst mit seinem
+    // neuesten Record, aeltere ueberspringt der Aufrufer
+    for (size_t group = 0; result == 0 && group < segment->count;) {
+        size_t group_end = group + 1;
+        while (group_end < segment->count && entries[group_end].hash == entries[group].hash) {
+            group_end++;
+        }
+        for (size_t i = group_end; result == 0 && i-- > group;) {
+            ColdRecord record;
+            if (read_fully(segment->fd, &record, sizeof(record), entries[i].offset) < 0) {
+                result = -1;
+                break;
+            }
+            size_t value_length = record.value_length == COLD_TOMBSTONE ? 0 : record.value_length;
+            size_t length = (size_t)record.key_length + value_length;
+            if (length > COLD_MAX_RECORD ||
+                read_fully(segment->fd, data, length, entries[i].offset + sizeof(record)) < 0) {
+                result = -1;
+                break;
+            }
+            result = callback(context, data, record.key_length,
+                              record.value_length == COLD_TOMBSTONE ? NULL : data + record.key_length,
+                              value_length, record.version);
+        }
+        group = group_end;
+    }
+    
+    free(entries);
+    free(data);
+    return result;
+}
+
+static bool segment_full(const Segment *segment) {
+    return segment->size >= COLD_SEGMENT_BYTES || segment->count == COLD_SEGMENT_ENTRIES;
+}
+
+// Bereits uebernommene Keys einer Verdichtung
+typedef struct {
+    char **keys;
+    size_t capacity;
+    size_t count;
+} KeySet;
+
+// 1: neu, 0: schon gesehen, -1: kein Speicher
+static int key_set_add(KeySet *set, const char *key, size_t key_length) {
+    if ((set->count + 1) * 2 > set->capacity) {
+        KeySet grown = {calloc(set->capacity ? set->capacity * 2 : 256, sizeof(char *)),
+                        set->capacity ? set->capacity * 2 : 256, 0};
+        if (!grown.keys) return -1;
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (!set->keys[i]) continue;
+            size_t slot = blob_hash(set->keys[i], strlen(set->keys[i])) & (grown.capacity - 1);
+            while (grown.keys[slot]) slot = (slot + 1) & (grown.capacity - 1);
+            grown.keys[slot] = set->keys[i];
+            grown.count++;
+        }
+        free(set->keys);
+        *set = grown;
+    }
+    
+    size_t slot = blob_hash(key, key_length) & (set->capacity - 1);
+    for (; set->keys[slot]; slot = (slot + 1) & (set->capacity - 1)) {
+        if (strlen(set->keys[slot]) == key_length && memcmp(set->keys[slot], key, key_length) == 0) {
+            return 0;
+        }
+    }
+    set->keys[slot] = strndup(key, key_length);
+    if (!set->keys[slot]) return -1;
+    set->count++;
+    return 1;
+}
+
+static void key_set_free(KeySet *set) {
+    for (size_t i = 0; i < set->capacity; i++) {
+        free(set->keys[i]);
+    }
+    free(set->keys);
+}
+
+typedef struct {
+    KeySet seen;
+    Segment *output;            // wird gerade geschrieben (compact-NNNNNN.tmp)
+    Segment **outputs;          // fertig, schon unter segment-NNNNNN.seg
+    size_t output_count;
+    unsigned next_number;
+} Compaction;
+
+// Versiegelt das laufende Ausgabesegment und gibt ihm seinen Namen
+static int finish_output(Compaction *compaction) {
+    Segment *output = compaction->output;
+    char *temp = compact_path(output->number);
+    char *path = segment_path(output->number);
+    Segment **outputs = realloc(compaction->outputs,
+                                (compaction->output_count + 1) * sizeof(Segment *));
+    int result = temp && path && outputs && segment_seal(output) == 0 &&
+                 rename(temp, path) == 0 ? 0 : -1;
+    if (outputs) compaction->outputs = outputs;
+    if (result == 0) {
+        compaction->outputs[compaction->output_count++] = output;
+    } else {
+        if (temp) unlink(temp);
+        segment_free(output);
+    }
+    free(temp);
+    free(path);
+    compaction->output = NULL;
+    return result;
+}
+
+static int compact_record(void *context, const char *key, size_t key_length,
+                          const char *value, size_t value_length, uint64_t version) {
+    Compaction *compaction = context;
+    int added = key_set_add(&compaction->seen, key, key_length);
+    if (added <= 0) return added;
+    
+    if (compaction->output && segment_full(compaction->output) && finish_output(compaction) < 0) {
+        return -1;
+    }
+    if (!compaction->output) {
+        unsigned number = compaction->next_number++;
+        char *path = compact_path(number);
+        int fd = path ? open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) : -1;
+        free(path);
+        compaction->output = fd >= 0 ? segment_new_active(fd, number) : NULL;
+        if (!compaction->output) {
+            if (fd >= 0) close(fd);
+            return -1;
+        }
+    }
+    // Loeschmarken bleiben: bis die alten Segmente entfernt sind, muessen
+    // sie deren Werte verdecken
+    return segment_append(compaction->output, key, key_length, value,
+                          value ? value_length : COLD_TOMBSTONE, version);
+}
+
+// Schreibt den neuesten Record jedes Keys aus allen (versiegelten)
+// Segmenten in neue Segmente ab *next_number und entfernt die alten. Die
+// neuen sind juenger als die alten; bricht die Verdichtung ab, gelten
+// weiter die alten. Laeuft im aufrufenden Thread, also in dem PUT oder
+// GET, das das Segment versiegelt hat, und liest dabei alle Segmente (bis
+// compact_at + 1, je bis COLD_SEGMENT_BYTES). Nur einen Teil zu
+// verdichten ginge nicht: die neuen Segmente bekommen hoehere Nummern und
+// wuerden sonst nach einem Neustart neuere Records verdecken. Die Kosten
+// verteilen sich ueber compact_at auf mindestens COLD_MAX_SEGMENTS
+// Versiegelungen, die Latenz des einen Requests bleibt.
+static int compact_segments(unsigned *next_number) {
+    Compaction compaction = {.next_number = *next_number};
+    int result = 0;
+    for (size_t i = cold.count; result == 0 && i-- > 0;) {
+        result = segment_scan(cold.segments[i], compact_record, &compaction);
+    }
+    if (compaction.output && finish_output(&compaction) < 0) result = -1;
+    key_set_free(&compaction.seen);
+    if (result == 0 && compaction.output_count > cold.capacity) {
+        Segment **segments = realloc(cold.segments, compaction.output_count * sizeof(Segment *));
+        if (segments) {
+            cold.segments = segments;
+            cold.capacity = compaction.output_count;
+        } else {
+            result = -1;
+        }
+    }
+    
+    if (result < 0) {
+        for (size_t i = 0; i < compaction.output_count; i++) {
+            char *path = segment_path(compaction.outputs[i]->number);
+            if (path) unlink(path);
+            free(path);
+            segment_free(compaction.outputs[i]);
+        }
+        if (compaction.output) {
+            char *path = compact_path(compaction.output->number);
+            if (path) unlink(path);
+            free(path);
+            segment_free(compaction.output);
+        }
+        free(compaction.outputs);
+        return -1;
+    }
+    
+    printf("Cold tier compacted %zu segments into %zu\n", cold.count, compaction.output_count);
+    for (size_t i = 0; i < cold.count; i++) {
+        char *path = segment_path(cold.segments[i]->number);
+        if (path) unlink(path);
+        free(path);
+        segment_free(cold.segments[i]);
+    }
+    memcpy(cold.segments, compaction.outputs, compaction.output_count * sizeof(Segment *));
+    cold.count = compaction.output_count;
+    free(compaction.outputs);
+    *next_number = compaction.next_number;
+    
+    // Sind viele Keys lebendig, erst nach ebenso vielen neuen Segmenten
+    // wieder, damit nicht jedes Versiegeln alles neu schreibt
+    cold.compact_at = cold.count * 2 > COLD_MAX_SEGMENTS ? cold.count * 2 : COLD_MAX_SEGMENTS;
+    return 0;
+}
+
+static int append_record(const char *key, size_t key_length, const char *value,
+                         uint32_t value_length, uint64_t version) {
+    Segment *active = cold.segments[cold.count - 1];
+    if (segment_append(active, key, key_length, value, value_length, version) < 0) return -1;
+    if (version > cold.last_version) cold.last_version = version;
+    
+    if (segment_full(active)) {
+        if (segment_seal(active) < 0) return -1;
+        unsigned next_number = active->number + 1;
+        if (cold.count > cold.compact_at && compact_segments(&next_number) < 0) {
+            fprintf(stderr, "Warning: cold tier compaction failed, keeping %zu segments\n",
+                    cold.count);
+        }
+        return start_active_segment(next_number);
+    }
+    return 0;
+}
+
+int cold_put(const char *key, size_t key_length, const Blob *value, uint64_t version) {
+    if (!blob_compressed(value)) {
+        return append_record(key, key_length, value->data, value->length, version);
+    }
+    
+    // Auf der Platte stehen Werte unkomprimiert, das Format haengt so
+    // nicht von --compress ab
+    char *scratch = malloc(value->length);
+    const char *data = scratch ? blob_contents(value, scratch) : NULL;
+    int result = data ? append_record(key, key_length, data, value->length, version) : -1;
+    free(scratch);
+    return result;
+}
+
+int cold_delete(const char *key, size_t key_length) {
+    uint64_t hash = blob_hash(key, key_length);
+    for (size_t i = 0; i < cold.count; i++) {
+        const Segment *segment = cold.segments[i];
+        if (bloom_test(segment->bloom, segment->bloom_words, hash)) {
+            return append_record(key, key_length, NULL, COLD_TOMBSTONE, 0);
+        }
+    }
+    return 0;
+}
+
+int cold_scan(ColdScan callback, void *context) {
+    for (size_t i = cold.count; i-- > 0;) {
+        if (segment_scan(cold.segments[i], callback, context) < 0) return -1;
+    }
+    return 0;
+}
+
+void cold_close(void) {
+    if (cold.count == 0) return;
+    
+    Segment *active = cold.segments[cold.count - 1];
+    if (active->count > 0) {
+        segment_seal(active);
+    } else {
+        char *path = segment_path(active->number);
+        if (path) unlink(path);
+        free(path);
+    }
+    for (size_t i = 0; i < cold.count; i++) {
+        segment_free(cold.segments[i]);
+    }
+    free(cold.segments);
+    cold.segments = NULL;
+    cold.count = 0;
+    cold.capacity = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef WEBSERVER_COLDTIER_H
+#define WEBSERVER_COLDTIER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blob.h"
+
+// Kalte Stufe des Stores: Werte, die aus dem Hot-Index verdraengt werden,
+// landen in Log-Segmenten (DIR/segment-NNNNNN.seg). Ein Segment wird nur
+// angehaengt; ist es voll, wird es versiegelt: ans Ende kommen ein nach
+// Key-Hash sortiertes Verzeichnis, ein Bloom-Filter und ein Footer.
+//
+// Im Speicher bleiben pro Segment nur der Bloom-Filter und jeder 256.
+// Hash des Verzeichnisses (fuer das aktive Segment das ganze
+// Verzeichnis). Lookups fragen die Segmente vom neuesten zum aeltesten;
+// ein negativer Bloom-Filter erspart das Lesen, sonst kosten sie einen
+// Block des Verzeichnisses und den Record.
+//
+// Gibt es mehr als 8 versiegelte Segmente, schreibt das Versiegeln sie zu
+// neuen mit nur dem neuesten Record pro Key zusammen (compact-NNNNNN.tmp,
+// dann umbenannt) und loescht die alten; so bleiben Platte und Anzahl der
+// Segmente an die lebendigen Keys gebunden.
+
+// Oeffnet oder legt DIR an; unversiegelte Segmente (Absturz) werden bis
+// zum letzten gueltigen Record gelesen und versiegelt. last_version ist die
+// hoechste gespeicherte Version.
+int cold_open(const char *directory, uint64_t *last_version);
+
+bool cold_enabled(void);
+
+// 1: gefunden (value mit eigener Referenz), 0: nicht vorhanden oder
+// geloescht, -1: Lesefehler
+int cold_get(const char *key, size_t key_length, Blob **value, uint64_t *version);
+
+int cold_put(const char *key, size_t key_length, const Blob *value, uint64_t version);
+
+// Schreibt eine Loeschmarke, falls ein Segment den Key enthalten koennte
+int cold_delete(const char *key, size_t key_length);
+
+// value == NULL: Loeschmarke. Rueckgabe < 0 bricht den Scan ab.
+typedef int (*ColdScan)(void *context, const char *key, size_t key_length,
+                        const char *value, size_t value_length, uint64_t version);
+
+// Alle Records, neueste Segmente zuerst; innerhalb eines Segments kommt
+// der neueste Record eines Keys vor den aelteren, die der Aufrufer
+// ueberspringen muss
+int cold_scan(ColdScan callback, void *context);
+
+// Versiegelt das aktive Segment
+void cold_close(void);
+
+#endif
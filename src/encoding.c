@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+
+#include "encoding.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+const char *const encoding_names[ENCODING_COUNT] = {
+    [ENCODING_IDENTITY] = "identity",
+    [ENCODING_GZIP] = "gzip",
+    [ENCODING_DEFLATE] = "deflate",
+};
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+// Liest einen qvalue ("0", "0.5", "1.000") als Tausendstel, -1 wenn ungueltig
+static int parse_qvalue(const char *value, const char *end) {
+    if (value == end || (*value != '0' && *value != '1')) return -1;
+    int result = (*value++ - '0') * 1000;
+    if (value < end && *value == '.') {
+        value++;
+        for (int scale = 100; scale > 0 && value < end && *value >= '0' && *value <= '9'; scale /= 10) {
+            result += (*value++ - '0') * scale;
+        }
+    }
+    return value == end && result <= 1000 ? result : -1;
+}
+
+ContentEncoding encoding_negotiate(const char *accept, size_t length) {
+    // Gewichte in Tausendsteln; -1 = nicht genannt
+    int weights[ENCODING_COUNT] = {-1, -1, -1};
+    int wildcard = -1;
+    const char *pos = accept;
+    const char *end = accept + length;
+    
+    while (pos < end) {
+        const char *item_end = memchr(pos, ',', end - pos);
+        if (!item_end) item_end = end;
+        
+        while (pos < item_end && is_space(*pos)) pos++;
+        const char *name = pos;
+        while (pos < item_end && *pos != ';' && !is_space(*pos)) pos++;
+        size_t name_length = pos - name;
+        
+        // Parameter: nur q ist fuer uns relevant
+        int weight = 1000;
+        while (pos < item_end) {
+            while (pos < item_end && (is_space(*pos) || *pos == ';')) pos++;
+            const char *parameter = pos;
+            while (pos < item_end && *pos != ';') pos++;
+            const char *parameter_end = pos;
+            while (parameter_end > parameter && is_space(parameter_end[-1])) parameter_end--;
+            if (parameter_end - parameter >= 2 && (parameter[0] == 'q' || parameter[0] == 'Q') &&
+                parameter[1] == '=') {
+                weight = parse_qvalue(parameter + 2, parameter_end);
+            }
+        }
+        
+        if (weight >= 0) {
+            if (name_length == 1 && name[0] == '*') {
+                wildcard = weight;
+            } else if ((name_length == 4 && strncasecmp(name, "gzip", 4) == 0) ||
+                       (name_length == 6 && strncasecmp(name, "x-gzip", 6) == 0)) {
+                weights[ENCODING_GZIP] = weight;
+            } else if (name_length == 7 && strncasecmp(name, "deflate", 7) == 0) {
+                weights[ENCODING_DEFLATE] = weight;
+            }
+        }
+        pos = item_end + (item_end < end);
+    }
+    
+    ContentEncoding best = ENCODING_IDENTITY;
+    int best_weight = 0;
+    for (int encoding = ENCODING_GZIP; encoding < ENCODING_COUNT; encoding++) {
+        int weight = weights[encoding] >= 0 ? weights[encoding] : wildcard;
+        if (weight > best_weight) {
+            best = encoding;
+            best_weight = weight;
+        }
+    }
+    return best;
+}
+
+bool encoding_available(void) {
+#ifdef HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+char *encoding_compress(ContentEncoding encoding, const char *data, size_t length,
+                        size_t headroom, size_t *encoded_length) {
+    if (encoding == ENCODING_IDENTITY) return NULL;
+#ifndef HAVE_ZLIB
+    (void)data;
+    (void)length;
+    (void)headroom;
+    (void)encoded_length;
+    return NULL;
+#else
+    
+    // gzip: Fensterbits + 16 fuer den gzip-Rahmen; deflate ist in HTTP
+    // das zlib-Format (RFC 1950), nicht rohes deflate
+    z_stream stream = {0};
+    int window_bits = encoding == ENCODING_GZIP ? MAX_WBITS + 16 : MAX_WBITS;
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window_bits, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "Error: cannot initialize %s\n", encoding_names[encoding]);
+        return NULL;
+    }
+    
+    size_t capacity = deflateBound(&stream, length);
+    char *encoded = malloc(headroom + capacity);
+    if (!encoded) {
+        deflateEnd(&stream);
+        return NULL;
+    }
+    
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = length;
+    stream.next_out = (Bytef *)encoded + headroom;
+    stream.avail_out = capacity;
+    int result = deflate(&stream, Z_FINISH);
+    *encoded_length = stream.total_out;
+    deflateEnd(&stream);
+    
+    if (result != Z_STREAM_END) {
+        fprintf(stderr, "Error: %s compression failed\n", encoding_names[encoding]);
+        free(encoded);
+        return NULL;
+    }
+    return encoded;
+#endif
+}
@@ -0,0 +1,30 @@
+#ifndef WEBSERVER_ENCODING_H
+#define WEBSERVER_ENCODING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Content-Codings fuer Antworten; identity heisst unkomprimiert
+typedef enum {
+    ENCODING_IDENTITY,
+    ENCODING_GZIP,
+    ENCODING_DEFLATE,
+    ENCODING_COUNT
+} ContentEncoding;
+
+extern const char *const encoding_names[ENCODING_COUNT];
+
+// Waehlt anhand eines Accept-Encoding-Werts die bevorzugte Kodierung;
+// bei gleicher Gewichtung gewinnt gzip
+ContentEncoding encoding_negotiate(const char *accept, size_t length);
+
+// false ohne zlib (-DWEBSERVER_ZLIB=OFF); dann gibt es nur identity
+bool encoding_available(void);
+
+// Komprimiert data mit zlib; Ergebnis per malloc, NULL bei Fehler oder
+// ohne zlib. Die kodierten Bytes beginnen nach headroom freien Bytes, in
+// die der Aufrufer z.B. einen Kopf legt; encoded_length zaehlt sie nicht
+char *encoding_compress(ContentEncoding encoding, const char *data, size_t length,
+                        size_t headroom, size_t *encoded_length);
+
+#endif
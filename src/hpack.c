@@ -0,0 +1,366 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "hpack.h"
+
+// Statische Tabelle (RFC 7541, Anhang A), Index 1 .. 61
+static const char *const static_table[][2] = {
+    {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+    {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"},
+    {":status", "200"}, {":status", "204"}, {":status", "206"}, {":status", "304"},
+    {":status", "400"}, {":status", "404"}, {":status", "500"},
+    {"accept-charset", ""}, {"accept-encoding", "gzip, deflate"}, {"accept-language", ""},
+    {"accept-ranges", ""}, {"accept", ""}, {"access-control-allow-origin", ""}, {"age", ""},
+    {"allow", ""}, {"authorization", ""}, {"cache-control", ""}, {"content-disposition", ""},
+    {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+    {"content-location", ""}, {"content-range", ""}, {"content-type", ""}, {"cookie", ""},
+    {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""}, {"from", ""}, {"host", ""},
+    {"if-match", ""}, {"if-modified-since", ""}, {"if-none-match", ""}, {"if-range", ""},
+    {"if-unmodified-since", ""}, {"last-modified", ""}, {"link", ""}, {"location", ""},
+    {"max-forwards", ""}, {"proxy-authenticate", ""}, {"proxy-authorization", ""},
+    {"range", ""}, {"referer", ""}, {"refresh", ""}, {"retry-after", ""}, {"server", ""},
+    {"set-cookie", ""}, {"strict-transport-security", ""}, {"transfer-encoding", ""},
+    {"user-agent", ""}, {"vary", ""}, {"via", ""}, {"www-authenticate", ""},
+};
+
+#define STATIC_TABLE_COUNT (sizeof(static_table) / sizeof(static_table[0]))
+
+// Codelaengen des Huffman-Codes (RFC 7541, Anhang B) fuer die Symbole
+// 0 .. 255 und EOS (256). Der Code ist kanonisch, die Codes selbst
+// ergeben sich also aus den Laengen.
+static const uint8_t huffman_lengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+#define HUFFMAN_MAX_LENGTH 30
+#define HUFFMAN_EOS 256
+
+// Kanonische Dekodiertabelle: Anzahl Codes je Laenge und Symbole sortiert
+// nach (Laenge, Symbol), einmalig aus huffman_lengths aufgebaut
+static uint16_t huffman_counts[HUFFMAN_MAX_LENGTH + 1];
+static uint16_t huffman_symbols[257];
+
+static void huffman_init(void) {
+    if (huffman_counts[5] != 0) return;
+    
+    size_t position = 0;
+    for (int length = 1; length <= HUFFMAN_MAX_LENGTH; length++) {
+        for (int symbol = 0; symbol <= HUFFMAN_EOS; symbol++) {
+            if (huffman_lengths[symbol] == length) {
+                huffman_symbols[position++] = symbol;
+                huffman_counts[length]++;
+            }
+        }
+    }
+}
+
+// Dekodiert Bit fuer Bit wie puff.c; Strings in Headern sind kurz.
+// Rueckgabe die Laenge in out oder -1 bei ungueltigem Code/Padding.
+static ssize_t huffman_decode(const uint8_t *in, size_t length, char *out) {
+    size_t written = 0;
+    uint32_t code = 0;
+    int code_length = 0;
+    int first = 0;          // erster Code der aktuellen Laenge
+    int index = 0;          // Position des ersten Symbols dieser Laenge
+    bool padding_ones = true;
+    
+    for (size_t i = 0; i < length; i++) {
+        for (int bit = 7; bit >= 0; bit--) {
+            int value = (in[i] >> bit) & 1;
+            code = (code << 1) | value;
+            code_length++;
+            padding_ones = padding_ones && value;
+            
+            int count = huffman_counts[code_length];
+            if ((int)code >= first && (int)code - first < count) {
+                int symbol = huffman_symbols[index + code - first];
+                if (symbol == HUFFMAN_EOS) return -1;
+                out[written++] = (char)symbol;
+                code = 0;
+                code_length = 0;
+                first = 0;
+                index = 0;
+                padding_ones = true;
+                continue;
+            }
+            if (code_length == HUFFMAN_MAX_LENGTH) return -1;
+            index += count;
+            first = (first + count) << 1;
+        }
+    }
+    
+    // Rest: hoechstens 7 Bits, alle 1 (Praefix von EOS)
+    if (code_length > 7 || !padding_ones) return -1;
+    return written;
+}
+
+void hpack_decoder_init(HpackDecoder *decoder) {
+    memset(decoder, 0, sizeof(*decoder));
+    decoder->max_size = HPACK_TABLE_SIZE;
+    huffman_init();
+}
+
+static void evict_oldest(HpackDecoder *decoder) {
+    size_t oldest = (decoder->head + decoder->count - 1) % HPACK_MAX_ENTRIES;
+    decoder->size -= decoder->name_lengths[oldest] + decoder->value_lengths[oldest] + 32;
+    free(decoder->entries[oldest]);
+    decoder->entries[oldest] = NULL;
+    decoder->count--;
+}
+
+void hpack_decoder_free(HpackDecoder *decoder) {
+    while (decoder->count > 0) {
+        evict_oldest(decoder);
+    }
+}
+
+static int table_insert(HpackDecoder *decoder, const char *name, size_t name_length,
+                        const char *value, size_t value_length) {
+    size_t entry_size = name_length + value_length + 32;
+    while (decoder->count > 0 && decoder->size + entry_size > decoder->max_size) {
+        evict_oldest(decoder);
+    }
+    // Zu gross fuer die Tabelle: leert sie nur (RFC 7541, 4.4)
+    if (entry_size > decoder->max_size) return 0;
+    
+    char *entry = malloc(name_length + value_length + 1);
+    if (!entry) return -1;
+    memcpy(entry, name, name_length);
+    entry[name_length] = '\0';
+    memcpy(entry + name_length + 1, value, value_length);
+    
+    decoder->head = (decoder->head + HPACK_MAX_ENTRIES - 1) % HPACK_MAX_ENTRIES;
+    decoder->entries[decoder->head] = entry;
+    decoder->name_lengths[decoder->head] = name_length;
+    decoder->value_lengths[decoder->head] = value_length;
+    decoder->count++;
+    decoder->size += entry_size;
+    return 0;
+}
+
+// Liefert Name und Wert zu einem Index (statisch, dann dynamisch)
+static int table_lookup(const HpackDecoder *decoder, uint64_t index,
+                        const char **name, size_t *name_length,
+                        const char **value, size_t *value_length) {
+    if (index == 0) return -1;
+    if (index <= STATIC_TABLE_COUNT) {
+        *name = static_table[index - 1][0];
+        *name_length = strlen(*name);
+        *value = static_table[index - 1][1];
+        *value_length = strlen(*value);
+        return 0;
+    }
+    
+    index -= STATIC_TABLE_COUNT + 1;
+    if (index >= decoder->count) return -1;
+    size_t slot = (decoder->head + index) % HPACK_MAX_ENTRIES;
+    *name = decoder->entries[slot];
+    *name_length = decoder->name_lengths[slot];
+    *value = decoder->entries[slot] + *name_length + 1;
+    *value_length = decoder->value_lengths[slot];
+    return 0;
+}
+
+// Ganzzahl mit prefix_bits Bit Praefix (RFC 7541, 5.1)
+static int decode_integer(const uint8_t **pos, const uint8_t *end, int prefix_bits,
+                          uint64_t *result) {
+    uint64_t max_prefix = (1u << prefix_bits) - 1;
+    *result = *(*pos)++ & max_prefix;
+    if (*result < max_prefix) return 0;
+    
+    for (int shift = 0; shift <= 28; shift += 7) {
+        if (*pos == end) return -1;
+        uint8_t byte = *(*pos)++;
+        *result += (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return 0;
+    }
+    return -1;
+}
+
+// Liest einen String nach out (Platz fuer die 8/5-fache Laenge bei Huffman)
+static ssize_t decode_string(const uint8_t **pos, const uint8_t *end, char *out) {
+    if (*pos == end) return -1;
+    bool huffman = **pos & 0x80;
+    uint64_t length;
+    if (decode_integer(pos, end, 7, &length) < 0 || length > (uint64_t)(end - *pos)) {
+        return -1;
+    }
+    
+    const uint8_t *data = *pos;
+    *pos += length;
+    if (huffman) return huffman_decode(data, length, out);
+    memcpy(out, data, length);
+    return length;
+}
+
+int hpack_decode(HpackDecoder *decoder, const uint8_t *block, size_t length,
+                 HpackField callback, void *context) {
+    const uint8_t *pos = block;
+    const uint8_t *end = block + length;
+    
+    // Jeder dekodierte String ist hoechstens 8/5 so lang wie seine
+    // Kodierung; ein Name aus der Tabelle passt in HPACK_TABLE_SIZE
+    char *scratch = malloc(length * 2 + HPACK_TABLE_SIZE);
+    if (!scratch) return -1;
+    int result = 0;
+    bool fields_seen = false;
+    
+    while (pos < end && result == 0) {
+        uint8_t first = *pos;
+        uint64_t index;
+        const char *name, *value;
+        size_t name_length, value_length;
+        
+        if (first & 0x80) {
+            // Indiziertes Feld
+            if (decode_integer(&pos, end, 7, &index) < 0 ||
+                table_lookup(decoder, index, &name, &name_length, &value, &value_length) < 0) {
+                result = -1;
+                break;
+            }
+            fields_seen = true;
+            result = callback(context, name, name_length, value, value_length);
+            continue;
+        }
+        
+        if ((first & 0xe0) == 0x20) {
+            // Groessenaenderung der dynamischen Tabelle, nur am Blockanfang
+            if (fields_seen || decode_integer(&pos, end, 5, &index) < 0 ||
+                index > HPACK_TABLE_SIZE) {
+                result = -1;
+                break;
+            }
+            decoder->max_size = index;
+            while (decoder->count > 0 && decoder->size > decoder->max_size) {
+                evict_oldest(decoder);
+            }
+            continue;
+        }
+        
+        // Literal: mit Indizierung (01), ohne (0000) oder nie indiziert (0001)
+        bool indexed = (first & 0xc0) == 0x40;
+        if (decode_integer(&pos, end, indexed ? 6 : 4, &index) < 0) {
+            result = -1;
+            break;
+        }
+        
+        char *name_buffer = scratch;
+        if (index != 0) {
+            const char *unused;
+            size_t unused_length;
+            if (table_lookup(decoder, index, &name, &name_length, &unused, &unused_length) < 0) {
+                result = -1;
+                break;
+            }
+            // Der Name kann beim Einfuegen verdraengt werden
+            memcpy(name_buffer, name, name_length);
+        } else {
+            ssize_t decoded = decode_string(&pos, end, name_buffer);
+            if (decoded <= 0) {
+                result = -1;
+                break;
+            }
+            name_length = decoded;
+        }
+        
+        char *value_buffer = name_buffer + name_length;
+        ssize_t decoded = decode_string(&pos, end, value_buffer);
+        if (decoded < 0) {
+            result = -1;
+            break;
+        }
+        value_length = decoded;
+        
+        if (indexed && table_insert(decoder, name_buffer, name_length,
+                                    value_buffer, value_length) < 0) {
+            result = -1;
+            break;
+        }
+        fields_seen = true;
+        result = callback(context, name_buffer, name_length, value_buffer, value_length);
+    }
+    
+    free(scratch);
+    return result;
+}
+
+static size_t encode_integer(uint8_t *out, size_t length, size_t capacity, uint8_t flags,
+                             int prefix_bits, uint64_t value) {
+    uint64_t max_prefix = (1u << prefix_bits) - 1;
+    if (length == capacity) return 0;
+    if (value < max_prefix) {
+        out[length++] = flags | value;
+        return length;
+    }
+    
+    out[length++] = flags | max_prefix;
+    value -= max_prefix;
+    while (value >= 0x80) {
+        if (length == capacity) return 0;
+        out[length++] = 0x80 | (value & 0x7f);
+        value >>= 7;
+    }
+    if (length == capacity) return 0;
+    out[length++] = value;
+    return length;
+}
+
+static size_t encode_string(uint8_t *out, size_t length, size_t capacity,
+                            const char *data, size_t data_length) {
+    length = encode_integer(out, length, capacity, 0, 7, data_length);
+    if (length == 0 || data_length > capacity - length) return 0;
+    memcpy(out + length, data, data_length);
+    return length + data_length;
+}
+
+size_t hpack_encode_status(uint8_t *out, size_t length, size_t capacity, int status) {
+    // Haeufige Statuscodes stehen in der statischen Tabelle (Index 8 .. 14)
+    static const int indexed[] = {200, 204, 206, 304, 400, 404, 500};
+    for (size_t i = 0; i < sizeof(indexed) / sizeof(indexed[0]); i++) {
+        if (indexed[i] == status) {
+            return encode_integer(out, length, capacity, 0x80, 7, 8 + i);
+        }
+    }
+    
+    char value[4];
+    value[0] = '0' + status / 100 % 10;
+    value[1] = '0' + status / 10 % 10;
+    value[2] = '0' + status % 10;
+    length = encode_integer(out, length, capacity, 0x00, 4, 8);
+    return length ? encode_string(out, length, capacity, value, 3) : 0;
+}
+
+size_t hpack_encode_field(uint8_t *out, size_t length, size_t capacity,
+                          const char *name, size_t name_length,
+                          const char *value, size_t value_length) {
+    // Literal ohne Indizierung; bekannte Namen per statischem Index
+    for (size_t i = 14; i < STATIC_TABLE_COUNT; i++) {
+        if (strlen(static_table[i][0]) == name_length &&
+            memcmp(static_table[i][0], name, name_length) == 0) {
+            length = encode_integer(out, length, capacity, 0x00, 4, i + 1);
+            return length ? encode_string(out, length, capacity, value, value_length) : 0;
+        }
+    }
+    
+    length = encode_integer(out, length, capacity, 0x00, 4, 0);
+    if (length) length = encode_string(out, length, capacity, name, name_length);
+    return length ? encode_string(out, length, capacity, value, value_length) : 0;
+}
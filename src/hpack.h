@@ -0,0 +1,43 @@
+#ifndef WEBSERVER_HPACK_H
+#define WEBSERVER_HPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// HPACK (RFC 7541): Dekodierer mit statischer und dynamischer Tabelle und
+// Huffman-Strings; der Kodierer schreibt nur Literale ohne Indizierung und
+// braucht daher keinen Zustand
+
+#define HPACK_TABLE_SIZE 4096           // SETTINGS_HEADER_TABLE_SIZE (Default)
+#define HPACK_MAX_ENTRIES (HPACK_TABLE_SIZE / 32)
+
+typedef struct {
+    char *entries[HPACK_MAX_ENTRIES];   // je Name, '\0', Wert; neuester bei head
+    uint32_t name_lengths[HPACK_MAX_ENTRIES];
+    uint32_t value_lengths[HPACK_MAX_ENTRIES];
+    size_t head;
+    size_t count;
+    size_t size;                        // Groesse nach RFC 7541, 4.1
+    size_t max_size;
+} HpackDecoder;
+
+// Wird pro dekodiertem Header-Feld aufgerufen; != 0 bricht ab
+typedef int (*HpackField)(void *context, const char *name, size_t name_length,
+                          const char *value, size_t value_length);
+
+void hpack_decoder_init(HpackDecoder *decoder);
+void hpack_decoder_free(HpackDecoder *decoder);
+
+// Dekodiert einen vollstaendigen Header-Block; -1 bei Kompressionsfehler
+// (die Verbindung ist dann nicht mehr benutzbar), sonst Rueckgabe des Callbacks
+int hpack_decode(HpackDecoder *decoder, const uint8_t *block, size_t length,
+                 HpackField callback, void *context);
+
+// Haengt ein Header-Feld an out an; Rueckgabe die neue Laenge oder 0,
+// wenn capacity nicht reicht
+size_t hpack_encode_status(uint8_t *out, size_t length, size_t capacity, int status);
+size_t hpack_encode_field(uint8_t *out, size_t length, size_t capacity,
+                          const char *name, size_t name_length,
+                          const char *value, size_t value_length);
+
+#endif
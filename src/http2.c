@@ -0,0 +1,1012 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "hpack.h"
+#include "http2.h"
+#include "tls.h"
+
+#define FRAME_HEADER_LENGTH 9
+#define HTTP2_MAX_FRAME 16384               // SETTINGS_MAX_FRAME_SIZE, in beide Richtungen
+#define HTTP2_MAX_STREAMS 256               // SETTINGS_MAX_CONCURRENT_STREAMS
+#define HTTP2_DEFAULT_WINDOW 65535
+#define HTTP2_MAX_WINDOW 0x7fffffff
+#define HTTP2_MAX_HEADER_BLOCK (64 * 1024)
+#define HTTP2_INPUT_SIZE (4 * (FRAME_HEADER_LENGTH + HTTP2_MAX_FRAME))
+#define HTTP2_OUTPUT_SIZE (64 * 1024)
+#define HTTP2_READS_PER_TURN 16             // danach kommen andere Verbindungen dran
+
+enum {
+    FRAME_DATA,
+    FRAME_HEADERS,
+    FRAME_PRIORITY,
+    FRAME_RST_STREAM,
+    FRAME_SETTINGS,
+    FRAME_PUSH_PROMISE,
+    FRAME_PING,
+    FRAME_GOAWAY,
+    FRAME_WINDOW_UPDATE,
+    FRAME_CONTINUATION,
+};
+
+enum {
+    FLAG_END_STREAM = 0x1,
+    FLAG_ACK = 0x1,
+    FLAG_END_HEADERS = 0x4,
+    FLAG_PADDED = 0x8,
+    FLAG_PRIORITY = 0x20,
+};
+
+enum {
+    SETTINGS_HEADER_TABLE_SIZE = 1,
+    SETTINGS_ENABLE_PUSH = 2,
+    SETTINGS_MAX_CONCURRENT_STREAMS = 3,
+    SETTINGS_INITIAL_WINDOW_SIZE = 4,
+    SETTINGS_MAX_FRAME_SIZE = 5,
+    SETTINGS_MAX_HEADER_LIST_SIZE = 6,
+};
+
+enum {
+    ERROR_NONE = 0x0,
+    ERROR_PROTOCOL = 0x1,
+    ERROR_INTERNAL = 0x2,
+    ERROR_FLOW_CONTROL = 0x3,
+    ERROR_STREAM_CLOSED = 0x5,
+    ERROR_FRAME_SIZE = 0x6,
+    ERROR_REFUSED_STREAM = 0x7,
+    ERROR_COMPRESSION = 0x9,
+};
+
+typedef struct Http2Connection Http2Connection;
+
+struct Http2Stream {
+    Http2Connection *connection;
+    struct Http2Stream *next;
+    uint32_t id;
+    bool receiving;                 // Request noch nicht vollstaendig
+    bool headers_received;          // weitere HEADERS sind Trailer
+    bool malformed;                 // wird mit RST_STREAM abgelehnt
+    bool too_large;                 // Header passen nicht in max_request_length
+    
+    // Pseudo-Header und die uebrigen Header als "name: wert\r\n"-Zeilen
+    char method[16];
+    char path[256];
+    char authority[256];
+    bool regular_seen;
+    char *headers;
+    size_t headers_length;
+    char *body;
+    size_t body_length;             // zaehlt auch verworfene Bytes
+    
+    // Antwort: noch nicht gesendeter Rest des Bodys, aus output oder ab
+    // file_offset aus file_fd (-1 ohne Datei)
+    int64_t send_window;
+    bool responded;
+    char *output;
+    int file_fd;
+    off_t file_offset;
+    size_t output_length;
+    size_t output_sent;
+};
+
+struct Http2Connection {
+    Http2Connection *next;          // Liste der ruhenden Verbindungen
+    const Http2Server *server;
+    int fd;
+    bool failed;                    // Socket-Fehler, nur noch aufraeumen
+    HpackDecoder decoder;
+    
+    Http2Stream *streams;
+    size_t stream_count;
+    uint32_t last_stream_id;
+    bool goaway_received;
+    
+    // Header-Block, der sich ueber CONTINUATION-Frames erstreckt
+    uint8_t *header_block;
+    size_t header_block_length;
+    uint32_t header_stream_id;
+    bool header_end_stream;
+    
+    // Flusskontrolle fuer gesendete Daten
+    int64_t send_window;
+    uint32_t peer_initial_window;
+    uint32_t peer_max_frame;
+    
+    uint8_t input[HTTP2_INPUT_SIZE];
+    size_t input_length;
+    uint8_t output[HTTP2_OUTPUT_SIZE];
+    size_t output_length;
+};
+
+static uint32_t read_u32(const uint8_t *data) {
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3];
+}
+
+static void write_u32(uint8_t *out, uint32_t value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static int flush_output(Http2Connection *connection) {
+    size_t sent = 0;
+    while (sent < connection->output_length && !connection->failed) {
+        ssize_t written = tls_send(connection->fd, connection->output + sent,
+                                   connection->output_length - sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EPIPE && errno != ECONNRESET) perror("Error: send failed");
+            connection->failed = true;
+        } else {
+            sent += written;
+        }
+    }
+    connection->output_length = 0;
+    return connection->failed ? -1 : 0;
+}
+
+// Haengt einen Frame an den Ausgabepuffer; gesendet wird gesammelt vor dem
+// naechsten recv() oder wenn der Puffer voll ist
+static int queue_frame(Http2Connection *connection, uint8_t type, uint8_t flags,
+                       uint32_t stream_id, const void *payload, size_t length) {
+    if (connection->output_length + FRAME_HEADER_LENGTH + length > sizeof(connection->output) &&
+        flush_output(connection) < 0) {
+        return -1;
+    }
+    
+    uint8_t *out = connection->output + connection->output_length;
+    out[0] = length >> 16;
+    out[1] = length >> 8;
+    out[2] = length;
+    out[3] = type;
+    out[4] = flags;
+    write_u32(out + 5, stream_id & HTTP2_MAX_WINDOW);
+    if (length > 0) memcpy(out + FRAME_HEADER_LENGTH, payload, length);
+    connection->output_length += FRAME_HEADER_LENGTH + length;
+    return 0;
+}
+
+static int send_rst_stream(Http2Connection *connection, uint32_t stream_id, uint32_t error) {
+    uint8_t payload[4];
+    write_u32(payload, error);
+    return queue_frame(connection, FRAME_RST_STREAM, 0, stream_id, payload, sizeof(payload));
+}
+
+static int send_window_update(Http2Connection *connection, uint32_t stream_id, uint32_t increment) {
+    uint8_t payload[4];
+    write_u32(payload, increment);
+    return queue_frame(connection, FRAME_WINDOW_UPDATE, 0, stream_id, payload, sizeof(payload));
+}
+
+static void send_goaway(Http2Connection *connection, uint32_t error) {
+    uint8_t payload[8];
+    write_u32(payload, connection->last_stream_id);
+    write_u32(payload + 4, error);
+    queue_frame(connection, FRAME_GOAWAY, 0, 0, payload, sizeof(payload));
+    flush_output(connection);
+}
+
+// Verbindungsfehler: GOAWAY senden, danach wird die Verbindung geschlossen
+static int connection_error(Http2Connection *connection, uint32_t error, const char *reason) {
+    fprintf(stderr, "HTTP/2 connection error: %s\n", reason);
+    send_goaway(connection, error);
+    return -1;
+}
+
+static Http2Stream *find_stream(Http2Connection *connection, uint32_t id) {
+    for (Http2Stream *stream = connection->streams; stream; stream = stream->next) {
+        if (stream->id == id) return stream;
+    }
+    return NULL;
+}
+
+static Http2Stream *create_stream(Http2Connection *connection, uint32_t id) {
+    Http2Stream *stream = calloc(1, sizeof(Http2Stream));
+    if (!stream) return NULL;
+    stream->headers = malloc(connection->server->max_request_length);
+    if (!stream->headers) {
+        free(stream);
+        return NULL;
+    }
+    stream->connection = connection;
+    stream->id = id;
+    stream->receiving = true;
+    stream->file_fd = -1;
+    stream->send_window = connection->peer_initial_window;
+    stream->next = connection->streams;
+    connection->streams = stream;
+    connection->stream_count++;
+    return stream;
+}
+
+static void remove_stream(Http2Connection *connection, Http2Stream *stream) {
+    Http2Stream **link = &connection->streams;
+    while (*link != stream) {
+        link = &(*link)->next;
+    }
+    *link = stream->next;
+    connection->stream_count--;
+    free(stream->headers);
+    free(stream->body);
+    free(stream->output);
+    if (stream->file_fd >= 0) close(stream->file_fd);
+    free(stream);
+}
+
+// true, solange ein Rest des Bodys auf Fenster wartet
+static bool body_pending(const Http2Stream *stream) {
+    return stream->output || stream->file_fd >= 0;
+}
+
+// Sendet so viel vom Body, wie Stream- und Verbindungsfenster erlauben,
+// hoechstens aber budget Bytes; final: mit data endet der Body
+static int send_stream_data(Http2Stream *stream, const char *data, size_t length, size_t *sent,
+                            size_t budget, bool final) {
+    Http2Connection *connection = stream->connection;
+    size_t max_frame = connection->peer_max_frame < HTTP2_MAX_FRAME ?
+                       connection->peer_max_frame : HTTP2_MAX_FRAME;
+    
+    while (*sent < length && budget > 0 && stream->send_window > 0 && connection->send_window > 0) {
+        size_t chunk = length - *sent;
+        if (chunk > budget) chunk = budget;
+        if (chunk > max_frame) chunk = max_frame;
+        if ((int64_t)chunk > stream->send_window) chunk = stream->send_window;
+        if ((int64_t)chunk > connection->send_window) chunk = connection->send_window;
+        
+        bool last = final && *sent + chunk == length;
+        if (queue_frame(connection, FRAME_DATA, last ? FLAG_END_STREAM : 0, stream->id,
+                        data + *sent, chunk) < 0) {
+            return -1;
+        }
+        *sent += chunk;
+        budget -= chunk;
+        stream->send_window -= chunk;
+        connection->send_window -= chunk;
+    }
+    return 0;
+}
+
+// Wie send_stream_data() fuer den Rest des Bodys, liest ihn aus der Datei
+// aber nur stueckweise, soweit die Fenster reichen
+static int send_file_data(Http2Stream *stream, size_t budget) {
+    Http2Connection *connection = stream->connection;
+    char chunk[HTTP2_MAX_FRAME];
+    while (stream->output_sent < stream->output_length && budget > 0 &&
+           stream->send_window > 0 && connection->send_window > 0) {
+        size_t length = stream->output_length - stream->output_sent;
+        if (length > budget) length = budget;
+        if (length > sizeof(chunk)) length = sizeof(chunk);
+        if ((int64_t)length > stream->send_window) length = stream->send_window;
+        if ((int64_t)length > connection->send_window) length = connection->send_window;
+        
+        ssize_t bytes_read = pread(stream->file_fd, chunk, length,
+                                   stream->file_offset + stream->output_sent);
+        if (bytes_read < 0 && errno == EINTR) continue;
+        if (bytes_read <= 0) {
+            // Kopf ist schon raus, der Stream kann nur noch abbrechen
+            perror("Error: cannot read value file");
+            stream->output_sent = stream->output_length;
+            return send_rst_stream(connection, stream->id, ERROR_INTERNAL);
+        }
+        size_t sent = 0;
+        bool last = stream->output_sent + bytes_read == stream->output_length;
+        if (send_stream_data(stream, chunk, bytes_read, &sent, bytes_read, last) < 0) return -1;
+        stream->output_sent += sent;
+        budget -= sent;
+    }
+    return 0;
+}
+
+// Reihum je ein Stueck pro Stream, bis die Fenster erschoepft sind
+static int send_pending(Http2Connection *connection) {
+    bool progress = true;
+    while (progress && connection->send_window > 0) {
+        progress = false;
+        Http2Stream *stream = connection->streams;
+        while (stream) {
+            Http2Stream *next = stream->next;
+            if (body_pending(stream) && stream->send_window > 0) {
+                size_t before = stream->output_sent;
+                if ((stream->output ?
+                     send_stream_data(stream, stream->output, stream->output_length,
+                                      &stream->output_sent, HTTP2_MAX_FRAME, true) :
+                     send_file_data(stream, HTTP2_MAX_FRAME)) < 0) {
+                    return -1;
+                }
+                progress = progress || stream->output_sent != before;
+                if (stream->output_sent == stream->output_length) {
+                    remove_stream(connection, stream);
+                }
+            }
+            stream = next;
+        }
+    }
+    return 0;
+}
+
+static bool is_connection_header(const char *name, size_t length) {
+    static const char *const names[] = {
+        "connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade",
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strlen(names[i]) == length && strncasecmp(names[i], name, length) == 0) return true;
+    }
+    return false;
+}
+
+// HEADERS-Frame der Antwort; ohne Body endet damit der Stream
+static int queue_response_headers(Http2Stream *stream, int status, const char *headers,
+                                  size_t length, bool has_body) {
+    Http2Connection *connection = stream->connection;
+    if (stream->responded) return -1;
+    stream->responded = true;
+    
+    uint8_t block[HTTP2_MAX_FRAME];
+    size_t block_length = hpack_encode_status(block, 0, sizeof(block), status);
+    
+    // "Name: Wert\r\n"-Zeilen in kleingeschriebene Felder umsetzen
+    const char *line = headers ? headers : "";
+    while (*line && block_length) {
+        const char *line_end = strstr(line, "\r\n");
+        if (!line_end) line_end = line + strlen(line);
+        const char *colon = memchr(line, ':', line_end - line);
+        if (colon && !is_connection_header(line, colon - line)) {
+            char name[64];
+            size_t name_length = colon - line;
+            if (name_length >= sizeof(name)) name_length = sizeof(name) - 1;
+            for (size_t i = 0; i < name_length; i++) {
+                name[i] = (line[i] >= 'A' && line[i] <= 'Z') ? line[i] + 32 : line[i];
+            }
+            const char *value = colon + 1;
+            while (value < line_end && *value == ' ') value++;
+            block_length = hpack_encode_field(block, block_length, sizeof(block), name, name_length,
+                                              value, line_end - value);
+        }
+        line = *line_end ? line_end + 2 : line_end;
+    }
+    
+    char content_length[24];
+    int digits = snprintf(content_length, sizeof(content_length), "%zu", length);
+    if (block_length) {
+        block_length = hpack_encode_field(block, block_length, sizeof(block), "content-length", 14,
+                                          content_length, digits);
+    }
+    if (block_length == 0) {
+        fprintf(stderr, "Error: HTTP/2 response headers too large\n");
+        send_rst_stream(connection, stream->id, ERROR_INTERNAL);
+        return 1;
+    }
+    
+    return queue_frame(connection, FRAME_HEADERS, FLAG_END_HEADERS | (has_body ? 0 : FLAG_END_STREAM),
+                       stream->id, block, block_length);
+}
+
+int http2_respond(Http2Stream *stream, int status, const char *headers,
+                  const char *body, size_t length) {
+    Http2Connection *connection = stream->connection;
+    bool has_body = body && length > 0;
+    int queued = queue_response_headers(stream, status, headers, length, has_body);
+    if (queued != 0 || !has_body) return queued < 0 ? -1 : 0;
+    
+    // Was nicht sofort ins Fenster passt, wartet auf WINDOW_UPDATE
+    size_t sent = 0;
+    if (send_stream_data(stream, body, length, &sent, length, true) < 0) return -1;
+    if (sent < length) {
+        stream->output = malloc(length - sent);
+        if (!stream->output) return send_rst_stream(connection, stream->id, ERROR_INTERNAL);
+        memcpy(stream->output, body + sent, length - sent);
+        stream->output_length = length - sent;
+    }
+    return 0;
+}
+
+int http2_respond_file(Http2Stream *stream, int status, const char *headers,
+                       int fd, off_t offset, size_t length) {
+    Http2Connection *connection = stream->connection;
+    int queued = queue_response_headers(stream, status, headers, length, length > 0);
+    if (queued != 0 || length == 0) return queued < 0 ? -1 : 0;
+    
+    stream->file_fd = dup(fd);
+    if (stream->file_fd < 0) {
+        perror("Error: cannot duplicate value file");
+        return send_rst_stream(connection, stream->id, ERROR_INTERNAL);
+    }
+    stream->file_offset = offset;
+    stream->output_length = length;
+    return send_file_data(stream, length);
+}
+
+// Haengt eine Zeile an den Header-Text des Streams an
+static void append_header(Http2Stream *stream, const char *name, size_t name_length,
+                          const char *value, size_t value_length) {
+    size_t capacity = stream->connection->server->max_request_length;
+    size_t needed = name_length + value_length + 4;
+    if (stream->headers_length + needed > capacity) {
+        stream->too_large = true;
+        return;
+    }
+    char *out = stream->headers + stream->headers_length;
+    memcpy(out, name, name_length);
+    memcpy(out + name_length, ": ", 2);
+    memcpy(out + name_length + 2, value, value_length);
+    memcpy(out + name_length + 2 + value_length, "\r\n", 2);
+    stream->headers_length += needed;
+}
+
+static bool copy_pseudo(char *out, size_t out_size, const char *value, size_t length) {
+    if (out[0] != '\0' || length == 0 || length >= out_size) return false;
+    memcpy(out, value, length);
+    out[length] = '\0';
+    return true;
+}
+
+// Pruefung nach RFC 9113, 8.2 und 8.3; Verstoesse machen den Request ungueltig
+static int collect_header(void *context, const char *name, size_t name_length,
+                          const char *value, size_t value_length) {
+    Http2Stream *stream = context;
+    if (!stream || stream->malformed) return 0;
+    
+    for (size_t i = 0; i < value_length; i++) {
+        if (value[i] == '\r' || value[i] == '\n' || value[i] == '\0') {
+            stream->malformed = true;
+            return 0;
+        }
+    }
+    for (size_t i = 0; i < name_length; i++) {
+        if ((name[i] >= 'A' && name[i] <= 'Z') || (i > 0 && name[i] == ':') || name[i] == ' ') {
+            stream->malformed = true;
+            return 0;
+        }
+    }
+    
+    // Trailer werden gelesen, aber nicht weitergereicht
+    if (stream->headers_received) return 0;
+    
+    if (name[0] == ':') {
+        bool valid = !stream->regular_seen;
+        if (name_length == 7 && memcmp(name, ":method", 7) == 0) {
+            valid = valid && copy_pseudo(stream->method, sizeof(stream->method), value, value_length);
+        } else if (name_length == 5 && memcmp(name, ":path", 5) == 0) {
+            valid = valid && copy_pseudo(stream->path, sizeof(stream->path), value, value_length);
+        } else if (name_length == 10 && memcmp(name, ":authority", 10) == 0) {
+            valid = valid && copy_pseudo(stream->authority, sizeof(stream->authority),
+                                         value, value_length);
+        } else if (!(name_length == 7 && memcmp(name, ":scheme", 7) == 0)) {
+            valid = false;
+        }
+        stream->malformed = !valid;
+        return 0;
+    }
+    
+    stream->regular_seen = true;
+    if (is_connection_header(name, name_length) ||
+        (name_length == 2 && memcmp(name, "te", 2) == 0 &&
+         !(value_length == 8 && memcmp(value, "trailers", 8) == 0))) {
+        stream->malformed = true;
+        return 0;
+    }
+    // Content-Length ergibt sich aus den DATA-Frames, Host aus :authority
+    if ((name_length == 14 && memcmp(name, "content-length", 14) == 0) ||
+        (name_length == 4 && memcmp(name, "host", 4) == 0 && stream->authority[0])) {
+        return 0;
+    }
+    append_header(stream, name, name_length, value, value_length);
+    return 0;
+}
+
+// Setzt den vollstaendigen Request zusammen und ruft den Handler
+static int dispatch_stream(Http2Connection *connection, Http2Stream *stream) {
+    stream->receiving = false;
+    if (stream->malformed || !stream->method[0] || !stream->path[0]) {
+        send_rst_stream(connection, stream->id, ERROR_PROTOCOL);
+        remove_stream(connection, stream);
+        return 0;
+    }
+    
+    const Http2Server *server = connection->server;
+    if (stream->too_large) {
+        http2_respond(stream, 431, NULL, NULL, 0);
+        remove_stream(connection, stream);
+        return connection->failed ? -1 : 0;
+    }
+    
+    char start[600];
+    int start_length = snprintf(start, sizeof(start), "%s %s HTTP/2.0\r\n%s%s%s",
+                                stream->method, stream->path,
+                                stream->authority[0] ? "host: " : "", stream->authority,
+                                stream->authority[0] ? "\r\n" : "");
+    char end[48];
+    int end_length = snprintf(end, sizeof(end), "content-length: %zu\r\n\r\n", stream->body_length);
+    
+    // Verworfene Bodies bleiben leer; der Router lehnt solche Laengen ab
+    size_t body_length = stream->body_length <= server->max_request_length ? stream->body_length : 0;
+    size_t headers_length = start_length + stream->headers_length + end_length;
+    char *request = malloc(headers_length + body_length + 1);
+    if (!request) {
+        send_rst_stream(connection, stream->id, ERROR_INTERNAL);
+        remove_stream(connection, stream);
+        return 0;
+    }
+    memcpy(request, start, start_length);
+    memcpy(request + start_length, stream->headers, stream->headers_length);
+    memcpy(request + start_length + stream->headers_length, end, end_length);
+    if (body_length) memcpy(request + headers_length, stream->body, body_length);
+    request[headers_length + body_length] = '\0';
+    
+    int result = server->handler(server->context, stream, request, headers_length,
+                                 headers_length + body_length);
+    free(request);
+    if (connection->failed) return -1;
+    if (!stream->responded) {
+        send_rst_stream(connection, stream->id, ERROR_INTERNAL);
+    }
+    if (result < 0) {
+        fprintf(stderr, "Error: HTTP/2 stream %u failed\n", stream->id);
+    }
+    if (!body_pending(stream)) remove_stream(connection, stream);
+    return 0;
+}
+
+// Entfernt Padding (und bei HEADERS die Prioritaet) aus einem Payload
+static int strip_padding(uint8_t flags, bool priority, const uint8_t **payload, size_t *length) {
+    size_t padding = 0;
+    if (flags & FLAG_PADDED) {
+        if (*length < 1) return -1;
+        padding = (*payload)[0];
+        (*payload)++;
+        (*length)--;
+    }
+    if (priority && (flags & FLAG_PRIORITY)) {
+        if (*length < 5) return -1;
+        *payload += 5;
+        *length -= 5;
+    }
+    if (padding > *length) return -1;
+    *length -= padding;
+    return 0;
+}
+
+// Ein vollstaendiger Header-Block liegt vor
+static int finish_header_block(Http2Connection *connection) {
+    uint32_t id = connection->header_stream_id;
+    bool end_stream = connection->header_end_stream;
+    Http2Stream *stream = find_stream(connection, id);
+    bool refused = false;
+    
+    if (!stream) {
+        if (id <= connection->last_stream_id) {
+            return connection_error(connection, ERROR_STREAM_CLOSED, "HEADERS on closed stream");
+        }
+        connection->last_stream_id = id;
+        refused = connection->stream_count >= HTTP2_MAX_STREAMS || connection->goaway_received;
+        stream = refused ? NULL : create_stream(connection, id);
+        refused = refused || !stream;
+    } else if (!stream->receiving || !end_stream) {
+        return connection_error(connection, ERROR_PROTOCOL, "unexpected HEADERS");
+    }
+    
+    // Auch abgelehnte Bloecke dekodieren, sonst geraet die Tabelle aus dem Takt
+    int result = hpack_decode(&connection->decoder, connection->header_block,
+                              connection->header_block_length, collect_header, stream);
+    connection->header_block_length = 0;
+    connection->header_stream_id = 0;
+    if (result < 0) {
+        return connection_error(connection, ERROR_COMPRESSION, "invalid header block");
+    }
+    if (refused) {
+        return send_rst_stream(connection, id, ERROR_REFUSED_STREAM);
+    }
+    
+    stream->headers_received = true;
+    if (end_stream) return dispatch_stream(connection, stream);
+    return 0;
+}
+
+static int handle_header_fragment(Http2Connection *connection, const uint8_t *data, size_t length,
+                                  uint8_t flags) {
+    if (connection->header_block_length + length > HTTP2_MAX_HEADER_BLOCK) {
+        return connection_error(connection, ERROR_PROTOCOL, "header block too large");
+    }
+    if (!connection->header_block) {
+        connection->header_block = malloc(HTTP2_MAX_HEADER_BLOCK);
+        if (!connection->header_block) {
+            return connection_error(connection, ERROR_INTERNAL, "out of memory");
+        }
+    }
+    memcpy(connection->header_block + connection->header_block_length, data, length);
+    connection->header_block_length += length;
+    return (flags & FLAG_END_HEADERS) ? finish_header_block(connection) : 0;
+}
+
+static int handle_data(Http2Connection *connection, uint32_t id, uint8_t flags,
+                       const uint8_t *payload, size_t length) {
+    size_t frame_length = length;
+    if (id == 0 || id > connection->last_stream_id) {
+        return connection_error(connection, ERROR_PROTOCOL, "DATA on idle stream");
+    }
+    if (strip_padding(flags, false, &payload, &length) < 0) {
+        return connection_error(connection, ERROR_PROTOCOL, "invalid padding");
+    }
+    
+    // Gelesene Bytes sofort wieder freigeben; der Puffer ist nie das Limit
+    if (frame_length > 0 && send_window_update(connection, 0, frame_length) < 0) return -1;
+    
+    Http2Stream *stream = find_stream(connection, id);
+    if (!stream || !stream->receiving) {
+        return send_rst_stream(connection, id, ERROR_STREAM_CLOSED);
+    }
+    
+    size_t limit = connection->server->max_request_length;
+    if (stream->body_length + length <= limit) {
+        if (!stream->body) stream->body = malloc(limit);
+        if (!stream->body) {
+            return connection_error(connection, ERROR_INTERNAL, "out of memory");
+        }
+        memcpy(stream->body + stream->body_length, payload, length);
+    }
+    stream->body_length += length;
+    
+    if (flags & FLAG_END_STREAM) return dispatch_stream(connection, stream);
+    if (frame_length > 0) return send_window_update(connection, id, frame_length);
+    return 0;
+}
+
+static int apply_settings(Http2Connection *connection, const uint8_t *payload, size_t length) {
+    for (size_t i = 0; i + 6 <= length; i += 6) {
+        uint16_t id = payload[i] << 8 | payload[i + 1];
+        uint32_t value = read_u32(payload + i + 2);
+        
+        if (id == SETTINGS_INITIAL_WINDOW_SIZE) {
+            if (value > HTTP2_MAX_WINDOW) {
+                return connection_error(connection, ERROR_FLOW_CONTROL, "window too large");
+            }
+            // Aendert die Fenster aller offenen Streams um die Differenz;
+            // keines darf dabei ueber 2^31-1 wachsen (RFC 7540, 6.9.2)
+            int64_t delta = (int64_t)value - connection->peer_initial_window;
+            for (Http2Stream *stream = connection->streams; stream; stream = stream->next) {
+                if (stream->send_window + delta > HTTP2_MAX_WINDOW) {
+                    return connection_error(connection, ERROR_FLOW_CONTROL, "window too large");
+                }
+            }
+            for (Http2Stream *stream = connection->streams; stream; stream = stream->next) {
+                stream->send_window += delta;
+            }
+            connection->peer_initial_window = value;
+        } else if (id == SETTINGS_MAX_FRAME_SIZE) {
+            if (value < HTTP2_MAX_FRAME || value > 0xffffff) {
+                return connection_error(connection, ERROR_PROTOCOL, "invalid frame size");
+            }
+            connection->peer_max_frame = value;
+        } else if (id == SETTINGS_ENABLE_PUSH && value > 1) {
+            return connection_error(connection, ERROR_PROTOCOL, "invalid ENABLE_PUSH");
+        }
+    }
+    return 0;
+}
+
+static int handle_frame(Http2Connection *connection, uint8_t type, uint8_t flags, uint32_t id,
+                        const uint8_t *payload, size_t length) {
+    // Zwischen HEADERS und dem letzten CONTINUATION ist nichts anderes erlaubt
+    if (connection->header_stream_id != 0 &&
+        (type != FRAME_CONTINUATION || id != connection->header_stream_id)) {
+        return connection_error(connection, ERROR_PROTOCOL, "expected CONTINUATION");
+    }
+    
+    switch (type) {
+    case FRAME_DATA:
+        return handle_data(connection, id, flags, payload, length);
+    
+    case FRAME_HEADERS:
+        if (id == 0 || id % 2 == 0) {
+            return connection_error(connection, ERROR_PROTOCOL, "invalid stream id");
+        }
+        if (strip_padding(flags, true, &payload, &length) < 0) {
+            return connection_error(connection, ERROR_PROTOCOL, "invalid padding");
+        }
+        connection->header_stream_id = id;
+        connection->header_end_stream = flags & FLAG_END_STREAM;
+        return handle_header_fragment(connection, payload, length, flags);
+    
+    case FRAME_CONTINUATION:
+        if (connection->header_stream_id == 0) {
+            return connection_error(connection, ERROR_PROTOCOL, "unexpected CONTINUATION");
+        }
+        return handle_header_fragment(connection, payload, length, flags);
+    
+    case FRAME_PRIORITY:
+        if (id == 0 || length != 5) {
+            return connection_error(connection, ERROR_PROTOCOL, "invalid PRIORITY");
+        }
+        return 0;
+    
+    case FRAME_RST_STREAM: {
+        if (id == 0 || length != 4) {
+            return connection_error(connection, ERROR_PROTOCOL, "invalid RST_STREAM");
+        }
+        Http2Stream *stream = find_stream(connection, id);
+        if (stream) remove_stream(connection, stream);
+        return 0;
+    }
+    
+    case FRAME_SETTINGS:
+        if (id != 0 || length % 6 != 0 || ((flags & FLAG_ACK) && length != 0)) {
+            return connection_error(connection, ERROR_FRAME_SIZE, "invalid SETTINGS");
+        }
+        if (flags & FLAG_ACK) return 0;
+        if (apply_settings(connection, payload, length) < 0) return -1;
+        return queue_frame(connection, FRAME_SETTINGS, FLAG_ACK, 0, NULL, 0);
+    
+    case FRAME_PING:
+        if (id != 0 || length != 8) {
+            return connection_error(connection, ERROR_FRAME_SIZE, "invalid PING");
+        }
+        if (flags & FLAG_ACK) return 0;
+        return queue_frame(connection, FRAME_PING, FLAG_ACK, 0, payload, length);
+    
+    case FRAME_GOAWAY:
+        if (id != 0 || length < 8) {
+            return connection_error(connection, ERROR_PROTOCOL, "invalid GOAWAY");
+        }
+        connection->goaway_received = true;
+        return 0;
+    
+    case FRAME_WINDOW_UPDATE: {
+        if (length != 4) {
+            return connection_error(connection, ERROR_FRAME_SIZE, "invalid WINDOW_UPDATE");
+        }
+        uint32_t increment = read_u32(payload) & HTTP2_MAX_WINDOW;
+        if (id == 0) {
+            if (increment == 0 || connection->send_window + increment > HTTP2_MAX_WINDOW) {
+                return connection_error(connection, ERROR_FLOW_CONTROL, "invalid window increment");
+            }
+            connection->send_window += increment;
+            return 0;
+        }
+        Http2Stream *stream = find_stream(connection, id);
+        if (!stream) return 0;
+        if (increment == 0 || stream->send_window + increment > HTTP2_MAX_WINDOW) {
+            send_rst_stream(connection, id, ERROR_FLOW_CONTROL);
+            remove_stream(connection, stream);
+            return 0;
+        }
+        stream->send_window += increment;
+        return 0;
+    }
+    
+    case FRAME_PUSH_PROMISE:
+        return connection_error(connection, ERROR_PROTOCOL, "PUSH_PROMISE from client");
+    
+    default:
+        // Unbekannte Frame-Typen werden ignoriert
+        return 0;
+    }
+}
+
+// Verarbeitet alle vollstaendigen Frames im Eingabepuffer
+static int process_input(Http2Connection *connection) {
+    size_t offset = 0;
+    int result = 0;
+    
+    while (result == 0 && connection->input_length - offset >= FRAME_HEADER_LENGTH) {
+        const uint8_t *frame = connection->input + offset;
+        size_t length = (size_t)frame[0] << 16 | frame[1] << 8 | frame[2];
+        if (length > HTTP2_MAX_FRAME) {
+            result = connection_error(connection, ERROR_FRAME_SIZE, "frame too large");
+            break;
+        }
+        if (connection->input_length - offset < FRAME_HEADER_LENGTH + length) break;
+        
+        result = handle_frame(connection, frame[3], frame[4], read_u32(frame + 5) & HTTP2_MAX_WINDOW,
+                              frame + FRAME_HEADER_LENGTH, length);
+        offset += FRAME_HEADER_LENGTH + length;
+    }
+    
+    memmove(connection->input, connection->input + offset, connection->input_length - offset);
+    connection->input_length -= offset;
+    return result;
+}
+
+// Liest mehr Bytes; 0 bei geschlossener Verbindung oder Stopp
+static ssize_t read_input(Http2Connection *connection) {
+    while (1) {
+        ssize_t bytes_read = tls_recv(connection->fd, connection->input + connection->input_length,
+                                      sizeof(connection->input) - connection->input_length, 0);
+        if (bytes_read >= 0) {
+            connection->input_length += bytes_read;
+            return bytes_read;
+        }
+        if (errno == EINTR && !*connection->server->stop) continue;
+        if (errno == EINTR) return 0;
+        if (errno != ECONNRESET) perror("Error: recv failed");
+        return -1;
+    }
+}
+
+static int base64url_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-' || c == '+') return 62;
+    if (c == '_' || c == '/') return 63;
+    return -1;
+}
+
+// HTTP2-Settings: base64url-kodierter SETTINGS-Payload (ohne Padding)
+static int apply_upgrade_settings(Http2Connection *connection, const Http2Upgrade *upgrade) {
+    uint8_t payload[256];
+    size_t length = 0;
+    uint32_t bits = 0;
+    int bit_count = 0;
+    
+    for (size_t i = 0; i < upgrade->settings_length; i++) {
+        if (upgrade->settings[i] == '=') break;
+        int value = base64url_value(upgrade->settings[i]);
+        if (value < 0 || length == sizeof(payload)) return -1;
+        bits = bits << 6 | value;
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            payload[length++] = bits >> bit_count;
+        }
+    }
+    if (length % 6 != 0) return -1;
+    return apply_settings(connection, payload, length);
+}
+
+static Http2Connection *suspended;
+
+// Auch von OpenSSL schon gelesene Bytes zaehlen, die poll() nicht sieht
+static bool readable(int fd) {
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    return tls_pending(fd) || poll(&pfd, 1, 0) > 0;
+}
+
+static void free_connection(Http2Connection *connection) {
+    while (connection->streams) {
+        remove_stream(connection, connection->streams);
+    }
+    free(connection->header_block);
+    hpack_decoder_free(&connection->decoder);
+    free(connection);
+}
+
+// Verarbeitet Frames und liest weiter, solange Daten anliegen; sonst oder
+// nach HTTP2_READS_PER_TURN Lesevorgaengen ruht die Verbindung in der Liste
+static int run_connection(Http2Connection *connection, int result) {
+    const Http2Server *server = connection->server;
+    unsigned reads = 0;
+    while (result == 0) {
+        result = process_input(connection);
+        if (result == 0) result = send_pending(connection);
+        if (result == 0) result = flush_output(connection);
+        if (result != 0) break;
+        
+        if (*server->stop) {
+            send_goaway(connection, ERROR_NONE);
+            break;
+        }
+        if (connection->goaway_received && connection->stream_count == 0) break;
+        
+        // Gepufferte TLS-Daten werden erst geleert, damit poll() die
+        // ruhende Verbindung wieder meldet
+        if (!tls_pending(connection->fd) &&
+            (reads++ == HTTP2_READS_PER_TURN || !readable(connection->fd))) {
+            connection->next = suspended;
+            suspended = connection;
+            return HTTP2_SUSPENDED;
+        }
+        
+        ssize_t bytes_read = read_input(connection);
+        if (bytes_read <= 0) {
+            if (bytes_read < 0) result = -1;
+            break;
+        }
+    }
+    
+    free_connection(connection);
+    return result < 0 ? -1 : 0;
+}
+
+static Http2Connection *take_suspended(int fd) {
+    for (Http2Connection **link = &suspended; *link; link = &(*link)->next) {
+        if ((*link)->fd == fd) {
+            Http2Connection *connection = *link;
+            *link = connection->next;
+            return connection;
+        }
+    }
+    return NULL;
+}
+
+int http2_serve(const Http2Server *server, int fd, const char *input, size_t input_length,
+                const Http2Upgrade *upgrade) {
+    Http2Connection *connection = calloc(1, sizeof(Http2Connection));
+    if (!connection) return -1;
+    connection->server = server;
+    connection->fd = fd;
+    connection->send_window = HTTP2_DEFAULT_WINDOW;
+    connection->peer_initial_window = HTTP2_DEFAULT_WINDOW;
+    connection->peer_max_frame = HTTP2_MAX_FRAME;
+    hpack_decoder_init(&connection->decoder);
+    
+    int result = 0;
+    if (input_length > sizeof(connection->input)) input_length = sizeof(connection->input);
+    memcpy(connection->input, input, input_length);
+    connection->input_length = input_length;
+    
+    // Server-Preface: unsere Einstellungen
+    uint8_t settings[12];
+    settings[0] = 0;
+    settings[1] = SETTINGS_MAX_CONCURRENT_STREAMS;
+    write_u32(settings + 2, HTTP2_MAX_STREAMS);
+    settings[6] = 0;
+    settings[7] = SETTINGS_MAX_HEADER_LIST_SIZE;
+    write_u32(settings + 8, server->max_request_length);
+    queue_frame(connection, FRAME_SETTINGS, 0, 0, settings, sizeof(settings));
+    
+    if (upgrade && apply_upgrade_settings(connection, upgrade) < 0) {
+        result = connection_error(connection, ERROR_PROTOCOL, "invalid HTTP2-Settings");
+    }
+    
+    // Client-Preface abwarten
+    while (result == 0 && connection->input_length < HTTP2_PREFACE_LENGTH) {
+        if (flush_output(connection) < 0 || read_input(connection) <= 0) result = -1;
+    }
+    if (result == 0 && memcmp(connection->input, HTTP2_PREFACE, HTTP2_PREFACE_LENGTH) != 0) {
+        result = connection_error(connection, ERROR_PROTOCOL, "invalid client preface");
+    }
+    if (result == 0) {
+        connection->input_length -= HTTP2_PREFACE_LENGTH;
+        memmove(connection->input, connection->input + HTTP2_PREFACE_LENGTH, connection->input_length);
+    }
+    
+    // Der Upgrade-Request ist Stream 1, halb geschlossen
+    if (result == 0 && upgrade) {
+        Http2Stream *stream = create_stream(connection, 1);
+        connection->last_stream_id = 1;
+        if (!stream) {
+            result = -1;
+        } else {
+            stream->receiving = false;
+            int handled = server->handler(server->context, stream, upgrade->request,
+                                          upgrade->headers_length, upgrade->length);
+            if (connection->failed) {
+                result = -1;
+            } else {
+                if (!stream->responded) send_rst_stream(connection, 1, ERROR_INTERNAL);
+                if (handled < 0) fprintf(stderr, "Error: HTTP/2 stream 1 failed\n");
+                if (!body_pending(stream)) remove_stream(connection, stream);
+            }
+        }
+    }
+    
+    return run_connection(connection, result);
+}
+
+int http2_resume(int fd) {
+    Http2Connection *connection = take_suspended(fd);
+    return connection ? run_connection(connection, 0) : -1;
+}
+
+void http2_drop(int fd) {
+    Http2Connection *connection = take_suspended(fd);
+    if (!connection) return;
+    if (*connection->server->stop) {
+        send_goaway(connection, ERROR_NONE);
+    }
+    free_connection(connection);
+}
+
+int http2_stream_fd(const Http2Stream *stream) {
+    return stream->connection->fd;
+}
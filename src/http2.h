@@ -0,0 +1,74 @@
+#ifndef WEBSERVER_HTTP2_H
+#define WEBSERVER_HTTP2_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// HTTP/2 ueber Klartext (h2c), per Prior Knowledge oder Upgrade. Jeder
+// vollstaendig empfangene Stream wird als HTTP/1.1-Text an den Handler
+// gereicht, damit Parser und Router dieselben bleiben; die Antwort kommt
+// ueber http2_respond() zurueck. Waehrend Antworten auf Fenster warten,
+// laufen weitere Streams auf derselben Verbindung.
+
+#define HTTP2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define HTTP2_PREFACE_LENGTH 24
+
+typedef struct Http2Stream Http2Stream;
+
+// request: Request-Zeile, Header (inkl. Content-Length), Leerzeile, Body
+typedef int (*Http2Handler)(void *context, Http2Stream *stream, const char *request,
+                            size_t headers_length, size_t length);
+
+typedef struct {
+    Http2Handler handler;
+    void *context;
+    size_t max_request_length;          // groessere Requests werden nicht gepuffert
+    volatile sig_atomic_t *stop;        // gesetzt: Verbindung mit GOAWAY beenden
+} Http2Server;
+
+// Nach "Upgrade: h2c" wird der ausloesende HTTP/1.1-Request zu Stream 1
+typedef struct {
+    const char *settings;               // Wert von HTTP2-Settings (base64url)
+    size_t settings_length;
+    const char *request;
+    size_t headers_length;
+    size_t length;
+} Http2Upgrade;
+
+// Rueckgabe, wenn auf der Verbindung gerade nichts zu lesen ist; ihr Zustand
+// bleibt erhalten, bis http2_resume() oder http2_drop() sie aufnimmt. server
+// muss solange gueltig bleiben
+#define HTTP2_SUSPENDED 1
+
+// Bedient eine Verbindung, solange Frames anliegen; input sind bereits
+// gelesene Bytes ab dem Client-Preface, upgrade NULL bei Prior Knowledge.
+// 0 am Ende, -1 bei Fehler, sonst HTTP2_SUSPENDED. Das Client-Preface und
+// Schreibvorgaenge werden weiterhin blockierend abgewartet
+int http2_serve(const Http2Server *server, int fd, const char *input, size_t input_length,
+                const Http2Upgrade *upgrade);
+
+// Setzt eine ruhende Verbindung fort, sobald fd lesbar ist; Rueckgabe wie
+// bei http2_serve()
+int http2_resume(int fd);
+
+// Gibt den Zustand einer ruhenden Verbindung frei (beim Stopp nach einem
+// GOAWAY); fd bleibt offen
+void http2_drop(int fd);
+
+// Socket der Verbindung, zu der der Stream gehoert
+int http2_stream_fd(const Http2Stream *stream);
+
+// Antwortet auf einen Stream; headers als "Name: Wert\r\n"-Zeilen wie bei
+// HTTP/1.1, Verbindungs-Header werden ausgelassen
+int http2_respond(Http2Stream *stream, int status, const char *headers,
+                  const char *body, size_t length);
+
+// Wie http2_respond(), der Body sind length Bytes ab offset in fd. Die
+// Datei wird nicht auf einmal gelesen, sondern stueckweise, soweit die
+// Fenster des Clients reichen; fd bleibt beim Aufrufer (der Stream haelt
+// eine Kopie)
+int http2_respond_file(Http2Stream *stream, int status, const char *headers,
+                       int fd, off_t offset, size_t length);
+
+#endif
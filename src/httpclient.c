@@ -0,0 +1,336 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <netdb.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "httpclient.h"
+
+#define RESPONSE_INITIAL_SIZE 16384
+
+// Fortschritt beim Lesen einer Antwort
+typedef struct {
+    size_t head_length;                 // 0: Header noch unvollstaendig
+    ssize_t content_length;             // -1: bis zum Verbindungsende bzw. chunked
+    bool chunked;
+    size_t chunk_position;              // naechste Chunk-Zeile im Rohtext
+    size_t decoded_length;              // zusammengesetzter Body hinter den Headern
+} ResponseState;
+
+int http_peer_init(HttpPeer *peer, const char *address, size_t length, unsigned timeout_seconds) {
+    if (length == 0 || length >= sizeof(peer->name)) return -1;
+    const char *colon = memrchr(address, ':', length);
+    size_t port_length = colon ? length - (colon - address) - 1 : 0;
+    if (!colon || colon == address || port_length == 0 || port_length >= sizeof(peer->port)) {
+        return -1;
+    }
+    
+    snprintf(peer->name, sizeof(peer->name), "%.*s", (int)length, address);
+    snprintf(peer->host, sizeof(peer->host), "%.*s", (int)(colon - address), address);
+    snprintf(peer->port, sizeof(peer->port), "%.*s", (int)port_length, colon + 1);
+    peer->timeout_seconds = timeout_seconds;
+    pthread_mutex_init(&peer->lock, NULL);
+    peer->idle_count = 0;
+    return 0;
+}
+
+static int connect_peer(const HttpPeer *peer) {
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *addresses;
+    if (getaddrinfo(peer->host, peer->port, &hints, &addresses) != 0) return -1;
+    
+    int fd = -1;
+    for (struct addrinfo *address = addresses; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd < 0) continue;
+        
+        // Eine haengende Gegenstelle blockiert sonst den Aufrufer
+        struct timeval timeout = {peer->timeout_seconds, 0};
+        int opt = 1;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        if (connect(fd, address->ai_addr, address->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+static int send_request(int fd, const char *request, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, request, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        request += sent;
+        length -= sent;
+    }
+    return 0;
+}
+
+static bool header_is(const char *line, size_t name_length, const char *name) {
+    return name_length == strlen(name) && strncasecmp(line, name, name_length) == 0;
+}
+
+// Hop-by-Hop-Header (RFC 7230, 6.1) gelten nur fuer die Verbindung zur
+// Gegenstelle; connection ist der Wert ihres Connection-Headers oder NULL
+static bool is_hop_by_hop(const char *line, size_t name_length,
+                          const char *connection, size_t connection_length) {
+    static const char *const names[] = {"connection", "keep-alive", "te", "trailer", "upgrade"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (header_is(line, name_length, names[i])) return true;
+    }
+    if (name_length > 6 && strncasecmp(line, "proxy-", 6) == 0) return true;
+    
+    const char *end = connection + connection_length;
+    for (const char *token = connection; token && token < end;) {
+        while (token < end && (*token == ' ' || *token == '\t' || *token == ',')) token++;
+        const char *token_end = token;
+        while (token_end < end && *token_end != ',' && *token_end != ' ' && *token_end != '\t') {
+            token_end++;
+        }
+        if (token_end - token == (ptrdiff_t)name_length &&
+            strncasecmp(token, line, name_length) == 0) {
+            return true;
+        }
+        token = token_end;
+    }
+    return false;
+}
+
+// Zerlegt Status-Zeile und Header
+static int parse_head(char *head, size_t head_length, HttpResponse *response, ResponseState *state) {
+    char *line_end = memmem(head, head_length, "\r\n", 2);
+    if (!line_end || head_length < 12 || strncmp(head, "HTTP/1.", 7) != 0) return -1;
+    response->status = atoi(head + 9);
+    snprintf(response->status_text, sizeof(response->status_text), "%.*s",
+             line_end - head > 13 ? (int)(line_end - head - 13) : 0, head + 13);
+    
+    response->headers = malloc(head_length + 1);
+    if (!response->headers) return -1;
+    size_t headers_length = 0;
+    state->content_length = -1;
+    
+    char *end = head + head_length - 2;
+    const char *connection = NULL;
+    size_t connection_length = 0;
+    for (char *line = line_end + 2; line < end;) {
+        char *next = memmem(line, end - line + 2, "\r\n", 2);
+        char *colon = memchr(line, ':', next - line);
+        if (colon && header_is(line, colon - line, "connection")) {
+            connection = colon + 1;
+            connection_length = next - connection;
+        }
+        line = next + 2;
+    }
+    
+    for (char *line = line_end + 2; line < end; line = line_end + 2) {
+        line_end = memmem(line, end - line + 2, "\r\n", 2);
+        char *colon = memchr(line, ':', line_end - line);
+        if (!colon) continue;
+        size_t name_length = colon - line;
+        if (header_is(line, name_length, "content-length")) {
+            state->content_length = strtol(colon + 1, NULL, 10);
+        } else if (header_is(line, name_length, "transfer-encoding")) {
+            state->chunked = memmem(colon, line_end - colon, "chunked", 7) != NULL;
+        } else if (!is_hop_by_hop(line, name_length, connection, connection_length)) {
+            memcpy(response->headers + headers_length, line, line_end + 2 - line);
+            headers_length += line_end + 2 - line;
+        }
+    }
+    response->headers[headers_length] = '\0';
+    
+    // Ohne Body unabhaengig von den Headern
+    if (response->status / 100 == 1 || response->status == 204 || response->status == 304) {
+        state->chunked = false;
+        state->content_length = 0;
+    }
+    if (state->chunked) {
+        state->content_length = -1;
+        state->chunk_position = head_length;
+        state->decoded_length = 0;
+    }
+    return 0;
+}
+
+// Setzt vollstaendige Chunks hinter den Headern zusammen; 1, wenn der
+// letzte Chunk (und etwaige Trailer) da ist, -1 bei Formatfehler
+static int decode_chunks(char *buffer, size_t length, ResponseState *state) {
+    while (1) {
+        char *line = buffer + state->chunk_position;
+        char *line_end = memmem(line, buffer + length - line, "\r\n", 2);
+        if (!line_end) return 0;
+        
+        char *digits_end;
+        unsigned long size = strtoul(line, &digits_end, 16);
+        if (digits_end == line) return -1;
+        if (size == 0) {
+            char *trailer_end = memmem(line_end, buffer + length - line_end, "\r\n\r\n", 4);
+            if (!trailer_end) return 0;
+            state->chunk_position = trailer_end + 4 - buffer;
+            return 1;
+        }
+        
+        size_t data = line_end + 2 - buffer;
+        if (length < data + size + 2) return 0;
+        // Nach vorne schieben ueberschreibt nur schon gelesene Chunk-Zeilen
+        memmove(buffer + state->head_length + state->decoded_length, buffer + data, size);
+        state->decoded_length += size;
+        state->chunk_position = data + size + 2;
+    }
+}
+
+// Liest eine Antwort; *reusable ist danach true, wenn die Verbindung fuer
+// den naechsten Request taugt. -2: Verbindung war schon vor der Antwort zu
+static int read_response(int fd, HttpResponse *response, bool *reusable) {
+    size_t capacity = RESPONSE_INITIAL_SIZE;
+    size_t length = 0;
+    char *buffer = malloc(capacity);
+    ResponseState state = {0};
+    bool complete = false;
+    *reusable = false;
+    
+    while (buffer && !complete) {
+        if (length == capacity) {
+            char *grown = realloc(buffer, capacity * 2);
+            if (!grown) break;
+            buffer = grown;
+            capacity *= 2;
+        }
+        
+        ssize_t received = recv(fd, buffer + length, capacity - length, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) {
+            // Ohne Laengenangabe endet die Antwort mit der Verbindung
+            if (received == 0 && state.head_length > 0 && !state.chunked &&
+                state.content_length < 0) {
+                state.content_length = length - state.head_length;
+                complete = true;
+                break;
+            }
+            free(buffer);
+            free(response->headers);
+            response->headers = NULL;
+            return received == 0 && length == 0 ? -2 : -1;
+        }
+        length += received;
+        
+        if (state.head_length == 0) {
+            char *head_end = memmem(buffer, length, "\r\n\r\n", 4);
+            size_t head_length = head_end ? (size_t)(head_end + 4 - buffer) : length;
+            if (head_length > HTTP_MAX_HEAD) {
+                fprintf(stderr, "Error: response head exceeds %d bytes\n", HTTP_MAX_HEAD);
+                break;
+            }
+            if (!head_end) continue;
+            state.head_length = head_length;
+            if (parse_head(buffer, state.head_length, response, &state) < 0) break;
+        }
+        
+        if (state.chunked) {
+            int decoded = decode_chunks(buffer, length, &state);
+            if (decoded < 0) break;
+            if (decoded > 0) {
+                // Mehr als die Antwort: die Gegenstelle hat unaufgefordert gesendet
+                *reusable = length == state.chunk_position;
+                state.content_length = state.decoded_length;
+                complete = true;
+            }
+        } else if (state.content_length >= 0 &&
+                   length >= state.head_length + (size_t)state.content_length) {
+            *reusable = length == state.head_length + (size_t)state.content_length;
+            complete = true;
+        }
+    }
+    if (!complete) {
+        free(buffer);
+        free(response->headers);
+        response->headers = NULL;
+        *reusable = false;
+        return -1;
+    }
+    
+    response->storage = buffer;
+    response->body = buffer + state.head_length;
+    response->body_length = state.content_length;
+    return 0;
+}
+
+int http_peer_exchange(HttpPeer *peer, const char *request, size_t length, HttpResponse *response) {
+    memset(response, 0, sizeof(*response));
+    
+    // Eine ruhende Verbindung kann die Gegenstelle inzwischen geschlossen
+    // haben; dann einmal mit einer neuen Verbindung wiederholen
+    while (1) {
+        pthread_mutex_lock(&peer->lock);
+        bool pooled = peer->idle_count > 0;
+        int fd = pooled ? peer->idle[--peer->idle_count] : -1;
+        pthread_mutex_unlock(&peer->lock);
+        if (!pooled) fd = connect_peer(peer);
+        if (fd < 0) {
+            fprintf(stderr, "Error: cannot connect to %s\n", peer->name);
+            return -1;
+        }
+        
+        bool reusable = false;
+        int result = send_request(fd, request, length) < 0 ? -2 :
+                     read_response(fd, response, &reusable);
+        pthread_mutex_lock(&peer->lock);
+        if (result == 0 && reusable && peer->idle_count < HTTP_PEER_POOL_SIZE) {
+            peer->idle[peer->idle_count++] = fd;
+            fd = -1;
+        }
+        pthread_mutex_unlock(&peer->lock);
+        if (fd >= 0) close(fd);
+        if (result == 0) return 0;
+        if (result == -2 && pooled) continue;
+        
+        fprintf(stderr, "Error: no response from %s\n", peer->name);
+        return -1;
+    }
+}
+
+const char *http_response_header(const HttpResponse *response, const char *name, size_t *length) {
+    size_t name_length = strlen(name);
+    for (const char *line = response->headers; *line;) {
+        const char *line_end = strstr(line, "\r\n");
+        if (!line_end) break;
+        if (line_end - line > (ptrdiff_t)name_length && line[name_length] == ':' &&
+            strncasecmp(line, name, name_length) == 0) {
+            const char *value = line + name_length + 1;
+            while (*value == ' ' || *value == '\t') value++;
+            *length = line_end - value;
+            return value;
+        }
+        line = line_end + 2;
+    }
+    return NULL;
+}
+
+void http_response_free(HttpResponse *response) {
+    free(response->headers);
+    free(response->storage);
+    response->headers = NULL;
+    response->storage = NULL;
+}
+
+void http_peer_close(HttpPeer *peer) {
+    pthread_mutex_lock(&peer->lock);
+    while (peer->idle_count > 0) {
+        close(peer->idle[--peer->idle_count]);
+    }
+    pthread_mutex_unlock(&peer->lock);
+}
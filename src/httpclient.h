@@ -0,0 +1,57 @@
+#ifndef WEBSERVER_HTTPCLIENT_H
+#define WEBSERVER_HTTPCLIENT_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// HTTP/1.1-Client fuer Verbindungen zu anderen Servern (Cluster-Knoten,
+// Upstream des Proxys). Jede Gegenstelle haelt einige ruhende
+// Keep-Alive-Verbindungen; der Pool ist threadsicher.
+
+#define HTTP_PEER_POOL_SIZE 4           // ruhende Verbindungen pro Gegenstelle
+
+// Groesster akzeptierter Antwortkopf (Status-Zeile und Header); die Header
+// werden weitergereicht und muessen in den Antwortpuffer des Servers passen
+#define HTTP_MAX_HEAD 4096
+
+typedef struct {
+    char name[128];                     // "host:port" wie konfiguriert
+    char host[128];
+    char port[16];
+    unsigned timeout_seconds;           // Verbindungsaufbau, Senden, jede Leseoperation
+    pthread_mutex_t lock;
+    int idle[HTTP_PEER_POOL_SIZE];
+    size_t idle_count;
+} HttpPeer;
+
+// Antwort; headers enthaelt alle Header ausser Content-Length,
+// Transfer-Encoding und den Hop-by-Hop-Headern (Connection, Keep-Alive,
+// Proxy-*, TE, Trailer, Upgrade und die in Connection genannten), je
+// "Name: Wert\r\n". Chunked-Bodies sind bereits zusammengesetzt.
+typedef struct {
+    int status;
+    char status_text[64];
+    char *headers;
+    const char *body;
+    size_t body_length;
+    char *storage;
+} HttpResponse;
+
+// address: "host:port" (length Bytes); -1, wenn das Format nicht stimmt
+int http_peer_init(HttpPeer *peer, const char *address, size_t length, unsigned timeout_seconds);
+
+// Schickt einen vollstaendigen Request und liest die Antwort; eine
+// inzwischen geschlossene Pool-Verbindung wird einmal neu aufgebaut. -1 bei
+// Verbindungsfehler, Timeout oder einem Kopf ueber HTTP_MAX_HEAD
+int http_peer_exchange(HttpPeer *peer, const char *request, size_t length, HttpResponse *response);
+
+// Wert eines Antwort-Headers (ohne fuehrende Leerzeichen) oder NULL
+const char *http_response_header(const HttpResponse *response, const char *name, size_t *length);
+
+void http_response_free(HttpResponse *response);
+
+// Schliesst die ruhenden Verbindungen
+void http_peer_close(HttpPeer *peer);
+
+#endif
@@ -0,0 +1,382 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "blob.h"
+#include "bulk.h"
+#include "kv.h"
+#include "store.h"
+
+#define KV_INPUT_SIZE (64 * 1024)
+#define KV_OUTPUT_SIZE (64 * 1024)
+#define KV_READS_PER_TURN 16            // danach kommen andere Verbindungen dran
+
+// Keys liegen im Store unter demselben Praefix wie bei HTTP; die Pfadlaenge
+// ist wie beim HTTP-Parser auf 255 Bytes begrenzt
+#define KV_PREFIX "/dynamic/"
+#define KV_PREFIX_LENGTH 9
+#define KV_MAX_KEY (255 - KV_PREFIX_LENGTH)
+
+typedef struct KvConnection {
+    struct KvConnection *next;          // Liste der ruhenden Verbindungen
+    const KvServer *server;
+    int fd;
+    size_t input_length;
+    size_t output_length;
+    size_t discard;                     // Rest eines abgelehnten Requests, wird ueberlesen
+    bool failed;
+    char input[KV_INPUT_SIZE];
+    char output[KV_OUTPUT_SIZE];
+} KvConnection;
+
+typedef struct {
+    uint8_t opcode;
+    uint16_t key_length;
+    uint32_t opaque;
+    uint32_t value_length;
+    const char *key;
+    const char *value;
+} KvRequest;
+
+static uint16_t read_u16(const char *data) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    return (uint16_t)(bytes[0] << 8 | bytes[1]);
+}
+
+static uint32_t read_u32(const char *data) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+static void write_u16(char *out, uint16_t value) {
+    out[0] = value >> 8;
+    out[1] = value;
+}
+
+static void write_u32(char *out, uint32_t value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static int send_bytes(KvConnection *connection, const char *data, size_t length) {
+    size_t sent = 0;
+    while (sent < length && !connection->failed) {
+        ssize_t written = send(connection->fd, data + sent, length - sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EPIPE && errno != ECONNRESET) perror("Error: send failed");
+            connection->failed = true;
+        } else {
+            sent += written;
+        }
+    }
+    return connection->failed ? -1 : 0;
+}
+
+// Antworten werden gesammelt und vor dem naechsten recv() in einem
+// send() verschickt, so kostet ein gepipelineter Batch zwei Systemaufrufe
+static int flush_output(KvConnection *connection) {
+    int result = send_bytes(connection, connection->output, connection->output_length);
+    connection->output_length = 0;
+    return result;
+}
+
+// Reserviert Platz fuer eine Antwort und schreibt Header und Key; NULL,
+// wenn sie nicht in den Ausgabepuffer passt
+static char *queue_response(KvConnection *connection, const KvRequest *request, KvStatus status,
+                            const char *key, size_t key_length, size_t value_length) {
+    size_t length = KV_HEADER_LENGTH + key_length + value_length;
+    if (length > sizeof(connection->output)) return NULL;
+    if (connection->output_length + length > sizeof(connection->output) &&
+        flush_output(connection) < 0) {
+        return NULL;
+    }
+    
+    char *out = connection->output + connection->output_length;
+    out[0] = KV_MAGIC_RESPONSE;
+    out[1] = request->opcode;
+    write_u16(out + 2, key_length);
+    write_u16(out + 4, status);
+    write_u16(out + 6, 0);
+    write_u32(out + 8, request->opaque);
+    write_u32(out + 12, value_length);
+    if (key_length > 0) memcpy(out + KV_HEADER_LENGTH, key, key_length);
+    connection->output_length += length;
+    return out + KV_HEADER_LENGTH + key_length;
+}
+
+static int queue_status(KvConnection *connection, const KvRequest *request, KvStatus status) {
+    return queue_response(connection, request, status, NULL, 0, 0) ? 0 : -1;
+}
+
+// Antwort mit dem Wert eines Blobs; komprimierte Werte werden direkt in den
+// Ausgabepuffer entpackt
+static int queue_value(KvConnection *connection, const KvRequest *request,
+                       const char *key, size_t key_length, Blob *blob) {
+    size_t start = connection->output_length;
+    char *out = queue_response(connection, request, KV_OK, key, key_length, blob->length);
+    if (out) {
+        const char *data = blob_contents(blob, out);
+        if (data) {
+            if (data != out) memcpy(out, data, blob->length);
+            return 0;
+        }
+        connection->output_length = start;
+        return queue_status(connection, request, KV_INTERNAL_ERROR);
+    }
+    if (connection->failed) return -1;
+    
+    // Groesser als der Ausgabepuffer (aus der kalten Stufe): direkt senden
+    char *scratch = malloc(blob->length);
+    const char *data = scratch ? blob_contents(blob, scratch) : NULL;
+    if (!data) {
+        free(scratch);
+        return queue_status(connection, request, KV_INTERNAL_ERROR);
+    }
+    char header[KV_HEADER_LENGTH];
+    header[0] = KV_MAGIC_RESPONSE;
+    header[1] = request->opcode;
+    write_u16(header + 2, key_length);
+    write_u16(header + 4, KV_OK);
+    write_u16(header + 6, 0);
+    write_u32(header + 8, request->opaque);
+    write_u32(header + 12, blob->length);
+    int result = flush_output(connection) < 0 ||
+                 send_bytes(connection, header, sizeof(header)) < 0 ||
+                 send_bytes(connection, key, key_length) < 0 ||
+                 send_bytes(connection, data, blob->length) < 0 ? -1 : 0;
+    free(scratch);
+    return result;
+}
+
+static size_t store_key(char *path, const char *key, size_t key_length) {
+    memcpy(path, KV_PREFIX, KV_PREFIX_LENGTH);
+    memcpy(path + KV_PREFIX_LENGTH, key, key_length);
+    path[KV_PREFIX_LENGTH + key_length] = '\0';
+    return KV_PREFIX_LENGTH + key_length;
+}
+
+static bool valid_key(size_t key_length) {
+    return key_length > 0 && key_length <= KV_MAX_KEY;
+}
+
+// MGET-Eintraege wiederholen den Key (echo), GET-Antworten nicht
+static int handle_get(KvConnection *connection, const KvRequest *request,
+                      const char *key, size_t key_length, bool echo) {
+    char path[KV_PREFIX_LENGTH + KV_MAX_KEY + 1];
+    size_t path_length = store_key(path, key, key_length);
+    int slot = store_find(path, path_length);
+    Blob *value = slot != -1 ? store_value(slot) : NULL;
+    size_t echo_length = echo ? key_length : 0;
+    if (!value) {
+        return queue_response(connection, request, KV_NOT_FOUND, key, echo_length, 0) ? 0 : -1;
+    }
+    return queue_value(connection, request, key, echo_length, value);
+}
+
+static KvStatus handle_set(KvConnection *connection, const KvRequest *request) {
+    char path[KV_PREFIX_LENGTH + KV_MAX_KEY + 1];
+    size_t path_length = store_key(path, request->key, request->key_length);
+    
+    Blob *value = blob_intern(request->value, request->value_length);
+    if (!value) return KV_NO_SPACE;
+    
+    int slot = store_find(path, path_length);
+    if (slot != -1 ? store_replace(slot, value) < 0 :
+                     store_insert(path, path_length, value) == -1) {
+        blob_release(value);
+        return KV_NO_SPACE;
+    }
+    // Ein Key liegt nie zugleich im Store und als grosser Wert
+    if (bulk_enabled()) bulk_remove(path, path_length);
+    
+    const KvServer *server = connection->server;
+    if (server->changed) server->changed(server->context, path, path_length);
+    return KV_OK;
+}
+
+static KvStatus handle_del(KvConnection *connection, const KvRequest *request) {
+    char path[KV_PREFIX_LENGTH + KV_MAX_KEY + 1];
+    size_t path_length = store_key(path, request->key, request->key_length);
+    int slot = store_find(path, path_length);
+    bool removed = bulk_enabled() && bulk_remove(path, path_length) == 1;
+    if (slot == -1 && !removed) return KV_NOT_FOUND;
+    
+    if (slot != -1) store_remove(slot);
+    const KvServer *server = connection->server;
+    if (server->changed) server->changed(server->context, path, path_length);
+    return KV_OK;
+}
+
+// Ein Eintrag pro Key, dann der Abschluss; ein fehlerhafter Body wird
+// vorab erkannt und nur mit KV_INVALID beantwortet
+static int handle_mget(KvConnection *connection, const KvRequest *request) {
+    const char *end = request->value + request->value_length;
+    for (const char *pos = request->value; pos < end;) {
+        if (end - pos < 2 || !valid_key(read_u16(pos)) || (size_t)(end - pos - 2) < read_u16(pos)) {
+            return queue_status(connection, request, KV_INVALID);
+        }
+        pos += 2 + read_u16(pos);
+    }
+    
+    for (const char *pos = request->value; pos < end;) {
+        size_t key_length = read_u16(pos);
+        if (handle_get(connection, request, pos + 2, key_length, true) < 0) return -1;
+        pos += 2 + key_length;
+    }
+    return queue_status(connection, request, KV_OK);
+}
+
+static int handle_request(KvConnection *connection, const KvRequest *request) {
+    if (request->opcode != KV_MGET && !valid_key(request->key_length)) {
+        return queue_status(connection, request, KV_INVALID);
+    }
+    
+    switch (request->opcode) {
+    case KV_GET:
+        return handle_get(connection, request, request->key, request->key_length, false);
+    case KV_SET:
+    case KV_DEL:
+        if (connection->server->read_only) {
+            return queue_status(connection, request, KV_READ_ONLY);
+        }
+        return queue_status(connection, request, request->opcode == KV_SET ?
+                            handle_set(connection, request) : handle_del(connection, request));
+    case KV_MGET:
+        return handle_mget(connection, request);
+    default:
+        return queue_status(connection, request, KV_UNKNOWN_OPCODE);
+    }
+}
+
+// Bearbeitet alle vollstaendigen Requests im Eingabepuffer
+static int process_input(KvConnection *connection) {
+    size_t offset = 0;
+    int result = 0;
+    
+    while (result == 0) {
+        size_t available = connection->input_length - offset;
+        if (connection->discard > 0) {
+            size_t skipped = available < connection->discard ? available : connection->discard;
+            connection->discard -= skipped;
+            offset += skipped;
+            if (connection->discard > 0) break;
+            continue;
+        }
+        if (available < KV_HEADER_LENGTH) break;
+        
+        const char *header = connection->input + offset;
+        if ((uint8_t)header[0] != KV_MAGIC_REQUEST) {
+            fprintf(stderr, "Error: invalid binary protocol magic 0x%02x\n", (uint8_t)header[0]);
+            return -1;
+        }
+        KvRequest request = {
+            .opcode = header[1],
+            .key_length = read_u16(header + 2),
+            .opaque = read_u32(header + 8),
+            .value_length = read_u32(header + 12),
+        };
+        size_t length = KV_HEADER_LENGTH + request.key_length + (size_t)request.value_length;
+        
+        // Zu lange Keys und zu grosse Werte werden abgelehnt und ueberlesen,
+        // ohne sie zu puffern
+        if (request.key_length > KV_MAX_KEY ||
+            request.value_length > connection->server->max_value_length) {
+            result = queue_status(connection, &request, KV_INVALID);
+            connection->discard = length;
+            continue;
+        }
+        if (available < length) break;
+        
+        request.key = header + KV_HEADER_LENGTH;
+        request.value = request.key + request.key_length;
+        result = handle_request(connection, &request);
+        offset += length;
+    }
+    
+    memmove(connection->input, connection->input + offset, connection->input_length - offset);
+    connection->input_length -= offset;
+    return result;
+}
+
+static KvConnection *suspended;
+
+static bool readable(int fd) {
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    return poll(&pfd, 1, 0) > 0;
+}
+
+// Liest und bearbeitet, solange Daten anliegen; liegt nichts an oder ist
+// das Lesebudget verbraucht, ruht die Verbindung in der Liste
+static int run_connection(KvConnection *connection) {
+    int result = 0;
+    unsigned reads = 0;
+    while (result == 0) {
+        if (process_input(connection) < 0 || flush_output(connection) < 0) {
+            result = -1;
+            break;
+        }
+        if (*connection->server->stop) break;
+        if (reads++ == KV_READS_PER_TURN || !readable(connection->fd)) {
+            connection->next = suspended;
+            suspended = connection;
+            return KV_SUSPENDED;
+        }
+        
+        ssize_t bytes_read = recv(connection->fd, connection->input + connection->input_length,
+                                  sizeof(connection->input) - connection->input_length, 0);
+        if (bytes_read == 0) break;
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            if (errno != ECONNRESET) perror("Error: recv failed");
+            result = -1;
+            break;
+        }
+        connection->input_length += bytes_read;
+    }
+    
+    free(connection);
+    return result;
+}
+
+// Nimmt die ruhende Verbindung zu fd aus der Liste
+static KvConnection *take_suspended(int fd) {
+    for (KvConnection **link = &suspended; *link; link = &(*link)->next) {
+        if ((*link)->fd == fd) {
+            KvConnection *connection = *link;
+            *link = connection->next;
+            return connection;
+        }
+    }
+    return NULL;
+}
+
+int kv_serve(const KvServer *server, int fd) {
+    KvConnection *connection = malloc(sizeof(KvConnection));
+    if (!connection) return -1;
+    connection->server = server;
+    connection->fd = fd;
+    connection->input_length = 0;
+    connection->output_length = 0;
+    connection->discard = 0;
+    connection->failed = false;
+    return run_connection(connection);
+}
+
+int kv_resume(int fd) {
+    KvConnection *connection = take_suspended(fd);
+    return connection ? run_connection(connection) : -1;
+}
+
+void kv_drop(int fd) {
+    free(take_suspended(fd));
+}
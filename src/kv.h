@@ -0,0 +1,72 @@
+#ifndef WEBSERVER_KV_H
+#define WEBSERVER_KV_H
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binaeres Key-Value-Protokoll fuer Dienst-zu-Dienst-Verkehr auf einem
+// eigenen Port. Jede Nachricht beginnt mit einem 16-Byte-Header
+// (Netzwerk-Byte-Order), dann folgen Key und Wert:
+//
+//   u8  magic         KV_MAGIC_REQUEST / KV_MAGIC_RESPONSE
+//   u8  opcode        KvOpcode
+//   u16 key_length
+//   u16 status        KvStatus, in Requests 0
+//   u16 reserved
+//   u32 opaque        vom Client gewaehlt, unveraendert zurueck
+//   u32 value_length
+//
+// Key "x" ist dieselbe Ressource wie "/dynamic/x" ueber HTTP. Requests
+// duerfen gepipelinet werden, Antworten kommen in derselben Reihenfolge.
+// MGET: der Wert ist eine Folge von (u16 Laenge, Key); die Antwort ist ein
+// Eintrag pro Key (mit Key) und ein Abschluss mit key_length 0.
+
+#define KV_MAGIC_REQUEST 0x4b
+#define KV_MAGIC_RESPONSE 0x6b
+#define KV_HEADER_LENGTH 16
+
+typedef enum {
+    KV_GET = 1,
+    KV_SET = 2,
+    KV_DEL = 3,
+    KV_MGET = 4,
+} KvOpcode;
+
+typedef enum {
+    KV_OK = 0,
+    KV_NOT_FOUND = 1,
+    KV_INVALID = 2,                     // Key leer oder zu lang, Wert zu gross
+    KV_NO_SPACE = 3,
+    KV_UNKNOWN_OPCODE = 4,
+    KV_INTERNAL_ERROR = 5,
+    KV_READ_ONLY = 6,                   // SET/DEL auf einem Follower (replication.h)
+} KvStatus;
+
+typedef struct {
+    // Nach SET und DEL mit dem Store-Key ("/dynamic/..."), z.B. fuer Watcher
+    void (*changed)(void *context, const char *key, size_t key_length);
+    void *context;
+    size_t max_value_length;
+    bool read_only;                     // SET und DEL ablehnen
+    volatile sig_atomic_t *stop;        // gesetzt: Verbindung nach dem Batch beenden
+} KvServer;
+
+// Rueckgabe, wenn die Verbindung auf weitere Requests wartet; ihr Zustand
+// bleibt erhalten, bis kv_resume() oder kv_drop() sie wieder aufnimmt
+#define KV_SUSPENDED 1
+
+// Bedient eine Verbindung, solange Requests anliegen; 0 am Ende, -1 bei
+// Protokoll- oder Socketfehler, sonst KV_SUSPENDED. Schreiben blockiert
+// weiterhin, bis die Antworten im Socket sind
+int kv_serve(const KvServer *server, int fd);
+
+// Setzt eine ruhende Verbindung fort, sobald fd lesbar ist; Rueckgabe wie
+// bei kv_serve()
+int kv_resume(int fd);
+
+// Gibt den Zustand einer ruhenden Verbindung frei; fd bleibt offen
+void kv_drop(int fd);
+
+#endif
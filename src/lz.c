@@ -0,0 +1,142 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 12
+
+// Wie bei LZ4: die letzten 5 Bytes sind immer Literale, und in den letzten
+// 12 Bytes beginnt kein Match mehr
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+
+static uint32_t read32(const uint8_t *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static uint32_t lz_hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Schreibt den Rest einer Laenge ab 15 als Folge von 255ern plus Endbyte
+static uint8_t *put_length(uint8_t *out, size_t length) {
+    for (; length >= 255; length -= 255) {
+        *out++ = 255;
+    }
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+// Schreibt eine Sequenz; match_length 0 fuer die letzte (nur Literale).
+// NULL, wenn dest nicht reicht.
+static uint8_t *put_sequence(uint8_t *out, const uint8_t *out_end, const uint8_t *literals,
+                             size_t literal_length, size_t offset, size_t match_length) {
+    size_t match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+    size_t needed = 1 + literal_length + literal_length / 255 + 1 +
+                    (match_length ? 2 + match_code / 255 + 1 : 0);
+    if (needed > (size_t)(out_end - out)) return NULL;
+    
+    uint8_t *token = out++;
+    *token = (uint8_t)((literal_length < 15 ? literal_length : 15) << 4);
+    if (literal_length >= 15) out = put_length(out, literal_length - 15);
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+    if (match_length == 0) return out;
+    
+    *out++ = (uint8_t)offset;
+    *out++ = (uint8_t)(offset >> 8);
+    *token |= (uint8_t)(match_code < 15 ? match_code : 15);
+    if (match_code >= 15) out = put_length(out, match_code - 15);
+    return out;
+}
+
+size_t lz_compress(const char *source, size_t length, char *dest, size_t capacity) {
+    const uint8_t *in = (const uint8_t *)source;
+    uint8_t *out = (uint8_t *)dest;
+    const uint8_t *out_end = out + capacity;
+    uint32_t table[1 << LZ_HASH_BITS] = {0};
+    size_t anchor = 0;
+    
+    for (size_t position = 1; position + LZ_MATCH_LIMIT <= length;) {
+        uint32_t sequence = read32(in + position);
+        uint32_t hash = lz_hash(sequence);
+        size_t candidate = table[hash];
+        table[hash] = (uint32_t)position;
+        
+        if (position - candidate > LZ_MAX_OFFSET || read32(in + candidate) != sequence) {
+            // Ohne Treffer schneller voranschreiten, damit nicht
+            // komprimierbare Daten wenig kosten
+            position += 1 + ((position - anchor) >> 6);
+            continue;
+        }
+        
+        size_t match_length = LZ_MIN_MATCH;
+        while (position + match_length < length - LZ_LAST_LITERALS &&
+               in[candidate + match_length] == in[position + match_length]) {
+            match_length++;
+        }
+        out = put_sequence(out, out_end, in + anchor, position - anchor,
+                           position - candidate, match_length);
+        if (!out) return 0;
+        position += match_length;
+        anchor = position;
+    }
+    
+    out = put_sequence(out, out_end, in + anchor, length - anchor, 0, 0);
+    return out ? (size_t)(out - (uint8_t *)dest) : 0;
+}
+
+static int get_length(const uint8_t **in, const uint8_t *in_end, size_t *length) {
+    uint8_t byte;
+    do {
+        if (*in == in_end) return -1;
+        byte = *(*in)++;
+        *length += byte;
+    } while (byte == 255);
+    return 0;
+}
+
+int lz_decompress(const char *source, size_t length, char *dest, size_t dest_length) {
+    const uint8_t *in = (const uint8_t *)source;
+    const uint8_t *in_end = in + length;
+    uint8_t *out = (uint8_t *)dest;
+    uint8_t *out_end = out + dest_length;
+    
+    while (in < in_end) {
+        uint8_t token = *in++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && get_length(&in, in_end, &literal_length) < 0) return -1;
+        if (literal_length > (size_t)(in_end - in) || literal_length > (size_t)(out_end - out)) {
+            return -1;
+        }
+        memcpy(out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+        if (in == in_end) break;
+        
+        if (in_end - in < 2) return -1;
+        size_t offset = in[0] | (size_t)in[1] << 8;
+        in += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15 && get_length(&in, in_end, &match_length) < 0) return -1;
+        match_length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > (size_t)(out - (uint8_t *)dest) ||
+            match_length > (size_t)(out_end - out)) {
+            return -1;
+        }
+        
+        // Ueberlappende Matches (offset < Laenge) wiederholen das Muster
+        const uint8_t *from = out - offset;
+        if (offset >= match_length) {
+            memcpy(out, from, match_length);
+            out += match_length;
+        } else {
+            while (match_length--) *out++ = *from++;
+        }
+    }
+    return out == out_end ? 0 : -1;
+}
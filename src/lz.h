@@ -0,0 +1,16 @@
+#ifndef WEBSERVER_LZ_H
+#define WEBSERVER_LZ_H
+
+#include <stddef.h>
+
+// Schneller LZ77-Codec im Blockformat von LZ4: Sequenzen aus Token
+// (4 Bit Literal-, 4 Bit Matchlaenge), Literalen und 16-Bit-Offset.
+// Gedacht fuer Werte im Speicher, nicht als Austauschformat.
+
+// Komprimiert source nach dest; 0, wenn das Ergebnis nicht in capacity passt
+size_t lz_compress(const char *source, size_t length, char *dest, size_t capacity);
+
+// Entpackt genau dest_length Bytes; -1 bei beschaedigten Daten
+int lz_decompress(const char *source, size_t length, char *dest, size_t dest_length);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef WEBSERVER_PROBES_H
+#define WEBSERVER_PROBES_H
+
+// USDT-Probes (Provider "webserver") fuer bpftrace/perf.
+// Ohne <sys/sdt.h> oder mit -DWEBSERVER_USDT=OFF verschwinden alle Probes;
+// mit sdt.h ist eine inaktive Probe ein einzelnes nop.
+//
+// Probes und Argumente:
+//   conn__start      (fd)
+//   conn__done       (fd, requests)
+//   request__receive (fd, request_bytes)
+//   request__start   (method, path)
+//   response__send   (fd, status, body_bytes)
+//   store__get       (path, slot, bytes)        slot = -1 bei Miss
+//   store__put       (path, slot, bytes, created)
+//   store__delete    (path, slot)               slot = -1 bei Miss
+//   store__full      (path)
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define PROBE1(name, a)                DTRACE_PROBE1(webserver, name, a)
+#define PROBE2(name, a, b)             DTRACE_PROBE2(webserver, name, a, b)
+#define PROBE3(name, a, b, c)          DTRACE_PROBE3(webserver, name, a, b, c)
+#define PROBE4(name, a, b, c, d)       DTRACE_PROBE4(webserver, name, a, b, c, d)
+#else
+#define PROBE1(name, a)                do {} while (0)
+#define PROBE2(name, a, b)             do {} while (0)
+#define PROBE3(name, a, b, c)          do {} while (0)
+#define PROBE4(name, a, b, c, d)       do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,402 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "blob.h"
+#include "httpclient.h"
+#include "proxy.h"
+
+#define MAX_PATH 256
+#define MAX_ETAG 128
+#define MAX_PREFIX 64
+
+typedef enum {
+    FLIGHT_FREE,
+    FLIGHT_QUEUED,
+    FLIGHT_RUNNING,
+    FLIGHT_DONE,
+} FlightState;
+
+// Ein laufender Abruf; alle Wartenden auf denselben Pfad teilen ihn
+typedef struct {
+    FlightState state;
+    char path[MAX_PATH];
+    char etag[MAX_ETAG];                // Revalidierung, leer = unbedingt
+    int result;                         // -1: keine Antwort vom Upstream
+    HttpResponse response;
+} Flight;
+
+typedef struct {
+    char path[MAX_PATH];                // leer = frei
+    Blob *value;
+    uint64_t last_used;
+} CacheEntry;
+
+static struct {
+    bool enabled;
+    HttpPeer upstream;
+    char prefixes[PROXY_MAX_PREFIXES][MAX_PREFIX];
+    size_t prefix_count;
+    unsigned ttl_seconds;
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    Flight flights[PROXY_MAX_FLIGHTS];
+    pthread_t workers[PROXY_WORKERS];
+    size_t worker_count;
+    bool stopping;
+    int done_pipe[2];                   // Worker -> Hauptthread
+    // Nur im Hauptthread: gerade beantworteter Abruf (proxy_result)
+    const Flight *answering;
+    CacheEntry cache[PROXY_CACHE_ENTRIES];
+    size_t cache_bytes;
+    uint64_t cache_clock;
+} proxy = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .queued = PTHREAD_COND_INITIALIZER,
+    .done_pipe = {-1, -1},
+};
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static size_t build_request(char *out, size_t size, const char *path, const char *etag) {
+    int length = snprintf(out, size, "GET %s HTTP/1.1\r\nHost: %s\r\n", path, proxy.upstream.name);
+    if (etag && *etag) {
+        length += snprintf(out + length, size - length, "If-None-Match: %s\r\n", etag);
+    }
+    length += snprintf(out + length, size - length, "\r\n");
+    return length;
+}
+
+static void *worker_main(void *argument) {
+    (void)argument;
+    pthread_mutex_lock(&proxy.lock);
+    while (!proxy.stopping) {
+        Flight *flight = NULL;
+        for (size_t i = 0; i < PROXY_MAX_FLIGHTS && !flight; i++) {
+            if (proxy.flights[i].state == FLIGHT_QUEUED) flight = &proxy.flights[i];
+        }
+        if (!flight) {
+            pthread_cond_wait(&proxy.queued, &proxy.lock);
+            continue;
+        }
+        flight->state = FLIGHT_RUNNING;
+        char request[MAX_PATH + MAX_ETAG + 256];
+        size_t length = build_request(request, sizeof(request), flight->path, flight->etag);
+        pthread_mutex_unlock(&proxy.lock);
+        
+        HttpResponse response;
+        int result = http_peer_exchange(&proxy.upstream, request, length, &response);
+        
+        pthread_mutex_lock(&proxy.lock);
+        flight->result = result;
+        flight->response = response;
+        flight->state = FLIGHT_DONE;
+        char byte = 1;
+        if (write(proxy.done_pipe[1], &byte, 1) < 0 && errno != EAGAIN) {
+            perror("Error: proxy completion signal failed");
+        }
+    }
+    pthread_mutex_unlock(&proxy.lock);
+    return NULL;
+}
+
+int proxy_init(const char *upstream, const char *prefixes, unsigned ttl_seconds) {
+    if (http_peer_init(&proxy.upstream, upstream, strlen(upstream), PROXY_TIMEOUT_SECONDS) < 0) {
+        fprintf(stderr, "Error: expected upstream HOST:PORT, got '%s'\n", upstream);
+        return -1;
+    }
+    for (const char *pos = prefixes; *pos;) {
+        const char *end = strchr(pos, ',');
+        size_t length = end ? (size_t)(end - pos) : strlen(pos);
+        // /dynamic/ gehoert dem Store selbst, /admin/ der Verwaltung
+        if (proxy.prefix_count == PROXY_MAX_PREFIXES || length == 0 || length >= MAX_PREFIX ||
+            pos[0] != '/' || strncmp(pos, "/dynamic/", length < 9 ? length : 9) == 0 ||
+            strncmp(pos, "/admin/", length < 7 ? length : 7) == 0) {
+            fprintf(stderr, "Error: invalid proxy prefix '%.*s'\n", (int)length, pos);
+            return -1;
+        }
+        snprintf(proxy.prefixes[proxy.prefix_count++], MAX_PREFIX, "%.*s", (int)length, pos);
+        pos += length + (end ? 1 : 0);
+    }
+    proxy.ttl_seconds = ttl_seconds;
+    
+    if (pipe2(proxy.done_pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        perror("Error: cannot create proxy pipe");
+        return -1;
+    }
+    for (size_t i = 0; i < PROXY_WORKERS; i++) {
+        if (pthread_create(&proxy.workers[i], NULL, worker_main, NULL) != 0) {
+            fprintf(stderr, "Error: cannot start proxy worker\n");
+            proxy_stop();
+            return -1;
+        }
+        proxy.worker_count++;
+    }
+    proxy.enabled = true;
+    return proxy.done_pipe[0];
+}
+
+bool proxy_enabled(void) {
+    return proxy.enabled;
+}
+
+bool proxy_matches(const char *path) {
+    for (size_t i = 0; i < proxy.prefix_count; i++) {
+        if (strncmp(path, proxy.prefixes[i], strlen(proxy.prefixes[i])) == 0) return true;
+    }
+    return false;
+}
+
+static CacheEntry *find_entry(const char *path) {
+    for (size_t i = 0; i < PROXY_CACHE_ENTRIES; i++) {
+        if (proxy.cache[i].path[0] && strcmp(proxy.cache[i].path, path) == 0) {
+            return &proxy.cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void drop_entry(CacheEntry *entry) {
+    proxy.cache_bytes -= entry->value->length;
+    blob_release(entry->value);
+    entry->value = NULL;
+    entry->path[0] = '\0';
+}
+
+// Am laengsten nicht genutzter Eintrag (freie zuerst)
+static CacheEntry *oldest_entry(void) {
+    CacheEntry *oldest = &proxy.cache[0];
+    for (size_t i = 0; i < PROXY_CACHE_ENTRIES; i++) {
+        CacheEntry *entry = &proxy.cache[i];
+        if (!entry->path[0]) return entry;
+        if (entry->last_used < oldest->last_used) oldest = entry;
+    }
+    return oldest;
+}
+
+const Blob *proxy_cached(const char *path) {
+    CacheEntry *entry = find_entry(path);
+    if (!entry) return NULL;
+    entry->last_used = ++proxy.cache_clock;
+    return entry->value;
+}
+
+int proxy_parse_entry(const char *value, size_t length, ProxyEntry *entry) {
+    const char *line_end = memchr(value, '\n', length);
+    const char *space = line_end ? memchr(value, ' ', line_end - value) : NULL;
+    if (!space || space == value) return -1;
+    
+    uint64_t expires = 0;
+    for (const char *pos = value; pos < space; pos++) {
+        if (*pos < '0' || *pos > '9') return -1;
+        expires = expires * 10 + (*pos - '0');
+    }
+    entry->expires_ms = expires;
+    entry->etag = space + 1;
+    entry->etag_length = line_end - space - 1;
+    entry->body = line_end + 1;
+    entry->body_length = value + length - entry->body;
+    return 0;
+}
+
+bool proxy_entry_fresh(const ProxyEntry *entry) {
+    return now_ms() < entry->expires_ms;
+}
+
+// Lebensdauer nach Cache-Control; false, wenn die Antwort nicht in den
+// Cache darf
+static bool cache_lifetime(const HttpResponse *response, uint64_t *lifetime_ms) {
+    *lifetime_ms = (uint64_t)proxy.ttl_seconds * 1000;
+    size_t length;
+    const char *control = http_response_header(response, "Cache-Control", &length);
+    if (!control) return true;
+    if (memmem(control, length, "no-store", 8) || memmem(control, length, "no-cache", 8) ||
+        memmem(control, length, "private", 7)) {
+        return false;
+    }
+    const char *max_age = memmem(control, length, "max-age=", 8);
+    if (max_age) *lifetime_ms = strtoull(max_age + 8, NULL, 10) * 1000;
+    return true;
+}
+
+// Legt body mit neuer Ablaufzeit unter path ab
+static void store_entry(const char *path, const char *etag, size_t etag_length,
+                        const char *body, size_t body_length, uint64_t lifetime_ms) {
+    char prefix[32 + MAX_ETAG];
+    if (etag_length >= MAX_ETAG) etag_length = 0;
+    int prefix_length = snprintf(prefix, sizeof(prefix), "%llu %.*s\n",
+                                 (unsigned long long)(now_ms() + lifetime_ms), (int)etag_length,
+                                 etag_length ? etag : "");
+    char *value = malloc(prefix_length + body_length);
+    if (!value) return;
+    memcpy(value, prefix, prefix_length);
+    memcpy(value + prefix_length, body, body_length);
+    
+    size_t length = prefix_length + body_length;
+    CacheEntry *entry = find_entry(path);
+    if (entry) drop_entry(entry);
+    if (length > PROXY_CACHE_BYTES) {
+        free(value);
+        fprintf(stderr, "Warning: %s not cached, value too large\n", path);
+        return;
+    }
+    while (proxy.cache_bytes + length > PROXY_CACHE_BYTES) drop_entry(oldest_entry());
+    
+    Blob *blob = blob_intern(value, length);
+    free(value);
+    if (!blob) {
+        fprintf(stderr, "Warning: %s not cached, value too large\n", path);
+        return;
+    }
+    entry = oldest_entry();
+    if (entry->path[0]) drop_entry(entry);
+    snprintf(entry->path, sizeof(entry->path), "%s", path);
+    entry->value = blob;
+    entry->last_used = ++proxy.cache_clock;
+    proxy.cache_bytes += length;
+}
+
+// Uebernimmt das Ergebnis eines Abrufs in den Cache (nur Hauptthread)
+static void apply_response(const char *path, const HttpResponse *response) {
+    uint64_t lifetime_ms;
+    if (!cache_lifetime(response, &lifetime_ms)) return;
+    
+    size_t etag_length = 0;
+    const char *etag = http_response_header(response, "ETag", &etag_length);
+    if (response->status == 200) {
+        store_entry(path, etag, etag_length, response->body, response->body_length, lifetime_ms);
+        return;
+    }
+    if (response->status != 304) return;
+    
+    // Unveraendert: vorhandenen Body mit neuer Ablaufzeit behalten
+    CacheEntry *cached = find_entry(path);
+    const Blob *blob = cached ? cached->value : NULL;
+    char *scratch = blob ? malloc(blob->length) : NULL;
+    const char *value = scratch ? blob_contents(blob, scratch) : NULL;
+    ProxyEntry entry;
+    if (value && proxy_parse_entry(value, blob->length, &entry) == 0) {
+        if (!etag) {
+            etag = entry.etag;
+            etag_length = entry.etag_length;
+        }
+        store_entry(path, etag, etag_length, entry.body, entry.body_length, lifetime_ms);
+    }
+    free(scratch);
+}
+
+int proxy_fetch(const char *path, const char *etag, size_t etag_length) {
+    if (strlen(path) >= MAX_PATH) return -1;
+    pthread_mutex_lock(&proxy.lock);
+    Flight *free_flight = NULL;
+    for (size_t i = 0; i < PROXY_MAX_FLIGHTS; i++) {
+        Flight *flight = &proxy.flights[i];
+        if (flight->state == FLIGHT_FREE) {
+            if (!free_flight) free_flight = flight;
+        } else if (strcmp(flight->path, path) == 0) {
+            // Laeuft schon (oder wartet auf proxy_complete): anhaengen
+            pthread_mutex_unlock(&proxy.lock);
+            return 0;
+        }
+    }
+    if (!free_flight) {
+        pthread_mutex_unlock(&proxy.lock);
+        return -1;
+    }
+    snprintf(free_flight->path, sizeof(free_flight->path), "%s", path);
+    snprintf(free_flight->etag, sizeof(free_flight->etag), "%.*s",
+             etag && etag_length < MAX_ETAG ? (int)etag_length : 0, etag ? etag : "");
+    free_flight->state = FLIGHT_QUEUED;
+    pthread_cond_signal(&proxy.queued);
+    pthread_mutex_unlock(&proxy.lock);
+    return 0;
+}
+
+int proxy_fetch_now(const char *path, const char *etag, size_t etag_length,
+                    HttpResponse *response) {
+    char request[MAX_PATH + MAX_ETAG + 256];
+    char etag_copy[MAX_ETAG];
+    if (strlen(path) >= MAX_PATH) return -1;
+    snprintf(etag_copy, sizeof(etag_copy), "%.*s",
+             etag && etag_length < MAX_ETAG ? (int)etag_length : 0, etag ? etag : "");
+    size_t length = build_request(request, sizeof(request), path, etag_copy);
+    if (http_peer_exchange(&proxy.upstream, request, length, response) < 0) return -1;
+    apply_response(path, response);
+    return 0;
+}
+
+const HttpResponse *proxy_result(const char *path, bool *failed) {
+    const Flight *flight = proxy.answering;
+    *failed = false;
+    if (!flight || strcmp(flight->path, path) != 0) return NULL;
+    *failed = flight->result < 0;
+    return flight->result < 0 ? NULL : &flight->response;
+}
+
+void proxy_complete(int fd, ProxyWoken woken, void *context) {
+    char signals[64];
+    while (read(fd, signals, sizeof(signals)) > 0) {
+    }
+    
+    for (size_t i = 0; i < PROXY_MAX_FLIGHTS; i++) {
+        Flight *flight = &proxy.flights[i];
+        pthread_mutex_lock(&proxy.lock);
+        bool done = flight->state == FLIGHT_DONE;
+        pthread_mutex_unlock(&proxy.lock);
+        if (!done) continue;
+        
+        // Bis zur Freigabe bleibt der Pfad belegt: Wartende, die in woken()
+        // neu beantwortet werden, haengen sich nicht an einen neuen Abruf
+        if (flight->result == 0) apply_response(flight->path, &flight->response);
+        proxy.answering = flight;
+        woken(context, flight->path, strlen(flight->path));
+        proxy.answering = NULL;
+        
+        if (flight->result == 0) http_response_free(&flight->response);
+        pthread_mutex_lock(&proxy.lock);
+        flight->state = FLIGHT_FREE;
+        pthread_mutex_unlock(&proxy.lock);
+    }
+}
+
+void proxy_stop(void) {
+    pthread_mutex_lock(&proxy.lock);
+    proxy.stopping = true;
+    pthread_cond_broadcast(&proxy.queued);
+    pthread_mutex_unlock(&proxy.lock);
+    // Laufende Abrufe enden spaetestens mit dem Timeout des Upstreams
+    for (size_t i = 0; i < proxy.worker_count; i++) {
+        pthread_join(proxy.workers[i], NULL);
+    }
+    proxy.worker_count = 0;
+    
+    for (size_t i = 0; i < PROXY_MAX_FLIGHTS; i++) {
+        if (proxy.flights[i].state == FLIGHT_DONE && proxy.flights[i].result == 0) {
+            http_response_free(&proxy.flights[i].response);
+        }
+        proxy.flights[i].state = FLIGHT_FREE;
+    }
+    for (size_t i = 0; i < PROXY_CACHE_ENTRIES; i++) {
+        if (proxy.cache[i].path[0]) drop_entry(&proxy.cache[i]);
+    }
+    http_peer_close(&proxy.upstream);
+    if (proxy.done_pipe[0] >= 0) {
+        close(proxy.done_pipe[0]);
+        close(proxy.done_pipe[1]);
+    }
+    proxy.enabled = false;
+}
@@ -0,0 +1,77 @@
+#ifndef WEBSERVER_PROXY_H
+#define WEBSERVER_PROXY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blob.h"
+#include "httpclient.h"
+
+// Caching-Reverse-Proxy: GET-Requests unter konfigurierten Praefixen holen
+// Hilfs-Threads ueber gepoolte Keep-Alive-Verbindungen vom Upstream.
+// Antworten mit 200 landen mit Ablaufzeit (Cache-Control: max-age, sonst
+// TTL) und ETag in einem eigenen Cache, Key ist der Pfad; abgelaufene
+// Eintraege werden per If-None-Match revalidiert. Der Cache ist vom Store
+// getrennt (keine Quoten, Replikation, Exporte oder KV-Zugriffe) und auf
+// PROXY_CACHE_ENTRIES Eintraege und PROXY_CACHE_BYTES begrenzt; ist er
+// voll, faellt der am laengsten nicht genutzte Eintrag heraus.
+// Gleichzeitige Fehlschlaege fuer denselben Pfad loesen nur einen Abruf
+// aus (Single-Flight): die Requests warten geparkt (watch.h) und werden
+// nach dem Abruf neu beantwortet.
+//
+// Gespeicherter Wert: "<Ablauf in ms seit 1970> <ETag>\n" und der Body
+
+#define PROXY_CACHE_ENTRIES 64
+#define PROXY_CACHE_BYTES (16 * 1024 * 1024)
+#define PROXY_MAX_PREFIXES 8
+#define PROXY_MAX_FLIGHTS 64            // gleichzeitig laufende Abrufe
+#define PROXY_WORKERS 4
+#define PROXY_TIMEOUT_SECONDS 10
+
+// upstream: "host:port"; prefixes: "/static/,/assets/"; liefert einen
+// Deskriptor, der lesbar wird, wenn proxy_complete() Arbeit hat
+int proxy_init(const char *upstream, const char *prefixes, unsigned ttl_seconds);
+bool proxy_enabled(void);
+bool proxy_matches(const char *path);
+
+typedef struct {
+    uint64_t expires_ms;
+    const char *etag;
+    size_t etag_length;
+    const char *body;
+    size_t body_length;
+} ProxyEntry;
+
+// Cache-Eintrag fuer path oder NULL (nur Hauptthread; die Referenz bleibt
+// beim Cache und gilt bis zum naechsten proxy_complete/proxy_fetch_now)
+const Blob *proxy_cached(const char *path);
+
+// Zerlegt einen gespeicherten Wert; -1, wenn er kein Cache-Eintrag ist
+int proxy_parse_entry(const char *value, size_t length, ProxyEntry *entry);
+bool proxy_entry_fresh(const ProxyEntry *entry);
+
+// Startet den Abruf von path, sofern er nicht schon laeuft; etag (oder
+// NULL) des abgelaufenen Eintrags fuer die Revalidierung. -1, wenn schon
+// PROXY_MAX_FLIGHTS Abrufe laufen
+int proxy_fetch(const char *path, const char *etag, size_t etag_length);
+
+// Holt path sofort im aufrufenden Thread (ohne Single-Flight), z.B. fuer
+// Requests, die nicht geparkt werden koennen; Ergebnis wie bei
+// proxy_result(), mit http_response_free() freigeben
+int proxy_fetch_now(const char *path, const char *etag, size_t etag_length,
+                    HttpResponse *response);
+
+// Antwort des gerade abgeschlossenen Abrufs von path, solange dessen
+// Wartende beantwortet werden (fuer nicht gespeicherte Antworten); NULL
+// sonst oder nach einem Verbindungsfehler (*failed)
+const HttpResponse *proxy_result(const char *path, bool *failed);
+
+// Hauptthread: speichert abgeschlossene Abrufe und ruft danach je Pfad
+// woken() auf, damit die Wartenden neu beantwortet werden
+typedef void (*ProxyWoken)(void *context, const char *path, size_t path_length);
+void proxy_complete(int fd, ProxyWoken woken, void *context);
+
+void proxy_stop(void);
+
+#endif
@@ -0,0 +1,533 @@
+// Spielt einen mit --capture erzeugten JSONL-Mitschnitt gegen einen Server ab
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define RESPONSE_BUFFER_SIZE 65536
+
+typedef struct {
+    char *raw;
+    size_t raw_length;
+    uint64_t offset_us;     // Sendezeitpunkt relativ zum Start (Originaltempo)
+    int status;             // Antwortstatus, 0 = Fehler
+    uint64_t latency_us;
+} ReplayRequest;
+
+typedef struct {
+    ReplayRequest *requests;
+    size_t count;
+    size_t capacity;
+} ReplayLog;
+
+typedef struct {
+    struct sockaddr_in addr;
+    ReplayLog *log;
+    size_t first;
+    size_t stride;
+    double speed;           // 0 = so schnell wie moeglich
+    uint64_t start_us;
+} ReplayWorker;
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Dynamischer Puffer fuer dekodierte Strings und zusammengesetzte Requests
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+static void buffer_append(Buffer *buffer, const char *data, size_t length) {
+    // Schuetzt Laengenrechnung und Verdopplung vor einem Ueberlauf
+    if (length > PTRDIFF_MAX / 2 - 1 - buffer->length) {
+        fprintf(stderr, "Error: buffer too large\n");
+        exit(EXIT_FAILURE);
+    }
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 256;
+        while (buffer->length + length + 1 > capacity) capacity *= 2;
+        char *grown = realloc(buffer->data, capacity);
+        if (!grown) {
+            perror("Error: out of memory");
+            exit(EXIT_FAILURE);
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static void buffer_append_str(Buffer *buffer, const char *str) {
+    buffer_append(buffer, str, strlen(str));
+}
+
+// Minimaler JSON-Leser fuer das Capture-Format
+typedef struct {
+    const char *pos;
+    const char *end;
+} JsonCursor;
+
+static void json_skip_ws(JsonCursor *json) {
+    while (json->pos < json->end &&
+           (*json->pos == ' ' || *json->pos == '\t' || *json->pos == '\r' || *json->pos == '\n')) {
+        json->pos++;
+    }
+}
+
+static bool json_expect(JsonCursor *json, char c) {
+    json_skip_ws(json);
+    if (json->pos < json->end && *json->pos == c) {
+        json->pos++;
+        return true;
+    }
+    return false;
+}
+
+// Liest einen String; \u00XX wird zum Byte XX, groessere Codepoints zu UTF-8
+static bool json_read_string(JsonCursor *json, Buffer *out) {
+    if (!json_expect(json, '"')) return false;
+    buffer_append(out, "", 0);
+    while (json->pos < json->end && *json->pos != '"') {
+        char c = *json->pos++;
+        if (c != '\\') {
+            buffer_append(out, &c, 1);
+            continue;
+        }
+        if (json->pos >= json->end) return false;
+        char escape = *json->pos++;
+        switch (escape) {
+        case 'n': buffer_append(out, "\n", 1); break;
+        case 'r': buffer_append(out, "\r", 1); break;
+        case 't': buffer_append(out, "\t", 1); break;
+        case 'b': buffer_append(out, "\b", 1); break;
+        case 'f': buffer_append(out, "\f", 1); break;
+        case 'u': {
+            if (json->end - json->pos < 4) return false;
+            char hex[5] = {0};
+            memcpy(hex, json->pos, 4);
+            json->pos += 4;
+            unsigned long code = strtoul(hex, NULL, 16);
+            char bytes[3];
+            if (code < 0x100) {
+                bytes[0] = (char)code;
+                buffer_append(out, bytes, 1);
+            } else if (code < 0x800) {
+                bytes[0] = (char)(0xc0 | (code >> 6));
+                bytes[1] = (char)(0x80 | (code & 0x3f));
+                buffer_append(out, bytes, 2);
+            } else {
+                bytes[0] = (char)(0xe0 | (code >> 12));
+                bytes[1] = (char)(0x80 | ((code >> 6) & 0x3f));
+                bytes[2] = (char)(0x80 | (code & 0x3f));
+                buffer_append(out, bytes, 3);
+            }
+            break;
+        }
+        default:
+            buffer_append(out, &escape, 1);
+        }
+    }
+    return json_expect(json, '"');
+}
+
+// Ueberspringt einen beliebigen Wert (unbekannte Felder)
+static bool json_skip_value(JsonCursor *json) {
+    json_skip_ws(json);
+    if (json->pos >= json->end) return false;
+    if (*json->pos == '"') {
+        Buffer ignored = {0};
+        bool ok = json_read_string(json, &ignored);
+        free(ignored.data);
+        return ok;
+    }
+    if (*json->pos == '[' || *json->pos == '{') {
+        char close = *json->pos == '[' ? ']' : '}';
+        json->pos++;
+        if (json_expect(json, close)) return true;
+        do {
+            if (close == '}') {
+                if (!json_skip_value(json) || !json_expect(json, ':')) return false;
+            }
+            if (!json_skip_value(json)) return false;
+        } while (json_expect(json, ','));
+        return json_expect(json, close);
+    }
+    while (json->pos < json->end && !strchr(",]} \t\r\n", *json->pos)) json->pos++;
+    return true;
+}
+
+// Baut aus einer Capture-Zeile den rohen HTTP-Request
+static bool parse_capture_line(const char *line, size_t length, Buffer *raw, uint64_t *gap_us) {
+    JsonCursor json = {line, line + length};
+    Buffer method = {0}, path = {0}, headers = {0}, body = {0};
+    bool has_content_length = false;
+    bool ok = json_expect(&json, '{');
+    *gap_us = 0;
+    
+    while (ok && !json_expect(&json, '}')) {
+        Buffer key = {0};
+        ok = json_read_string(&json, &key) && json_expect(&json, ':');
+        if (!ok) {
+            free(key.data);
+            break;
+        }
+        if (strcmp(key.data, "method") == 0) {
+            ok = json_read_string(&json, &method);
+        } else if (strcmp(key.data, "path") == 0) {
+            ok = json_read_string(&json, &path);
+        } else if (strcmp(key.data, "body") == 0) {
+            ok = json_read_string(&json, &body);
+        } else if (strcmp(key.data, "gap_us") == 0) {
+            json_skip_ws(&json);
+            char *number_end;
+            *gap_us = strtoull(json.pos, &number_end, 10);
+            ok = number_end != json.pos;
+            json.pos = number_end;
+        } else if (strcmp(key.data, "headers") == 0) {
+            ok = json_expect(&json, '[');
+            if (ok && !json_expect(&json, ']')) {
+                do {
+                    Buffer name = {0}, value = {0};
+                    ok = json_expect(&json, '[') && json_read_string(&json, &name) &&
+                         json_expect(&json, ',') && json_read_string(&json, &value) &&
+                         json_expect(&json, ']');
+                    if (ok) {
+                        if (strcasecmp(name.data, "Content-Length") == 0) has_content_length = true;
+                        buffer_append(&headers, name.data, name.length);
+                        buffer_append_str(&headers, ": ");
+                        buffer_append(&headers, value.data, value.length);
+                        buffer_append_str(&headers, "\r\n");
+                    }
+                    free(name.data);
+                    free(value.data);
+                } while (ok && json_expect(&json, ','));
+                ok = ok && json_expect(&json, ']');
+            }
+        } else {
+            ok = json_skip_value(&json);
+        }
+        free(key.data);
+        if (ok) json_expect(&json, ',');
+    }
+    
+    ok = ok && method.length > 0 && path.length > 0;
+    if (ok) {
+        buffer_append(raw, method.data, method.length);
+        buffer_append_str(raw, " ");
+        buffer_append(raw, path.data, path.length);
+        buffer_append_str(raw, " HTTP/1.1\r\n");
+        if (headers.length) buffer_append(raw, headers.data, headers.length);
+        if (!has_content_length && body.length > 0) {
+            char header[64];
+            snprintf(header, sizeof(header), "Content-Length: %zu\r\n", body.length);
+            buffer_append_str(raw, header);
+        }
+        buffer_append_str(raw, "\r\n");
+        if (body.length) buffer_append(raw, body.data, body.length);
+    }
+    
+    free(method.data);
+    free(path.data);
+    free(headers.data);
+    free(body.data);
+    return ok;
+}
+
+static int load_capture(const char *filename, ReplayLog *log) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        perror("Error: cannot open capture");
+        return -1;
+    }
+    
+    char *line = NULL;
+    size_t line_capacity = 0;
+    ssize_t line_length;
+    unsigned long line_number = 0;
+    unsigned long skipped = 0;
+    uint64_t offset_us = 0;
+    
+    while ((line_length = getline(&line, &line_capacity, file)) >= 0) {
+        line_number++;
+        if (line_length <= 1) continue;
+        
+        Buffer raw = {0};
+        uint64_t gap_us;
+        if (!parse_capture_line(line, line_length, &raw, &gap_us)) {
+            if (skipped++ == 0) {
+                fprintf(stderr, "Skipping line %lu: not a captured request\n", line_number);
+            }
+            free(raw.data);
+            continue;
+        }
+        
+        if (log->count == log->capacity) {
+            log->capacity = log->capacity ? log->capacity * 2 : 1024;
+            log->requests = realloc(log->requests, log->capacity * sizeof(ReplayRequest));
+            if (!log->requests) {
+                perror("Error: out of memory");
+                exit(EXIT_FAILURE);
+            }
+        }
+        offset_us += gap_us;
+        log->requests[log->count++] = (ReplayRequest){raw.data, raw.length, offset_us, 0, 0};
+    }
+    
+    if (skipped > 1) {
+        fprintf(stderr, "Skipped %lu lines without method and path\n", skipped);
+    }
+    free(line);
+    fclose(file);
+    return 0;
+}
+
+static int replay_connect(const struct sockaddr_in *addr) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    return fd;
+}
+
+static bool send_request(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+// Liest genau eine Antwort; Rest fuer die naechste bleibt im Puffer
+static int read_response(int fd, char *buffer, size_t *buffered) {
+    while (1) {
+        char *headers_end = memmem(buffer, *buffered, "\r\n\r\n", 4);
+        if (headers_end) {
+            size_t headers_length = headers_end - buffer + 4;
+            size_t content_length = 0;
+            int status = 0;
+            sscanf(buffer, "HTTP/%*s %d", &status);
+            char *header = memmem(buffer, headers_length, "\r\n", 2);
+            while (header && header < headers_end) {
+                if (strncasecmp(header + 2, "Content-Length:", 15) == 0) {
+                    content_length = strtoul(header + 17, NULL, 10);
+                }
+                header = memmem(header + 2, headers_end - header, "\r\n", 2);
+            }
+            
+            size_t total = headers_length + content_length;
+            if (*buffered >= total) {
+                memmove(buffer, buffer + total, *buffered - total);
+                *buffered -= total;
+                return status;
+            }
+            if (total > RESPONSE_BUFFER_SIZE) {
+                // Grosse Bodies nur verwerfen, nicht puffern
+                size_t to_discard = total - *buffered;
+                *buffered = 0;
+                while (to_discard > 0) {
+                    ssize_t n = recv(fd, buffer, to_discard < RESPONSE_BUFFER_SIZE ?
+                                     to_discard : RESPONSE_BUFFER_SIZE, 0);
+                    if (n <= 0) return 0;
+                    to_discard -= n;
+                }
+                return status;
+            }
+        }
+        if (*buffered == RESPONSE_BUFFER_SIZE) return 0;
+        ssize_t n = recv(fd, buffer + *buffered, RESPONSE_BUFFER_SIZE - *buffered, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        *buffered += n;
+    }
+}
+
+static void *replay_worker_main(void *arg) {
+    ReplayWorker *worker = arg;
+    char *buffer = malloc(RESPONSE_BUFFER_SIZE);
+    size_t buffered = 0;
+    int fd = -1;
+    
+    for (size_t i = worker->first; i < worker->log->count; i += worker->stride) {
+        ReplayRequest *request = &worker->log->requests[i];
+        
+        if (worker->speed > 0) {
+            uint64_t due = worker->start_us + (uint64_t)(request->offset_us / worker->speed);
+            uint64_t now = now_us();
+            if (due > now) usleep(due - now);
+        }
+        
+        if (fd < 0) {
+            fd = replay_connect(&worker->addr);
+            buffered = 0;
+            if (fd < 0) continue;
+        }
+        
+        uint64_t begin = now_us();
+        if (send_request(fd, request->raw, request->raw_length)) {
+            request->status = read_response(fd, buffer, &buffered);
+        }
+        request->latency_us = now_us() - begin;
+        
+        // Verbindung nach Fehlern neu aufbauen
+        if (request->status == 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    
+    if (fd >= 0) close(fd);
+    free(buffer);
+    return NULL;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_report(const ReplayLog *log, size_t connections, uint64_t elapsed_us) {
+    uint64_t *latencies = malloc(log->count * sizeof(uint64_t));
+    unsigned long statuses[600] = {0};
+    unsigned long errors = 0;
+    
+    for (size_t i = 0; i < log->count; i++) {
+        latencies[i] = log->requests[i].latency_us;
+        int status = log->requests[i].status;
+        if (status > 0 && status < 600) {
+            statuses[status]++;
+        } else {
+            errors++;
+        }
+    }
+    qsort(latencies, log->count, sizeof(uint64_t), compare_u64);
+    
+    double seconds = elapsed_us / 1e6;
+    printf("Replayed %zu requests over %zu connections in %.2fs (%.0f req/s), %lu errors\n",
+           log->count, connections, seconds, seconds > 0 ? log->count / seconds : 0.0, errors);
+    for (int status = 0; status < 600; status++) {
+        if (statuses[status]) printf("  %d: %lu\n", status, statuses[status]);
+    }
+    if (log->count > 0) {
+        printf("Latency (us): p50 %llu, p90 %llu, p99 %llu, max %llu\n",
+               (unsigned long long)latencies[log->count * 50 / 100],
+               (unsigned long long)latencies[log->count * 90 / 100],
+               (unsigned long long)latencies[log->count * 99 / 100],
+               (unsigned long long)latencies[log->count - 1]);
+    }
+    free(latencies);
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s <IP> <Port> <capture.jsonl> [options]\n", program);
+    fprintf(stderr,
+        "  --speed X          X-fache Originalgeschwindigkeit (Default 1)\n"
+        "  --max              ohne Pausen so schnell wie moeglich\n"
+        "  --connections N    Requests reihum auf N Verbindungen verteilen (Default 1)\n");
+}
+
+int main(int argc, char *argv[]) {
+    double speed = 1.0;
+    size_t connections = 1;
+    
+    static const struct option long_options[] = {
+        {"speed", required_argument, NULL, 's'},
+        {"max", no_argument, NULL, 'm'},
+        {"connections", required_argument, NULL, 'c'},
+        {NULL, 0, NULL, 0}
+    };
+    
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (option) {
+        case 's':
+            speed = strtod(optarg, NULL);
+            if (speed <= 0) {
+                fprintf(stderr, "Error: --speed must be positive\n");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'm':
+            speed = 0;
+            break;
+        case 'c':
+            connections = strtoul(optarg, NULL, 10);
+            if (connections == 0) connections = 1;
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    if (argc - optind != 3) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(atoi(argv[optind + 1]));
+    if (inet_pton(AF_INET, argv[optind], &addr.sin_addr) <= 0) {
+        fprintf(stderr, "Error: invalid address %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    
+    ReplayLog log = {0};
+    if (load_capture(argv[optind + 2], &log) < 0) {
+        return EXIT_FAILURE;
+    }
+    if (connections > log.count && log.count > 0) connections = log.count;
+    
+    pthread_t *threads = calloc(connections, sizeof(pthread_t));
+    ReplayWorker *workers = calloc(connections, sizeof(ReplayWorker));
+    uint64_t start = now_us();
+    
+    for (size_t i = 0; i < connections; i++) {
+        workers[i] = (ReplayWorker){addr, &log, i, connections, speed, start};
+        if (pthread_create(&threads[i], NULL, replay_worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Error: cannot start worker %zu\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    for (size_t i = 0; i < connections; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    
+    print_report(&log, connections, now_us() - start);
+    
+    for (size_t i = 0; i < log.count; i++) {
+        free(log.requests[i].raw);
+    }
+    free(log.requests);
+    free(threads);
+    free(workers);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,709 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "blob.h"
+#include "replication.h"
+#include "store.h"
+
+#define FRAME_HEADER_LENGTH 16
+#define EPOCH_LENGTH 8
+#define MAX_KEY_LENGTH 255
+#define MAX_VALUE_LENGTH (1024 * 1024)
+#define MAX_FRAME (FRAME_HEADER_LENGTH + MAX_KEY_LENGTH + MAX_VALUE_LENGTH)
+#define SEND_BATCH (256 * 1024)
+#define RETRY_SECONDS 1
+
+enum {
+    FRAME_HELLO = 1,                    // Follower: seq = zuletzt angewendet, Wert = Epoche
+    FRAME_SNAPSHOT = 2,                 // seq = Stand des Snapshots, Wert = Epoche; ITEMs folgen
+    FRAME_RESUME = 3,                   // seq = Stand des Followers, Wert = Epoche
+    FRAME_ITEM = 4,                     // Eintrag des Snapshots
+    FRAME_PUT = 5,
+    FRAME_DELETE = 6,
+    FRAME_SNAPSHOT_END = 7,             // seq wie SNAPSHOT; erst jetzt gilt der Snapshot
+};
+
+typedef struct {
+    uint64_t seq;
+    size_t length;
+    char frame[];
+} LogEntry;
+
+typedef struct {
+    int fd;
+    uint64_t next_seq;
+    char *initial;                      // Snapshot oder RESUME, vor dem Log gesendet
+    size_t initial_length;
+} Sender;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;             // neuer Eintrag, Sender beendet oder Stopp
+    LogEntry *log[REPLICATION_LOG_ENTRIES];     // seq % REPLICATION_LOG_ENTRIES
+    uint64_t last_seq;
+    size_t log_count;
+    uint64_t epoch;
+    bool active;
+    bool stopping;
+    int sender_fds[REPLICATION_MAX_FOLLOWERS];
+    size_t senders;
+} primary = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .changed = PTHREAD_COND_INITIALIZER,
+};
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} Buffer;
+
+static int buffer_append(Buffer *buffer, size_t length, char **out) {
+    if (buffer->length + length > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 64 * 1024;
+        while (capacity < buffer->length + length) capacity *= 2;
+        char *data = realloc(buffer->data, capacity);
+        if (!data) return -1;
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    *out = buffer->data + buffer->length;
+    buffer->length += length;
+    return 0;
+}
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;                // unterbricht die Wartezeit vor neuem Verbindungsversuch
+    char host[256];
+    char port[16];
+    uint64_t epoch;                     // Stand fuer das naechste HELLO
+    uint64_t applied;
+    int primary_fd;
+    int channel[2];                     // Empfangs-Thread -> Hauptthread, nur ganze Frames
+    pthread_t receiver;
+    bool active;
+    bool stopping;
+    // Nur im Hauptthread
+    char *input;
+    size_t input_length;
+    Buffer snapshot;                    // ITEM-Frames bis SNAPSHOT_END
+    bool snapshot_pending;
+    uint64_t snapshot_seq;
+    uint64_t snapshot_epoch;
+} follower = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .primary_fd = -1,
+    .channel = {-1, -1},
+};
+
+static uint64_t read_u64(const char *data) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value = value << 8 | bytes[i];
+    return value;
+}
+
+static uint32_t read_u32(const char *data) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+static void write_u64(char *out, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        out[i] = value;
+        value >>= 8;
+    }
+}
+
+static void write_header(char *out, uint8_t type, uint64_t seq, size_t key_length,
+                         size_t value_length) {
+    out[0] = type;
+    out[1] = 0;
+    out[2] = key_length >> 8;
+    out[3] = key_length;
+    out[4] = value_length >> 24;
+    out[5] = value_length >> 16;
+    out[6] = value_length >> 8;
+    out[7] = value_length;
+    write_u64(out + 8, seq);
+}
+
+// Laenge des Frames am Anfang von data oder 0, wenn er unvollstaendig ist
+static size_t frame_length(const char *data, size_t available) {
+    if (available < FRAME_HEADER_LENGTH) return 0;
+    size_t length = FRAME_HEADER_LENGTH + ((uint8_t)data[2] << 8 | (uint8_t)data[3]) +
+                    read_u32(data + 4);
+    return available >= length ? length : 0;
+}
+
+static bool frame_valid(const char *header) {
+    size_t key_length = (uint8_t)header[2] << 8 | (uint8_t)header[3];
+    return key_length <= MAX_KEY_LENGTH && read_u32(header + 4) <= MAX_VALUE_LENGTH;
+}
+
+static int send_all(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += sent;
+        length -= sent;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, char *data, size_t length) {
+    while (length > 0) {
+        ssize_t received = recv(fd, data, length, 0);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        data += received;
+        length -= received;
+    }
+    return 0;
+}
+
+// Store-Beobachter: kodiert die Aenderung als Frame und haengt sie an den
+// Ring; der aelteste Eintrag faellt heraus
+static void record_change(void *context, const char *key, size_t key_length, const Blob *value) {
+    (void)context;
+    size_t value_length = value ? value->length : 0;
+    LogEntry *entry = malloc(sizeof(LogEntry) + FRAME_HEADER_LENGTH + key_length + value_length);
+    if (!entry) {
+        fprintf(stderr, "Error: cannot log change of %.*s for followers\n", (int)key_length, key);
+        return;
+    }
+    entry->length = FRAME_HEADER_LENGTH + key_length + value_length;
+    memcpy(entry->frame + FRAME_HEADER_LENGTH, key, key_length);
+    if (value) {
+        char *out = entry->frame + FRAME_HEADER_LENGTH + key_length;
+        const char *data = blob_contents(value, out);
+        if (!data) {
+            fprintf(stderr, "Error: corrupt value of %.*s not replicated\n", (int)key_length, key);
+            free(entry);
+            return;
+        }
+        if (data != out) memcpy(out, data, value_length);
+    }
+    
+    pthread_mutex_lock(&primary.lock);
+    entry->seq = ++primary.last_seq;
+    write_header(entry->frame, value ? FRAME_PUT : FRAME_DELETE, entry->seq, key_length, value_length);
+    size_t index = entry->seq % REPLICATION_LOG_ENTRIES;
+    free(primary.log[index]);
+    primary.log[index] = entry;
+    if (primary.log_count < REPLICATION_LOG_ENTRIES) primary.log_count++;
+    pthread_cond_broadcast(&primary.changed);
+    pthread_mutex_unlock(&primary.lock);
+}
+
+int replication_primary_start(void) {
+    // Neue Epoche pro Start: Sequenznummern eines frueheren Laufs gelten nicht
+    if (getrandom(&primary.epoch, sizeof(primary.epoch), 0) != sizeof(primary.epoch)) {
+        primary.epoch = (uint64_t)time(NULL) << 32 ^ (uint64_t)getpid();
+    }
+    for (size_t i = 0; i < REPLICATION_MAX_FOLLOWERS; i++) primary.sender_fds[i] = -1;
+    primary.active = true;
+    store_set_observer(record_change, NULL);
+    return 0;
+}
+
+static int snapshot_item(void *context, const char *key, size_t key_length,
+                         const char *value, size_t value_length) {
+    char *out;
+    if (key_length > MAX_KEY_LENGTH || value_length > MAX_VALUE_LENGTH ||
+        buffer_append(context, FRAME_HEADER_LENGTH + key_length + value_length, &out) < 0) {
+        return -1;
+    }
+    write_header(out, FRAME_ITEM, 0, key_length, value_length);
+    memcpy(out + FRAME_HEADER_LENGTH, key, key_length);
+    memcpy(out + FRAME_HEADER_LENGTH + key_length, value, value_length);
+    return 0;
+}
+
+static void *sender_main(void *argument) {
+    Sender *sender = argument;
+    char *batch = malloc(SEND_BATCH);
+    bool ok = batch && send_all(sender->fd, sender->initial, sender->initial_length) == 0;
+    free(sender->initial);
+    
+    while (ok) {
+        size_t length = 0;
+        pthread_mutex_lock(&primary.lock);
+        while (!primary.stopping && sender->next_seq > primary.last_seq) {
+            pthread_cond_wait(&primary.changed, &primary.lock);
+        }
+        if (primary.stopping) {
+            pthread_mutex_unlock(&primary.lock);
+            break;
+        }
+        if (sender->next_seq + primary.log_count <= primary.last_seq) {
+            // Aus dem Ring gefallen: der Follower holt sich einen Snapshot
+            pthread_mutex_unlock(&primary.lock);
+            fprintf(stderr, "Warning: follower fell behind at seq %llu, disconnecting\n",
+                    (unsigned long long)sender->next_seq);
+            break;
+        }
+        while (sender->next_seq <= primary.last_seq) {
+            LogEntry *entry = primary.log[sender->next_seq % REPLICATION_LOG_ENTRIES];
+            if (length > 0 && length + entry->length > SEND_BATCH) break;
+            if (entry->length > SEND_BATCH) {
+                // Einzelner grosser Eintrag: ausserhalb des Locks aus einer Kopie senden
+                char *copy = malloc(entry->length);
+                size_t copy_length = entry->length;
+                if (copy) memcpy(copy, entry->frame, copy_length);
+                sender->next_seq++;
+                pthread_mutex_unlock(&primary.lock);
+                ok = copy && send_all(sender->fd, copy, copy_length) == 0;
+                free(copy);
+                pthread_mutex_lock(&primary.lock);
+                break;
+            }
+            memcpy(batch + length, entry->frame, entry->length);
+            length += entry->length;
+            sender->next_seq++;
+        }
+        pthread_mutex_unlock(&primary.lock);
+        if (ok && length > 0) ok = send_all(sender->fd, batch, length) == 0;
+    }
+    
+    pthread_mutex_lock(&primary.lock);
+    for (size_t i = 0; i < REPLICATION_MAX_FOLLOWERS; i++) {
+        if (primary.sender_fds[i] == sender->fd) primary.sender_fds[i] = -1;
+    }
+    primary.senders--;
+    pthread_cond_broadcast(&primary.changed);
+    pthread_mutex_unlock(&primary.lock);
+    
+    close(sender->fd);
+    free(batch);
+    free(sender);
+    return NULL;
+}
+
+void replication_accept(int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        if (errno != EINTR) perror("Error: accept follower failed");
+        return;
+    }
+    
+    // Das HELLO kommt direkt nach dem Verbindungsaufbau
+    struct timeval timeout = {RETRY_SECONDS, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    char hello[FRAME_HEADER_LENGTH + EPOCH_LENGTH];
+    if (recv_all(fd, hello, sizeof(hello)) < 0 || hello[0] != FRAME_HELLO ||
+        read_u32(hello + 4) != EPOCH_LENGTH) {
+        fprintf(stderr, "Error: invalid follower handshake\n");
+        close(fd);
+        return;
+    }
+    uint64_t follower_seq = read_u64(hello + 8);
+    uint64_t follower_epoch = read_u64(hello + FRAME_HEADER_LENGTH);
+    
+    // Nur der Hauptthread schreibt ins Log, last_seq steht also bis zum
+    // Start des Senders fest und passt zum Snapshot
+    Sender *sender = calloc(1, sizeof(Sender));
+    Buffer initial = {0};
+    char *out;
+    bool resume = follower_epoch == primary.epoch && follower_seq <= primary.last_seq &&
+                  follower_seq + primary.log_count >= primary.last_seq;
+    if (!sender || buffer_append(&initial, FRAME_HEADER_LENGTH + EPOCH_LENGTH, &out) < 0) {
+        free(sender);
+        free(initial.data);
+        close(fd);
+        return;
+    }
+    write_header(out, resume ? FRAME_RESUME : FRAME_SNAPSHOT,
+                 resume ? follower_seq : primary.last_seq, 0, EPOCH_LENGTH);
+    write_u64(out + FRAME_HEADER_LENGTH, primary.epoch);
+    long items = resume ? 0 : store_scan("", snapshot_item, &initial);
+    if (!resume && items >= 0) {
+        if (buffer_append(&initial, FRAME_HEADER_LENGTH, &out) < 0) {
+            items = -1;
+        } else {
+            write_header(out, FRAME_SNAPSHOT_END, primary.last_seq, 0, 0);
+        }
+    }
+    if (items < 0) {
+        fprintf(stderr, "Error: cannot build snapshot for follower\n");
+        free(sender);
+        free(initial.data);
+        close(fd);
+        return;
+    }
+    if (resume) {
+        printf("Follower resumes at seq %llu\n", (unsigned long long)follower_seq);
+    } else {
+        printf("Follower gets snapshot of %ld entries at seq %llu\n", items,
+               (unsigned long long)primary.last_seq);
+    }
+    
+    sender->fd = fd;
+    sender->next_seq = (resume ? follower_seq : primary.last_seq) + 1;
+    sender->initial = initial.data;
+    sender->initial_length = initial.length;
+    
+    pthread_mutex_lock(&primary.lock);
+    size_t free_index = REPLICATION_MAX_FOLLOWERS;
+    for (size_t i = 0; i < REPLICATION_MAX_FOLLOWERS; i++) {
+        if (primary.sender_fds[i] == -1) {
+            free_index = i;
+            break;
+        }
+    }
+    pthread_t thread;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+    if (free_index == REPLICATION_MAX_FOLLOWERS ||
+        pthread_create(&thread, &attributes, sender_main, sender) != 0) {
+        pthread_mutex_unlock(&primary.lock);
+        pthread_attr_destroy(&attributes);
+        fprintf(stderr, "Error: cannot serve another follower\n");
+        free(initial.data);
+        free(sender);
+        close(fd);
+        return;
+    }
+    pthread_attr_destroy(&attributes);
+    primary.sender_fds[free_index] = fd;
+    primary.senders++;
+    pthread_mutex_unlock(&primary.lock);
+}
+
+static int connect_primary(void) {
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *addresses;
+    if (getaddrinfo(follower.host, follower.port, &hints, &addresses) != 0) return -1;
+    
+    int fd = -1;
+    for (struct addrinfo *address = addresses; address && fd < 0; address = address->ai_next) {
+        fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+// Liest vom Primary und reicht nur vollstaendige Frames an den Hauptthread
+// weiter, damit ein Abbruch dort nie einen halben Frame hinterlaesst
+static void forward_frames(int fd, char *buffer) {
+    size_t buffered = 0;
+    while (1) {
+        ssize_t received = recv(fd, buffer + buffered, MAX_FRAME - buffered, 0);
+        if (received <= 0) {
+            if (received < 0 && errno == EINTR) continue;
+            return;
+        }
+        buffered += received;
+        
+        size_t offset = 0;
+        size_t length;
+        while (buffered - offset >= FRAME_HEADER_LENGTH) {
+            if (!frame_valid(buffer + offset)) {
+                fprintf(stderr, "Error: invalid replication frame\n");
+                return;
+            }
+            length = frame_length(buffer + offset, buffered - offset);
+            if (length == 0) break;
+            offset += length;
+        }
+        if (offset > 0 && send_all(follower.channel[1], buffer, offset) < 0) return;
+        memmove(buffer, buffer + offset, buffered - offset);
+        buffered -= offset;
+    }
+}
+
+static void *receiver_main(void *argument) {
+    (void)argument;
+    char *buffer = malloc(MAX_FRAME);
+    bool connected_before = false;
+    
+    pthread_mutex_lock(&follower.lock);
+    while (buffer && !follower.stopping) {
+        pthread_mutex_unlock(&follower.lock);
+        int fd = connect_primary();
+        pthread_mutex_lock(&follower.lock);
+        
+        if (fd < 0 || follower.stopping) {
+            if (fd >= 0) close(fd);
+            struct timespec retry;
+            clock_gettime(CLOCK_REALTIME, &retry);
+            retry.tv_sec += RETRY_SECONDS;
+            if (!follower.stopping) pthread_cond_timedwait(&follower.wake, &follower.lock, &retry);
+            continue;
+        }
+        
+        char hello[FRAME_HEADER_LENGTH + EPOCH_LENGTH];
+        write_header(hello, FRAME_HELLO, follower.applied, 0, EPOCH_LENGTH);
+        write_u64(hello + FRAME_HEADER_LENGTH, follower.epoch);
+        follower.primary_fd = fd;
+        printf("Following %s:%s from seq %llu\n", follower.host, follower.port,
+               (unsigned long long)follower.applied);
+        fflush(stdout);
+        pthread_mutex_unlock(&follower.lock);
+        
+        if (send_all(fd, hello, sizeof(hello)) == 0) {
+            connected_before = true;
+            forward_frames(fd, buffer);
+        }
+        
+        pthread_mutex_lock(&follower.lock);
+        follower.primary_fd = -1;
+        close(fd);
+        if (connected_before && !follower.stopping) {
+            fprintf(stderr, "Warning: lost connection to primary, reconnecting\n");
+        }
+    }
+    pthread_mutex_unlock(&follower.lock);
+    
+    // Hauptthread sieht das Ende des Kanals
+    shutdown(follower.channel[1], SHUT_WR);
+    free(buffer);
+    return NULL;
+}
+
+int replication_follow(const char *address) {
+    const char *colon = strrchr(address, ':');
+    if (!colon || colon == address || (size_t)(colon - address) >= sizeof(follower.host) ||
+        strlen(colon + 1) == 0 || strlen(colon + 1) >= sizeof(follower.port)) {
+        fprintf(stderr, "Error: expected HOST:PORT, got '%s'\n", address);
+        return -1;
+    }
+    snprintf(follower.host, sizeof(follower.host), "%.*s", (int)(colon - address), address);
+    snprintf(follower.port, sizeof(follower.port), "%s", colon + 1);
+    
+    follower.input = malloc(MAX_FRAME);
+    if (!follower.input || socketpair(AF_UNIX, SOCK_STREAM, 0, follower.channel) < 0) {
+        perror("Error: cannot set up replication channel");
+        free(follower.input);
+        return -1;
+    }
+    fcntl(follower.channel[0], F_SETFL, fcntl(follower.channel[0], F_GETFL) | O_NONBLOCK);
+    
+    if (pthread_create(&follower.receiver, NULL, receiver_main, NULL) != 0) {
+        fprintf(stderr, "Error: cannot start replication receiver\n");
+        close(follower.channel[0]);
+        close(follower.channel[1]);
+        free(follower.input);
+        return -1;
+    }
+    follower.active = true;
+    return follower.channel[0];
+}
+
+bool replication_read_only(void) {
+    return follower.active;
+}
+
+typedef struct {
+    char **keys;
+    size_t count;
+    size_t capacity;
+} KeyList;
+
+static int collect_key(void *context, const char *key, size_t key_length,
+                       const char *value, size_t value_length) {
+    (void)value;
+    (void)value_length;
+    KeyList *list = context;
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 128;
+        char **keys = realloc(list->keys, capacity * sizeof(char *));
+        if (!keys) return -1;
+        list->keys = keys;
+        list->capacity = capacity;
+    }
+    list->keys[list->count] = strndup(key, key_length);
+    return list->keys[list->count++] ? 0 : -1;
+}
+
+// Vor dem Uebernehmen eines Snapshots: alle Eintraege verwerfen, auch die
+// der kalten Stufe
+static void clear_store(void) {
+    KeyList list = {0};
+    store_scan("", collect_key, &list);
+    for (size_t i = 0; i < list.count; i++) {
+        if (!list.keys[i]) continue;
+        int slot = store_find(list.keys[i], strlen(list.keys[i]));
+        if (slot != -1) store_remove(slot);
+        free(list.keys[i]);
+    }
+    free(list.keys);
+}
+
+static void discard_snapshot(void) {
+    free(follower.snapshot.data);
+    follower.snapshot = (Buffer){0};
+    follower.snapshot_pending = false;
+}
+
+// Erst der vollstaendige Snapshot ersetzt den Store; bricht die Verbindung
+// vorher ab, bleiben Store und applied/epoch unveraendert
+static void apply_snapshot(ReplicationChanged changed, void *context) {
+    clear_store();
+    size_t offset = 0;
+    size_t length;
+    while ((length = frame_length(follower.snapshot.data + offset,
+                                  follower.snapshot.length - offset)) > 0) {
+        const char *frame = follower.snapshot.data + offset;
+        size_t key_length = (uint8_t)frame[2] << 8 | (uint8_t)frame[3];
+        StoreItem item = {frame + FRAME_HEADER_LENGTH, key_length,
+                          frame + FRAME_HEADER_LENGTH + key_length, read_u32(frame + 4)};
+        if (store_put_batch(&item, 1) != 1) {
+            fprintf(stderr, "Error: store full, replicated %.*s dropped\n", (int)key_length, item.key);
+        } else if (changed) {
+            changed(context, item.key, key_length);
+        }
+        offset += length;
+    }
+    
+    pthread_mutex_lock(&follower.lock);
+    follower.epoch = follower.snapshot_epoch;
+    follower.applied = follower.snapshot_seq;
+    pthread_mutex_unlock(&follower.lock);
+    printf("Applied snapshot at seq %llu\n", (unsigned long long)follower.snapshot_seq);
+    discard_snapshot();
+}
+
+static void apply_frame(const char *frame, ReplicationChanged changed, void *context) {
+    uint8_t type = frame[0];
+    uint64_t seq = read_u64(frame + 8);
+    size_t key_length = (uint8_t)frame[2] << 8 | (uint8_t)frame[3];
+    size_t value_length = read_u32(frame + 4);
+    const char *key = frame + FRAME_HEADER_LENGTH;
+    const char *value = key + key_length;
+    
+    switch (type) {
+    case FRAME_SNAPSHOT:
+        // Rest eines abgebrochenen Snapshots verwerfen
+        discard_snapshot();
+        follower.snapshot_pending = true;
+        follower.snapshot_epoch = value_length == EPOCH_LENGTH ? read_u64(value) : 0;
+        follower.snapshot_seq = seq;
+        printf("Receiving snapshot at seq %llu\n", (unsigned long long)seq);
+        return;
+    case FRAME_SNAPSHOT_END:
+        if (follower.snapshot_pending && seq == follower.snapshot_seq) apply_snapshot(changed, context);
+        return;
+    case FRAME_RESUME:
+        discard_snapshot();
+        return;
+    case FRAME_ITEM: {
+        if (!follower.snapshot_pending) return;
+        char *out;
+        size_t length = FRAME_HEADER_LENGTH + key_length + value_length;
+        if (buffer_append(&follower.snapshot, length, &out) < 0) {
+            fprintf(stderr, "Error: out of memory, snapshot discarded\n");
+            discard_snapshot();
+            return;
+        }
+        memcpy(out, frame, length);
+        return;
+    }
+    case FRAME_PUT:
+    case FRAME_DELETE:
+        break;
+    default:
+        fprintf(stderr, "Error: unknown replication frame type %u\n", type);
+        return;
+    }
+    
+    // Nach einem Wiederaufbau koennen Eintraege doppelt ankommen
+    pthread_mutex_lock(&follower.lock);
+    bool duplicate = seq <= follower.applied;
+    if (!duplicate) follower.applied = seq;
+    pthread_mutex_unlock(&follower.lock);
+    if (duplicate) return;
+    
+    if (type == FRAME_DELETE) {
+        int slot = store_find(key, key_length);
+        if (slot == -1) return;
+        store_remove(slot);
+    } else {
+        StoreItem item = {key, key_length, value, value_length};
+        if (store_put_batch(&item, 1) != 1) {
+            fprintf(stderr, "Error: store full, replicated %.*s dropped\n", (int)key_length, key);
+            return;
+        }
+    }
+    if (changed) changed(context, key, key_length);
+}
+
+int replication_receive(int fd, ReplicationChanged changed, void *context) {
+    while (1) {
+        ssize_t received = recv(fd, follower.input + follower.input_length,
+                                MAX_FRAME - follower.input_length, 0);
+        if (received == 0) return -1;
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        follower.input_length += received;
+        
+        size_t offset = 0;
+        size_t length;
+        while ((length = frame_length(follower.input + offset, follower.input_length - offset)) > 0) {
+            apply_frame(follower.input + offset, changed, context);
+            offset += length;
+        }
+        memmove(follower.input, follower.input + offset, follower.input_length - offset);
+        follower.input_length -= offset;
+    }
+}
+
+void replication_stop(void) {
+    if (primary.active) {
+        store_set_observer(NULL, NULL);
+        pthread_mutex_lock(&primary.lock);
+        primary.stopping = true;
+        for (size_t i = 0; i < REPLICATION_MAX_FOLLOWERS; i++) {
+            if (primary.sender_fds[i] >= 0) shutdown(primary.sender_fds[i], SHUT_RDWR);
+        }
+        pthread_cond_broadcast(&primary.changed);
+        while (primary.senders > 0) pthread_cond_wait(&primary.changed, &primary.lock);
+        pthread_mutex_unlock(&primary.lock);
+        for (size_t i = 0; i < REPLICATION_LOG_ENTRIES; i++) free(primary.log[i]);
+        primary.active = false;
+    }
+    
+    if (follower.active) {
+        pthread_mutex_lock(&follower.lock);
+        follower.stopping = true;
+        if (follower.primary_fd >= 0) shutdown(follower.primary_fd, SHUT_RDWR);
+        pthread_cond_broadcast(&follower.wake);
+        pthread_mutex_unlock(&follower.lock);
+        // Ein blockiertes send() auf den Kanal endet mit dem Schliessen
+        shutdown(follower.channel[0], SHUT_RDWR);
+        pthread_join(follower.receiver, NULL);
+        close(follower.channel[0]);
+        close(follower.channel[1]);
+        free(follower.input);
+        discard_snapshot();
+        follower.active = false;
+    }
+}
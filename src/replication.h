@@ -0,0 +1,46 @@
+#ifndef WEBSERVER_REPLICATION_H
+#define WEBSERVER_REPLICATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Asynchrone Replikation des Stores vom Primary zu Followern ueber TCP.
+// Der Primary schreibt jede Aenderung (store_insert/replace/remove) als
+// Log-Eintrag mit fortlaufender Sequenznummer in einen Ring und schickt
+// sie je Follower aus einem eigenen Thread. Ein Follower meldet sich mit
+// Epoche und letzter Sequenznummer; liegt der Rest noch im Ring, geht es
+// dort weiter, sonst kommt zuerst ein Snapshot. Der Follower sammelt ihn
+// bis zum abschliessenden Frame und ersetzt erst dann seinen Store; bis
+// dahin liefert er den alten Stand. Followers sind nur lesbar.
+//
+// Frames (16-Byte-Header, Netzwerk-Byte-Order, dann Key und Wert):
+//   u8 type, u8 reserved, u16 key_length, u32 value_length, u64 seq
+
+#define REPLICATION_LOG_ENTRIES 4096
+#define REPLICATION_MAX_FOLLOWERS 16
+
+// Wird nach jeder vom Follower angewendeten Aenderung aufgerufen
+typedef void (*ReplicationChanged)(void *context, const char *key, size_t key_length);
+
+// Primary: ab jetzt Aenderungen protokollieren
+int replication_primary_start(void);
+
+// Primary: nimmt einen Follower auf listen_fd an (Handshake, Snapshot im
+// aufrufenden Thread, danach Sender-Thread)
+void replication_accept(int listen_fd);
+
+// Follower: verbindet sich (auch nach Abbruechen) mit "host:port"; liefert
+// einen Deskriptor, der lesbar wird, wenn replication_receive() Arbeit hat
+int replication_follow(const char *address);
+
+// Follower: wendet empfangene Frames auf den Store an; -1, wenn der
+// Empfangs-Thread beendet ist
+int replication_receive(int fd, ReplicationChanged changed, void *context);
+
+// true auf einem Follower: schreibende Requests werden abgelehnt
+bool replication_read_only(void);
+
+// Beendet Sender bzw. Empfaenger
+void replication_stop(void);
+
+#endif
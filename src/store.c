@@ -0,0 +1,669 @@
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "bulk.h"
+#include "coldtier.h"
+#include "store.h"
+
+#define CACHE_LINE 64
+
+// Keys bis STORE_KEY_CHUNK - 1 Bytes liegen in festen Chunks hinter dem
+// Index, so allokieren PUT und DELETE nicht; laengere kommen vom Heap
+#define STORE_KEY_CHUNK 256
+
+typedef struct {
+    char prefix[STORE_COLLECTION_PREFIX];
+    size_t prefix_length;
+    size_t max_keys;            // 0 = unbegrenzt
+    size_t max_bytes;
+    size_t reserved_keys;       // bleiben ihr frei, auch wenn andere wachsen
+    bool configured;            // mit --quota genannt
+    size_t keys;
+    size_t bytes;               // unkomprimierte Laenge der Werte
+    uint64_t rejected;          // abgewiesene Schreibzugriffe
+    uint64_t demoted;           // in die kalte Stufe verdraengt
+} StoreCollection;
+
+// Ein Slot liegt ganz in einer halben Cache-Line: ein Treffer liest
+// Fingerprint, Key-Zeiger und Wert aus derselben Line, danach nur noch den
+// Key. Was nur Schreibzugriffe brauchen, steht daneben
+typedef struct {
+    uint32_t fingerprint;       // 0 = leer
+    uint16_t key_length;        // Pfade sind kuerzer als BUFFER_SIZE
+    uint8_t referenced;         // Referenz-Bit fuer CLOCK (nur mit kalter Stufe)
+    uint8_t collection;         // Index in collection_table
+    const char *key;
+    Blob *value;
+    uint64_t version;
+} __attribute__((aligned(32))) StoreSlot;
+
+typedef struct {
+    StoreSlot slots[STORE_SLOTS] __attribute__((aligned(CACHE_LINE)));
+    uint8_t dirty[STORE_SLOTS];         // nur mit kalter Stufe: nicht auf Platte
+    size_t clock_hand;
+    size_t count;
+    size_t memory;                      // gespeicherte Bytes aller Werte, je Key
+    // Jede Aenderung bekommt die naechste Version, auch nach DELETE + PUT
+    // wiederholt sich ein ETag also nicht
+    uint64_t last_version;
+    
+    // Eintrag der kalten Stufe, fuer den im Index kein Platz war
+    // (STORE_COLD_SLOT); gilt bis zum naechsten store_find
+    char *cold_key;
+    size_t cold_key_length;
+    Blob *cold_value;
+    uint64_t cold_version;
+
+    // Neue Chunks vom Anfang, freigegebene auf einem Stapel
+    char key_chunks[STORE_CAPACITY][STORE_KEY_CHUNK] __attribute__((aligned(CACHE_LINE)));
+    size_t key_chunks_used;
+    uint16_t free_key_chunks[STORE_CAPACITY];
+    size_t free_key_count;
+    
+    // [0] ist "/", [1] ist "*", danach die mit --quota genannten
+    StoreCollection collection_table[STORE_COLLECTIONS];
+    size_t collection_count;
+} StoreIndex;
+
+static StoreIndex *store;
+static StoreObserver observer;
+static void *observer_context;
+
+int store_init(void) {
+    store = arena_map(sizeof(StoreIndex), "index");
+    if (!store) return -1;
+    strcpy(store->collection_table[0].prefix, "/");
+    store->collection_table[0].prefix_length = 1;
+    strcpy(store->collection_table[1].prefix, "*");
+    store->collection_table[1].prefix_length = 1;
+    store->collection_table[1].max_keys = STORE_CAPACITY;
+    store->collection_count = 2;
+    return 0;
+}
+
+// Reserven (erst ab der ersten Quota): eine genannte Collection behaelt
+// ihre Key-Grenze (ohne eine STORE_CAPACITY / STORE_COLLECTIONS), nicht
+// genannte "/" und "*" teilen sich den Rest bis zu diesem Mindestanteil.
+// "*" ohne eigene Grenzen bekommt hoechstens, was die anderen Reserven
+// uebrig lassen. -1, wenn die Reserven mehr Keys belegen, als der Index hat
+static int update_reservations(void) {
+    size_t minimum = STORE_CAPACITY / STORE_COLLECTIONS;
+    size_t reserved = 0;
+    size_t unconfigured = 0;
+    for (size_t i = 0; i < store->collection_count; i++) {
+        StoreCollection *collection = &store->collection_table[i];
+        if (!collection->configured) {
+            unconfigured++;
+            continue;
+        }
+        collection->reserved_keys = collection->max_keys ? collection->max_keys : minimum;
+        reserved += collection->reserved_keys;
+    }
+    if (reserved > STORE_CAPACITY) return -1;
+    
+    size_t share = unconfigured ? (STORE_CAPACITY - reserved) / unconfigured : 0;
+    for (size_t i = 0; i < 2; i++) {
+        StoreCollection *collection = &store->collection_table[i];
+        if (collection->configured) continue;
+        collection->reserved_keys = share < minimum ? share : minimum;
+        reserved += collection->reserved_keys;
+    }
+    if (!store->collection_table[1].configured) {
+        store->collection_table[1].max_keys = STORE_CAPACITY - reserved +
+                                              store->collection_table[1].reserved_keys;
+    }
+    return 0;
+}
+
+// Freie Slots, die andere Collections fuer sich reserviert und noch nicht
+// belegt haben
+static size_t reserved_for_others(uint8_t id) {
+    size_t outstanding = 0;
+    for (size_t i = 0; i < store->collection_count; i++) {
+        const StoreCollection *collection = &store->collection_table[i];
+        if (i != id && collection->keys < collection->reserved_keys) {
+            outstanding += collection->reserved_keys - collection->keys;
+        }
+    }
+    return outstanding;
+}
+
+// Ein neuer Key der Collection bekommt einen Slot innerhalb ihrer Reserve
+// oder einen, den keine andere Collection reserviert hat
+static bool slot_available(uint8_t id) {
+    const StoreCollection *collection = &store->collection_table[id];
+    return store->count < STORE_CAPACITY &&
+           (collection->keys < collection->reserved_keys ||
+            store->count + reserved_for_others(id) < STORE_CAPACITY);
+}
+
+// Verdraengt werden duerfen Eintraege ueber der Reserve ihrer Collection
+static bool over_reservation(uint8_t id) {
+    return store->collection_table[id].keys > store->collection_table[id].reserved_keys;
+}
+
+static bool memory_available(size_t released, size_t needed) {
+    return store->memory - released + needed <= STORE_MEMORY;
+}
+
+// Laenge von "/dynamic/<name>/" am Anfang des Keys, 0 wenn er zu "/" gehoert
+static size_t collection_prefix(const char *key, size_t key_length) {
+    if (key_length < 11 || memcmp(key, "/dynamic/", 9) != 0 || key[9] == '/') return 0;
+    const char *end = memchr(key + 10, '/', key_length - 10);
+    if (!end || end + 1 - key >= STORE_COLLECTION_PREFIX) return 0;
+    return end + 1 - key;
+}
+
+static int find_collection(const char *prefix, size_t prefix_length) {
+    for (size_t i = 2; i < store->collection_count; i++) {
+        if (store->collection_table[i].prefix_length == prefix_length &&
+            memcmp(store->collection_table[i].prefix, prefix, prefix_length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static uint8_t collection_of(const char *key, size_t key_length) {
+    size_t prefix_length = collection_prefix(key, key_length);
+    if (prefix_length == 0) return 0;
+    int index = find_collection(key, prefix_length);
+    return index != -1 ? index : 1;
+}
+
+int store_set_quota(const char *spec) {
+    const char *limits = strchr(spec, '=');
+    unsigned long long max_keys, max_bytes = 0;
+    if (!limits || sscanf(limits + 1, "%llu,%llu", &max_keys, &max_bytes) < 1) return -1;
+    
+    size_t prefix_length = limits - spec;
+    int index;
+    if (prefix_length == 1 && spec[0] == '/') {
+        index = 0;
+    } else if (prefix_length == 1 && spec[0] == '*') {
+        index = 1;
+    } else {
+        // Nur ein ganzer Praefix, wie ihn collection_prefix() liefert
+        if (collection_prefix(spec, prefix_length) != prefix_length) return -1;
+        index = find_collection(spec, prefix_length);
+        if (index == -1) {
+            if (store->collection_count == STORE_COLLECTIONS) return -1;
+            index = store->collection_count++;
+            memcpy(store->collection_table[index].prefix, spec, prefix_length);
+            store->collection_table[index].prefix[prefix_length] = '\0';
+            store->collection_table[index].prefix_length = prefix_length;
+        }
+    }
+    store->collection_table[index].max_keys = max_keys;
+    store->collection_table[index].max_bytes = max_bytes;
+    store->collection_table[index].configured = true;
+    return update_reservations();
+}
+
+static bool over_quota(const StoreCollection *collection, size_t keys, size_t bytes) {
+    return (collection->max_keys && keys > collection->max_keys) ||
+           (collection->max_bytes && bytes > collection->max_bytes);
+}
+
+int store_open_cold(const char *directory) {
+    uint64_t last_version;
+    if (cold_open(directory, &last_version) < 0) return -1;
+    if (last_version > store->last_version) store->last_version = last_version;
+    return 0;
+}
+
+int store_open_bulk(const char *directory) {
+    uint64_t last_version;
+    if (bulk_open(directory, &last_version) < 0) return -1;
+    if (last_version > store->last_version) store->last_version = last_version;
+    return 0;
+}
+
+uint64_t store_next_version(void) {
+    return ++store->last_version;
+}
+
+// FNV-1a; die unteren Bits waehlen den Slot, der ganze Wert ist der
+// Fingerprint (nie 0, damit 0 "leer" bedeuten kann)
+static uint32_t store_hash(const char *key, size_t key_length) {
+    uint32_t hash = 0x811c9dc5;
+    for (size_t i = 0; i < key_length; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 0x01000193;
+    }
+    return hash ? hash : 1;
+}
+
+static int store_find_hashed(const char *key, size_t key_length, uint32_t fingerprint) {
+    for (size_t slot = fingerprint & (STORE_SLOTS - 1); store->slots[slot].fingerprint != 0;
+         slot = (slot + 1) & (STORE_SLOTS - 1)) {
+        StoreSlot *entry = &store->slots[slot];
+        if (entry->fingerprint == fingerprint && entry->key_length == key_length &&
+            memcmp(entry->key, key, key_length) == 0) {
+            entry->referenced = 1;
+            return slot;
+        }
+    }
+    return -1;
+}
+
+static char *key_alloc(size_t key_length) {
+    if (key_length < STORE_KEY_CHUNK) {
+        if (store->free_key_count > 0) {
+            return store->key_chunks[store->free_key_chunks[--store->free_key_count]];
+        }
+        if (store->key_chunks_used < STORE_CAPACITY) {
+            return store->key_chunks[store->key_chunks_used++];
+        }
+    }
+    return malloc(key_length + 1);
+}
+
+static void key_free(const char *key) {
+    if (key < store->key_chunks[0] || key >= store->key_chunks[STORE_CAPACITY]) {
+        free((char *)key);
+        return;
+    }
+    store->free_key_chunks[store->free_key_count++] = (key - store->key_chunks[0]) / STORE_KEY_CHUNK;
+}
+
+// Verschiebt nachfolgende Eintraege der Sondierkette zurueck, damit keine
+// Grabsteine noetig sind
+static void remove_slot(int slot) {
+    StoreCollection *collection = &store->collection_table[store->slots[slot].collection];
+    collection->keys--;
+    collection->bytes -= store->slots[slot].value->length;
+    store->memory -= store->slots[slot].value->stored_length;
+    blob_release(store->slots[slot].value);
+    key_free(store->slots[slot].key);
+    store->count--;
+    
+    size_t hole = slot;
+    size_t next = (hole + 1) & (STORE_SLOTS - 1);
+    while (store->slots[next].fingerprint != 0) {
+        size_t home = store->slots[next].fingerprint & (STORE_SLOTS - 1);
+        // Darf nur nachruecken, wenn sein Heimat-Slot nicht zwischen Loch und next liegt
+        if (((next - home) & (STORE_SLOTS - 1)) >= ((next - hole) & (STORE_SLOTS - 1))) {
+            store->slots[hole] = store->slots[next];
+            store->dirty[hole] = store->dirty[next];
+            hole = next;
+        }
+        next = (next + 1) & (STORE_SLOTS - 1);
+    }
+    
+    store->slots[hole] = (StoreSlot){0};
+}
+
+// Verdraengt per CLOCK einen Eintrag ausser keep in die kalte Stufe, mit
+// collection >= 0 nur einen dieser Collection, sonst einen aus einer
+// Collection ueber ihrer Reserve. Nach zwei Umlaeufen sind alle
+// Referenz-Bits geloescht; findet sich dann keiner, -1
+static int demote_one(int collection, const char *keep) {
+    for (size_t step = 0; step < 2 * STORE_SLOTS; step++) {
+        size_t slot = store->clock_hand;
+        store->clock_hand = (slot + 1) & (STORE_SLOTS - 1);
+        if (store->slots[slot].fingerprint == 0 || store->slots[slot].key == keep) continue;
+        if (collection >= 0 ? store->slots[slot].collection != collection :
+                              !over_reservation(store->slots[slot].collection)) {
+            continue;
+        }
+        if (store->slots[slot].referenced) {
+            store->slots[slot].referenced = 0;
+            continue;
+        }
+        
+        if (store->dirty[slot] &&
+            cold_put(store->slots[slot].key, store->slots[slot].key_length, store->slots[slot].value,
+                     store->slots[slot].version) < 0) {
+            return -1;
+        }
+        store->collection_table[store->slots[slot].collection].demoted++;
+        remove_slot(slot);
+        return 0;
+    }
+    return -1;
+}
+
+// Macht mit kalter Stufe Platz fuer einen Eintrag der Collection id:
+// zuerst ausserhalb der Reserven, zur Not bei eigenen Eintraegen
+static bool make_room(uint8_t id, const char *keep) {
+    if (!cold_enabled()) return false;
+    bool shared = false;
+    for (size_t i = 0; i < store->collection_count && !shared; i++) {
+        shared = over_reservation(i);
+    }
+    return demote_one(shared ? -1 : id, keep) == 0;
+}
+
+static int insert_slot(const char *key, size_t key_length, Blob *value, uint64_t version,
+                       bool dirty) {
+    uint8_t id = collection_of(key, key_length);
+    StoreCollection *collection = &store->collection_table[id];
+    bool fits = key_length <= UINT16_MAX && !over_quota(collection, 1, value->length) &&
+                value->stored_length <= STORE_MEMORY;
+    while (fits && over_quota(collection, collection->keys + 1, collection->bytes + value->length)) {
+        fits = cold_enabled() && demote_one(id, NULL) == 0;
+    }
+    while (fits && (!slot_available(id) || !memory_available(0, value->stored_length))) {
+        fits = make_room(id, NULL);
+    }
+    if (!fits) {
+        // Zurueckholen ist kein Schreibzugriff
+        if (dirty) collection->rejected++;
+        return -1;
+    }
+    
+    char *copy = key_alloc(key_length);
+    if (!copy) return -1;
+    memcpy(copy, key, key_length);
+    copy[key_length] = '\0';
+    
+    uint32_t fingerprint = store_hash(key, key_length);
+    size_t slot = fingerprint & (STORE_SLOTS - 1);
+    while (store->slots[slot].fingerprint != 0) {
+        slot = (slot + 1) & (STORE_SLOTS - 1);
+    }
+    
+    store->slots[slot] = (StoreSlot){
+        .fingerprint = fingerprint,
+        .key_length = key_length,
+        .referenced = 1,
+        .collection = id,
+        .key = copy,
+        .value = value,
+        .version = version,
+    };
+    store->dirty[slot] = dirty;
+    store->count++;
+    store->memory += value->stored_length;
+    collection->keys++;
+    collection->bytes += value->length;
+    return slot;
+}
+
+static void drop_cold_slot(void) {
+    free(store->cold_key);
+    blob_release(store->cold_value);
+    store->cold_key = NULL;
+    store->cold_value = NULL;
+}
+
+int store_find(const char *key, size_t key_length) {
+    if (store->cold_value) drop_cold_slot();
+    int slot = store_find_hashed(key, key_length, store_hash(key, key_length));
+    if (slot != -1 || !cold_enabled()) return slot;
+    
+    // Aus der kalten Stufe zurueckholen; was auf Platte steht, muss beim
+    // naechsten Verdraengen nicht erneut geschrieben werden
+    Blob *value;
+    uint64_t version;
+    if (cold_get(key, key_length, &value, &version) <= 0) return -1;
+    slot = insert_slot(key, key_length, value, version, false);
+    if (slot != -1) return slot;
+    
+    // Passt er nicht in den Index (z.B. ueber einer inzwischen kleineren
+    // Grenze), wird er trotzdem geliefert, nur ohne Platz im Index
+    store->cold_key = strndup(key, key_length);
+    if (!store->cold_key) {
+        blob_release(value);
+        return -1;
+    }
+    store->cold_key_length = key_length;
+    store->cold_value = value;
+    store->cold_version = version;
+    return STORE_COLD_SLOT;
+}
+
+int store_insert(const char *key, size_t key_length, Blob *value) {
+    int slot = insert_slot(key, key_length, value, store->last_version + 1, true);
+    if (slot != -1) {
+        store->last_version++;
+        if (observer) observer(observer_context, key, key_length, value);
+    }
+    return slot;
+}
+
+int store_replace(int slot, Blob *value) {
+    // Der Key steht nicht im Index: der neue Wert muss hinein
+    if (slot == STORE_COLD_SLOT) {
+        slot = store_insert(store->cold_key, store->cold_key_length, value);
+        if (slot != -1) drop_cold_slot();
+        return slot;
+    }
+    
+    StoreCollection *collection = &store->collection_table[store->slots[slot].collection];
+    size_t bytes = collection->bytes - store->slots[slot].value->length + value->length;
+    if (value->length > store->slots[slot].value->length && over_quota(collection, collection->keys, bytes)) {
+        collection->rejected++;
+        return -1;
+    }
+    
+    // Fuer einen groesseren Wert verdraengt die kalte Stufe andere
+    // Eintraege; der eigene kann dabei nachruecken und den Slot wechseln
+    size_t released = store->slots[slot].value->stored_length;
+    if (!memory_available(released, value->stored_length)) {
+        const char *key = store->slots[slot].key;
+        size_t key_length = store->slots[slot].key_length;
+        uint32_t fingerprint = store->slots[slot].fingerprint;
+        bool fits = value->stored_length <= STORE_MEMORY;
+        while (fits && !memory_available(released, value->stored_length)) {
+            fits = make_room(store->slots[slot].collection, key);
+            slot = store_find_hashed(key, key_length, fingerprint);
+        }
+        if (!fits) {
+            collection->rejected++;
+            return -1;
+        }
+    }
+    collection->bytes = collection->bytes - store->slots[slot].value->length + value->length;
+    store->memory = store->memory - released + value->stored_length;
+    
+    blob_release(store->slots[slot].value);
+    store->slots[slot].value = value;
+    store->slots[slot].version = ++store->last_version;
+    store->dirty[slot] = 1;
+    if (observer) observer(observer_context, store->slots[slot].key, store->slots[slot].key_length, value);
+    return slot;
+}
+
+void store_remove(int slot) {
+    if (slot == STORE_COLD_SLOT) {
+        cold_delete(store->cold_key, store->cold_key_length);
+        if (observer) observer(observer_context, store->cold_key, store->cold_key_length, NULL);
+        drop_cold_slot();
+        return;
+    }
+    
+    // Aeltere Versionen auf Platte duerfen nicht wieder auftauchen
+    if (cold_enabled()) {
+        cold_delete(store->slots[slot].key, store->slots[slot].key_length);
+    }
+    if (observer) observer(observer_context, store->slots[slot].key, store->slots[slot].key_length, NULL);
+    remove_slot(slot);
+}
+
+void store_set_observer(StoreObserver callback, void *context) {
+    observer = callback;
+    observer_context = context;
+}
+
+Blob *store_value(int slot) {
+    return slot == STORE_COLD_SLOT ? store->cold_value : store->slots[slot].value;
+}
+
+uint64_t store_version(int slot) {
+    return slot == STORE_COLD_SLOT ? store->cold_version : store->slots[slot].version;
+}
+
+size_t store_put_batch(const StoreItem *items, size_t count) {
+    if (count == 0) return 0;
+    uint32_t fingerprints[count];
+    
+    // Erst alle Slots vorladen, damit sich die Cache-Misses ueberlappen
+    for (size_t i = 0; i < count; i++) {
+        fingerprints[i] = store_hash(items[i].key, items[i].key_length);
+        __builtin_prefetch(&store->slots[fingerprints[i] & (STORE_SLOTS - 1)]);
+    }
+    
+    size_t stored = 0;
+    for (size_t i = 0; i < count; i++) {
+        Blob *value = blob_intern(items[i].value, items[i].value_length);
+        if (!value) break;
+        
+        // Aeltere Werte in der kalten Stufe verdeckt der neue Eintrag
+        int slot = store_find_hashed(items[i].key, items[i].key_length, fingerprints[i]);
+        if (slot != -1 ? store_replace(slot, value) < 0 :
+                         store_insert(items[i].key, items[i].key_length, value) == -1) {
+            blob_release(value);
+            break;
+        }
+        stored++;
+    }
+    return stored;
+}
+
+int store_format_collections(char *buffer, size_t size) {
+    size_t length = 0;
+    for (size_t i = 0; i < store->collection_count; i++) {
+        const StoreCollection *collection = &store->collection_table[i];
+        int written = snprintf(buffer + length, length < size ? size - length : 0,
+                               "keys@%s %zu\nbytes@%s %zu\nrejected@%s %llu\ndemoted@%s %llu\n",
+                               collection->prefix, collection->keys,
+                               collection->prefix, collection->bytes,
+                               collection->prefix, (unsigned long long)collection->rejected,
+                               collection->prefix, (unsigned long long)collection->demoted);
+        if (written < 0) return -1;
+        length += written;
+    }
+    return length;
+}
+
+// Menge bereits gemeldeter Keys fuer store_scan
+typedef struct {
+    char **keys;
+    size_t capacity;
+    size_t count;
+} KeySet;
+
+// true, wenn der Key neu war
+static bool key_set_add(KeySet *set, const char *key, size_t key_length) {
+    if ((set->count + 1) * 2 > set->capacity) {
+        KeySet grown = {calloc(set->capacity ? set->capacity * 2 : 256, sizeof(char *)),
+                        set->capacity ? set->capacity * 2 : 256, 0};
+        if (!grown.keys) return false;
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (!set->keys[i]) continue;
+            size_t slot = blob_hash(set->keys[i], strlen(set->keys[i])) & (grown.capacity - 1);
+            while (grown.keys[slot]) slot = (slot + 1) & (grown.capacity - 1);
+            grown.keys[slot] = set->keys[i];
+            grown.count++;
+        }
+        free(set->keys);
+        *set = grown;
+    }
+    
+    size_t slot = blob_hash(key, key_length) & (set->capacity - 1);
+    for (; set->keys[slot]; slot = (slot + 1) & (set->capacity - 1)) {
+        if (strlen(set->keys[slot]) == key_length && memcmp(set->keys[slot], key, key_length) == 0) {
+            return false;
+        }
+    }
+    set->keys[slot] = strndup(key, key_length);
+    if (!set->keys[slot]) return false;
+    set->count++;
+    return true;
+}
+
+static void key_set_free(KeySet *set) {
+    for (size_t i = 0; i < set->capacity; i++) {
+        free(set->keys[i]);
+    }
+    free(set->keys);
+}
+
+typedef struct {
+    const char *prefix;
+    size_t prefix_length;
+    KeySet seen;
+    StoreScan callback;
+    void *context;
+    long count;
+} ScanState;
+
+static int scan_cold_record(void *context, const char *key, size_t key_length,
+                            const char *value, size_t value_length, uint64_t version) {
+    (void)version;
+    ScanState *state = context;
+    if (key_length < state->prefix_length ||
+        memcmp(key, state->prefix, state->prefix_length) != 0 ||
+        !key_set_add(&state->seen, key, key_length) || !value) {
+        return 0;
+    }
+    state->count++;
+    return state->callback(state->context, key, key_length, value, value_length);
+}
+
+long store_scan(const char *prefix, StoreScan callback, void *context) {
+    ScanState state = {prefix, strlen(prefix), {NULL, 0, 0}, callback, context, 0};
+    
+    // Hot-Eintraege mit eigener Referenz, damit der Callback blockieren darf
+    size_t hot_count = 0;
+    char **keys = calloc(store->count ? store->count : 1, sizeof(char *));
+    Blob **values = calloc(store->count ? store->count : 1, sizeof(Blob *));
+    if (!keys || !values) {
+        free(keys);
+        free(values);
+        return -1;
+    }
+    for (size_t slot = 0; slot < STORE_SLOTS; slot++) {
+        if (store->slots[slot].fingerprint == 0 || store->slots[slot].key_length < state.prefix_length ||
+            memcmp(store->slots[slot].key, prefix, state.prefix_length) != 0) {
+            continue;
+        }
+        keys[hot_count] = strndup(store->slots[slot].key, store->slots[slot].key_length);
+        if (!keys[hot_count]) break;
+        values[hot_count++] = blob_ref(store->slots[slot].value);
+    }
+    
+    int result = 0;
+    for (size_t i = 0; i < hot_count; i++) {
+        size_t key_length = strlen(keys[i]);
+        if (result == 0) {
+            char *scratch = blob_compressed(values[i]) ? malloc(values[i]->length) : NULL;
+            const char *data = blob_contents(values[i], scratch);
+            result = data ? callback(context, keys[i], key_length, data, values[i]->length) : -1;
+            free(scratch);
+            state.count++;
+        }
+        if (cold_enabled()) key_set_add(&state.seen, keys[i], key_length);
+        free(keys[i]);
+        blob_release(values[i]);
+    }
+    free(keys);
+    free(values);
+    
+    if (result == 0 && cold_enabled()) {
+        result = cold_scan(scan_cold_record, &state);
+    }
+    key_set_free(&state.seen);
+    return result < 0 ? -1 : state.count;
+}
+
+void store_close(void) {
+    if (!cold_enabled()) return;
+    
+    // Hot-Eintraege, die nur im Speicher stehen, sichern
+    for (size_t slot = 0; slot < STORE_SLOTS; slot++) {
+        if (store->slots[slot].fingerprint != 0 && store->dirty[slot] &&
+            cold_put(store->slots[slot].key, store->slots[slot].key_length, store->slots[slot].value,
+                     store->slots[slot].version) == 0) {
+            store->dirty[slot] = 0;
+        }
+    }
+    cold_close();
+}
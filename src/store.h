@@ -0,0 +1,120 @@
+#ifndef WEBSERVER_STORE_H
+#define WEBSERVER_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "blob.h"
+
+// Index der dynamischen Ressourcen: offene Adressierung mit linearem
+// Sondieren ueber 32-Byte-Slots (zwei pro Cache-Line) mit Fingerprint,
+// Key-Laenge, Key- und Wert-Zeiger und Version. Ein Treffer liest seinen
+// Slot und den Key; Keys liegen in festen Chunks hinter dem Index, Werte in
+// der Blob-Arena.
+
+// Speicher fuer Werte: die gespeicherten (mit --compress also ggf.
+// komprimierten) Bytes aller Keys zusammen, ein von mehreren Keys geteilter
+// Wert zaehlt je Key. So viel wie 100 Werte maximaler Groesse; kleine oder
+// komprimierte Werte lassen entsprechend mehr Keys zu. Ist das Budget oder
+// der Index voll, antwortet PUT ohne kalte Stufe mit 507, mit ihr wird ein
+// selten genutzter Eintrag auf Platte verdraengt.
+#define STORE_MEMORY (100 * 8192)
+
+// Maximale Anzahl Keys im Index
+#define STORE_CAPACITY 1024
+
+// Anzahl Slots (Zweierpotenz, Fuellgrad <= 25%)
+#define STORE_SLOTS 4096
+
+// Collections: Keys unter /dynamic/<name>/ gehoeren zur Collection mit
+// diesem Praefix, wenn er mit store_set_quota() genannt wurde, sonst
+// gemeinsam zu "*"; alle uebrigen Keys zu "/". Jede hat eigene Grenzen fuer
+// Keys und Bytes im Speicher und eigene Zaehler. Ist eine voll, verdraengt
+// sie mit kalter Stufe nur eigene Eintraege, ohne antwortet nur sie mit
+// 507. Sobald Grenzen gesetzt sind, haelt der Index jeder Collection
+// ausserdem eine Reserve an Slots frei, die keine andere belegen oder
+// verdraengen darf; so kann ein Mandant die anderen nicht aus dem Index
+// draengen, auch nicht ueber das unbegrenzte "/". Die Reserven gelten fuer
+// Slots; STORE_MEMORY teilen sich alle, dort begrenzt nur die Byte-Grenze
+// einen Mandanten. Die Verdraengung selbst
+// (CLOCK) ist fuer alle Collections dieselbe, eine eigene Strategie je
+// Collection gibt es nicht. Die Collection wird nur beim Anlegen eines
+// Keys bestimmt, Suchen kennen sie nicht.
+#define STORE_COLLECTIONS 16
+#define STORE_COLLECTION_PREFIX 48
+
+// Legt den Index an (siehe arena_configure)
+int store_init(void);
+
+// "PREFIX=KEYS[,BYTES]": legt die Collection PREFIX ("/dynamic/name/")
+// an oder setzt die Grenzen von "/" bzw. "*"; 0 = unbegrenzt. Die Reserve
+// einer genannten Collection ist ihre Key-Grenze, ohne eine
+// STORE_CAPACITY / STORE_COLLECTIONS; nicht genannte "/" und "*" teilen
+// sich den Rest bis zu diesem Anteil, und "*" bekommt ohne eigene Grenzen
+// hoechstens, was die anderen Reserven uebrig lassen. -1 bei Fehlern, mehr
+// als STORE_COLLECTIONS - 2 Praefixen oder Reserven ueber STORE_CAPACITY.
+int store_set_quota(const char *spec);
+
+// Verdraengte Eintraege in Segmenten unter directory ablegen (coldtier.h)
+int store_open_cold(const char *directory);
+
+// Grosse Werte als Dateien unter directory (bulk.h); ihre Versionen kommen
+// aus derselben Folge wie die des Index
+int store_open_bulk(const char *directory);
+uint64_t store_next_version(void);
+
+// Slot des Keys oder -1; Keys aus der kalten Stufe werden zurueckgeholt.
+// Ist dafuer kein Platz, liefert es STORE_COLD_SLOT, der sich bis zum
+// naechsten store_find lesen, ersetzen und entfernen laesst wie jeder Slot
+#define STORE_COLD_SLOT STORE_SLOTS
+int store_find(const char *key, size_t key_length);
+
+// Legt key mit value an (uebernimmt die Referenz); -1, wenn voll
+int store_insert(const char *key, size_t key_length, Blob *value);
+
+// Ersetzt den Wert (uebernimmt die Referenz) und vergibt eine neue Version;
+// liefert den Slot, der sich aendert, wenn fuer einen groesseren Wert andere
+// Eintraege verdraengt werden. -1, wenn die Collection damit ueber ihrer
+// Byte-Grenze oder der Store ueber STORE_MEMORY laege (die Referenz bleibt
+// dann beim Aufrufer)
+int store_replace(int slot, Blob *value);
+
+void store_remove(int slot);
+
+// Wird nach jedem store_insert/replace/remove mit Key und neuem Wert (NULL
+// beim Entfernen) aufgerufen, z.B. fuer die Replikation; Verdraengen in
+// die kalte Stufe und Zurueckholen zaehlen nicht als Aenderung
+typedef void (*StoreObserver)(void *context, const char *key, size_t key_length,
+                              const Blob *value);
+void store_set_observer(StoreObserver observer, void *context);
+
+Blob *store_value(int slot);
+uint64_t store_version(int slot);
+
+typedef struct {
+    const char *key;
+    size_t key_length;
+    const char *value;
+    size_t value_length;
+} StoreItem;
+
+// Legt mehrere Eintraege an oder ersetzt sie; liefert, wie viele
+// gespeichert wurden (weniger als count nur, wenn der Store voll ist)
+size_t store_put_batch(const StoreItem *items, size_t count);
+
+typedef int (*StoreScan)(void *context, const char *key, size_t key_length,
+                         const char *value, size_t value_length);
+
+// Ruft callback fuer jeden Key mit dem Praefix auf, auch fuer die in der
+// kalten Stufe; grosse Werte liegen nicht im Store (siehe bulk_scan).
+// Anzahl Eintraege oder -1
+long store_scan(const char *prefix, StoreScan callback, void *context);
+
+// Zaehler je Collection als "<zaehler>@<praefix> <wert>"-Zeilen; Laenge
+// wie snprintf
+int store_format_collections(char *buffer, size_t size);
+
+// Sichert mit kalter Stufe alle Eintraege auf Platte
+void store_close(void);
+
+#endif
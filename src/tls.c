@@ -0,0 +1,276 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+
+#include "tls.h"
+
+#ifdef HAVE_OPENSSL
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+typedef struct {
+    SSL *ssl;
+    bool kernel_send;                   // kTLS TX: send()/sendfile() verschluesseln im Kernel
+    bool kernel_recv;                   // kTLS RX: recv() liefert Klartext
+    bool failed;                        // nach fatalem Fehler kein close_notify mehr
+} TlsSession;
+
+static SSL_CTX *tls_context;
+static TlsSession **sessions;           // nach fd indiziert
+static size_t session_capacity;
+static bool fallback_reported;
+
+// Server-Reihenfolge: h2 vor http/1.1, ohne Ueberschneidung kein ALPN
+static const unsigned char alpn_protocols[] = "\x02h2\x08http/1.1";
+
+static int select_alpn(SSL *ssl, const unsigned char **out, unsigned char *out_length,
+                       const unsigned char *in, unsigned int in_length, void *arg) {
+    (void)ssl;
+    (void)arg;
+    unsigned char *selected;
+    if (SSL_select_next_proto(&selected, out_length, alpn_protocols, sizeof(alpn_protocols) - 1,
+                              in, in_length) != OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+static void report_ssl_errors(const char *what) {
+    unsigned long error = ERR_get_error();
+    fprintf(stderr, "Error: %s: %s\n", what,
+            error ? ERR_reason_error_string(error) : strerror(errno));
+    ERR_clear_error();
+}
+
+int tls_init(const char *cert_file, const char *key_file) {
+    struct rlimit limit;
+    session_capacity = getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY ?
+                       limit.rlim_cur : 65536;
+    sessions = calloc(session_capacity, sizeof(TlsSession *));
+    tls_context = SSL_CTX_new(TLS_server_method());
+    if (!sessions || !tls_context) {
+        report_ssl_errors("cannot create TLS context");
+        tls_cleanup();
+        return -1;
+    }
+    
+    SSL_CTX_set_min_proto_version(tls_context, TLS1_2_VERSION);
+#ifdef SSL_OP_ENABLE_KTLS
+    SSL_CTX_set_options(tls_context, SSL_OP_ENABLE_KTLS);
+#endif
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // Viele Clients schliessen ohne close_notify; das ist hier kein Fehler
+    SSL_CTX_set_options(tls_context, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+    // Ohne Session-Tickets schreibt der Server nach dem Handshake nichts
+    // mehr an OpenSSL vorbei, bevor der Kernel uebernimmt
+    SSL_CTX_set_num_tickets(tls_context, 0);
+    SSL_CTX_set_alpn_select_cb(tls_context, select_alpn, NULL);
+    
+    if (SSL_CTX_use_certificate_chain_file(tls_context, cert_file) != 1) {
+        report_ssl_errors(cert_file);
+        tls_cleanup();
+        return -1;
+    }
+    if (SSL_CTX_use_PrivateKey_file(tls_context, key_file, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(tls_context) != 1) {
+        report_ssl_errors(key_file);
+        tls_cleanup();
+        return -1;
+    }
+    return 0;
+}
+
+bool tls_enabled(void) {
+    return tls_context != NULL;
+}
+
+static TlsSession *session_for(int fd) {
+    return sessions && fd >= 0 && (size_t)fd < session_capacity ? sessions[fd] : NULL;
+}
+
+int tls_accept(int fd) {
+    if (fd < 0 || (size_t)fd >= session_capacity) {
+        fprintf(stderr, "Error: descriptor %d out of TLS session range\n", fd);
+        return -1;
+    }
+    
+    TlsSession *session = calloc(1, sizeof(TlsSession));
+    if (!session) return -1;
+    session->ssl = SSL_new(tls_context);
+    if (!session->ssl || SSL_set_fd(session->ssl, fd) != 1) {
+        report_ssl_errors("cannot create TLS session");
+        SSL_free(session->ssl);
+        free(session);
+        return -1;
+    }
+    
+    // Blockierend wie recv() bei Klartext; EINTR heisst hier Shutdown
+    ERR_clear_error();
+    if (SSL_accept(session->ssl) != 1) {
+        report_ssl_errors("TLS handshake failed");
+        SSL_free(session->ssl);
+        free(session);
+        return -1;
+    }
+    
+    session->kernel_send = BIO_get_ktls_send(SSL_get_wbio(session->ssl));
+    session->kernel_recv = BIO_get_ktls_recv(SSL_get_rbio(session->ssl));
+    if (!session->kernel_send && !fallback_reported) {
+        fprintf(stderr, "Warning: kernel TLS unavailable, encrypting in user space\n");
+        fallback_reported = true;
+    }
+    sessions[fd] = session;
+    return 0;
+}
+
+void tls_close(int fd) {
+    TlsSession *session = session_for(fd);
+    if (!session) return;
+    
+    if (!session->failed) SSL_shutdown(session->ssl);
+    SSL_free(session->ssl);
+    free(session);
+    sessions[fd] = NULL;
+}
+
+bool tls_kernel_send(int fd) {
+    TlsSession *session = session_for(fd);
+    return session && session->kernel_send;
+}
+
+bool tls_pending(int fd) {
+    TlsSession *session = session_for(fd);
+    return session && !session->kernel_recv && SSL_has_pending(session->ssl);
+}
+
+// Uebersetzt SSL_read()/SSL_write()-Ergebnisse in die Konventionen von
+// recv()/send(): 0 bei Verbindungsende, sonst -1 mit errno
+static ssize_t ssl_result(TlsSession *session, int result) {
+    if (result > 0) return result;
+    
+    int saved_errno = errno;
+    switch (SSL_get_error(session->ssl, result)) {
+    case SSL_ERROR_ZERO_RETURN:
+        return 0;
+    case SSL_ERROR_WANT_READ:
+    case SSL_ERROR_WANT_WRITE:
+        errno = saved_errno == EINTR ? EINTR : EAGAIN;
+        return -1;
+    case SSL_ERROR_SYSCALL:
+        session->failed = true;
+        ERR_clear_error();
+        if (saved_errno == 0) return 0;     // EOF ohne close_notify
+        errno = saved_errno;
+        return -1;
+    default:
+        session->failed = true;
+        report_ssl_errors("TLS record layer");
+        errno = EPROTO;
+        return -1;
+    }
+}
+
+ssize_t tls_send(int fd, const void *buffer, size_t length, int flags) {
+    TlsSession *session = session_for(fd);
+    if (!session || session->kernel_send) {
+        return send(fd, buffer, length, flags);
+    }
+    if (length == 0) return 0;
+    
+    ERR_clear_error();
+    errno = 0;
+    return ssl_result(session, SSL_write(session->ssl, buffer, length > INT_MAX ? INT_MAX : length));
+}
+
+ssize_t tls_recv(int fd, void *buffer, size_t length, int flags) {
+    TlsSession *session = session_for(fd);
+    if (!session) {
+        return recv(fd, buffer, length, flags);
+    }
+    if (session->kernel_recv) {
+        // Records ausser Anwendungsdaten (Alerts, KeyUpdate) meldet der
+        // Kernel mit EIO; die liest OpenSSL per recvmsg() mit Kontrolldaten
+        ssize_t bytes_read = recv(fd, buffer, length, flags);
+        if (bytes_read >= 0 || errno != EIO) return bytes_read;
+    }
+    if (length == 0) return 0;
+    
+    // SSL_read() blockiert auf dem Socket; MSG_DONTWAIT meldet EAGAIN, wenn
+    // weder OpenSSL noch der Socket Bytes hat
+    char next;
+    if ((flags & MSG_DONTWAIT) && !SSL_has_pending(session->ssl) &&
+        recv(fd, &next, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return -1;
+    }
+    
+    ERR_clear_error();
+    errno = 0;
+    return ssl_result(session, SSL_read(session->ssl, buffer, length > INT_MAX ? INT_MAX : length));
+}
+
+void tls_cleanup(void) {
+    for (size_t fd = 0; sessions && fd < session_capacity; fd++) {
+        if (sessions[fd]) tls_close(fd);
+    }
+    free(sessions);
+    sessions = NULL;
+    session_capacity = 0;
+    SSL_CTX_free(tls_context);
+    tls_context = NULL;
+}
+
+#else
+
+// Ohne OpenSSL (-DWEBSERVER_TLS=OFF) gibt es keine Sitzungen, alles geht
+// direkt an den Socket
+int tls_init(const char *cert_file, const char *key_file) {
+    (void)cert_file;
+    (void)key_file;
+    fprintf(stderr, "Error: built without TLS support (WEBSERVER_TLS=OFF)\n");
+    return -1;
+}
+
+bool tls_enabled(void) {
+    return false;
+}
+
+int tls_accept(int fd) {
+    (void)fd;
+    return -1;
+}
+
+void tls_close(int fd) {
+    (void)fd;
+}
+
+bool tls_kernel_send(int fd) {
+    (void)fd;
+    return false;
+}
+
+bool tls_pending(int fd) {
+    (void)fd;
+    return false;
+}
+
+ssize_t tls_send(int fd, const void *buffer, size_t length, int flags) {
+    return send(fd, buffer, length, flags);
+}
+
+ssize_t tls_recv(int fd, void *buffer, size_t length, int flags) {
+    return recv(fd, buffer, length, flags);
+}
+
+void tls_cleanup(void) {
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef WEBSERVER_TLS_H
+#define WEBSERVER_TLS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// TLS-Listener: Handshake in OpenSSL, danach uebernimmt nach Moeglichkeit
+// Kernel-TLS die Record-Verschluesselung. Mit kTLS bleibt der Socket fuer
+// send()/sendfile() ein gewoehnlicher Socket; ohne (Kernel ohne "tls"-ULP,
+// nicht unterstuetzte Cipher) laufen Records ueber SSL_write()/SSL_read().
+//
+// tls_send()/tls_recv() ersetzen send()/recv() auf Client-Sockets und
+// fallen fuer Sockets ohne TLS-Sitzung direkt auf die Systemaufrufe durch.
+// Ohne OpenSSL (-DWEBSERVER_TLS=OFF) bleiben nur diese, tls_init() schlaegt
+// dann fehl.
+
+// Laedt Zertifikatskette und Schluessel (PEM); ALPN bietet h2 und http/1.1
+int tls_init(const char *cert_file, const char *key_file);
+bool tls_enabled(void);
+
+// Fuehrt den Handshake auf fd durch; -1 bei Fehler
+int tls_accept(int fd);
+
+// Sendet close_notify und gibt die Sitzung frei (fd bleibt offen)
+void tls_close(int fd);
+
+// true, wenn fd mit TLS-Sitzung vom Kernel verschluesselt wird
+bool tls_kernel_send(int fd);
+
+// true, wenn OpenSSL schon gelesene Daten puffert, die poll() nicht meldet
+bool tls_pending(int fd);
+
+// Wie send()/recv(); flags wie MSG_MORE wirken nur mit kTLS, MSG_DONTWAIT
+// beim Lesen immer
+ssize_t tls_send(int fd, const void *buffer, size_t length, int flags);
+ssize_t tls_recv(int fd, void *buffer, size_t length, int flags);
+
+void tls_cleanup(void);
+
+#endif
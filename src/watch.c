@@ -0,0 +1,254 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "watch.h"
+
+#define WATCH_BUCKETS 256
+#define WATCH_MAX_LISTENERS 4
+
+typedef struct WatchKey WatchKey;
+
+typedef struct Watcher {
+    struct Watcher *next;               // Warteliste des Schluessels
+    WatchKey *key;
+    size_t index;                       // Position in watchers[]
+    int fd;
+    uint64_t deadline_us;
+    size_t length;
+    char data[];
+} Watcher;
+
+struct WatchKey {
+    WatchKey *next;                     // Bucket-Kette
+    Watcher *waiters;
+    size_t length;
+    char key[];
+};
+
+static WatchKey *buckets[WATCH_BUCKETS];
+static Watcher *watchers[WATCH_MAX];    // alle Geparkten, fuer poll() und Fristen
+static size_t count;
+static WatchIdle idle[WATCH_MAX_IDLE];
+static size_t idle_count;
+static bool idle_first;
+
+static uint64_t watch_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// FNV-1a
+static size_t key_bucket(const char *key, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return hash % WATCH_BUCKETS;
+}
+
+static WatchKey **find_key(const char *key, size_t length) {
+    WatchKey **link = &buckets[key_bucket(key, length)];
+    while (*link && ((*link)->length != length || memcmp((*link)->key, key, length) != 0)) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void unlink_key(WatchKey *entry) {
+    WatchKey **link = find_key(entry->key, entry->length);
+    *link = entry->next;
+    free(entry);
+}
+
+// Nimmt den Watcher aus watchers[]; die Warteliste behandelt der Aufrufer
+static void remove_watcher(Watcher *watcher) {
+    watchers[watcher->index] = watchers[--count];
+    watchers[watcher->index]->index = watcher->index;
+}
+
+static void finish_watcher(Watcher *watcher, bool respond, WatchCallback callback, void *context) {
+    callback(context, watcher->fd, watcher->data, watcher->length, respond);
+    free(watcher);
+}
+
+// Einzelner Watcher (Frist, Abbruch): aus Warteliste und watchers[] loesen
+static void detach_watcher(Watcher *watcher) {
+    WatchKey *key = watcher->key;
+    Watcher **link = &key->waiters;
+    while (*link != watcher) link = &(*link)->next;
+    *link = watcher->next;
+    if (!key->waiters) unlink_key(key);
+    remove_watcher(watcher);
+}
+
+int watch_park(const char *key, size_t key_length, int fd, const void *data, size_t length,
+               uint64_t deadline_us) {
+    if (count == WATCH_MAX) return -1;
+    
+    WatchKey **link = find_key(key, key_length);
+    if (!*link) {
+        WatchKey *entry = malloc(sizeof(WatchKey) + key_length);
+        if (!entry) return -1;
+        entry->next = NULL;
+        entry->waiters = NULL;
+        entry->length = key_length;
+        memcpy(entry->key, key, key_length);
+        *link = entry;
+    }
+    
+    Watcher *watcher = malloc(sizeof(Watcher) + length);
+    if (!watcher) {
+        if (!(*link)->waiters) unlink_key(*link);
+        return -1;
+    }
+    watcher->key = *link;
+    watcher->next = (*link)->waiters;
+    (*link)->waiters = watcher;
+    watcher->fd = fd;
+    watcher->deadline_us = deadline_us;
+    watcher->length = length;
+    memcpy(watcher->data, data, length);
+    watcher->index = count;
+    watchers[count++] = watcher;
+    return 0;
+}
+
+size_t watch_notify(const char *key, size_t key_length, WatchCallback callback, void *context) {
+    if (count == 0) return 0;
+    
+    WatchKey **link = find_key(key, key_length);
+    if (!*link) return 0;
+    
+    // Liste zuerst abhaengen: Callbacks duerfen wieder parken
+    WatchKey *entry = *link;
+    Watcher *waiters = entry->waiters;
+    *link = entry->next;
+    free(entry);
+    
+    size_t woken = 0;
+    while (waiters) {
+        Watcher *watcher = waiters;
+        waiters = watcher->next;
+        remove_watcher(watcher);
+        finish_watcher(watcher, true, callback, context);
+        woken++;
+    }
+    return woken;
+}
+
+int watch_idle(int fd, int kind, uint64_t deadline_us) {
+    if (idle_count == WATCH_MAX_IDLE) return -1;
+    idle[idle_count++] = (WatchIdle){fd, kind, deadline_us};
+    return 0;
+}
+
+bool watch_idle_full(void) {
+    return idle_count == WATCH_MAX_IDLE;
+}
+
+int watch_idle_take(WatchIdle *taken) {
+    if (idle_count == 0) return -1;
+    *taken = idle[--idle_count];
+    return 0;
+}
+
+int watch_wait(const int *listen_fds, size_t listen_count, WatchIdle *taken,
+               WatchCallback callback, void *context) {
+    struct pollfd fds[WATCH_MAX_LISTENERS + WATCH_MAX_IDLE + WATCH_MAX];
+    Watcher *polled[WATCH_MAX];
+    if (listen_count > WATCH_MAX_LISTENERS) listen_count = WATCH_MAX_LISTENERS;
+    
+    while (1) {
+        // Abgelaufene Fristen beantworten, naechste Frist bestimmt das Timeout
+        uint64_t now = watch_now_us();
+        uint64_t next_deadline = UINT64_MAX;
+        for (size_t i = 0; i < count;) {
+            Watcher *watcher = watchers[i];
+            if (watcher->deadline_us <= now) {
+                detach_watcher(watcher);
+                finish_watcher(watcher, true, callback, context);
+                continue;
+            }
+            if (watcher->deadline_us < next_deadline) next_deadline = watcher->deadline_us;
+            i++;
+        }
+        for (size_t i = 0; i < idle_count; i++) {
+            if (idle[i].deadline_us <= now) {
+                *taken = idle[i];
+                idle[i] = idle[--idle_count];
+                return WATCH_IDLE_EXPIRED;
+            }
+            if (idle[i].deadline_us < next_deadline) next_deadline = idle[i].deadline_us;
+        }
+        uint64_t timeout_ms = next_deadline == UINT64_MAX ? 0 : (next_deadline - now + 999) / 1000;
+        
+        // Von Geparkten interessiert nur das Schliessen der Verbindung
+        size_t polled_count = count;
+        struct pollfd *watcher_fds = fds + listen_count + idle_count;
+        for (size_t i = 0; i < listen_count; i++) {
+            fds[i] = (struct pollfd){.fd = listen_fds[i], .events = POLLIN};
+        }
+        for (size_t i = 0; i < idle_count; i++) {
+            fds[listen_count + i] = (struct pollfd){.fd = idle[i].fd, .events = POLLIN};
+        }
+        for (size_t i = 0; i < polled_count; i++) {
+            polled[i] = watchers[i];
+            watcher_fds[i] = (struct pollfd){.fd = watchers[i]->fd, .events = POLLRDHUP};
+        }
+        
+        int ready = poll(fds, listen_count + idle_count + polled_count,
+                         next_deadline == UINT64_MAX ? -1 :
+                         timeout_ms > INT_MAX ? INT_MAX : (int)timeout_ms);
+        if (ready < 0) return -1;
+        
+        for (size_t i = 0; i < polled_count; i++) {
+            if (watcher_fds[i].revents) {
+                detach_watcher(polled[i]);
+                finish_watcher(polled[i], false, callback, context);
+            }
+        }
+        // Abwechselnd zuerst Listener oder ruhende Verbindungen (weitere
+        // Daten oder Schliessen), damit keine Seite die andere aushungert
+        idle_first = !idle_first;
+        for (int pass = 0; pass < 2; pass++) {
+            if ((pass == 0) != idle_first) {
+                for (size_t i = 0; i < listen_count; i++) {
+                    if (fds[i].revents) return i;
+                }
+                continue;
+            }
+            for (size_t i = 0; i < idle_count; i++) {
+                if (fds[listen_count + i].revents) {
+                    *taken = idle[i];
+                    idle[i] = idle[--idle_count];
+                    return WATCH_IDLE_READY;
+                }
+            }
+        }
+    }
+}
+
+void watch_close_all(WatchCallback callback, void *context) {
+    while (count > 0) {
+        Watcher *watcher = watchers[count - 1];
+        detach_watcher(watcher);
+        finish_watcher(watcher, false, callback, context);
+    }
+    while (idle_count > 0) {
+        close(idle[--idle_count].fd);
+    }
+}
+
+size_t watch_count(void) {
+    return count;
+}
@@ -0,0 +1,64 @@
+#ifndef WEBSERVER_WATCH_H
+#define WEBSERVER_WATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Geparkte Long-Poll-Requests, je Schluessel eine Warteliste. Ein
+// geparkter Client belegt nur seinen Socket und eine Kopie seines
+// Requests; die Hauptschleife wartet per poll() auf neue Verbindungen,
+// Fristen und Verbindungsabbrueche der Geparkten sowie auf weitere Daten
+// ruhender Verbindungen (Keep-Alive, HTTP/2, Binaerprotokoll).
+
+#define WATCH_MAX 1024                  // gleichzeitig geparkte Requests
+#define WATCH_MAX_IDLE 256              // ruhende Verbindungen
+
+// Rueckgaben von watch_wait(): eine ruhende Verbindung ist wieder lesbar
+// bzw. hat ihre Frist ueberschritten
+#define WATCH_IDLE_READY (-2)
+#define WATCH_IDLE_EXPIRED (-3)
+
+// Ruhende Verbindung; kind legt der Aufrufer fest (Protokoll)
+typedef struct {
+    int fd;
+    int kind;
+    uint64_t deadline_us;
+} WatchIdle;
+
+// Wird fuer jeden Watcher genau einmal aufgerufen: respond ist false, wenn
+// der Client die Verbindung geschlossen hat; der Callback schliesst fd
+typedef void (*WatchCallback)(void *context, int fd, const void *data, size_t length,
+                              bool respond);
+
+// Parkt fd unter key bis watch_notify() oder deadline_us (monotone Zeit);
+// data wird kopiert. -1, wenn schon WATCH_MAX Requests warten
+int watch_park(const char *key, size_t key_length, int fd, const void *data, size_t length,
+               uint64_t deadline_us);
+
+// Weckt nur die unter key geparkten Requests; Rueckgabe deren Anzahl
+size_t watch_notify(const char *key, size_t key_length, WatchCallback callback, void *context);
+
+// Legt eine Verbindung beiseite, bis sie wieder lesbar wird oder
+// deadline_us (monotone Zeit) verstreicht; -1, wenn schon WATCH_MAX_IDLE
+// ruhen
+int watch_idle(int fd, int kind, uint64_t deadline_us);
+bool watch_idle_full(void);
+
+// Wartet, bis einer der Listener lesbar ist, und erledigt dabei abgelaufene
+// und abgebrochene Watcher; Rueckgabe dessen Index, WATCH_IDLE_READY oder
+// WATCH_IDLE_EXPIRED mit der ruhenden Verbindung in *idle (sie gehoert
+// danach wieder dem Aufrufer) oder -1 mit errno (EINTR bei Signalen)
+int watch_wait(const int *listen_fds, size_t listen_count, WatchIdle *idle,
+               WatchCallback callback, void *context);
+
+// Gibt eine der ruhenden Verbindungen zurueck (Shutdown); -1, wenn keine ruht
+int watch_idle_take(WatchIdle *idle);
+
+// Beendet alle Watcher ohne Antwort und schliesst ruhende Verbindungen,
+// die nicht per watch_idle_take() abgeholt wurden (Shutdown)
+void watch_close_all(WatchCallback callback, void *context);
+
+size_t watch_count(void);
+
+#endif
@@ -5,102 +5,334 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <netdb.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <errno.h>
 #include <ctype.h>
+#include <signal.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "accesslog.h"
+#include "accounting.h"
+#include "archive.h"
+#include "arena.h"
+#include "blob.h"
+#include "bulk.h"
+#include "capture.h"
+#include "cluster.h"
+#include "encoding.h"
+#include "http2.h"
+#include "kv.h"
+#include "probes.h"
+#include "proxy.h"
+#include "replication.h"
+#include "store.h"
+#include "tls.h"
+#include "watch.h"
 
 // Konfigurationskonstanten
 #define BUFFER_SIZE 8192
 #define STATIC_RESP_COUNT 3
-#define DYNAMIC_RESOURCES_COUNT 100
 #define MAX_HEADERS 40
 #define MAX_HEADER_LENGTH 256
+#define CONNECTION_BUFFERS 64
+#define MAX_WAIT_SECONDS 300
+
+// Rueckgabe von process_request(), wenn der Request als Long-Poll geparkt
+// wurde; die Verbindung gehoert dann der Warteliste (siehe watch.h)
+#define REQUEST_PARKED 2
+
+// Rueckgaben von handle_client(), wenn die Verbindung ohne lesbare Daten
+// auf den naechsten Request wartet; sie ruht dann im poll() der
+// Hauptschleife (watch_idle()) und dient dort auch als Art der Verbindung
+#define CONNECTION_IDLE 3
+#define CONNECTION_IDLE_HTTP2 4         // Zustand in http2.c
+#define CONNECTION_IDLE_KV 5            // Zustand in kv.c
+#define CONNECTION_IDLE_SECONDS 60      // danach wird eine ruhende Verbindung geschlossen
 
 typedef struct {
     const char *path;
     const char *content;
     size_t content_length;
+    char *encoded[ENCODING_COUNT];          // beim Start erzeugt, NULL wenn nicht kleiner
+    size_t encoded_length[ENCODING_COUNT];
 } StaticResource;
 
-typedef struct {
-    char path[256];
-    char content[BUFFER_SIZE];
-    bool in_use;
-    size_t content_length;
-} DynamicResource;
-
 // Statische Ressourcen
 StaticResource static_resources[] = {
-    {"/static/foo", "Foo", 3},
-    {"/static/bar", "Bar", 3},
-    {"/static/baz", "Baz", 3}
+    {.path = "/static/foo", .content = "Foo", .content_length = 3},
+    {.path = "/static/bar", .content = "Bar", .content_length = 3},
+    {.path = "/static/baz", .content = "Baz", .content_length = 3},
 };
 
-// Array zum Speichern dynamischer Ressourcen
-DynamicResource dynamic_resources[DYNAMIC_RESOURCES_COUNT] = {0};
+// Wird von SIGINT/SIGTERM gesetzt, damit main() sauber zurueckkehrt
+// (atexit-Handler wie das PGO-Profil-Dumping laufen nur dann)
+volatile sig_atomic_t shutdown_requested = 0;
 
-int count_headers(const char *request) {
-    int count = 0;
-    const char *ptr = request;
-    const char *end = strstr(request, "\r\n\r\n");
-    
-    if (!end) return 0;
-    
-    while (ptr < end && (ptr = strstr(ptr, "\r\n")) != NULL) {
-        count++;
-        ptr += 2;
-    }
+// Cluster-Modus (cluster.h): fremde Keys umleiten; --cluster-forward
+// leitet sie stattdessen (blockierend) weiter
+bool cluster_redirect = true;
 
-    // Subtrahiere die Leerzeile am Ende
-    return count - 1;
+// Verlangen /admin/import und /admin/export als "Authorization: Bearer
+// TOKEN"; ohne Token nur von Loopback-Adressen erlaubt
+const char *admin_token = NULL;
+
+void handle_shutdown_signal(int signo) {
+    (void)signo;
+    shutdown_requested = 1;
 }
 
-// Überprüft, ob die Headerzeilen gültig sind
-bool validate_headers(const char *request) {
-    const char *header_start = strstr(request, "\r\n");
-    if (!header_start) return false;
-    
-    header_start += 2;
-    const char *header_end = strstr(request, "\r\n\r\n");
-    if (!header_end) return false;
+// Status und Body-Laenge der letzten Antwort dieses Threads (Access-Log)
+__thread int last_response_status;
+__thread size_t last_response_bytes;
+
+// Gesetzt, waehrend ein HTTP/2-Stream bearbeitet wird: Antworten gehen dann
+// als Frames ueber http2_respond() statt direkt auf den Socket
+__thread Http2Stream *response_stream;
+
+// Gesetzt, waehrend ein geparkter Request beantwortet wird: nicht erneut parken
+__thread bool answering_watcher;
+
+uint64_t monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
-    const char *line = header_start;
-    while (line < header_end) {
-        const char *next_line = strstr(line, "\r\n");
-        if (!next_line || (next_line - line) > MAX_HEADER_LENGTH) {
-            return false;
+// Bekannte Header; werden beim Parsen per perfektem Hash auf ihre ID abgebildet
+typedef enum {
+    HEADER_HOST,
+    HEADER_CONTENT_LENGTH,
+    HEADER_CONTENT_TYPE,
+    HEADER_CONNECTION,
+    HEADER_ACCEPT,
+    HEADER_ACCEPT_ENCODING,
+    HEADER_IF_MATCH,
+    HEADER_IF_NONE_MATCH,
+    HEADER_EXPECT,
+    HEADER_TRANSFER_ENCODING,
+    HEADER_UPGRADE,
+    HEADER_HTTP2_SETTINGS,
+    HEADER_USER_AGENT,
+    HEADER_PREFER,
+    HEADER_CLUSTER_FORWARDED,
+    HEADER_AUTHORIZATION,
+    HEADER_COUNT
+} HeaderId;
+
+// Kleingeschriebene Namen, Index = HeaderId
+const char *header_names[HEADER_COUNT] = {
+    [HEADER_HOST] = "host",
+    [HEADER_CONTENT_LENGTH] = "content-length",
+    [HEADER_CONTENT_TYPE] = "content-type",
+    [HEADER_CONNECTION] = "connection",
+    [HEADER_ACCEPT] = "accept",
+    [HEADER_ACCEPT_ENCODING] = "accept-encoding",
+    [HEADER_IF_MATCH] = "if-match",
+    [HEADER_IF_NONE_MATCH] = "if-none-match",
+    [HEADER_EXPECT] = "expect",
+    [HEADER_TRANSFER_ENCODING] = "transfer-encoding",
+    [HEADER_UPGRADE] = "upgrade",
+    [HEADER_HTTP2_SETTINGS] = "http2-settings",
+    [HEADER_USER_AGENT] = "user-agent",
+    [HEADER_PREFER] = "prefer",
+    [HEADER_CLUSTER_FORWARDED] = "x-cluster-forwarded",
+    [HEADER_AUTHORIZATION] = "authorization",
+};
+
+#define HEADER_HASH_SIZE 64
+
+// Slot -> HeaderId + 1 (0 = frei), wird von init_header_table() gefuellt
+signed char header_slots[HEADER_HASH_SIZE];
+size_t header_name_lengths[HEADER_COUNT];
+
+// Ausschnitt aus dem Request-Puffer; length 0 und offset 0 = nicht vorhanden
+typedef struct {
+    uint32_t offset;
+    uint32_t length;
+} Slice;
+
+// Einmal pro Request geparste Request-Zeile und Header-Tabelle
+typedef struct {
+    const char *data;              // Request-Puffer, alle Slices zeigen hier hinein
+    char method[16];
+    char path[256];
+    char version[16];
+    Slice known[HEADER_COUNT];     // Werte bekannter Header, O(1) per HeaderId
+    Slice names[MAX_HEADERS];      // alle Header in Reihenfolge
+    Slice values[MAX_HEADERS];
+    int header_count;
+    size_t headers_length;         // inkl. abschliessendem "\r\n\r\n"
+    ssize_t content_length;        // -1 = fehlt oder ungueltig
+    bool body_unknown;             // Content-Length ungueltig: Ende des Bodys unbekannt
+    int error_status;              // != 0: Request wird mit diesem Status abgelehnt
+    const char *error_text;
+    // Direkt in den Wertspeicher empfangener PUT-Body (receive_body()),
+    // sonst NULL; wer ihn uebernimmt, setzt *received_body auf NULL
+    Blob **received_body;
+} HttpRequest;
+
+// Perfekter Hash ueber die Kleinbuchstaben-Namen der bekannten Header:
+// erstes + letztes Zeichen + 7 * Laenge
+int header_hash(const char *name, size_t length) {
+    return (tolower((unsigned char)name[0]) + tolower((unsigned char)name[length - 1]) +
+            7 * length) & (HEADER_HASH_SIZE - 1);
+}
+
+// Fuellt die Slot-Tabelle; schlaegt fehl, wenn ein neuer Header kollidiert
+int init_header_table(void) {
+    for (int id = 0; id < HEADER_COUNT; id++) {
+        header_name_lengths[id] = strlen(header_names[id]);
+        int slot = header_hash(header_names[id], header_name_lengths[id]);
+        if (header_slots[slot] != 0) {
+            fprintf(stderr, "Error: header hash collision between '%s' and '%s'\n",
+                    header_names[id], header_names[header_slots[slot] - 1]);
+            return -1;
         }
-        line = next_line + 2;
+        header_slots[slot] = id + 1;
     }
-    
-    return true;
+    return 0;
 }
 
-// Ermittelt die Länge des Request-Bodys
-ssize_t get_content_length(const char *request) {
-    const char *cl_header = strcasestr(request, "Content-Length:");
-    
-    if (!cl_header) {
+// Bildet einen Header-Namen auf seine HeaderId ab, -1 fuer unbekannte
+int lookup_header_id(const char *name, size_t length) {
+    if (length == 0) return -1;
+    int id = header_slots[header_hash(name, length)] - 1;
+    if (id < 0 || header_name_lengths[id] != length ||
+        strncasecmp(name, header_names[id], length) != 0) {
         return -1;
     }
+    return id;
+}
+
+// Liefert den Wert eines bekannten Headers (ohne fuehrende/abschliessende
+// Leerzeichen) oder NULL, wenn er fehlt
+const char *request_header(const HttpRequest *request, HeaderId id, size_t *length) {
+    Slice value = request->known[id];
+    if (value.offset == 0) return NULL;
+    if (length) *length = value.length;
+    return request->data + value.offset;
+}
+
+void reject_request(HttpRequest *request, int status, const char *text) {
+    if (request->error_status == 0) {
+        request->error_status = status;
+        request->error_text = text;
+    }
+}
+
+// Kopiert das naechste durch Leerzeichen getrennte Token der Request-Zeile
+bool next_token(const char **pos, const char *end, char *out, size_t out_size) {
+    const char *start = *pos;
+    while (start < end && *start == ' ') start++;
+    const char *stop = start;
+    while (stop < end && *stop != ' ') stop++;
+    if (stop == start || (size_t)(stop - start) >= out_size) return false;
+    memcpy(out, start, stop - start);
+    out[stop - start] = '\0';
+    *pos = stop;
+    return true;
+}
+
+// Parst Content-Length streng als Dezimalzahl, -1 bei ungueltigem Wert
+ssize_t parse_content_length(const char *value, size_t length) {
+    if (length == 0 || length > 18) return -1;
+    ssize_t result = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (!isdigit((unsigned char)value[i])) return -1;
+        result = result * 10 + (value[i] - '0');
+    }
+    return result;
+}
+
+// Zerlegt Request-Zeile und Header einmalig in eine Tabelle von Slices.
+// headers_length umfasst alles bis einschliesslich "\r\n\r\n".
+void parse_request(const char *data, size_t headers_length, HttpRequest *request) {
+    request->data = data;
+    request->headers_length = headers_length;
+    request->header_count = 0;
+    request->content_length = -1;
+    request->body_unknown = false;
+    request->error_status = 0;
+    request->error_text = NULL;
+    request->received_body = NULL;
+    memset(request->known, 0, sizeof(request->known));
     
-    ssize_t length = 0;
-    if (sscanf(cl_header + 15, "%zd", &length) != 1) {
-        return -1;
+    // Ende des letzten Header-Zeilenumbruchs, die Leerzeile gehoert nicht dazu
+    const char *block_end = data + headers_length - 2;
+    const char *line_end = memmem(data, block_end - data, "\r\n", 2);
+    
+    const char *pos = data;
+    if (!next_token(&pos, line_end, request->method, sizeof(request->method)) ||
+        !next_token(&pos, line_end, request->path, sizeof(request->path)) ||
+        !next_token(&pos, line_end, request->version, sizeof(request->version))) {
+        reject_request(request, 400, "Invalid Request Format");
+        request->method[0] = request->path[0] = request->version[0] = '\0';
     }
     
-    return length;
+    const char *line = line_end + 2;
+    bool has_content_length = false;
+    while (line < block_end) {
+        const char *next_line = memmem(line, block_end - line, "\r\n", 2);
+        const char *colon = memchr(line, ':', next_line - line);
+        int id = colon && colon != line ? lookup_header_id(line, colon - line) : -1;
+        const char *value = colon ? colon + 1 : next_line;
+        const char *value_end = next_line;
+        while (value < value_end && (*value == ' ' || *value == '\t')) value++;
+        while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+        
+        // Content-Length gilt auch in abgelehnten Headern: der Body wird
+        // trotzdem verworfen und nicht als naechster Request gelesen
+        if (id == HEADER_CONTENT_LENGTH) {
+            ssize_t length = parse_content_length(value, value_end - value);
+            // Mehrere Content-Length-Header muessen uebereinstimmen
+            if (length < 0 || (has_content_length && length != request->content_length)) {
+                reject_request(request, 400, "Invalid Content-Length");
+                request->body_unknown = true;
+            }
+            has_content_length = true;
+            request->content_length = request->body_unknown ? -1 : length;
+        }
+        
+        if (request->header_count == MAX_HEADERS) {
+            reject_request(request, 400, "Too many headers");
+            line = next_line + 2;
+            continue;
+        }
+        if (next_line - line > MAX_HEADER_LENGTH || !colon || colon == line) {
+            reject_request(request, 400, "Invalid headers");
+            line = next_line + 2;
+            continue;
+        }
+        
+        Slice name_slice = {line - data, colon - line};
+        Slice value_slice = {value - data, value_end - value};
+        request->names[request->header_count] = name_slice;
+        request->values[request->header_count] = value_slice;
+        request->header_count++;
+        
+        if (id >= 0 && request->known[id].offset == 0) {
+            request->known[id] = value_slice;
+        }
+        
+        line = next_line + 2;
+    }
 }
 
-// Sendet alle Daten an den Client
-ssize_t send_all(int sock_fd, const char *buffer, size_t length) {
+// Sendet alle Daten an den Client (flags z.B. MSG_MORE)
+ssize_t send_all(int sock_fd, const char *buffer, size_t length, int flags) {
     size_t total_sent = 0;
     
     while (total_sent < length) {
-        ssize_t sent = send(sock_fd, buffer + total_sent, length - total_sent, MSG_NOSIGNAL);
+        ssize_t sent = tls_send(sock_fd, buffer + total_sent, length - total_sent,
+                                MSG_NOSIGNAL | flags);
         if (sent < 0) {
             if (errno == EPIPE) return -1;
             perror("Error: send failed");
@@ -112,60 +344,815 @@ ssize_t send_all(int sock_fd, const char *buffer, size_t length) {
     return total_sent;
 }
 
-// Sendet eine HTTP-Antwort an den Client
-int send_response(int client_fd, int status_code, const char *status_text,
-                 const char *body, size_t content_length) {
+// Sendet Header und Body mit einem sendmsg() statt zwei send(); TLS im
+// Userspace verschluesselt nacheinander per send_all()
+ssize_t send_header_body(int sock_fd, const char *header, size_t header_length,
+                         const char *body, size_t body_length) {
+    if (tls_enabled() && !tls_kernel_send(sock_fd)) {
+        if (send_all(sock_fd, header, header_length, body_length > 0 ? MSG_MORE : 0) < 0 ||
+            (body_length > 0 && send_all(sock_fd, body, body_length, 0) < 0)) {
+            return -1;
+        }
+        return header_length + body_length;
+    }
+    
+    struct iovec parts[2] = {{(char *)header, header_length}, {(char *)body, body_length}};
+    struct msghdr message = {.msg_iov = parts, .msg_iovlen = body_length > 0 ? 2 : 1};
+    size_t remaining = header_length + body_length;
+    while (remaining > 0) {
+        ssize_t sent = sendmsg(sock_fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EPIPE) return -1;
+            perror("Error: send failed");
+            return -1;
+        }
+        remaining -= sent;
+        
+        // Bereits verschickte Teile ueberspringen
+        while (message.msg_iovlen > 0 && (size_t)sent >= message.msg_iov->iov_len) {
+            sent -= message.msg_iov->iov_len;
+            message.msg_iov++;
+            message.msg_iovlen--;
+        }
+        if (message.msg_iovlen > 0) {
+            message.msg_iov->iov_base = (char *)message.msg_iov->iov_base + sent;
+            message.msg_iov->iov_len -= sent;
+        }
+    }
+    return header_length + body_length;
+}
+
+// Sendet eine HTTP-Antwort mit zusaetzlichen Headern (je "Name: Wert\r\n")
+int send_response_headers(int client_fd, int status_code, const char *status_text,
+                          const char *extra_headers, const char *body, size_t content_length) {
     char header[BUFFER_SIZE];
     
+    PROBE3(response__send, client_fd, status_code, content_length);
+    last_response_status = status_code;
+    last_response_bytes = content_length;
+    
+    if (response_stream) {
+        return http2_respond(response_stream, status_code, extra_headers, body, content_length);
+    }
+    
     int header_len = snprintf(header, sizeof(header),
         "HTTP/1.1 %d %s\r\n"
         "Content-Length: %zu\r\n"
+        "%s"
         "Connection: close\r\n"
         "\r\n",
-        status_code, status_text, content_length);
+        status_code, status_text, content_length, extra_headers ? extra_headers : "");
+    if (header_len < 0 || (size_t)header_len >= sizeof(header)) {
+        // Nur mit fremden Headern (Upstream, Cluster-Knoten) moeglich
+        fprintf(stderr, "Error: response headers too large\n");
+        return send_response_headers(client_fd, 502, "Bad Gateway", NULL, NULL, 0);
+    }
+    
+    // Header und Body in einem Segment, sonst Nagle + Delayed ACK (~40ms)
+    return send_header_body(client_fd, header, header_len, body,
+                            body ? content_length : 0) < 0 ? -1 : 0;
+}
+
+// Sendet eine HTTP-Antwort an den Client
+int send_response(int client_fd, int status_code, const char *status_text,
+                 const char *body, size_t content_length) {
+    return send_response_headers(client_fd, status_code, status_text, NULL,
+                                 body, content_length);
+}
+
+// 200 mit einem grossen Wert (bulk.h): Header, dann die Datei per
+// sendfile(); TLS im Userspace liest sie stueckweise durch den Stack,
+// HTTP/2 in DATA-Frames, soweit die Fenster reichen
+int send_bulk_response(int client_fd, const char *extra_headers, const BulkValue *value) {
+    PROBE3(response__send, client_fd, 200, value->length);
+    last_response_status = 200;
+    last_response_bytes = value->length;
+    
+    if (response_stream) {
+        return http2_respond_file(response_stream, 200, extra_headers, value->fd, value->offset,
+                                  value->length);
+    }
     
-    if (send_all(client_fd, header, header_len) < 0) {
+    char header[512];
+    int header_len = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Length: %zu\r\n"
+        "%s"
+        "Connection: close\r\n"
+        "\r\n",
+        value->length, extra_headers);
+    if (send_all(client_fd, header, header_len, MSG_MORE) < 0) {
         return -1;
     }
     
-    if (body && content_length > 0) {
-        if (send_all(client_fd, body, content_length) < 0) {
+    bool in_kernel = !tls_enabled() || tls_kernel_send(client_fd);
+    off_t offset = value->offset;
+    size_t remaining = value->length;
+    while (remaining > 0) {
+        ssize_t sent;
+        if (in_kernel) {
+            sent = sendfile(client_fd, value->fd, &offset, remaining);
+        } else {
+            char chunk[BUFFER_SIZE];
+            sent = pread(value->fd, chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk),
+                         offset);
+            if (sent > 0 && send_all(client_fd, chunk, sent, 0) < 0) return -1;
+            if (sent > 0) offset += sent;
+        }
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) {
+            if (sent == 0 || errno != EPIPE) perror("Error: sendfile failed");
             return -1;
         }
+        remaining -= sent;
+    }
+    return 0;
+}
+
+// Formatiert den ETag-Header einer Version; kodierte Varianten sind eigene
+// Repraesentationen und bekommen die Kodierung angehaengt ("7-gzip")
+void format_etag_header(char *out, size_t out_size, uint64_t version, ContentEncoding encoding) {
+    if (encoding == ENCODING_IDENTITY) {
+        snprintf(out, out_size, "ETag: \"%llu\"\r\n", (unsigned long long)version);
+    } else {
+        snprintf(out, out_size, "ETag: \"%llu-%s\"\r\n", (unsigned long long)version,
+                 encoding_names[encoding]);
+    }
+}
+
+// Haengt Content-Encoding (ausser bei identity) und Vary an out an
+void append_encoding_headers(char *out, size_t out_size, ContentEncoding encoding) {
+    size_t used = strlen(out);
+    if (encoding == ENCODING_IDENTITY) {
+        snprintf(out + used, out_size - used, "Vary: Accept-Encoding\r\n");
+    } else {
+        snprintf(out + used, out_size - used, "Content-Encoding: %s\r\nVary: Accept-Encoding\r\n",
+                 encoding_names[encoding]);
+    }
+}
+
+// Bevorzugte Kodierung laut Accept-Encoding, identity wenn der Header
+// fehlt oder ohne zlib gebaut wurde
+ContentEncoding request_encoding(const HttpRequest *request) {
+    size_t length;
+    const char *accept = request_header(request, HEADER_ACCEPT_ENCODING, &length);
+    return accept && encoding_available() ? encoding_negotiate(accept, length) : ENCODING_IDENTITY;
+}
+
+// Komprimiert die statischen Ressourcen einmal beim Start
+int init_static_variants(void) {
+    if (!encoding_available()) return 0;
+    for (int i = 0; i < STATIC_RESP_COUNT; i++) {
+        StaticResource *resource = &static_resources[i];
+        for (int encoding = ENCODING_GZIP; encoding < ENCODING_COUNT; encoding++) {
+            size_t length;
+            char *encoded = encoding_compress(encoding, resource->content,
+                                              resource->content_length, 0, &length);
+            if (!encoded) return -1;
+            if (length < resource->content_length) {
+                resource->encoded[encoding] = encoded;
+                resource->encoded_length[encoding] = length;
+            } else {
+                free(encoded);
+            }
+        }
+    }
+    return 0;
+}
+
+// Liefert die kodierte Variante eines Werts; erzeugt wird sie beim ersten
+// Abruf und danach am Blob wiederverwendet. zlib schreibt direkt hinter
+// den Kopf der Variante, der Puffer wird nur noch gekuerzt
+const BlobVariant *value_variant(Blob *content, ContentEncoding encoding) {
+    const BlobVariant *cached = blob_variant(content, encoding);
+    if (cached) return cached;
+    
+    char *scratch = blob_compressed(content) ? malloc(content->length) : NULL;
+    const char *data = blob_contents(content, scratch);
+    size_t length = 0;
+    char *encoded = data ? encoding_compress(encoding, data, content->length,
+                                             sizeof(BlobVariant), &length) : NULL;
+    free(scratch);
+    if (!encoded) return NULL;
+    
+    BlobVariant *variant = realloc(encoded, sizeof(BlobVariant) + length);
+    if (!variant) variant = (BlobVariant *)encoded;
+    variant->length = length;
+    return blob_set_variant(content, encoding, variant);
+}
+
+// Prueft, ob eine Liste von Entity-Tags ("*" oder "\"v1\", \"v2\"") die
+// Version enthaelt; schwache Tags (W/) zaehlen nie als Treffer
+bool etag_list_matches(const char *list, size_t length, uint64_t version) {
+    const char *pos = list;
+    const char *end = list + length;
+    
+    while (pos < end) {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == ',')) pos++;
+        if (pos == end) break;
+        
+        if (*pos == '*') {
+            if (version != 0) return true;
+            pos++;
+            continue;
+        }
+        
+        bool weak = end - pos >= 2 && pos[0] == 'W' && pos[1] == '/';
+        if (weak) pos += 2;
+        if (pos == end || *pos != '"') return false;
+        
+        const char *tag = ++pos;
+        while (pos < end && *pos != '"') pos++;
+        if (pos == end) return false;
+        
+        // Tags kodierter Varianten ("7-gzip") stehen fuer dieselbe Version
+        char *number_end;
+        unsigned long long tag_version = strtoull(tag, &number_end, 10);
+        if (!weak && version != 0 && number_end > tag && (number_end == pos || *number_end == '-') &&
+            tag_version == version) {
+            return true;
+        }
+        pos++;
+    }
+    return false;
+}
+
+// Bedingte Anfragen: If-Match muss die aktuelle Version (0 = fehlt) treffen,
+// If-None-Match darf sie nicht treffen
+bool preconditions_met(const HttpRequest *request, uint64_t current_version) {
+    size_t length;
+    const char *if_match = request_header(request, HEADER_IF_MATCH, &length);
+    if (if_match && !etag_list_matches(if_match, length, current_version)) {
+        return false;
+    }
+    
+    const char *if_none_match = request_header(request, HEADER_IF_NONE_MATCH, &length);
+    if (if_none_match && etag_list_matches(if_none_match, length, current_version)) {
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    int client_fd;
+    size_t bytes;
+} ExportTarget;
+
+int send_export_chunk(void *context, const char *data, size_t length) {
+    ExportTarget *target = context;
+    target->bytes += length;
+    return send_all(target->client_fd, data, length, MSG_MORE) < 0 ? -1 : 0;
+}
+
+// GET /admin/export?prefix=/dynamic/x&format=ndjson: streamt den Store als
+// Archiv; das Ende des Bodys markiert das Schliessen der Verbindung
+int export_store(const HttpRequest *request, int client_fd) {
+    char prefix[sizeof(request->path)] = "/dynamic/";
+    ArchiveFormat format = ARCHIVE_BINARY;
+    
+    const char *query = strchr(request->path, '?');
+    while (query && *query) {
+        const char *param = query + 1;
+        const char *param_end = strchrnul(param, '&');
+        if (strncmp(param, "prefix=", 7) == 0) {
+            snprintf(prefix, sizeof(prefix), "%.*s", (int)(param_end - param - 7), param + 7);
+        } else if (param_end - param == 13 && strncmp(param, "format=ndjson", 13) == 0) {
+            format = ARCHIVE_NDJSON;
+        }
+        query = param_end;
+    }
+    
+    char header[256];
+    int header_len = snprintf(header, sizeof(header),
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: %s\r\n"
+        "Connection: close\r\n"
+        "\r\n",
+        format == ARCHIVE_NDJSON ? "application/x-ndjson" : "application/octet-stream");
+    if (send_all(client_fd, header, header_len, MSG_MORE) < 0) {
+        return -1;
+    }
+    
+    ExportTarget target = {client_fd, 0};
+    long count = archive_export(format, prefix, send_export_chunk, &target);
+    
+    PROBE3(response__send, client_fd, 200, target.bytes);
+    last_response_status = 200;
+    last_response_bytes = target.bytes;
+    printf("Exported %ld entries with prefix '%s'\n", count, prefix);
+    return count < 0 ? -1 : 1;
+}
+
+// Import oder Export, egal mit welcher Methode
+bool is_archive_request(const HttpRequest *request) {
+    const char *path = request->path;
+    return strcmp(path, "/admin/import") == 0 ||
+           (strncmp(path, "/admin/export", 13) == 0 && (path[13] == '\0' || path[13] == '?'));
+}
+
+// Siehe admin_token; der Vergleich dauert unabhaengig vom ersten Unterschied
+bool admin_authorized(const HttpRequest *request, const struct sockaddr_in *client_addr) {
+    if (!admin_token) {
+        return client_addr && (ntohl(client_addr->sin_addr.s_addr) >> 24) == 127;
+    }
+    
+    size_t length;
+    const char *value = request_header(request, HEADER_AUTHORIZATION, &length);
+    size_t token_length = strlen(admin_token);
+    if (!value || length != 7 + token_length || strncasecmp(value, "Bearer ", 7) != 0) {
+        return false;
+    }
+    unsigned char difference = 0;
+    for (size_t i = 0; i < token_length; i++) {
+        difference |= value[7 + i] ^ admin_token[i];
+    }
+    return difference == 0;
+}
+
+bool is_import_request(const HttpRequest *request) {
+    return request->error_status == 0 && strcmp(request->path, "/admin/import") == 0 &&
+           (strcasecmp(request->method, "POST") == 0 || strcasecmp(request->method, "PUT") == 0);
+}
+
+void notify_watchers(void *context, const char *key, size_t key_length);
+
+// POST /admin/import: liest den Body stueckweise aus dem Socket und fuegt die
+// Eintraege gebuendelt in den Store ein. buffer enthaelt total_bytes Bytes ab
+// dem Request-Anfang; danach steht dort nur noch, was dem Body folgt.
+int import_archive(int client_fd, const HttpRequest *request, char *buffer, size_t *total_bytes) {
+    printf("\n=== New Request ===\nMethod: %s\nPath: %s\n", request->method, request->path);
+    PROBE2(request__start, request->method, request->path);
+    
+    ssize_t content_length = request->content_length;
+    size_t consumed = request->headers_length;
+    int result;
+    
+    if (replication_read_only()) {
+        // Der Body wird nicht gelesen, die Verbindung endet mit der Antwort
+        return send_response(client_fd, 403, "Forbidden", "Read-only replica", 17) < 0 ? -1 : 1;
+    } else if (content_length < 0) {
+        result = send_response(client_fd, 411, "Length Required", "Invalid Content-Length", 22);
+    } else {
+        ArchiveReader *reader = archive_reader_new(BUFFER_SIZE, notify_watchers, NULL);
+        if (!reader) return -1;
+        
+        size_t buffered = *total_bytes - consumed;
+        if (buffered > (size_t)content_length) buffered = content_length;
+        archive_reader_feed(reader, buffer + consumed, buffered);
+        consumed += buffered;
+        
+        // Rest des Bodys; ist er nicht komplett im Puffer, ist der Puffer
+        // danach frei. Nach einem Formatfehler wird nur noch verworfen.
+        size_t remaining = content_length - buffered;
+        while (remaining > 0) {
+            ssize_t bytes_read = tls_recv(client_fd, buffer, remaining < BUFFER_SIZE ? remaining : BUFFER_SIZE, 0);
+            if (bytes_read <= 0) {
+                if (bytes_read < 0 && errno == EINTR && !shutdown_requested) continue;
+                archive_reader_finish(reader);
+                return -1;
+            }
+            archive_reader_feed(reader, buffer, bytes_read);
+            remaining -= bytes_read;
+        }
+        
+        ArchiveStats stats = archive_reader_finish(reader);
+        char text[256];
+        int text_len = snprintf(text, sizeof(text), "Imported %zu entries, skipped %zu%s%s\n",
+                                stats.imported, stats.skipped,
+                                stats.error ? ": " : stats.full ? ": store full" : "",
+                                stats.error ? stats.error : "");
+        printf("%s", text);
+        if (stats.error) {
+            result = send_response(client_fd, 400, "Bad Request", text, text_len);
+        } else if (stats.full) {
+            result = send_response(client_fd, 507, "Insufficient Storage", text, text_len);
+        } else {
+            result = send_response(client_fd, 200, "OK", text, text_len);
+        }
     }
     
+    memmove(buffer, buffer + consumed, *total_bytes - consumed);
+    *total_bytes -= consumed;
+    return result;
+}
+
+// Liest "wait=N" aus dem Prefer-Header (RFC 7240), 0 wenn nicht gesetzt
+unsigned preferred_wait(const HttpRequest *request) {
+    size_t length;
+    const char *prefer = request_header(request, HEADER_PREFER, &length);
+    const char *end = prefer + length;
+    
+    for (const char *pos = prefer; prefer && pos < end; pos++) {
+        bool token_start = pos == prefer || pos[-1] == ',' || pos[-1] == ';' || pos[-1] == ' ';
+        if (token_start && end - pos > 5 && strncasecmp(pos, "wait=", 5) == 0) {
+            unsigned long seconds = 0;
+            for (pos += 5; pos < end && *pos >= '0' && *pos <= '9'; pos++) {
+                seconds = seconds * 10 + (*pos - '0');
+                if (seconds > MAX_WAIT_SECONDS) seconds = MAX_WAIT_SECONDS;
+            }
+            return seconds;
+        }
+    }
     return 0;
 }
 
-// Verarbeitet den HTTP-Request
-int process_request(const char *request, int client_fd) {
-    char method[16] = {0};
-    char path[256] = {0};
-    char version[16] = {0};
+// Kopie eines geparkten Requests fuer die spaetere Antwort
+typedef struct {
+    struct sockaddr_in client_addr;
+    uint64_t started_us;
+    size_t headers_length;
+    char request[];
+} ParkedRequest;
+
+// Parkt den Request unter seinem Pfad bis zur naechsten Aenderung oder bis
+// deadline_us; ueber HTTP/2, beim erneuten Beantworten und bei voller
+// Warteliste geht das nicht (0)
+int park_connection(const HttpRequest *request, int client_fd, uint64_t deadline_us) {
+    if (answering_watcher || response_stream) {
+        return 0;
+    }
     
-    printf("\n=== New Request ===\n");
+    char copy[sizeof(ParkedRequest) + BUFFER_SIZE];
+    ParkedRequest *parked = (ParkedRequest *)copy;
+    socklen_t address_length = sizeof(parked->client_addr);
+    if (getpeername(client_fd, (struct sockaddr *)&parked->client_addr, &address_length) < 0) {
+        memset(&parked->client_addr, 0, sizeof(parked->client_addr));
+    }
+    parked->started_us = monotonic_us();
+    parked->headers_length = request->headers_length;
+    memcpy(parked->request, request->data, request->headers_length);
     
-    // Validiere Request-Zeile
-    if (sscanf(request, "%15s %255s %15s", method, path, version) != 3) {
-        printf("Failed to parse request line\n");
-        return send_response(client_fd, 400, "Bad Request", "Invalid Request Format", 21);
+    size_t path_length = strlen(request->path);
+    if (watch_park(request->path, path_length, client_fd, parked,
+                   sizeof(ParkedRequest) + request->headers_length, deadline_us) < 0) {
+        fprintf(stderr, "Error: %d requests already parked\n", WATCH_MAX);
+        return 0;
+    }
+    return REQUEST_PARKED;
+}
+
+// Long-Poll: ein unveraenderter GET mit "Prefer: wait=N" wartet bis zur
+// naechsten Aenderung des Schluessels, hoechstens N Sekunden. Ueber HTTP/2
+// und bei voller Warteliste wird sofort geantwortet (0).
+int park_request(const HttpRequest *request, int client_fd) {
+    unsigned wait = preferred_wait(request);
+    if (wait == 0 || park_connection(request, client_fd, monotonic_us() + wait * 1000000ULL) == 0) {
+        return 0;
+    }
+    printf("Parked request for '%s' for up to %u s\n", request->path, wait);
+    return REQUEST_PARKED;
+}
+
+int process_request(const HttpRequest *request, int client_fd);
+
+// Beantwortet einen geparkten Request nach Aenderung oder Frist neu (siehe
+// WatchCallback); der weckende PUT kann selbst ueber HTTP/2 laufen
+void answer_watcher(void *context, int fd, const void *data, size_t length, bool respond) {
+    (void)context;
+    (void)length;
+    const ParkedRequest *parked = data;
+    
+    if (respond) {
+        Http2Stream *stream = response_stream;
+        int status = last_response_status;
+        size_t bytes = last_response_bytes;
+        response_stream = NULL;
+        answering_watcher = true;
+        
+        HttpRequest request;
+        parse_request(parked->request, parked->headers_length, &request);
+        process_request(&request, fd);
+        if (access_log_enabled()) {
+            access_log_request(&parked->client_addr, request.method, request.path,
+                               last_response_status, parked->headers_length,
+                               last_response_bytes, monotonic_us() - parked->started_us);
+        }
+        
+        answering_watcher = false;
+        response_stream = stream;
+        last_response_status = status;
+        last_response_bytes = bytes;
+    }
+    tls_close(fd);
+    close(fd);
+}
+
+// Aenderungen ueber das binaere Protokoll (kv.h), die Replikation oder
+// einen Import wecken auch HTTP-Long-Polls
+void notify_watchers(void *context, const char *key, size_t key_length) {
+    (void)context;
+    watch_notify(key, key_length, answer_watcher, NULL);
+}
+
+// Version des Keys im Store oder als grosser Wert (bulk.h), 0 wenn es ihn
+// nicht gibt
+uint64_t resource_version(int resource_index, const char *path, size_t path_length) {
+    if (resource_index != -1) return store_version(resource_index);
+    return bulk_enabled() ? bulk_version(path, path_length) : 0;
+}
+
+// PUT auf /dynamic/ mit einem Body, der nicht in den Puffer passt: mit
+// --bulk-dir als Datei speichern (store_bulk), sonst 411
+bool is_bulk_request(const HttpRequest *request) {
+    return bulk_enabled() && request->error_status == 0 &&
+           request->content_length >= BUFFER_SIZE &&
+           strcasecmp(request->method, "PUT") == 0 && strncmp(request->path, "/dynamic/", 9) == 0;
+}
+
+// PUT eines grossen Werts: der Body geht per splice() vom Socket in die
+// Datei, geschrieben wird nur, was schon im Puffer steht. buffer wie bei
+// import_archive(). Abgelehnt wird vor dem Lesen des Bodys, die Verbindung
+// endet dann mit der Antwort.
+int store_bulk(int client_fd, const HttpRequest *request, char *buffer, size_t *total_bytes) {
+    const char *path = request->path;
+    size_t path_length = strlen(path);
+    size_t content_length = request->content_length;
+    printf("\n=== New Request ===\nMethod: %s\nPath: %s\n", request->method, path);
+    printf("PUT request - Content-Length: %zu (bulk)\n", content_length);
+    PROBE2(request__start, request->method, path);
+    
+    if (replication_read_only()) {
+        return send_response(client_fd, 403, "Forbidden", "Read-only replica", 17) < 0 ? -1 : 1;
+    }
+    int resource_index = store_find(path, path_length);
+    uint64_t current_version = resource_version(resource_index, path, path_length);
+    if (!preconditions_met(request, current_version)) {
+        return send_response(client_fd, 412, "Precondition Failed", NULL, 0) < 0 ? -1 : 1;
+    }
+    
+    BulkUpload upload;
+    if (bulk_create(&upload, path, path_length, content_length) < 0) {
+        perror("Error: cannot create bulk value");
+        return send_response(client_fd, 507, "Insufficient Storage", NULL, 0) < 0 ? -1 : 1;
+    }
+    
+    // Der Body passt nie ganz in den Puffer, danach ist der Puffer frei
+    size_t consumed = *total_bytes;
+    int result = bulk_write(&upload, buffer + request->headers_length,
+                            consumed - request->headers_length);
+    
+    // TLS im Userspace entschluesselt in den Puffer
+    while (result == 0 && upload.written < content_length) {
+        ssize_t bytes_read;
+        if (!tls_enabled()) {
+            bytes_read = bulk_splice(&upload, client_fd);
+        } else {
+            size_t remaining = content_length - upload.written;
+            bytes_read = tls_recv(client_fd, buffer, remaining < BUFFER_SIZE ? remaining : BUFFER_SIZE, 0);
+            if (bytes_read > 0 && bulk_write(&upload, buffer, bytes_read) < 0) bytes_read = -1;
+        }
+        if (bytes_read < 0 && errno == EINTR && !shutdown_requested) continue;
+        if (bytes_read <= 0) result = -1;
+    }
+    if (result < 0) {
+        perror("Error: bulk upload failed");
+        bulk_abort(&upload);
+        return -1;
     }
     
-    // Validate HTTP version
-    if (count_headers(request) > MAX_HEADERS) {
-        return send_response(client_fd, 400, "Bad Request", "Too many headers", 15);
+    uint64_t version = store_next_version();
+    if (bulk_commit(&upload, version) < 0) {
+        result = send_response(client_fd, 507, "Insufficient Storage", NULL, 0);
+    } else {
+        // Der Key liegt jetzt nur noch als Datei vor
+        if (resource_index != -1) store_remove(resource_index);
+        printf("Stored %zu bytes for '%s' as file\n", content_length, path);
+        PROBE4(store__put, path, resource_index, content_length, current_version == 0);
+        watch_notify(path, path_length, answer_watcher, NULL);
+        char etag[64];
+        format_etag_header(etag, sizeof(etag), version, ENCODING_IDENTITY);
+        result = current_version == 0 ?
+                 send_response_headers(client_fd, 201, "Created", etag, NULL, 0) :
+                 send_response_headers(client_fd, 204, "No Content", etag, NULL, 0);
+    }
+    *total_bytes = 0;
+    return result;
+}
+
+// GET eines grossen Werts; schliesst value
+int serve_bulk(const HttpRequest *request, int client_fd, BulkValue *value) {
+    char etag[64];
+    format_etag_header(etag, sizeof(etag), value->version, ENCODING_IDENTITY);
+    size_t tags_length;
+    const char *if_none_match = request_header(request, HEADER_IF_NONE_MATCH, &tags_length);
+    int result;
+    if (if_none_match && etag_list_matches(if_none_match, tags_length, value->version)) {
+        bulk_close(value);
+        result = park_request(request, client_fd);
+        return result != 0 ? result :
+               send_response_headers(client_fd, 304, "Not Modified", etag, NULL, 0);
     }
     
-    if (!validate_headers(request)) {
-        return send_response(client_fd, 400, "Bad Request", "Invalid headers", 14);
+    printf("GET request - Serving %zu bytes from file\n", value->length);
+    result = send_bulk_response(client_fd, etag, value);
+    bulk_close(value);
+    return result;
+}
+
+// Antwort aus einem Proxy-Cache-Eintrag; 0, wenn keiner da oder er
+// abgelaufen ist (etag dann mit dessen ETag fuer die Revalidierung)
+int send_cached(const HttpRequest *request, int client_fd, char *etag, size_t etag_size) {
+    const Blob *blob = proxy_cached(request->path);
+    etag[0] = '\0';
+    if (!blob) {
+        return 0;
     }
     
-    printf("Method: %s\nPath: %s\nVersion: %s\n", method, path, version);
+    char *scratch = malloc(blob->length);
+    const char *value = scratch ? blob_contents(blob, scratch) : NULL;
+    ProxyEntry entry;
+    if (!value || proxy_parse_entry(value, blob->length, &entry) < 0) {
+        free(scratch);
+        return 0;
+    }
+    snprintf(etag, etag_size, "%.*s", entry.etag_length < etag_size ? (int)entry.etag_length : 0,
+             entry.etag);
+    if (!proxy_entry_fresh(&entry)) {
+        free(scratch);
+        return 0;
+    }
+    
+    char headers[192] = "";
+    if (etag[0]) {
+        snprintf(headers, sizeof(headers), "ETag: %s\r\n", etag);
+    }
+    size_t tags_length;
+    const char *if_none_match = request_header(request, HEADER_IF_NONE_MATCH, &tags_length);
+    int result;
+    if (etag[0] && if_none_match && memmem(if_none_match, tags_length, etag, strlen(etag))) {
+        result = send_response_headers(client_fd, 304, "Not Modified", headers, NULL, 0);
+    } else {
+        result = send_response_headers(client_fd, 200, "OK", headers, entry.body, entry.body_length);
+    }
+    free(scratch);
+    return result < 0 ? -1 : 1;
+}
+
+// Gibt die Antwort des Upstreams unveraendert weiter
+int send_upstream_response(int client_fd, const HttpResponse *response) {
+    return send_response_headers(client_fd, response->status, response->status_text,
+                                 response->headers, response->body, response->body_length);
+}
+
+// Caching-Reverse-Proxy (proxy.h): Treffer aus dessen Cache, sonst wartet der
+// Request geparkt auf den gemeinsamen Abruf und wird danach neu beantwortet
+int serve_proxied(const HttpRequest *request, int client_fd) {
+    if (strcasecmp(request->method, "GET") != 0) {
+        return send_response(client_fd, 405, "Method Not Allowed", NULL, 0);
+    }
+    
+    char etag[128];
+    int cached = send_cached(request, client_fd, etag, sizeof(etag));
+    if (cached != 0) {
+        return cached < 0 ? -1 : 0;
+    }
+    
+    // Nach dem Abruf: nicht gespeicherte Antworten direkt weitergeben
+    bool failed;
+    const HttpResponse *fetched = proxy_result(request->path, &failed);
+    if (fetched) {
+        return send_upstream_response(client_fd, fetched);
+    }
+    if (failed) {
+        return send_response(client_fd, 502, "Bad Gateway", NULL, 0);
+    }
+    if (answering_watcher) {
+        return send_response(client_fd, 504, "Gateway Timeout", NULL, 0);
+    }
+    
+    uint64_t deadline = monotonic_us() + (PROXY_TIMEOUT_SECONDS + 1) * 1000000ULL;
+    if (!response_stream && proxy_fetch(request->path, etag, strlen(etag)) == 0 &&
+        park_connection(request, client_fd, deadline) == REQUEST_PARKED) {
+        return REQUEST_PARKED;
+    }
+    
+    // Nicht parkbar (HTTP/2, Warteliste voll): selbst abrufen
+    HttpResponse response;
+    if (proxy_fetch_now(request->path, etag, strlen(etag), &response) < 0) {
+        return send_response(client_fd, 502, "Bad Gateway", NULL, 0);
+    }
+    cached = send_cached(request, client_fd, etag, sizeof(etag));
+    int result = cached != 0 ? (cached < 0 ? -1 : 0) : send_upstream_response(client_fd, &response);
+    http_response_free(&response);
+    return result;
+}
+
+// Leitet einen Request an den Eigentuemer des Keys weiter und gibt dessen
+// Antwort zurueck. Prefer entfaellt: ein Long-Poll wuerde die gepoolte
+// Verbindung und diesen Knoten bis zur Frist blockieren. Die Weiterleitung
+// ist synchron: bis die Antwort da ist (hoechstens CLUSTER_TIMEOUT_SECONDS),
+// bedient dieser Knoten nichts anderes. Leiten zwei Knoten gleichzeitig
+// aneinander weiter, warten beide bis zur Frist und antworten mit 502;
+// deshalb nur mit --cluster-forward, sonst wird umgeleitet.
+int forward_request(const HttpRequest *request, int client_fd, int owner) {
+    const char *self = cluster_node_name(cluster_self());
+    size_t body_length = request->content_length > 0 ? request->content_length : 0;
+    size_t capacity = request->headers_length + body_length + strlen(self) + 48;
+    char *out = malloc(capacity);
+    if (!out) {
+        return send_response(client_fd, 500, "Internal Server Error", NULL, 0);
+    }
+    
+    // Der Eigentuemer spricht HTTP/1.1, auch fuer Requests ueber HTTP/2
+    const char *end = request->data + request->headers_length - 2;
+    const char *first_line_end = memmem(request->data, end - request->data, "\r\n", 2);
+    size_t length = snprintf(out, capacity, "%s %s HTTP/1.1\r\n", request->method, request->path);
+    for (const char *line = first_line_end ? first_line_end + 2 : end; line < end;) {
+        const char *line_end = memmem(line, end - line, "\r\n", 2);
+        line_end = line_end ? line_end + 2 : end;
+        if (strncasecmp(line, "prefer:", 7) != 0) {
+            memcpy(out + length, line, line_end - line);
+            length += line_end - line;
+        }
+        line = line_end;
+    }
+    length += snprintf(out + length, capacity - length, CLUSTER_FORWARDED_HEADER ": %s\r\n\r\n",
+                       self);
+    memcpy(out + length, request->data + request->headers_length, body_length);
+    length += body_length;
+    
+    printf("Forwarding %s to cluster node %s\n", request->path, cluster_node_name(owner));
+    HttpResponse response;
+    int result = cluster_forward(owner, out, length, &response);
+    free(out);
+    if (result < 0) {
+        return send_response(client_fd, 502, "Bad Gateway", NULL, 0);
+    }
+    result = send_response_headers(client_fd, response.status, response.status_text,
+                                   response.headers, response.body, response.body_length);
+    http_response_free(&response);
+    return result;
+}
+
+// 307 behaelt Methode und Body bei, auch fuer PUT und DELETE
+int redirect_request(const HttpRequest *request, int client_fd, int owner) {
+    char location[512];
+    snprintf(location, sizeof(location), "Location: %s://%s%s\r\n",
+             tls_enabled() ? "https" : "http", cluster_node_name(owner), request->path);
+    return send_response_headers(client_fd, 307, "Temporary Redirect", location, NULL, 0);
+}
+
+// Verarbeitet den HTTP-Request
+int process_request(const HttpRequest *request, int client_fd) {
+    const char *method = request->method;
+    const char *path = request->path;
+    
+    printf("\n=== New Request ===\n");
+    
+    // Fehler aus Request-Zeile oder Headern (siehe parse_request)
+    if (request->error_status != 0) {
+        printf("Rejecting request: %s\n", request->error_text);
+        return send_response(client_fd, request->error_status,
+                             request->error_status == 403 ? "Forbidden" : "Bad Request",
+                             request->error_text, strlen(request->error_text));
+    }
+    
+    printf("Method: %s\nPath: %s\nVersion: %s\n", method, path, request->version);
+    
+    PROBE2(request__start, method, path);
+    
+    // POST/PUT auf /admin/import verarbeitet import_archive()
+    if (strcmp(path, "/admin/import") == 0) {
+        return send_response(client_fd, 405, "Method Not Allowed", NULL, 0);
+    }
+    if (strcmp(path, "/admin/stats") == 0) {
+        if (strcasecmp(method, "GET") != 0) {
+            return send_response(client_fd, 405, "Method Not Allowed", NULL, 0);
+        }
+        char stats[4096];
+        int length = accounting_format(stats, sizeof(stats));
+        if (length >= 0 && (size_t)length < sizeof(stats)) {
+            int collections = store_format_collections(stats + length, sizeof(stats) - length);
+            length = collections < 0 ? -1 : length + collections;
+        }
+        if (length >= 0 && (size_t)length < sizeof(stats)) {
+            size_t blob_count, blob_bytes, stored_bytes, variant_bytes;
+            blob_stats(&blob_count, &blob_bytes, &stored_bytes, &variant_bytes);
+            length += snprintf(stats + length, sizeof(stats) - length,
+                               "values %zu\nvalue_bytes %zu\nstored_bytes %zu\nvariant_bytes %zu\n",
+                               blob_count, blob_bytes, stored_bytes, variant_bytes);
+        }
+        if (length < 0 || (size_t)length >= sizeof(stats)) {
+            return send_response(client_fd, 500, "Internal Server Error", NULL, 0);
+        }
+        return send_response_headers(client_fd, 200, "OK", "Content-Type: text/plain\r\n",
+                                     stats, length);
+    }
+    if (strncmp(path, "/admin/export", 13) == 0 && (path[13] == '\0' || path[13] == '?')) {
+        if (strcasecmp(method, "GET") != 0) {
+            return send_response(client_fd, 405, "Method Not Allowed", NULL, 0);
+        }
+        return export_store(request, client_fd);
+    }
     
     if (strcasecmp(method, "HEAD") == 0) {
         return send_response(client_fd, 501, "Not Implemented", NULL, 0);
     }
     
+    if (proxy_enabled() && proxy_matches(path)) {
+        return serve_proxied(request, client_fd);
+    }
+    
     // Handle statische Ressourcen
     if (strncmp(path, "/static/", 8) == 0) {
         if (strcasecmp(method, "GET") != 0) {
@@ -173,11 +1160,29 @@ int process_request(const char *request, int client_fd) {
         }
         
         for (int i = 0; i < STATIC_RESP_COUNT; i++) {
-            if (strcmp(path, static_resources[i].path) == 0) {
-                return send_response(client_fd, 200, "OK",
-                                  static_resources[i].content,
-                                  static_resources[i].content_length);
+            const StaticResource *resource = &static_resources[i];
+            if (strcmp(path, resource->path) != 0) continue;
+            
+            // Nur Ressourcen mit kleinerer Variante variieren ueberhaupt
+            bool varies = false;
+            for (int encoding = ENCODING_GZIP; encoding < ENCODING_COUNT; encoding++) {
+                varies = varies || resource->encoded[encoding];
             }
+            if (!varies) {
+                return send_response(client_fd, 200, "OK", resource->content,
+                                     resource->content_length);
+            }
+            
+            ContentEncoding encoding = request_encoding(request);
+            if (!resource->encoded[encoding]) encoding = ENCODING_IDENTITY;
+            char headers[128] = "";
+            append_encoding_headers(headers, sizeof(headers), encoding);
+            if (encoding == ENCODING_IDENTITY) {
+                return send_response_headers(client_fd, 200, "OK", headers, resource->content,
+                                             resource->content_length);
+            }
+            return send_response_headers(client_fd, 200, "OK", headers, resource->encoded[encoding],
+                                         resource->encoded_length[encoding]);
         }
         
         return send_response(client_fd, 404, "Not Found", NULL, 0);
@@ -186,29 +1191,32 @@ int process_request(const char *request, int client_fd) {
     // Handle dynamische Ressourcen
     if (strncmp(path, "/dynamic/", 9) == 0) {
         printf("\nDynamic resource handle for path: '%s'\n", path);
-        int resource_index = -1;
-        int available_slot = -1;
-        
-        for (int i = 0; i < DYNAMIC_RESOURCES_COUNT; i++) {
-            if (dynamic_resources[i].in_use) {
-                if (strcmp(dynamic_resources[i].path, path) == 0) {
-                    resource_index = i;
-                    printf("Found existing resource at index %d\n", i);
-                    break;
-                }
-            } else if (available_slot == -1) {
-                available_slot = i;
+        size_t path_length = strlen(path);
+        
+        // Im Cluster bedient nur der Eigentuemer; schon weitergeleitete
+        // Requests nie erneut, auch wenn die Peer-Listen voneinander abweichen
+        if (cluster_enabled() && !request_header(request, HEADER_CLUSTER_FORWARDED, NULL)) {
+            int owner = cluster_owner(path, path_length);
+            if (owner != cluster_self()) {
+                return cluster_redirect ? redirect_request(request, client_fd, owner) :
+                                          forward_request(request, client_fd, owner);
             }
         }
         
+        int resource_index = store_find(path, path_length);
+        if (resource_index != -1) {
+            printf("Found existing resource at index %d\n", resource_index);
+        }
+        
+        // Follower spiegeln nur den Primary (replication.h)
+        bool writes = strcasecmp(method, "PUT") == 0 || strcasecmp(method, "DELETE") == 0;
+        if (writes && replication_read_only()) {
+            return send_response(client_fd, 403, "Forbidden", "Read-only replica", 17);
+        }
+        
         if (strcasecmp(method, "PUT") == 0) {
-            const char *headers_end = strstr(request, "\r\n\r\n");
-            if (!headers_end) {
-                return send_response(client_fd, 400, "Bad Request", "Missing headers", 14);
-            }
-            
-            const char *body = headers_end + 4;
-            ssize_t content_length = get_content_length(request);
+            const char *body = request->data + request->headers_length;
+            ssize_t content_length = request->content_length;
             printf("PUT request - Content-Length: %zd\n", content_length);
             
             if (content_length < 0 || content_length >= BUFFER_SIZE) {
@@ -216,51 +1224,136 @@ int process_request(const char *request, int client_fd) {
                                   "Invalid Content-Length", 20);
             }
             
+            // Compare-and-swap: Pruefen und Schreiben ohne Unterbrechung
+            uint64_t current_version = resource_version(resource_index, path, path_length);
+            if (!preconditions_met(request, current_version)) {
+                return send_response(client_fd, 412, "Precondition Failed", NULL, 0);
+            }
+            
+            // Gleicher Inhalt wie ein vorhandener Wert: nur Referenz erhoehen
+            Blob *content;
+            if (request->received_body && *request->received_body) {
+                content = blob_commit(*request->received_body);
+                *request->received_body = NULL;
+            } else {
+                content = blob_intern(body, content_length);
+            }
+            if (!content) {
+                return send_response(client_fd, 507, "Insufficient Storage", NULL, 0);
+            }
+            
+            size_t blob_count, blob_bytes, stored_bytes, variant_bytes;
+            blob_stats(&blob_count, &blob_bytes, &stored_bytes, &variant_bytes);
+            printf("Store holds %zu distinct values, %zu bytes (%zu stored)\n",
+                   blob_count, blob_bytes, stored_bytes);
+            
+            char etag[64];
             if (resource_index != -1) {
-                memset(dynamic_resources[resource_index].content, 0, BUFFER_SIZE);
-                memcpy(dynamic_resources[resource_index].content, body, content_length);
-                dynamic_resources[resource_index].content_length = content_length;
+                resource_index = store_replace(resource_index, content);
+                if (resource_index < 0) {
+                    blob_release(content);
+                    PROBE1(store__full, path);
+                    return send_response(client_fd, 507, "Insufficient Storage", NULL, 0);
+                }
                 printf("Updated resource %d with %zd bytes\n", resource_index, content_length);
-                return send_response(client_fd, 204, "No Content", NULL, 0);
-            } else if (available_slot != -1) {
-                dynamic_resources[available_slot].in_use = true;
-                strncpy(dynamic_resources[available_slot].path, path,
-                        sizeof(dynamic_resources[available_slot].path) - 1);
-                dynamic_resources[available_slot].path[sizeof(dynamic_resources[available_slot].path) - 1] = '\0';
-                memset(dynamic_resources[available_slot].content, 0, BUFFER_SIZE);
-                memcpy(dynamic_resources[available_slot].content, body, content_length);
-                dynamic_resources[available_slot].content_length = content_length;
-                printf("Created resource at slot %d with path '%s', content length %zd\n",
-                       available_slot, dynamic_resources[available_slot].path, content_length);
-                return send_response(client_fd, 201, "Created", NULL, 0);
-            } else {
+                watch_notify(path, path_length, answer_watcher, NULL);
+                PROBE4(store__put, path, resource_index, content_length, 0);
+                format_etag_header(etag, sizeof(etag), store_version(resource_index), ENCODING_IDENTITY);
+                return send_response_headers(client_fd, 204, "No Content", etag, NULL, 0);
+            }
+            
+            resource_index = store_insert(path, path_length, content);
+            if (resource_index == -1) {
+                blob_release(content);
+                PROBE1(store__full, path);
                 return send_response(client_fd, 507, "Insufficient Storage", NULL, 0);
             }
+            printf("Created resource at slot %d with path '%s', content length %zd\n",
+                   resource_index, path, content_length);
+            // Ersetzt einen grossen Wert (bulk.h), der Key liegt jetzt im Store
+            bool created = current_version == 0 || !bulk_remove(path, path_length);
+            PROBE4(store__put, path, resource_index, content_length, created);
+            watch_notify(path, path_length, answer_watcher, NULL);
+            format_etag_header(etag, sizeof(etag), store_version(resource_index), ENCODING_IDENTITY);
+            if (!created) {
+                return send_response_headers(client_fd, 204, "No Content", etag, NULL, 0);
+            }
+            return send_response_headers(client_fd, 201, "Created", etag, NULL, 0);
         }
         
         if (strcasecmp(method, "GET") == 0) {
-            if (resource_index != -1) {
-                size_t content_length = dynamic_resources[resource_index].content_length;
+            Blob *content = resource_index != -1 ? store_value(resource_index) : NULL;
+            PROBE3(store__get, path, resource_index, content ? content->length : 0);
+            if (content) {
+                // Unveraendert seit dem ETag des Clients: 304 oder Long-Poll
+                size_t tags_length;
+                const char *if_none_match = request_header(request, HEADER_IF_NONE_MATCH, &tags_length);
+                if (if_none_match &&
+                    etag_list_matches(if_none_match, tags_length, store_version(resource_index))) {
+                    int parked = park_request(request, client_fd);
+                    if (parked != 0) return parked;
+                }
+                
+                // Kodierte Variante nur, wenn sie wirklich kleiner ist; auch
+                // ein 304 nennt den ETag der Repraesentation, die 200 liefern wuerde
+                ContentEncoding encoding = request_encoding(request);
+                const BlobVariant *variant = encoding != ENCODING_IDENTITY ?
+                                             value_variant(content, encoding) : NULL;
+                if (!variant || variant->length >= content->length) encoding = ENCODING_IDENTITY;
+                
+                char headers[160];
+                format_etag_header(headers, sizeof(headers), store_version(resource_index), encoding);
+                if (if_none_match &&
+                    etag_list_matches(if_none_match, tags_length, store_version(resource_index))) {
+                    append_encoding_headers(headers, sizeof(headers), ENCODING_IDENTITY);
+                    return send_response_headers(client_fd, 304, "Not Modified", headers, NULL, 0);
+                }
                 printf("GET request - Serving content from resource %d, length: %zu\n",
-                       resource_index, content_length);
-                return send_response(client_fd, 200, "OK",
-                                  dynamic_resources[resource_index].content,
-                                  content_length);
-            } else {
-                printf("Resource not found for path: '%s'\n", path);
-                return send_response(client_fd, 404, "Not Found", NULL, 0);
+                       resource_index, content->length);
+                append_encoding_headers(headers, sizeof(headers), encoding);
+                if (encoding != ENCODING_IDENTITY) {
+                    return send_response_headers(client_fd, 200, "OK", headers,
+                                                 variant->data, variant->length);
+                }
+                
+                // Komprimierte Werte auf dem Stack entpacken; aus der kalten
+                // Stufe koennen auch groessere kommen
+                char plain[BUFFER_SIZE];
+                char *scratch = content->length <= sizeof(plain) ? plain : malloc(content->length);
+                const char *data = blob_contents(content, scratch);
+                int result = data ? send_response_headers(client_fd, 200, "OK", headers,
+                                                          data, content->length) :
+                                    send_response(client_fd, 500, "Internal Server Error", NULL, 0);
+                if (scratch != plain) free(scratch);
+                return result;
+            }
+            
+            BulkValue value;
+            int found = bulk_enabled() ? bulk_get(path, path_length, &value) : 0;
+            if (found > 0) {
+                return serve_bulk(request, client_fd, &value);
+            }
+            if (found < 0) {
+                perror("Error: cannot read bulk value");
+                return send_response(client_fd, 500, "Internal Server Error", NULL, 0);
             }
+            printf("Resource not found for path: '%s'\n", path);
+            return send_response(client_fd, 404, "Not Found", NULL, 0);
         }
         
         if (strcasecmp(method, "DELETE") == 0) {
+            PROBE2(store__delete, path, resource_index);
+            uint64_t current_version = resource_version(resource_index, path, path_length);
+            if (!preconditions_met(request, current_version)) {
+                return send_response(client_fd, 412, "Precondition Failed", NULL, 0);
+            }
             if (resource_index != -1) {
-                dynamic_resources[resource_index].in_use = false;
-                memset(dynamic_resources[resource_index].content, 0, BUFFER_SIZE);
-                dynamic_resources[resource_index].content_length = 0;
-                return send_response(client_fd, 204, "No Content", NULL, 0);
-            } else {
+                store_remove(resource_index);
+            } else if (current_version == 0 || !bulk_remove(path, path_length)) {
                 return send_response(client_fd, 404, "Not Found", NULL, 0);
             }
+            watch_notify(path, path_length, answer_watcher, NULL);
+            return send_response(client_fd, 204, "No Content", NULL, 0);
         }
         
         return send_response(client_fd, 405, "Method Not Allowed", NULL, 0);
@@ -269,17 +1362,168 @@ int process_request(const char *request, int client_fd) {
     return send_response(client_fd, 404, "Not Found", NULL, 0);
 }
 
-int handle_client(int client_fd) {
-    char buffer[BUFFER_SIZE] = {0};
+// Bearbeitet einen Stream wie einen HTTP/1.1-Request (siehe http2.h)
+int handle_http2_request(void *context, Http2Stream *stream, const char *data,
+                         size_t headers_length, size_t length) {
+    (void)context;
+    int client_fd = http2_stream_fd(stream);
+    HttpRequest request;
+    parse_request(data, headers_length, &request);
+    account(ACCOUNT_REQUESTS);
+    PROBE2(request__receive, client_fd, length);
+    capture_request(data, length);
+    
+    uint64_t started_us = access_log_enabled() ? monotonic_us() : 0;
+    response_stream = stream;
+    int result;
+    bool export = strncmp(request.path, "/admin/export", 13) == 0 &&
+                  (request.path[13] == '\0' || request.path[13] == '?');
+    if (export || is_import_request(&request)) {
+        // Export und Import streamen direkt ueber den Socket
+        printf("\n=== New Request ===\nRejecting %s over HTTP/2\n", request.path);
+        result = send_response(client_fd, 501, "Not Implemented",
+                               "Use HTTP/1.1 for import and export", 34);
+    } else {
+        result = process_request(&request, client_fd);
+    }
+    response_stream = NULL;
+    
+    if (access_log_enabled()) {
+        // Die Verbindung kann zwischendurch geruht haben, die Adresse
+        // kommt deshalb vom Socket
+        struct sockaddr_in client_addr = {0};
+        socklen_t address_length = sizeof(client_addr);
+        getpeername(client_fd, (struct sockaddr *)&client_addr, &address_length);
+        access_log_request(&client_addr, request.method, request.path,
+                           last_response_status, length, last_response_bytes,
+                           monotonic_us() - started_us);
+    }
+    return result;
+}
+
+Http2Server http2_server = {
+    .handler = handle_http2_request,
+    .max_request_length = BUFFER_SIZE,
+    .stop = &shutdown_requested,
+};
+
+// h2c per Upgrade: nur Requests ohne gestreamten Body, die neben
+// "Upgrade: h2c" auch HTTP2-Settings mitschicken (RFC 7540, 3.2)
+bool is_http2_upgrade(const HttpRequest *request) {
+    size_t upgrade_length, settings_length;
+    const char *upgrade = request_header(request, HEADER_UPGRADE, &upgrade_length);
+    if (request->error_status != 0 || !upgrade ||
+        !request_header(request, HEADER_HTTP2_SETTINGS, &settings_length)) {
+        return false;
+    }
+    for (const char *token = upgrade; token < upgrade + upgrade_length;) {
+        const char *token_end = memchr(token, ',', upgrade + upgrade_length - token);
+        if (!token_end) token_end = upgrade + upgrade_length;
+        while (token < token_end && *token == ' ') token++;
+        const char *trimmed = token_end;
+        while (trimmed > token && trimmed[-1] == ' ') trimmed--;
+        if (trimmed - token == 3 && strncasecmp(token, "h2c", 3) == 0) return true;
+        token = token_end + 1;
+    }
+    return false;
+}
+
+// HTTP2_SUSPENDED als Rueckgabe von handle_client()
+int http2_result(int result) {
+    return result == HTTP2_SUSPENDED ? CONNECTION_IDLE_HTTP2 : result;
+}
+
+// Wechselt nach einem Upgrade-Request auf HTTP/2; buffer enthaelt ab dem
+// Request total_bytes Bytes, danach folgt das Client-Preface
+int upgrade_to_http2(int client_fd, const HttpRequest *request, const char *buffer,
+                     size_t total_bytes) {
+    static const char switching[] =
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Connection: Upgrade\r\n"
+        "Upgrade: h2c\r\n"
+        "\r\n";
+    if (send_all(client_fd, switching, sizeof(switching) - 1, MSG_MORE) < 0) {
+        return -1;
+    }
+    
+    size_t request_length = request->headers_length +
+                            (request->content_length > 0 ? request->content_length : 0);
+    Http2Upgrade upgrade = {
+        .request = buffer,
+        .headers_length = request->headers_length,
+        .length = request_length,
+    };
+    upgrade.settings = request_header(request, HEADER_HTTP2_SETTINGS, &upgrade.settings_length);
+    
+    return http2_result(http2_serve(&http2_server, client_fd, buffer + request_length,
+                                    total_bytes - request_length, &upgrade));
+}
+
+// PUT-Bodies, die beim Parsen der Header noch nicht ganz angekommen sind,
+// gehen ohne Umweg ueber den Verbindungspuffer in den Wertspeicher.
+// Mitschnitt, Cluster-Weiterleitung und HTTP/2-Upgrade brauchen den
+// Request am Stueck
+bool receives_body_directly(const HttpRequest *request, size_t buffered) {
+    return request->error_status == 0 && request->content_length > 0 &&
+           request->content_length < BUFFER_SIZE &&
+           buffered < request->headers_length + request->content_length &&
+           strcasecmp(request->method, "PUT") == 0 && strncmp(request->path, "/dynamic/", 9) == 0 &&
+           !is_http2_upgrade(request) && !capture_enabled() && !cluster_enabled();
+}
+
+// Reserviert den Wert, uebernimmt die schon gepufferten Body-Bytes und
+// empfaengt den Rest direkt hinein; *total_bytes behaelt nur die Header.
+// -1 bei Verbindungsende oder -fehler. Ist kein Speicher frei, bleibt
+// *reserved NULL und der Body wird wie bisher gepuffert
+int receive_body(int client_fd, const HttpRequest *request, size_t *total_bytes, Blob **reserved) {
+    size_t length = request->content_length;
+    *reserved = blob_reserve(length);
+    if (!*reserved) return 0;
+    
+    size_t received = *total_bytes - request->headers_length;
+    memcpy((*reserved)->data, request->data + request->headers_length, received);
+    *total_bytes = request->headers_length;
+    while (received < length) {
+        // Nur bis zum Ende des Bodys, ein folgender Request landet im Puffer
+        ssize_t bytes_read = tls_recv(client_fd, (*reserved)->data + received, length - received, 0);
+        if (bytes_read <= 0) {
+            if (bytes_read < 0 && errno == EINTR && !shutdown_requested) continue;
+            if (bytes_read < 0) perror("Error: recv failed");
+            blob_cancel(*reserved);
+            *reserved = NULL;
+            return -1;
+        }
+        received += bytes_read;
+    }
+    return 0;
+}
+
+// Liest Requests in buffer (BUFFER_SIZE Bytes) und beantwortet sie
+int handle_connection(int client_fd, const struct sockaddr_in *client_addr, char *buffer) {
     size_t total_bytes = 0;
+    unsigned long requests = 0;
+    HttpRequest request;
+    bool headers_parsed = false;
+    
+    PROBE1(conn__start, client_fd);
     
     while (1) {
-        ssize_t bytes_read = recv(client_fd, buffer + total_bytes, 
-                                sizeof(buffer) - total_bytes - 1, 0);
+        // Ohne angefangenen Request wartet die Verbindung statt im recv()
+        // im poll() der Hauptschleife; der Server bedient solange andere.
+        // Das nicht blockierende recv() ersetzt ein eigenes poll()
+        bool may_idle = total_bytes == 0 && !headers_parsed && !watch_idle_full();
+        ssize_t bytes_read = tls_recv(client_fd, buffer + total_bytes,
+                                      BUFFER_SIZE - total_bytes - 1, may_idle ? MSG_DONTWAIT : 0);
         
         if (bytes_read <= 0) {
+            if (bytes_read < 0 && may_idle && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                PROBE2(conn__done, client_fd, requests);
+                return CONNECTION_IDLE;
+            }
             if (bytes_read < 0) {
+                if (errno == EINTR && !shutdown_requested) continue;
                 perror("Error: recv failed");
+                PROBE2(conn__done, client_fd, requests);
                 return -1;
             }
             break;
@@ -288,63 +1532,216 @@ int handle_client(int client_fd) {
         total_bytes += bytes_read;
         buffer[total_bytes] = '\0';
         
+        // HTTP/2 mit Prior Knowledge beginnt mit dem Client-Preface
+        if (requests == 0 && !headers_parsed &&
+            memcmp(buffer, HTTP2_PREFACE, total_bytes < HTTP2_PREFACE_LENGTH ?
+                                          total_bytes : HTTP2_PREFACE_LENGTH) == 0) {
+            if (total_bytes < HTTP2_PREFACE_LENGTH) continue;
+            int result = http2_serve(&http2_server, client_fd, buffer, total_bytes, NULL);
+            PROBE2(conn__done, client_fd, requests);
+            return http2_result(result);
+        }
+        
         while (1) {
-            char *headers_end = strstr(buffer, "\r\n\r\n");
-            if (!headers_end) {
-                break;
+            // Header nur einmal pro Request parsen, auch wenn der Body
+            // in mehreren recv()-Aufrufen ankommt
+            if (!headers_parsed) {
+                char *headers_end = strstr(buffer, "\r\n\r\n");
+                if (!headers_end) {
+                    break;
+                }
+                parse_request(buffer, headers_end - buffer + 4, &request);
+                headers_parsed = true;
+                // Vor der Entscheidung ueber den Body: ein abgelehnter Import
+                // wird nicht gestreamt, sondern verworfen
+                if (is_archive_request(&request) && !admin_authorized(&request, client_addr)) {
+                    reject_request(&request, 403, admin_token ? "Admin token required" :
+                                                  "Admin access only from localhost");
+                }
             }
             
-            size_t headers_length = headers_end - buffer + 4;
-            ssize_t content_length = get_content_length(buffer);
-            
+            ssize_t content_length = request.content_length;
             if (content_length < 0) {
                 content_length = 0;
             }
             
-            size_t total_request_length = headers_length + content_length;
-            if (total_bytes < total_request_length) {
+            // Archiv-Import und grosse Werte: der Body kann groesser als der
+            // Puffer sein und wird beim Lesen verarbeitet
+            bool bulk = is_bulk_request(&request);
+            bool streamed = bulk || is_import_request(&request);
+            size_t total_request_length = request.headers_length + content_length;
+            Blob *received_body = NULL;
+            if (receives_body_directly(&request, total_bytes)) {
+                if (receive_body(client_fd, &request, &total_bytes, &received_body) < 0) {
+                    PROBE2(conn__done, client_fd, requests);
+                    return -1;
+                }
+                request.received_body = &received_body;
+            }
+            
+            // Ist das Ende des Bodys unbekannt oder passt er nicht in den
+            // Puffer, endet die Verbindung mit der Antwort; sonst wuerde er
+            // als naechster Request gelesen
+            bool closing = request.body_unknown ||
+                           (!streamed && !received_body && total_request_length >= BUFFER_SIZE);
+            if (closing) {
+                // Bodys ab BUFFER_SIZE lehnt PUT selbst ab (411), kleinere
+                // haetten direkt empfangen werden muessen
+                if (request.content_length < BUFFER_SIZE) {
+                    reject_request(&request, 400, "Request too large");
+                }
+                total_request_length = request.headers_length;
+            }
+            size_t buffered_length = received_body ? request.headers_length : total_request_length;
+            if (!streamed && total_bytes < buffered_length) {
                 break;
             }
             
-            buffer[total_request_length] = '\0';
+            requests++;
+            // Den Upgrade-Request zaehlt handle_http2_request als Stream 1
+            if (!streamed && is_http2_upgrade(&request)) {
+                int result = upgrade_to_http2(client_fd, &request, buffer, total_bytes);
+                PROBE2(conn__done, client_fd, requests);
+                return result;
+            }
+            account(ACCOUNT_REQUESTS);
+            PROBE2(request__receive, client_fd, total_request_length);
+            if (!streamed && !received_body) {
+                capture_request(buffer, total_request_length);
+            }
             
-            int process_result = process_request(buffer, client_fd);
+            uint64_t started_us = access_log_enabled() ? monotonic_us() : 0;
+            int process_result = bulk ? store_bulk(client_fd, &request, buffer, &total_bytes) :
+                                 streamed ?
+                                 import_archive(client_fd, &request, buffer, &total_bytes) :
+                                 process_request(&request, client_fd);
+            headers_parsed = false;
+            // Abgelehnte PUTs (412, 403, ...) uebernehmen den Body nicht
+            blob_cancel(received_body);
+            if (process_result == REQUEST_PARKED) {
+                // Antwort und Access-Log kommen aus answer_watcher()
+                PROBE2(conn__done, client_fd, requests);
+                return REQUEST_PARKED;
+            }
+            if (access_log_enabled()) {
+                access_log_request(client_addr, request.method, request.path,
+                                   last_response_status, total_request_length,
+                                   last_response_bytes, monotonic_us() - started_us);
+            }
             if (process_result < 0) {
                 fprintf(stderr, "Error: request processing failed\n");
+                PROBE2(conn__done, client_fd, requests);
                 return -1;
             }
+            if (process_result > 0 || closing) {
+                // Antwort ohne Content-Length endet mit der Verbindung
+                PROBE2(conn__done, client_fd, requests);
+                return 0;
+            }
             
-            size_t remaining = total_bytes - total_request_length;
-            memmove(buffer, buffer + total_request_length, remaining);
-            total_bytes = remaining;
+            if (!streamed) {
+                size_t remaining = total_bytes - buffered_length;
+                memmove(buffer, buffer + buffered_length, remaining);
+                total_bytes = remaining;
+            }
             buffer[total_bytes] = '\0';
         }
     }
     
+    PROBE2(conn__done, client_fd, requests);
     return 0;
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        fprintf(stderr, "Usage: %s <IP> <Port>\n", argv[0]);
-        return EXIT_FAILURE;
+// Verbindungspuffer kommen aus einem vorab angelegten Pool; mit TLS laeuft
+// der Handshake vorher (nicht mehr, wenn eine ruhende Verbindung fortgesetzt
+// wird), danach lesen und schreiben alle Pfade ueber tls_*()
+int handle_client(int client_fd, const struct sockaddr_in *client_addr, bool resumed) {
+    if (!resumed && tls_enabled() && tls_accept(client_fd) < 0) {
+        return -1;
+    }
+    
+    char *buffer = buffer_pool_acquire();
+    if (!buffer) {
+        fprintf(stderr, "Error: no free connection buffer\n");
+        return -1;
     }
     
-    const char *ip = argv[1];
-    int port = atoi(argv[2]);
+    int result = handle_connection(client_fd, client_addr, buffer);
+    buffer_pool_release(buffer);
+    return result;
+}
+
+// Schliesst eine ruhende Verbindung samt dem Zustand ihres Protokolls
+void close_idle(int client_fd, int kind) {
+    if (kind == CONNECTION_IDLE_HTTP2) {
+        http2_drop(client_fd);
+    } else if (kind == CONNECTION_IDLE_KV) {
+        kv_drop(client_fd);
+    }
+    tls_close(client_fd);
+    close(client_fd);
+}
+
+// Schliesst die Verbindung nach handle_client(), ausser sie ist geparkt
+// oder ruht bis zum naechsten Request; ist die Liste der ruhenden voll,
+// wird eine HTTP/2- oder KV-Verbindung geschlossen
+void finish_client(int client_fd, int result) {
+    if (result < 0) {
+        fprintf(stderr, "Error handling client\n");
+    }
+    if (result >= CONNECTION_IDLE) {
+        uint64_t deadline_us = monotonic_us() + CONNECTION_IDLE_SECONDS * 1000000ULL;
+        if (watch_idle(client_fd, result, deadline_us) < 0) {
+            close_idle(client_fd, result);
+        }
+        return;
+    }
+    if (result != REQUEST_PARKED) {
+        tls_close(client_fd);
+        close(client_fd);
+    }
+}
+
+// Setzt eine lesbar gewordene ruhende Verbindung fort
+int resume_client(const WatchIdle *idle) {
+    if (idle->kind == CONNECTION_IDLE_HTTP2) {
+        return http2_result(http2_resume(idle->fd));
+    }
+    if (idle->kind == CONNECTION_IDLE_KV) {
+        int result = kv_resume(idle->fd);
+        return result == KV_SUSPENDED ? CONNECTION_IDLE_KV : result;
+    }
+    struct sockaddr_in peer_addr = {0};
+    socklen_t peer_len = sizeof(peer_addr);
+    getpeername(idle->fd, (struct sockaddr *)&peer_addr, &peer_len);
+    return handle_client(idle->fd, &peer_addr, true);
+}
+
+KvServer kv_server = {
+    .changed = notify_watchers,
+    .max_value_length = BUFFER_SIZE - 1,
+    .stop = &shutdown_requested,
+};
+
+// Bindet einen TCP-Listener an ip:port; -1 bei Fehler
+int open_listener(const char *ip, int port) {
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
     
     if (server_fd < 0) {
         perror("Error: socket creation failed");
-        return EXIT_FAILURE;
+        return -1;
     }
     
     int opt = 1;
     if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         perror("setsockopt failed");
         close(server_fd);
-        return EXIT_FAILURE;
+        return -1;
     }
+    // Angenommene Verbindungen erben TCP_NODELAY, das spart je Verbindung
+    // einen Systemaufruf; Antworten auf pipelined Requests warten so nicht
+    // hinter Nagle
+    setsockopt(server_fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
     
     struct sockaddr_in server_addr = {0};
     server_addr.sin_family = AF_INET;
@@ -353,40 +1750,458 @@ int main(int argc, char *argv[]) {
     if (inet_pton(AF_INET, ip, &server_addr.sin_addr) <= 0) {
         perror("Invalid address");
         close(server_fd);
-        return EXIT_FAILURE;
+        return -1;
     }
     
     if (bind(server_fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         perror("bind failed");
         close(server_fd);
-        return EXIT_FAILURE;
+        return -1;
     }
     
-    if (listen(server_fd, 10) < 0) {
+    // Viele gleichzeitige Clients warten sonst nach verworfenen SYNs
+    // sekundenlang auf den Verbindungsaufbau
+    if (listen(server_fd, SOMAXCONN) < 0) {
         perror("listen failed");
         close(server_fd);
+        return -1;
+    }
+    return server_fd;
+}
+
+void close_listeners(const int *fds, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+}
+
+void print_usage(const char *program) {
+    fprintf(stderr, "Usage: %s <IP> <Port> [options]\n", program);
+    fprintf(stderr,
+        "  --capture FILE          Requests als JSONL in FILE mitschneiden\n"
+        "  --capture-sample N      nur jeden N-ten Request mitschneiden (Default 1)\n"
+        "  --access-log FILE       binaeres Access-Log (siehe accesslog-decode)\n"
+        "  --access-log-rotate N   nach N Bytes nach FILE.1 rotieren (Default 64 MiB)\n"
+        "  --huge-pages MODE       Arenen mit Huge Pages: transparent oder explicit\n"
+        "  --prefault              Arenen beim Start einlagern\n"
+        "  --mlock                 Arenen im RAM sperren\n"
+        "  --data-dir DIR          verdraengte Werte in Segmenten unter DIR ablegen;\n"
+        "                          der Store bleibt ueber Neustarts erhalten\n"
+        "  --bulk-dir DIR          PUT-Bodies ab 8 KiB als Dateien unter DIR ablegen\n"
+        "                          (splice()/sendfile(), nicht mit Replikation/Cluster)\n"
+        "  --import FILE           Store beim Start aus einem Archiv fuellen\n"
+        "  --export FILE           Store beim Beenden als Archiv sichern\n"
+        "                          (.ndjson/.jsonl: NDJSON, sonst binaer)\n"
+        "  --admin-token TOKEN     /admin/import und /admin/export nur mit\n"
+        "                          \"Authorization: Bearer TOKEN\" (Default: nur localhost)\n"
+        "  --compress[=N]          Werte ab N Bytes (Default 256) LZ-komprimiert speichern\n"
+        "  --quota PREFIX=KEYS[,BYTES]\n"
+        "                          Grenzen der Collection PREFIX (/dynamic/NAME/, * fuer\n"
+        "                          alle nicht genannten zusammen, / fuer die uebrigen Keys);\n"
+        "                          KEYS Slots bleiben der Collection reserviert\n"
+        "  --tls-cert FILE         TLS mit Zertifikatskette FILE (PEM); Records\n"
+        "                          verschluesselt nach Moeglichkeit der Kernel (kTLS)\n"
+        "  --tls-key FILE          privater Schluessel zu --tls-cert (PEM)\n"
+        "  --kv-port PORT          binaeres Key-Value-Protokoll (siehe kv.h) auf PORT\n"
+        "                          (nicht mit --cluster)\n"
+        "  --replicate PORT        als Primary Aenderungen an Follower auf PORT senden\n"
+        "  --follow HOST:PORT      als nur lesbarer Follower den Primary spiegeln\n"
+        "  --cluster NODES         Keys per Consistent Hashing auf NODES verteilen\n"
+        "                          (HOST:PORT,HOST:PORT,...; dieser Knoten inklusive)\n"
+        "  --cluster-node NAME     dieser Knoten in NODES (Default IP:Port)\n"
+        "  --cluster-redirect      fremde Keys mit 307 umleiten (Default)\n"
+        "  --cluster-forward       fremde Keys an den Eigentuemer weiterleiten; blockiert\n"
+        "                          diesen Knoten bis zu dessen Antwort\n"
+        "  --proxy HOST:PORT       GETs unter --proxy-prefix vom Upstream holen und cachen\n"
+        "  --proxy-prefix LIST     Praefixe, kommagetrennt (Default /static/)\n"
+        "  --proxy-ttl N           Sekunden im Cache ohne max-age (Default 60)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *capture_file = NULL;
+    unsigned capture_sample = 1;
+    const char *access_log_file = NULL;
+    size_t access_log_rotate = 64 * 1024 * 1024;
+    ArenaOptions arena_options = {ARENA_PAGES_NORMAL, false, false};
+    const char *data_dir = NULL;
+    const char *bulk_dir = NULL;
+    const char *import_file = NULL;
+    const char *export_file = NULL;
+    size_t compress_min = 0;
+    const char *quotas[STORE_COLLECTIONS + 1];
+    size_t quota_count = 0;
+    const char *tls_cert_file = NULL;
+    const char *tls_key_file = NULL;
+    int kv_port = 0;
+    int replication_port = 0;
+    const char *follow_address = NULL;
+    const char *cluster_nodes = NULL;
+    const char *cluster_node = NULL;
+    const char *proxy_upstream = NULL;
+    const char *proxy_prefixes = "/static/";
+    unsigned proxy_ttl = 60;
+    
+    static const struct option long_options[] = {
+        {"capture", required_argument, NULL, 'c'},
+        {"capture-sample", required_argument, NULL, 's'},
+        {"access-log", required_argument, NULL, 'a'},
+        {"access-log-rotate", required_argument, NULL, 'r'},
+        {"huge-pages", required_argument, NULL, 'H'},
+        {"prefault", no_argument, NULL, 'P'},
+        {"mlock", no_argument, NULL, 'L'},
+        {"data-dir", required_argument, NULL, 'd'},
+        {"bulk-dir", required_argument, NULL, 'b'},
+        {"import", required_argument, NULL, 'i'},
+        {"export", required_argument, NULL, 'e'},
+        {"admin-token", required_argument, NULL, 'A'},
+        {"compress", optional_argument, NULL, 'z'},
+        {"quota", required_argument, NULL, 'Q'},
+        {"tls-cert", required_argument, NULL, 'C'},
+        {"tls-key", required_argument, NULL, 'K'},
+        {"kv-port", required_argument, NULL, 'k'},
+        {"replicate", required_argument, NULL, 'R'},
+        {"follow", required_argument, NULL, 'F'},
+        {"cluster", required_argument, NULL, 'N'},
+        {"cluster-node", required_argument, NULL, 'n'},
+        {"cluster-redirect", no_argument, NULL, 'D'},
+        {"cluster-forward", no_argument, NULL, 'W'},
+        {"proxy", required_argument, NULL, 'U'},
+        {"proxy-prefix", required_argument, NULL, 'X'},
+        {"proxy-ttl", required_argument, NULL, 'T'},
+        {NULL, 0, NULL, 0}
+    };
+    
+    int option;
+    while ((option = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch (option) {
+        case 'c':
+            capture_file = optarg;
+            break;
+        case 's':
+            capture_sample = strtoul(optarg, NULL, 10);
+            break;
+        case 'a':
+            access_log_file = optarg;
+            break;
+        case 'r':
+            access_log_rotate = strtoull(optarg, NULL, 10);
+            break;
+        case 'H':
+            if (strcmp(optarg, "transparent") == 0) {
+                arena_options.pages = ARENA_PAGES_TRANSPARENT;
+            } else if (strcmp(optarg, "explicit") == 0) {
+                arena_options.pages = ARENA_PAGES_EXPLICIT;
+            } else {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'P':
+            arena_options.prefault = true;
+            break;
+        case 'L':
+            arena_options.lock = true;
+            break;
+        case 'd':
+            data_dir = optarg;
+            break;
+        case 'b':
+            bulk_dir = optarg;
+            break;
+        case 'i':
+            import_file = optarg;
+            break;
+        case 'e':
+            export_file = optarg;
+            break;
+        case 'z':
+            compress_min = optarg ? strtoull(optarg, NULL, 10) : 256;
+            if (compress_min == 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'Q':
+            if (quota_count == sizeof(quotas) / sizeof(quotas[0])) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            quotas[quota_count++] = optarg;
+            break;
+        case 'C':
+            tls_cert_file = optarg;
+            break;
+        case 'K':
+            tls_key_file = optarg;
+            break;
+        case 'k':
+            kv_port = atoi(optarg);
+            if (kv_port <= 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'R':
+            replication_port = atoi(optarg);
+            if (replication_port <= 0) {
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'F':
+            follow_address = optarg;
+            break;
+        case 'N':
+            cluster_nodes = optarg;
+            break;
+        case 'n':
+            cluster_node = optarg;
+            break;
+        case 'D':
+            cluster_redirect = true;
+            break;
+        case 'W':
+            cluster_redirect = false;
+            break;
+        case 'A':
+            admin_token = optarg;
+            break;
+        case 'U':
+            proxy_upstream = optarg;
+            break;
+        case 'X':
+            proxy_prefixes = optarg;
+            break;
+        case 'T':
+            proxy_ttl = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    
+    if (argc - optind != 2 || !tls_cert_file != !tls_key_file ||
+        (replication_port && follow_address)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    // Das Binaerprotokoll kennt keine Eigentuemer und leitet nicht weiter
+    if (kv_port && cluster_nodes) {
+        fprintf(stderr, "Error: --kv-port cannot be combined with --cluster\n");
+        return EXIT_FAILURE;
+    }
+    // Replikation und Weiterleitung transportieren Werte nur im Speicher
+    if (bulk_dir && (replication_port || follow_address || cluster_nodes)) {
+        fprintf(stderr, "Error: --bulk-dir cannot be combined with replication or --cluster\n");
+        return EXIT_FAILURE;
+    }
+    
+    if (init_header_table() < 0 || init_static_variants() < 0) {
+        return EXIT_FAILURE;
+    }
+    
+    if (tls_cert_file) {
+        if (tls_init(tls_cert_file, tls_key_file) < 0) {
+            return EXIT_FAILURE;
+        }
+        // OpenSSL schreibt ohne MSG_NOSIGNAL
+        signal(SIGPIPE, SIG_IGN);
+    }
+    
+    // Der erste Request soll keinen Speicher mehr anfassen muessen, den
+    // das System erst noch einlagert
+    arena_configure(&arena_options);
+    blob_configure_compression(compress_min);
+    if (store_init() < 0 || blob_arena_init(STORE_MEMORY, BUFFER_SIZE) < 0 ||
+        buffer_pool_init(CONNECTION_BUFFERS, BUFFER_SIZE) < 0) {
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < quota_count; i++) {
+        if (store_set_quota(quotas[i]) < 0) {
+            fprintf(stderr, "Error: invalid --quota %s\n", quotas[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (data_dir && store_open_cold(data_dir) < 0) {
+        return EXIT_FAILURE;
+    }
+    if (bulk_dir && store_open_bulk(bulk_dir) < 0) {
+        return EXIT_FAILURE;
+    }
+    
+    if (import_file) {
+        ArchiveStats stats;
+        if (archive_import_file(import_file, BUFFER_SIZE, &stats) < 0) {
+            return EXIT_FAILURE;
+        }
+        printf("Imported %zu entries from %s, skipped %zu%s\n", stats.imported, import_file,
+               stats.skipped, stats.full ? ", store full" : "");
+    }
+    
+    const char *ip = argv[optind];
+    int port = atoi(argv[optind + 1]);
+    
+    if (cluster_nodes) {
+        char self[128];
+        snprintf(self, sizeof(self), "%s:%d", ip, port);
+        if (cluster_init(cluster_nodes, cluster_node ? cluster_node : self) < 0) {
+            return EXIT_FAILURE;
+        }
+        // Weitergeleitet wird ueber unverschluesselte Peer-Verbindungen
+        if (tls_cert_file && !cluster_redirect) {
+            fprintf(stderr, "Error: --cluster-forward cannot be combined with TLS\n");
+            return EXIT_FAILURE;
+        }
+    }
+    int server_fd = open_listener(ip, port);
+    int kv_fd = kv_port ? open_listener(ip, kv_port) : -1;
+    int replication_fd = replication_port ? open_listener(ip, replication_port) : -1;
+    int listeners[] = {server_fd, kv_fd, replication_fd};
+    size_t listener_count = sizeof(listeners) / sizeof(listeners[0]);
+    if (server_fd < 0 || (kv_port && kv_fd < 0) || (replication_port && replication_fd < 0)) {
+        close_listeners(listeners, listener_count);
+        return EXIT_FAILURE;
+    }
+    // HTTP-Clients senden zuerst: accept() erst, wenn der Request anliegt,
+    // sonst ruht jede neue Verbindung einmal, bevor ihr erstes recv() Daten
+    // findet
+    int defer_seconds = 1;
+    setsockopt(server_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_seconds, sizeof(defer_seconds));
+    
+    // Kein SA_RESTART: accept()/recv() kehren mit EINTR zurueck
+    struct sigaction sa = {0};
+    sa.sa_handler = handle_shutdown_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    
+    if (capture_file && capture_open(capture_file, capture_sample) < 0) {
+        close_listeners(listeners, listener_count);
+        return EXIT_FAILURE;
+    }
+    
+    if (access_log_file && access_log_open(access_log_file, access_log_rotate) < 0) {
+        capture_close();
+        close_listeners(listeners, listener_count);
+        return EXIT_FAILURE;
+    }
+    
+    // Follower: der Empfangs-Thread meldet sich ueber follow_fd
+    int follow_fd = -1;
+    if (replication_port) {
+        replication_primary_start();
+    } else if (follow_address && (follow_fd = replication_follow(follow_address)) < 0) {
+        access_log_close();
+        capture_close();
+        close_listeners(listeners, listener_count);
+        return EXIT_FAILURE;
+    }
+    kv_server.read_only = replication_read_only();
+    
+    // Abgeschlossene Proxy-Abrufe melden sich ueber proxy_fd
+    int proxy_fd = proxy_upstream ? proxy_init(proxy_upstream, proxy_prefixes, proxy_ttl) : -1;
+    if (proxy_upstream && proxy_fd < 0) {
+        replication_stop();
+        access_log_close();
+        capture_close();
+        close_listeners(listeners, listener_count);
         return EXIT_FAILURE;
     }
     
     printf("Server listening on %s:%d\n", ip, port);
+    if (kv_port) {
+        printf("Binary protocol listening on %s:%d\n", ip, kv_port);
+    }
+    if (replication_port) {
+        printf("Replicating to followers on %s:%d\n", ip, replication_port);
+    }
     
-    while (1) {
+    int listen_fds[4] = {server_fd};
+    size_t listen_count = 1;
+    if (kv_fd >= 0) {
+        listen_fds[listen_count++] = kv_fd;
+    }
+    if (replication_fd >= 0 || follow_fd >= 0) {
+        listen_fds[listen_count++] = replication_fd >= 0 ? replication_fd : follow_fd;
+    }
+    if (proxy_fd >= 0) {
+        listen_fds[listen_count++] = proxy_fd;
+    }
+    while (!shutdown_requested) {
+        // Wartet auch auf Fristen und Abbrueche geparkter Long-Polls
+        WatchIdle idle;
+        int listener = watch_wait(listen_fds, listen_count, &idle, answer_watcher, NULL);
+        if (listener == WATCH_IDLE_READY) {
+            finish_client(idle.fd, resume_client(&idle));
+            continue;
+        }
+        if (listener == WATCH_IDLE_EXPIRED) {
+            close_idle(idle.fd, idle.kind);
+            continue;
+        }
+        if (listener < 0) {
+            if (errno == EINTR) continue;
+            perror("poll failed");
+            break;
+        }
+        
+        // Replikation laeuft im Hauptthread, der Store hat keine Locks
+        if (listen_fds[listener] == replication_fd) {
+            replication_accept(replication_fd);
+            continue;
+        }
+        if (listen_fds[listener] == proxy_fd) {
+            proxy_complete(proxy_fd, notify_watchers, NULL);
+            continue;
+        }
+        if (listen_fds[listener] == follow_fd) {
+            if (replication_receive(follow_fd, notify_watchers, NULL) < 0) {
+                fprintf(stderr, "Error: replication receiver stopped\n");
+                listen_fds[listener] = listen_fds[--listen_count];
+            }
+            continue;
+        }
+        
         struct sockaddr_in client_addr;
         socklen_t client_len = sizeof(client_addr);
-        int client_fd = accept(server_fd, (struct sockaddr *)&client_addr, &client_len);
+        int client_fd = accept(listen_fds[listener], (struct sockaddr *)&client_addr, &client_len);
         
         if (client_fd < 0) {
+            if (errno == EINTR) continue;
             perror("accept failed");
             break;
         }
+        account(ACCOUNT_CONNECTIONS);
         
-        if (handle_client(client_fd) < 0) {
-            fprintf(stderr, "Error handling client\n");
+        int result;
+        if (listen_fds[listener] == kv_fd) {
+            result = kv_serve(&kv_server, client_fd);
+            if (result == KV_SUSPENDED) result = CONNECTION_IDLE_KV;
+        } else {
+            result = handle_client(client_fd, &client_addr, false);
         }
-        
-        close(client_fd);
+        finish_client(client_fd, result);
+    }
+    
+    WatchIdle idle;
+    while (watch_idle_take(&idle) == 0) {
+        close_idle(idle.fd, idle.kind);
+    }
+    watch_close_all(answer_watcher, NULL);
+    replication_stop();
+    cluster_cleanup();
+    if (proxy_enabled()) {
+        proxy_stop();
     }
+    access_log_close();
+    capture_close();
+    tls_cleanup();
+    close_listeners(listeners, listener_count);
     
-    close(server_fd);
-    return EXIT_FAILURE;
+    bool exported = !export_file || archive_export_file(export_file) == 0;
+    store_close();
+    return shutdown_requested && exported ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
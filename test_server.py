@@ -0,0 +1,1692 @@
+"""
+Tests for the webserver extensions beyond RN Praxis 1
+"""
+
+import contextlib
+import json
+import os
+import re
+import select
+import shutil
+import signal
+import socket
+import ssl
+import struct
+import subprocess
+import time
+import zlib
+from http.client import HTTPConnection, HTTPSConnection
+
+import pytest
+
+from util import KillOnExit, randbytes
+
+
+@pytest.fixture
+def webserver(request):
+    """
+    Return a callable function that spawns a webserver with the given arguments.
+    """
+    def runner(*args, **kwargs):
+        """Spawn a webserver with the given arguments."""
+        return KillOnExit([request.config.getoption('executable'), *args], **kwargs)
+
+    return runner
+
+
+@pytest.fixture
+def tool(request):
+    """
+    Return the path of a helper executable built next to the webserver.
+    """
+    def path(name):
+        return os.path.join(os.path.dirname(request.config.getoption('executable')), name)
+
+    return path
+
+
+def stop(server):
+    """Stop a server gracefully, so it flushes its output files."""
+    server.send_signal(signal.SIGTERM)
+    server.wait(timeout=2)
+
+
+@pytest.mark.timeout(2)
+def test_capture(webserver, port, tmp_path):
+    """
+    Test sampled requests are captured as JSONL
+    """
+
+    capture = tmp_path / 'capture.jsonl'
+    content = randbytes(16)
+
+    with webserver('127.0.0.1', f'{port}', '--capture', str(capture)) as server, contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        conn.request('PUT', '/dynamic/captured', content, {'X-Test': 'yes'})
+        conn.getresponse().read()
+        conn.request('GET', '/static/foo')
+        conn.getresponse().read()
+        stop(server)
+
+    records = [json.loads(line) for line in capture.read_text().splitlines()]
+    assert [r['method'] for r in records] == ['PUT', 'GET']
+    assert records[0]['path'] == '/dynamic/captured'
+    assert ['X-Test', 'yes'] in records[0]['headers']
+    assert records[0]['body'].encode('latin-1') == content
+    assert records[0]['gap_us'] == 0 and records[1]['gap_us'] >= 0
+
+
+@pytest.mark.timeout(5)
+def test_replay(webserver, port, tmp_path, tool):
+    """
+    Test a capture can be replayed against a fresh server
+    """
+
+    capture = tmp_path / 'capture.jsonl'
+    content = randbytes(32).hex().encode()
+
+    with webserver('127.0.0.1', f'{port}', '--capture', str(capture)) as server, contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        conn.request('PUT', '/dynamic/replayed', content)
+        conn.getresponse().read()
+        stop(server)
+
+    with webserver('127.0.0.1', f'{port}'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        result = subprocess.run([tool('replay'), '127.0.0.1', f'{port}', str(capture), '--max'],
+                                capture_output=True, check=True, text=True)
+        assert 'Replayed 1 requests' in result.stdout
+
+        conn.request('GET', '/dynamic/replayed')
+        response = conn.getresponse()
+        assert response.status == 200
+        assert response.read() == content
+
+
+@pytest.mark.timeout(2)
+def test_content_length_header_only(webserver, port):
+    """
+    Test Content-Length is only taken from the request's own header
+    """
+
+    with webserver('127.0.0.1', f'{port}'), socket.create_connection(
+        ('localhost', port)
+    ) as conn:
+        body = b'Content-Length: 999\r\n'
+        conn.send(b'GET /dynamic/pipelined HTTP/1.1\r\nX-Note: Content-Length: 5\r\n\r\n'
+                  b'PUT /dynamic/pipelined HTTP/1.1\r\ncontent-length: %d\r\n\r\n' % len(body) + body +
+                  b'GET /dynamic/pipelined HTTP/1.1\r\n\r\n')
+        time.sleep(.5)
+        replies = conn.recv(4096)
+        statuses = re.findall(rb'HTTP/1.1 (\d+)', replies)
+        assert statuses == [b'404', b'201', b'200']
+        assert replies.endswith(body)
+
+
+@pytest.mark.timeout(3)
+def test_rejected_request_body(webserver, port):
+    """
+    Test the body of a rejected request is discarded, not parsed as the next request
+    """
+    
+    smuggled = b'GET /static/foo HTTP/1.1\r\n\r\n'
+    rejected = [
+        b'X-Long: ' + b'a' * 300 + b'\r\n',
+        b'No-Colon\r\n',
+        b''.join(b'X-H%d: 1\r\n' % i for i in range(41)),
+    ]
+    with webserver('127.0.0.1', f'{port}'):
+        for headers in rejected:
+            with socket.create_connection(('localhost', port)) as conn:
+                conn.sendall(b'PUT /dynamic/smuggle HTTP/1.1\r\n' + headers +
+                             b'Content-Length: %d\r\n\r\n' % len(smuggled) + smuggled +
+                             b'GET /dynamic/smuggle HTTP/1.1\r\n\r\n')
+                conn.shutdown(socket.SHUT_WR)
+                replies = read_reply(conn)
+                assert re.findall(rb'HTTP/1.1 (\d+)', replies) == [b'400', b'404']
+                assert b'Foo' not in replies
+        
+        # Widerspruechliche Laengen: die Verbindung endet mit der Antwort
+        with socket.create_connection(('localhost', port)) as conn:
+            conn.sendall(b'PUT /dynamic/smuggle HTTP/1.1\r\nContent-Length: 1\r\n'
+                         b'Content-Length: %d\r\n\r\n' % len(smuggled) + smuggled)
+            conn.shutdown(socket.SHUT_WR)
+            assert re.findall(rb'HTTP/1.1 (\d+)', read_reply(conn)) == [b'400']
+
+
+@pytest.mark.timeout(5)
+def test_access_log(webserver, port, tmp_path, tool):
+    """
+    Test the binary access log decodes to one JSON record per request
+    """
+
+    log = tmp_path / 'access.log'
+
+    with webserver('127.0.0.1', f'{port}', '--access-log', str(log)) as server, contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        conn.request('PUT', '/dynamic/logged', b'12345')
+        conn.getresponse().read()
+        conn.request('GET', '/dynamic/logged')
+        conn.getresponse().read()
+        # Ohne weitere Requests schreibt der Flusher den Puffer nach einer Sekunde
+        wait_for(lambda: log.stat().st_size > 16, timeout=3)
+        stop(server)
+
+    result = subprocess.run([tool('accesslog-decode'), '--json', str(log)],
+                            capture_output=True, check=True, text=True)
+    records = [json.loads(line) for line in result.stdout.splitlines()]
+    assert [(r['method'], r['path'], r['status']) for r in records] == [
+        ('PUT', '/dynamic/logged', 201),
+        ('GET', '/dynamic/logged', 200),
+    ]
+    assert records[0]['client'].startswith('127.0.0.1:')
+    assert records[1]['response_bytes'] == 5
+
+
+@pytest.mark.timeout(2)
+def test_if_match(webserver, port):
+    """
+    Test PUT and DELETE honor If-Match against the resource's ETag
+    """
+
+    with webserver('127.0.0.1', f'{port}'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        conn.request('PUT', '/dynamic/versioned', b'one', {'If-Match': '*'})
+        assert conn.getresponse().status == 412
+        conn.request('PUT', '/dynamic/versioned', b'one', {'If-None-Match': '*'})
+        response = conn.getresponse()
+        response.read()
+        assert response.status == 201
+        first = response.getheader('ETag')
+
+        conn.request('PUT', '/dynamic/versioned', b'two', {'If-Match': first})
+        response = conn.getresponse()
+        response.read()
+        assert response.status == 204
+        second = response.getheader('ETag')
+        assert second != first
+
+        conn.request('PUT', '/dynamic/versioned', b'lost', {'If-Match': first})
+        assert conn.getresponse().status == 412
+        conn.request('DELETE', '/dynamic/versioned', headers={'If-Match': f'W/{second}'})
+        assert conn.getresponse().status == 412
+
+        conn.request('GET', '/dynamic/versioned')
+        response = conn.getresponse()
+        assert response.getheader('ETag') == second
+        assert response.read() == b'two'
+
+        conn.request('DELETE', '/dynamic/versioned', headers={'If-Match': f'"0", {second}'})
+        assert conn.getresponse().status == 204
+
+
+@pytest.mark.timeout(2)
+def test_shared_content(webserver, port):
+    """
+    Test keys with identical content stay independent
+    """
+
+    content = randbytes(64)
+
+    with webserver('127.0.0.1', f'{port}'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        for name in ('a', 'b', 'c'):
+            conn.request('PUT', f'/dynamic/shared-{name}', content)
+            assert conn.getresponse().status == 201
+
+        conn.request('DELETE', '/dynamic/shared-a')
+        assert conn.getresponse().status == 204
+        conn.request('PUT', '/dynamic/shared-b', b'changed')
+        assert conn.getresponse().status == 204
+
+        for name, expected in (('b', b'changed'), ('c', content)):
+            conn.request('GET', f'/dynamic/shared-{name}')
+            response = conn.getresponse()
+            assert response.status == 200
+            assert response.read() == expected
+
+
+@pytest.mark.timeout(5)
+def test_segmented_put(webserver, port):
+    """
+    Test PUT bodies arriving after their headers, followed by pipelined requests
+    """
+    
+    content = randbytes(7000)
+    
+    with webserver('127.0.0.1', f'{port}'), socket.create_connection(
+        ('localhost', port)
+    ) as conn:
+        head = b'PUT /dynamic/segmented-%s HTTP/1.1\r\nContent-Length: %d\r\n'
+        for name in (b'a', b'b'):
+            conn.sendall(head % (name, len(content)) + b'\r\n' + content[:100])
+            time.sleep(.1)
+            conn.sendall(content[100:3000])
+            time.sleep(.1)
+            conn.sendall(content[3000:] + b'GET /dynamic/segmented-%s HTTP/1.1\r\n\r\n' % name)
+        # Abgelehnter PUT: der schon empfangene Body wird verworfen
+        conn.sendall(head % (b'a', 10) + b'If-None-Match: *\r\n\r\n01234')
+        time.sleep(.1)
+        conn.sendall(b'56789GET /dynamic/segmented-a HTTP/1.1\r\n\r\n')
+        conn.shutdown(socket.SHUT_WR)
+        
+        replies = read_reply(conn)
+        statuses = re.findall(rb'HTTP/1.1 (\d+)', replies)
+        assert statuses == [b'201', b'200', b'201', b'200', b'412', b'200']
+        assert replies.count(content) == 3
+
+
+@pytest.mark.timeout(10)
+def test_index_capacity(webserver, port):
+    """
+    Test the index stays consistent when filled, thinned out and refilled
+    """
+
+    with webserver('127.0.0.1', f'{port}'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        def put(name):
+            conn.request('PUT', f'/dynamic/key-{name}', name.encode())
+            return conn.getresponse().status
+
+        # STORE_CAPACITY; kleine Werte halten STORE_MEMORY nicht auf
+        assert all(put(f'{i}') == 201 for i in range(1024))
+        assert put('overflow') == 507
+
+        for i in range(0, 1024, 2):
+            conn.request('DELETE', f'/dynamic/key-{i}')
+            assert conn.getresponse().status == 204
+        assert all(put(f'new-{i}') == 201 for i in range(512))
+
+        for name in [f'{i}' for i in range(1, 1024, 2)] + [f'new-{i}' for i in range(512)]:
+            conn.request('GET', f'/dynamic/key-{name}')
+            response = conn.getresponse()
+            assert response.read() == name.encode()
+        conn.request('GET', '/dynamic/key-0')
+        assert conn.getresponse().status == 404
+
+
+@pytest.mark.timeout(10)
+def test_memory_budget(webserver, port, tmp_path):
+    """
+    Test the store admits values up to a byte budget, and more of them when they compress
+    """
+
+    def fill(conn, value):
+        for i in range(300):
+            conn.request('PUT', f'/dynamic/value-{i}', value(i))
+            response = conn.getresponse()
+            response.read()
+            if response.status != 201:
+                assert response.status == 507
+                return i
+        return 300
+
+    # STORE_MEMORY reicht fuer 100 Werte von 8192 Bytes
+    with webserver('127.0.0.1', f'{port}'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        def put(length):
+            conn.request('PUT', '/dynamic/growing', randbytes(length))
+            response = conn.getresponse()
+            response.read()
+            return response.status
+
+        assert put(100) == 201
+        assert fill(conn, lambda i: randbytes(8000)) == 102
+        # Ersetzen darf das Budget ebenso wenig ueberschreiten
+        assert put(4000) == 507
+        assert put(3000) == 204
+
+    with webserver('127.0.0.1', f'{port}', '--compress'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        assert fill(conn, lambda i: f'{i:05}'.encode() * 1600) == 300
+
+    # Mit kalter Stufe verdraengt auch ein wachsender Wert andere Eintraege
+    with webserver('127.0.0.1', f'{port}', '--data-dir', str(tmp_path / 'data')), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        values = {f'/dynamic/value-{i}': randbytes(8000) for i in range(150)}
+        values['/dynamic/growing'] = randbytes(100)
+        for key, value in values.items():
+            conn.request('PUT', key, value)
+            response = conn.getresponse()
+            response.read()
+            assert response.status == 201
+
+        values['/dynamic/growing'] = randbytes(8000)
+        conn.request('PUT', '/dynamic/growing', values['/dynamic/growing'])
+        response = conn.getresponse()
+        response.read()
+        assert response.status == 204
+
+        for key, value in values.items():
+            conn.request('GET', key)
+            response = conn.getresponse()
+            assert response.read() == value
+
+
+@pytest.mark.timeout(2)
+@pytest.mark.parametrize('options', [
+    ('--huge-pages', 'transparent', '--prefault'),
+    ('--huge-pages', 'explicit', '--prefault', '--mlock'),
+])
+def test_arena_options(webserver, port, options):
+    """
+    Test the server runs with huge-page, pre-faulted arenas (falling back if unavailable)
+    """
+
+    content = randbytes(4096)
+
+    with webserver('127.0.0.1', f'{port}', *options), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        conn.request('PUT', '/dynamic/arena', content)
+        assert conn.getresponse().status == 201
+        conn.request('GET', '/dynamic/arena')
+        assert conn.getresponse().read() == content
+
+
+@pytest.mark.timeout(5)
+@pytest.mark.parametrize('archive_format', ['binary', 'ndjson'])
+def test_archive_roundtrip(webserver, port, archive_format):
+    """
+    Test the store is exported and imported again over the admin endpoints
+    """
+
+    values = {f'/dynamic/archived-{i}': randbytes(1024) for i in range(20)}
+
+    with webserver('127.0.0.1', f'{port}'):
+        for key, value in values.items():
+            with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+                conn.request('PUT', key, value)
+                assert conn.getresponse().status == 201
+        with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+            conn.request('PUT', '/dynamic/other', b'not exported')
+            conn.getresponse().read()
+        with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+            conn.request('GET', f'/admin/export?prefix=/dynamic/archived-&format={archive_format}')
+            response = conn.getresponse()
+            assert response.status == 200
+            archive = response.read()
+
+    if archive_format == 'ndjson':
+        entries = [json.loads(line) for line in archive.decode().splitlines()]
+        assert {e['key']: e['value'].encode('latin-1') for e in entries} == values
+    else:
+        assert archive.startswith(b'TKNARCH1')
+
+    with webserver('127.0.0.1', f'{port}'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        # Groesser als der Verbindungspuffer, wird also gestreamt
+        assert len(archive) > 8192
+        conn.request('POST', '/admin/import', archive)
+        response = conn.getresponse()
+        assert response.status == 200
+        assert response.read().startswith(b'Imported 20 entries, skipped 0')
+
+        for key, value in values.items():
+            conn.request('GET', key)
+            assert conn.getresponse().read() == value
+        conn.request('GET', '/dynamic/other')
+        assert conn.getresponse().status == 404
+
+
+@pytest.mark.timeout(3)
+def test_archive_files(webserver, port, tmp_path):
+    """
+    Test --export writes the store on shutdown and --import loads it on startup
+    """
+
+    archive = tmp_path / 'backup.ndjson'
+    archive.write_text('{"key": "/dynamic/seeded", "value": "caf\\u00e9"}\n'
+                       '{"key": "/static/foo", "value": "skipped"}\n')
+
+    with webserver('127.0.0.1', f'{port}', '--import', str(archive), '--export', str(archive)) as server:
+        with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+            conn.request('GET', '/dynamic/seeded')
+            assert conn.getresponse().read() == b'caf\xe9'
+        with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+            conn.request('PUT', '/dynamic/added', b'new')
+            conn.getresponse().read()
+        stop(server)
+        assert server.returncode == 0
+
+    entries = [json.loads(line) for line in archive.read_text().splitlines()]
+    assert sorted(e['key'] for e in entries) == ['/dynamic/added', '/dynamic/seeded']
+
+    with webserver('127.0.0.1', f'{port}'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        conn.request('POST', '/admin/import', b'TKNARCH1\x05\x00\x00\x00')
+        response = conn.getresponse()
+        assert response.status == 400
+        assert b'Truncated archive' in response.read()
+    
+    with webserver('127.0.0.1', f'{port}', '--admin-token', 'secret'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        # Mit Token nur noch gegen "Authorization: Bearer"; der Body wird verworfen
+        conn.request('POST', '/admin/import', archive.read_bytes())
+        response = conn.getresponse()
+        assert response.status == 403
+        assert response.read() == b'Admin token required'
+        conn.request('GET', '/admin/export', headers={'Authorization': 'Bearer wrong'})
+        response = conn.getresponse()
+        assert response.status == 403
+        response.read()
+        conn.request('GET', '/dynamic/added')
+        assert conn.getresponse().status == 404
+        conn.request('POST', '/admin/import', archive.read_bytes(),
+                     {'Authorization': 'Bearer secret'})
+        assert conn.getresponse().read().startswith(b'Imported 2 entries')
+        conn.request('GET', '/admin/export?format=ndjson', headers={'Authorization': 'Bearer secret'})
+        response = conn.getresponse()
+        assert response.status == 200
+        assert b'/dynamic/added' in response.read()
+
+
+@pytest.mark.timeout(10)
+def test_cold_tier(webserver, port, tmp_path):
+    """
+    Test keys beyond the in-memory capacity are kept on disk and survive a restart
+    """
+
+    data_dir = tmp_path / 'data'
+    values = {f'/dynamic/tiered-{i}': randbytes(4096) for i in range(250)}
+
+    with webserver('127.0.0.1', f'{port}', '--data-dir', str(data_dir)) as server:
+        with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+            for key, value in values.items():
+                conn.request('PUT', key, value)
+                response = conn.getresponse()
+                response.read()
+                assert response.status == 201
+
+            for key in list(values)[:50]:
+                conn.request('DELETE', key)
+                assert conn.getresponse().status == 204
+                del values[key]
+
+            for key, value in values.items():
+                conn.request('GET', key)
+                response = conn.getresponse()
+                assert response.status == 200
+                assert response.read() == value
+            conn.request('GET', '/dynamic/tiered-0')
+            assert conn.getresponse().status == 404
+        stop(server)
+        assert server.returncode == 0
+
+    assert list(data_dir.glob('segment-*.seg'))
+
+    with webserver('127.0.0.1', f'{port}', '--data-dir', str(data_dir)), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        conn.request('GET', '/admin/export?format=ndjson')
+        response = conn.getresponse()
+        entries = [json.loads(line) for line in response.read().decode().splitlines()]
+        assert {e['key']: e['value'].encode('latin-1') for e in entries} == values
+
+    with webserver('127.0.0.1', f'{port}', '--data-dir', str(data_dir)), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        for key in ('/dynamic/tiered-10', '/dynamic/tiered-200'):
+            conn.request('GET', key)
+            response = conn.getresponse()
+            assert response.read() == values.get(key, b'')
+
+
+@pytest.mark.timeout(10)
+def test_bulk_values(webserver, port, tmp_path):
+    """
+    Test bodies beyond the buffer are stored as files with --bulk-dir and survive a restart
+    """
+    
+    bulk_dir = tmp_path / 'bulk'
+    large = randbytes(3 * 1024 * 1024)
+    
+    def request(method, path, body=None, headers={}):
+        with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+            conn.request(method, path, body, headers)
+            response = conn.getresponse()
+            return response.status, response.getheader('ETag'), response.read()
+    
+    with webserver('127.0.0.1', f'{port}', '--bulk-dir', str(bulk_dir)) as server:
+        status, etag, _ = request('PUT', '/dynamic/large', large)
+        assert status == 201
+        assert request('GET', '/dynamic/large') == (200, etag, large)
+        assert request('GET', '/dynamic/large', headers={'If-None-Match': etag})[0] == 304
+        # Abgelehnt wird vor dem Body, die Verbindung endet mit der Antwort
+        with socket.create_connection(('localhost', port)) as sock:
+            sock.sendall(b'PUT /dynamic/large HTTP/1.1\r\nContent-Length: %d\r\n'
+                         b'If-None-Match: *\r\n\r\n' % len(large))
+            assert read_reply(sock).startswith(b'HTTP/1.1 412 ')
+        
+        # Kleine und grosse Werte ersetzen einander
+        assert request('PUT', '/dynamic/large', b'small')[0] == 204
+        assert request('GET', '/dynamic/large')[2] == b'small'
+        assert not list(bulk_dir.glob('*.val'))
+        status, etag, _ = request('PUT', '/dynamic/large', large[::-1])
+        assert status == 204
+        
+        assert request('PUT', '/dynamic/deleted', large)[0] == 201
+        assert request('DELETE', '/dynamic/deleted')[0] == 204
+        assert request('GET', '/dynamic/deleted')[0] == 404
+        stop(server)
+    
+    kv_port = int(port) + 1
+    with webserver('127.0.0.1', f'{port}', '--bulk-dir', str(bulk_dir), '--kv-port', f'{kv_port}'):
+        assert request('GET', '/dynamic/large') == (200, etag, large[::-1])
+        status, new_etag, _ = request('PUT', '/dynamic/other', b'x')
+        assert int(new_etag.strip('"')) > int(etag.strip('"'))
+        
+        # Auch ueber das Binaerprotokoll ersetzt oder loescht ein Schreibzugriff den grossen Wert
+        assert request('PUT', '/dynamic/removed', large)[0] == 201
+        # Ueber HTTP/2 kommt die Datei in DATA-Frames, soweit die Fenster reichen
+        with socket.create_connection(('localhost', port)) as sock:
+            conn = H2Connection(sock)
+            sock.sendall(conn.request(1, 'GET', '/dynamic/removed'))
+            while len(conn.responses.get(1, {}).get('body', b'')) < 65535:
+                conn.read_frame()
+            sock.sendall(h2_frame(H2_WINDOW_UPDATE, 0, 0, struct.pack('>I', len(large))) +
+                         h2_frame(H2_WINDOW_UPDATE, 0, 1, struct.pack('>I', len(large))))
+            conn.wait([1])
+            assert conn.responses[1]['headers']['content-length'] == str(len(large))
+            assert conn.responses[1]['body'] == large
+        
+        # Export und Import nehmen grosse Werte mit
+        for archive_format in ('binary', 'ndjson'):
+            status, _, archive = request('GET', f'/admin/export?prefix=/dynamic/removed&format={archive_format}')
+            assert status == 200
+            assert request('DELETE', '/dynamic/removed')[0] == 204
+            status, _, body = request('POST', '/admin/import', archive)
+            assert body.startswith(b'Imported 1 entries, skipped 0')
+            assert request('GET', '/dynamic/removed')[2] == large
+        with socket.create_connection(('localhost', kv_port)) as sock:
+            sock.sendall(kv_request(KV_SET, 1, b'large', b'small') + kv_request(KV_DEL, 2, b'removed'))
+            assert kv_read_response(sock) == (KV_SET, KV_OK, 1, b'', b'')
+            assert kv_read_response(sock) == (KV_DEL, KV_OK, 2, b'', b'')
+        assert request('GET', '/dynamic/large')[2] == b'small'
+        assert request('GET', '/dynamic/removed')[0] == 404
+        assert not list(bulk_dir.glob('*.val'))
+
+
+@pytest.mark.timeout(10)
+def test_compression(webserver, port, tmp_path):
+    """
+    Test compressible values are stored compressed and served unchanged, also via the cold tier
+    """
+
+    def record(i):
+        readings = [{'sensor': f'sensor-{i}', 'unit': 'celsius', 'value': i % 7} for _ in range(20)]
+        return json.dumps({'id': i, 'readings': readings}).encode()
+
+    values = {f'/dynamic/compressed-{i}': record(i) for i in range(150)}
+    values['/dynamic/small'] = b'{"tiny": true}'
+    values['/dynamic/random'] = randbytes(2048)
+
+    log = tmp_path / 'stdout.log'
+    with open(log, 'w') as stdout, webserver(
+        '127.0.0.1', f'{port}', '--compress', '--data-dir', str(tmp_path / 'data'), stdout=stdout,
+    ) as server:
+        with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+            for key, value in values.items():
+                conn.request('PUT', key, value)
+                response = conn.getresponse()
+                response.read()
+                assert response.status == 201
+
+            for key, value in values.items():
+                conn.request('GET', key)
+                response = conn.getresponse()
+                assert response.status == 200
+                assert response.read() == value
+
+            conn.request('GET', '/admin/export?format=ndjson')
+            entries = [json.loads(line) for line in conn.getresponse().read().decode().splitlines()]
+            assert {e['key']: e['value'].encode('latin-1') for e in entries} == values
+        stop(server)
+
+    stats = re.findall(r'Store holds \d+ distinct values, (\d+) bytes \((\d+) stored\)', log.read_text())
+    raw, stored = map(int, stats[-1])
+    assert stored * 3 < raw
+
+
+@pytest.mark.timeout(5)
+def test_content_encoding(webserver, port):
+    """
+    Test dynamic values are served gzip- or deflate-encoded when the client accepts it
+    """
+
+    content = json.dumps([{'sensor': 'outdoor', 'unit': 'celsius', 'value': i % 5} for i in range(50)]).encode()
+    incompressible = randbytes(512)
+
+    with webserver('127.0.0.1', f'{port}'), contextlib.closing(HTTPConnection('localhost', port)) as conn:
+        conn.request('PUT', '/dynamic/encoded', content)
+        response = conn.getresponse()
+        response.read()
+        version = response.getheader('ETag').strip('"')
+
+        for accept, encoding, decode in [
+            ('gzip, deflate', 'gzip', lambda data: zlib.decompress(data, 16 + zlib.MAX_WBITS)),
+            ('deflate, gzip;q=0.5', 'deflate', zlib.decompress),
+            ('gzip;q=0, *;q=0.1', 'deflate', zlib.decompress),
+            ('gzip;q=0', None, bytes),
+        ]:
+            for _ in range(2):
+                conn.request('GET', '/dynamic/encoded', headers={'Accept-Encoding': accept})
+                response = conn.getresponse()
+                body = response.read()
+                assert response.status == 200
+                assert response.getheader('Content-Encoding') == encoding
+                assert response.getheader('Vary') == 'Accept-Encoding'
+                assert decode(body) == content
+                assert response.getheader('ETag') == (f'"{version}-{encoding}"' if encoding else f'"{version}"')
+
+        # 304 nennt den ETag der ausgehandelten Variante
+        for accept, etag in [('gzip', f'"{version}-gzip"'), ('identity', f'"{version}"')]:
+            conn.request('GET', '/dynamic/encoded',
+                         headers={'Accept-Encoding': accept, 'If-None-Match': f'"{version}-gzip"'})
+            response = conn.getresponse()
+            response.read()
+            assert response.status == 304
+            assert response.getheader('ETag') == etag
+            assert response.getheader('Vary') == 'Accept-Encoding'
+        assert 0 < stats(port)['variant_bytes'] < len(content)
+
+        # Das ETag einer kodierten Variante gilt als Version fuer If-Match
+        conn.request('PUT', '/dynamic/encoded', b'changed', headers={'If-Match': f'"{version}-gzip"'})
+        response = conn.getresponse()
+        response.read()
+        assert response.status == 204
+
+        conn.request('PUT', '/dynamic/random', incompressible)
+        conn.getresponse().read()
+        conn.request('GET', '/dynamic/random', headers={'Accept-Encoding': 'gzip'})
+        response = conn.getresponse()
+        assert response.getheader('Content-Encoding') is None
+        assert response.read() == incompressible
+
+        conn.request('GET', '/static/foo', headers={'Accept-Encoding': 'gzip'})
+        response = conn.getresponse()
+        assert response.getheader('Content-Encoding') is None
+        assert response.read() == b'Foo'
+
+
+H2_PREFACE = b'PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n'
+H2_DATA, H2_HEADERS, H2_RST_STREAM, H2_SETTINGS, H2_GOAWAY, H2_WINDOW_UPDATE = 0, 1, 3, 4, 7, 8
+H2_END_STREAM, H2_END_HEADERS = 0x1, 0x4
+
+# Namen der statischen HPACK-Tabelle, Index 1 .. 61
+H2_STATIC_NAMES = [
+    ':authority', ':method', ':method', ':path', ':path', ':scheme', ':scheme', ':status', ':status',
+    ':status', ':status', ':status', ':status', ':status', 'accept-charset', 'accept-encoding',
+    'accept-language', 'accept-ranges', 'accept', 'access-control-allow-origin', 'age', 'allow',
+    'authorization', 'cache-control', 'content-disposition', 'content-encoding', 'content-language',
+    'content-length', 'content-location', 'content-range', 'content-type', 'cookie', 'date', 'etag',
+    'expect', 'expires', 'from', 'host', 'if-match', 'if-modified-since', 'if-none-match', 'if-range',
+    'if-unmodified-since', 'last-modified', 'link', 'location', 'max-forwards', 'proxy-authenticate',
+    'proxy-authorization', 'range', 'referer', 'refresh', 'retry-after', 'server', 'set-cookie',
+    'strict-transport-security', 'transfer-encoding', 'user-agent', 'vary', 'via', 'www-authenticate',
+]
+H2_STATIC_STATUS = {8: '200', 9: '204', 10: '206', 11: '304', 12: '400', 13: '404', 14: '500'}
+
+
+def h2_frame(frame_type, flags, stream_id, payload=b''):
+    """Encode an HTTP/2 frame."""
+    return struct.pack('>I', len(payload))[1:] + struct.pack('>BBI', frame_type, flags, stream_id) + payload
+
+
+def hpack_integer(value, prefix_bits, flags=0):
+    """Encode an HPACK integer with the given prefix."""
+    limit = (1 << prefix_bits) - 1
+    if value < limit:
+        return bytes([flags | value])
+    out = [flags | limit]
+    value -= limit
+    while value >= 0x80:
+        out.append(0x80 | value & 0x7f)
+        value >>= 7
+    return bytes(out + [value])
+
+
+def hpack_request(method, path, headers=()):
+    """Encode request headers as HPACK literals without indexing or Huffman coding."""
+    block = b''
+    for name, value in [(':method', method), (':path', path), (':scheme', 'http'),
+                        (':authority', 'localhost'), *headers]:
+        block += b'\x00' + hpack_integer(len(name), 7) + name.encode()
+        block += hpack_integer(len(value), 7) + value.encode()
+    return block
+
+
+def hpack_decode_response(block):
+    """Decode the subset of HPACK the server emits (static indices and plain literals)."""
+    def integer(pos, prefix_bits):
+        limit = (1 << prefix_bits) - 1
+        value = block[pos] & limit
+        pos += 1
+        if value == limit:
+            shift = 0
+            while True:
+                value += (block[pos] & 0x7f) << shift
+                pos += 1
+                shift += 7
+                if not block[pos - 1] & 0x80:
+                    break
+        return value, pos
+
+    def string(pos):
+        assert not block[pos] & 0x80, 'server does not use Huffman coding'
+        length, pos = integer(pos, 7)
+        return block[pos:pos + length].decode(), pos + length
+
+    headers, pos = {}, 0
+    while pos < len(block):
+        if block[pos] & 0x80:
+            index, pos = integer(pos, 7)
+            headers[':status'] = H2_STATIC_STATUS[index]
+            continue
+        index, pos = integer(pos, 4)
+        if index:
+            name = H2_STATIC_NAMES[index - 1]
+        else:
+            name, pos = string(pos)
+        headers[name], pos = string(pos)
+    return headers
+
+
+class H2Connection:
+    """Minimal HTTP/2 client connection over a plain socket."""
+
+    def __init__(self, sock, settings=b''):
+        self.sock = sock
+        self.buffer = b''
+        self.responses = {}
+        sock.sendall(H2_PREFACE + h2_frame(H2_SETTINGS, 0, 0, settings))
+
+    def request(self, stream_id, method, path, body=b'', headers=()):
+        """Return the frames that start a request on the given stream."""
+        block = hpack_request(method, path, headers)
+        if not body:
+            return h2_frame(H2_HEADERS, H2_END_HEADERS | H2_END_STREAM, stream_id, block)
+        return (h2_frame(H2_HEADERS, H2_END_HEADERS, stream_id, block) +
+                h2_frame(H2_DATA, H2_END_STREAM, stream_id, body))
+
+    def read_frame(self):
+        """Read one frame and record responses; return (type, flags, stream id, payload)."""
+        while len(self.buffer) < 9 or len(self.buffer) < 9 + int.from_bytes(self.buffer[:3], 'big'):
+            data = self.sock.recv(65536)
+            assert data, 'connection closed'
+            self.buffer += data
+        length = int.from_bytes(self.buffer[:3], 'big')
+        frame_type, flags, stream_id = struct.unpack('>BBI', self.buffer[3:9])
+        payload, self.buffer = self.buffer[9:9 + length], self.buffer[9 + length:]
+
+        if frame_type == H2_HEADERS:
+            self.responses[stream_id] = {'headers': hpack_decode_response(payload), 'body': b'', 'done': False}
+        elif frame_type == H2_DATA:
+            self.responses[stream_id]['body'] += payload
+        elif frame_type == H2_RST_STREAM:
+            self.responses[stream_id] = {'reset': struct.unpack('>I', payload)[0], 'done': True}
+        if frame_type in (H2_HEADERS, H2_DATA) and flags & H2_END_STREAM:
+            self.responses[stream_id]['done'] = True
+        return frame_type, flags, stream_id, payload
+
+    def wait(self, stream_ids):
+        """Read frames until all given streams are complete."""
+        while not all(self.responses.get(i, {}).get('done') for i in stream_ids):
+            self.read_frame()
+
+
+@pytest.mark.timeout(5)
+def test_http2_multiplexing(webserver, port):
+    """
+    Test many concurrent HTTP/2 streams on one connection while a large response waits for window updates
+    """
+
+    content = randbytes(4000)
+
+    with webserver('127.0.0.1', f'{port}'), socket.create_connection(('localhost', port)) as sock:
+        # Stream-Fenster von 100 Bytes: die grosse Antwort muss warten
+        conn = H2Connection(sock, struct.pack('>HI', 4, 100))
+        sock.sendall(conn.request(1, 'PUT', '/dynamic/large', content) +
+                     conn.request(3, 'GET', '/dynamic/large', headers=[('accept-encoding', 'identity')]))
+        conn.wait([1])
+        assert conn.responses[1]['headers'][':status'] == '201'
+
+        streams = range(5, 5 + 2 * 200, 2)
+        sock.sendall(b''.join(
+            conn.request(i, 'PUT', f'/dynamic/stream-{i}', f'value {i}'.encode()) if i % 3 == 0 else
+            conn.request(i, 'GET', '/static/foo')
+            for i in streams
+        ))
+        conn.wait(streams)
+        for i in streams:
+            response = conn.responses[i]
+            if i % 3 == 0:
+                assert response['headers'][':status'] == '201'
+            else:
+                assert response['headers'][':status'] == '200'
+                assert response['body'] == b'Foo'
+
+        assert len(conn.responses[3]['body']) == 100
+        assert not conn.responses[3]['done']
+        sock.sendall(h2_frame(H2_WINDOW_UPDATE, 0, 3, struct.pack('>I', len(content))))
+        conn.wait([3])
+        assert conn.responses[3]['headers']['content-length'] == str(len(content))
+        assert conn.responses[3]['body'] == content
+
+        sock.sendall(conn.request(5 + 2 * 200, 'GET', '/dynamic/stream-9'))
+        conn.wait([5 + 2 * 200])
+        assert conn.responses[5 + 2 * 200]['body'] == b'value 9'
+
+        # Pseudo-Header nach normalen Headern: Stream wird abgelehnt
+        block = b'\x00\x01a\x01b' + hpack_request('GET', '/static/foo')
+        sock.sendall(h2_frame(H2_HEADERS, H2_END_HEADERS | H2_END_STREAM, 1001, block))
+        conn.wait([1001])
+        assert conn.responses[1001]['reset'] == 1
+
+        # Ein groesseres Anfangsfenster darf kein offenes Stream-Fenster ueber 2^31-1 heben
+        sock.sendall(h2_frame(H2_HEADERS, H2_END_HEADERS, 1003, hpack_request('PUT', '/dynamic/open')) +
+                     h2_frame(H2_WINDOW_UPDATE, 0, 1003, struct.pack('>I', 2**31 - 1 - 100)) +
+                     h2_frame(H2_SETTINGS, 0, 0, struct.pack('>HI', 4, 200)))
+        while (frame := conn.read_frame())[0] != H2_GOAWAY:
+            pass
+        assert struct.unpack('>I', frame[3][4:8])[0] == 3
+
+
+@pytest.mark.timeout(5)
+def test_http2_upgrade(webserver, port):
+    """
+    Test an HTTP/1.1 request is upgraded to h2c and answered on stream 1
+    """
+
+    with webserver('127.0.0.1', f'{port}'), socket.create_connection(('localhost', port)) as sock:
+        sock.sendall(b'PUT /dynamic/upgraded HTTP/1.1\r\nHost: localhost\r\n'
+                     b'Connection: Upgrade, HTTP2-Settings\r\nUpgrade: h2c\r\n'
+                     b'HTTP2-Settings: AAMAAABkAAQAAP__\r\nContent-Length: 5\r\n\r\nhello')
+        switching = b''
+        while b'\r\n\r\n' not in switching:
+            switching += sock.recv(1)
+        assert switching.startswith(b'HTTP/1.1 101 ')
+
+        conn = H2Connection(sock)
+        conn.wait([1])
+        assert conn.responses[1]['headers'][':status'] == '201'
+
+        sock.sendall(conn.request(3, 'GET', '/dynamic/upgraded'))
+        conn.wait([3])
+        assert conn.responses[3]['body'] == b'hello'
+
+        # Nur Import und Export brauchen HTTP/1.1; der Upgrade-Request zaehlt einmal
+        sock.sendall(conn.request(5, 'GET', '/admin/export') + conn.request(7, 'GET', '/admin/stats'))
+        conn.wait([5, 7])
+        assert conn.responses[5]['headers'][':status'] == '501'
+        assert conn.responses[7]['headers'][':status'] == '200'
+        counters = dict(line.split() for line in conn.responses[7]['body'].decode().splitlines())
+        assert int(counters['requests']) == 4
+
+
+@pytest.mark.timeout(5)
+def test_http2_interop(webserver, port):
+    """
+    Test the HTTP/2 server against the h2 reference implementation as client
+    """
+    
+    h2_connection = pytest.importorskip('h2.connection')
+    h2_events = pytest.importorskip('h2.events')
+    content = randbytes(6000)
+    
+    with webserver('127.0.0.1', f'{port}'), socket.create_connection(('localhost', port)) as sock:
+        conn = h2_connection.H2Connection()
+        conn.initiate_connection()
+        conn.send_headers(1, [(':method', 'PUT'), (':path', '/dynamic/interop'), (':scheme', 'http'),
+                              (':authority', 'localhost'), ('content-length', str(len(content)))])
+        # Body ueber mehrere DATA-Frames, dazwischen ein zweiter Stream
+        conn.send_data(1, content[:2000])
+        conn.send_headers(3, [(':method', 'GET'), (':path', '/static/foo'), (':scheme', 'http'),
+                              (':authority', 'localhost')], end_stream=True)
+        conn.send_data(1, content[2000:4000])
+        conn.send_data(1, content[4000:], end_stream=True)
+        conn.send_headers(5, [(':method', 'GET'), (':path', '/dynamic/interop'), (':scheme', 'http'),
+                              (':authority', 'localhost'), ('accept-encoding', 'identity')],
+                          end_stream=True)
+        sock.sendall(conn.data_to_send())
+        
+        responses, bodies, ended = {}, {}, set()
+        while ended != {1, 3, 5}:
+            data = sock.recv(65536)
+            assert data
+            for event in conn.receive_data(data):
+                if isinstance(event, h2_events.ResponseReceived):
+                    responses[event.stream_id] = dict(event.headers)
+                elif isinstance(event, h2_events.DataReceived):
+                    bodies[event.stream_id] = bodies.get(event.stream_id, b'') + event.data
+                    conn.acknowledge_received_data(event.flow_controlled_length, event.stream_id)
+                elif isinstance(event, h2_events.StreamEnded):
+                    ended.add(event.stream_id)
+            sock.sendall(conn.data_to_send())
+        
+        assert responses[1][b':status'] == b'201'
+        assert responses[3][b':status'] == b'200'
+        assert bodies[3] == b'Foo'
+        assert bodies[5] == content
+
+
+@pytest.fixture
+def certificate(tmp_path):
+    """Self-signed certificate for localhost, as (cert, key) paths."""
+    if not shutil.which('openssl'):
+        pytest.skip('openssl not available')
+    cert, key = tmp_path / 'cert.pem', tmp_path / 'key.pem'
+    subprocess.run(['openssl', 'req', '-x509', '-newkey', 'rsa:2048', '-nodes', '-days', '1',
+                    '-subj', '/CN=localhost', '-keyout', key, '-out', cert],
+                   check=True, capture_output=True)
+    return cert, key
+
+
+@pytest.mark.timeout(10)
+def test_tls(webserver, port, certificate):
+    """
+    Test HTTP/1.1 and HTTP/2 (via ALPN) over the TLS listener
+    """
+
+    cert, key = certificate
+    context = ssl.create_default_context(cafile=cert)
+    content = randbytes(6000)
+
+    with webserver('127.0.0.1', f'{port}', '--tls-cert', f'{cert}', '--tls-key', f'{key}'):
+        with contextlib.closing(HTTPSConnection('localhost', port, context=context)) as conn:
+            # Mehrere Requests auf einer Verbindung, Body ueber mehrere Records
+            conn.request('PUT', '/dynamic/secret', content)
+            assert conn.getresponse().read() == b''
+            conn.request('GET', '/dynamic/secret', headers={'Accept-Encoding': 'identity'})
+            response = conn.getresponse()
+            assert response.status == 200
+            assert response.read() == content
+            conn.request('GET', '/static/foo')
+            assert conn.getresponse().read() == b'Foo'
+
+        context.set_alpn_protocols(['h2', 'http/1.1'])
+        with socket.create_connection(('localhost', port)) as raw, \
+                context.wrap_socket(raw, server_hostname='localhost') as sock:
+            assert sock.selected_alpn_protocol() == 'h2'
+            conn = H2Connection(sock)
+            sock.sendall(conn.request(1, 'GET', '/dynamic/secret', headers=[('accept-encoding', 'identity')]) +
+                         conn.request(3, 'GET', '/static/bar'))
+            conn.wait([1, 3])
+            assert conn.responses[1]['body'] == content
+            assert conn.responses[3]['body'] == b'Bar'
+
+        # Klartext auf dem TLS-Port scheitert am Handshake, der Server laeuft weiter
+        with socket.create_connection(('localhost', port)) as sock:
+            sock.sendall(b'GET /static/foo HTTP/1.1\r\n\r\n')
+            try:
+                reply = sock.recv(1024)
+            except ConnectionResetError:
+                reply = b''
+            assert b'200 OK' not in reply
+
+        context = ssl.create_default_context(cafile=cert)
+        with contextlib.closing(HTTPSConnection('localhost', port, context=context)) as conn:
+            conn.request('GET', '/static/baz')
+            assert conn.getresponse().read() == b'Baz'
+
+
+def watch(port, path, etag, wait):
+    """Send a long-poll GET on a raw socket and return the socket."""
+    sock = socket.create_connection(('localhost', port))
+    sock.sendall(f'GET {path} HTTP/1.1\r\nIf-None-Match: {etag}\r\nPrefer: wait={wait}\r\n\r\n'.encode())
+    return sock
+
+
+def read_reply(sock):
+    """Read a response up to the end of the connection."""
+    reply = b''
+    while data := sock.recv(4096):
+        reply += data
+    return reply
+
+
+@pytest.mark.timeout(10)
+def test_watch(webserver, port, tmp_path):
+    """
+    Test long-poll GETs are parked per key and woken only by changes to their key
+    """
+
+    with webserver('127.0.0.1', f'{port}'), \
+            contextlib.closing(HTTPConnection('localhost', port)) as conn:
+        etags = {}
+        for key in ('a', 'b'):
+            conn.request('PUT', f'/dynamic/{key}', b'first')
+            response = conn.getresponse()
+            assert response.read() == b''
+            etags[key] = response.headers['ETag']
+
+        # Ohne Prefer nur bedingter GET
+        conn.request('GET', '/dynamic/a', headers={'If-None-Match': etags['a']})
+        response = conn.getresponse()
+        assert response.status == 304
+        assert response.read() == b''
+
+        watchers_a = [watch(port, '/dynamic/a', etags['a'], 30) for _ in range(50)]
+        watcher_b = watch(port, '/dynamic/b', etags['b'], 30)
+        aborted = watch(port, '/dynamic/b', etags['b'], 30)
+
+        # Geparkte Verbindungen blockieren den Server nicht
+        conn.request('GET', '/static/foo')
+        assert conn.getresponse().read() == b'Foo'
+        aborted.close()
+
+        conn.request('PUT', '/dynamic/a', b'second')
+        assert conn.getresponse().status == 204
+        for sock in watchers_a:
+            with sock:
+                reply = read_reply(sock)
+                assert reply.startswith(b'HTTP/1.1 200 OK\r\n')
+                assert reply.endswith(b'\r\n\r\nsecond')
+
+        with watcher_b:
+            assert select.select([watcher_b], [], [], 0.2)[0] == []
+            conn.request('DELETE', '/dynamic/b')
+            assert conn.getresponse().status == 204
+            assert read_reply(watcher_b).startswith(b'HTTP/1.1 404 Not Found\r\n')
+
+        # Frist ohne Aenderung: 304 mit unveraendertem ETag
+        conn.request('GET', '/dynamic/a')
+        response = conn.getresponse()
+        assert response.read() == b'second'
+        started = time.monotonic()
+        with watch(port, '/dynamic/a', response.headers['ETag'], 1) as sock:
+            reply = read_reply(sock)
+        assert reply.startswith(b'HTTP/1.1 304 Not Modified\r\n')
+        assert response.headers['ETag'].encode() in reply
+        assert 0.9 < time.monotonic() - started < 3
+
+    # Ein Import weckt ebenso, auch fuer grosse Werte (--bulk-dir)
+    values = {'/dynamic/small': b'imported', '/dynamic/large': randbytes(20000)}
+    archive = b''.join(json.dumps({'key': key, 'value': value.decode('latin-1')}).encode() + b'\n'
+                       for key, value in values.items())
+    with webserver('127.0.0.1', f'{port}', '--bulk-dir', str(tmp_path / 'bulk')), \
+            contextlib.closing(HTTPConnection('localhost', port)) as conn:
+        watchers = {}
+        for key in values:
+            conn.request('PUT', key, b'first')
+            response = conn.getresponse()
+            response.read()
+            watchers[key] = watch(port, key, response.headers['ETag'], 30)
+
+        conn.request('GET', '/static/foo')
+        assert conn.getresponse().read() == b'Foo'
+        conn.request('POST', '/admin/import', archive)
+        response = conn.getresponse()
+        assert response.read().startswith(b'Imported 2 entries')
+        for key, sock in watchers.items():
+            with sock:
+                sock.settimeout(5)
+                reply = read_reply(sock)
+                assert reply.startswith(b'HTTP/1.1 200 OK\r\n')
+                assert reply.endswith(b'\r\n\r\n' + values[key])
+
+
+KV_GET, KV_SET, KV_DEL, KV_MGET = 1, 2, 3, 4
+KV_OK, KV_NOT_FOUND, KV_INVALID = 0, 1, 2
+
+
+def kv_request(opcode, opaque, key=b'', value=b''):
+    """Encode a binary protocol request."""
+    return struct.pack('>BBHHHII', 0x4b, opcode, len(key), 0, 0, opaque, len(value)) + key + value
+
+
+def kv_read_response(sock):
+    """Read one binary protocol response as (opcode, status, opaque, key, value)."""
+    def read_exactly(length):
+        data = b''
+        while len(data) < length:
+            chunk = sock.recv(length - len(data))
+            assert chunk, 'connection closed'
+            data += chunk
+        return data
+
+    magic, opcode, key_length, status, _, opaque, value_length = struct.unpack('>BBHHHII', read_exactly(16))
+    assert magic == 0x6b
+    return opcode, status, opaque, read_exactly(key_length), read_exactly(value_length)
+
+
+@pytest.mark.timeout(5)
+def test_binary_protocol(webserver, port):
+    """
+    Test pipelined GET/SET/DEL/MGET on the binary listener sharing the HTTP store
+    """
+
+    kv_port = int(port) + 1
+    content = randbytes(5000)
+
+    with webserver('127.0.0.1', f'{port}', '--kv-port', f'{kv_port}'), \
+            contextlib.closing(HTTPConnection('localhost', port)) as conn:
+        conn.request('PUT', '/dynamic/shared', b'from http')
+        assert conn.getresponse().status == 201
+
+        with socket.create_connection(('localhost', kv_port)) as sock:
+            # Alles in einem Segment, Antworten in Request-Reihenfolge
+            sock.sendall(kv_request(KV_GET, 1, b'shared') +
+                         kv_request(KV_SET, 2, b'large', content) +
+                         kv_request(KV_GET, 3, b'large') +
+                         kv_request(KV_GET, 4, b'missing') +
+                         kv_request(KV_MGET, 5, value=b'\x00\x06shared\x00\x07missing') +
+                         kv_request(KV_SET, 6, b'large', randbytes(9000)) +
+                         kv_request(KV_DEL, 7, b'shared') +
+                         kv_request(KV_DEL, 8, b'shared') +
+                         kv_request(9, 9, b'x') +
+                         kv_request(KV_SET, 10, b'', b'x'))
+            assert kv_read_response(sock) == (KV_GET, KV_OK, 1, b'', b'from http')
+            assert kv_read_response(sock) == (KV_SET, KV_OK, 2, b'', b'')
+            assert kv_read_response(sock) == (KV_GET, KV_OK, 3, b'', content)
+            assert kv_read_response(sock) == (KV_GET, KV_NOT_FOUND, 4, b'', b'')
+            assert kv_read_response(sock) == (KV_MGET, KV_OK, 5, b'shared', b'from http')
+            assert kv_read_response(sock) == (KV_MGET, KV_NOT_FOUND, 5, b'missing', b'')
+            assert kv_read_response(sock) == (KV_MGET, KV_OK, 5, b'', b'')
+            # Zu grosser Wert wird ueberlesen, die Verbindung bleibt synchron
+            assert kv_read_response(sock) == (KV_SET, KV_INVALID, 6, b'', b'')
+            assert kv_read_response(sock) == (KV_DEL, KV_OK, 7, b'', b'')
+            assert kv_read_response(sock) == (KV_DEL, KV_NOT_FOUND, 8, b'', b'')
+            assert kv_read_response(sock)[1:3] == (4, 9)
+            assert kv_read_response(sock) == (KV_SET, KV_INVALID, 10, b'', b'')
+
+            # Zu lange Keys werden ueberlesen, auch wenn sie nicht in den Puffer passen
+            sock.sendall(kv_request(KV_GET, 11, b'k' * 65535) + kv_request(KV_GET, 12, b'large'))
+            assert kv_read_response(sock) == (KV_GET, KV_INVALID, 11, b'', b'')
+            assert kv_read_response(sock) == (KV_GET, KV_OK, 12, b'', content)
+
+            # Viele kleine Requests gepipelinet
+            sock.sendall(b''.join(kv_request(KV_SET, i, b'key-%d' % (i % 20), b'v%d' % i) for i in range(1000)))
+            for i in range(1000):
+                assert kv_read_response(sock) == (KV_SET, KV_OK, i, b'', b'')
+
+        conn.request('GET', '/dynamic/large', headers={'Accept-Encoding': 'identity'})
+        response = conn.getresponse()
+        assert response.read() == content
+        conn.request('GET', '/dynamic/key-7')
+        assert conn.getresponse().read() == b'v987'
+        conn.request('GET', '/dynamic/shared')
+        response = conn.getresponse()
+        assert response.status == 404
+        response.read()
+
+
+@pytest.mark.timeout(5)
+def test_idle_connections(webserver, port):
+    """
+    Test idle HTTP/1.1, HTTP/2 and binary protocol connections do not block other clients
+    """
+    
+    kv_port = int(port) + 1
+    
+    with webserver('127.0.0.1', f'{port}', '--kv-port', f'{kv_port}'), \
+            socket.create_connection(('localhost', kv_port)) as kv_sock, \
+            socket.create_connection(('localhost', port)) as h2_sock, \
+            contextlib.closing(HTTPConnection('localhost', port, timeout=2)) as conn, \
+            socket.create_connection(('localhost', port)) as silent:
+        h2 = H2Connection(h2_sock)
+        conn.request('GET', '/static/foo')
+        assert conn.getresponse().read() == b'Foo'
+        
+        # Alle vier Verbindungen ruhen, neue werden trotzdem bedient
+        assert http_put(port, '/dynamic/idle', b'first') == 201
+        kv_sock.sendall(kv_request(KV_SET, 1, b'idle', b'second'))
+        assert kv_read_response(kv_sock) == (KV_SET, KV_OK, 1, b'', b'')
+        assert http_get(port, '/dynamic/idle') == (200, b'second')
+        
+        h2_sock.sendall(h2.request(1, 'GET', '/dynamic/idle', headers=[('accept-encoding', 'identity')]))
+        h2.wait([1])
+        assert h2.responses[1]['body'] == b'second'
+        conn.request('GET', '/dynamic/idle')
+        assert conn.getresponse().read() == b'second'
+        
+        silent.sendall(b'GET /static/foo HTTP/1.1\r\n\r\n')
+        reply = b''
+        while not reply.endswith(b'Foo'):
+            data = silent.recv(4096)
+            assert data, 'connection closed'
+            reply += data
+
+
+def wait_for(predicate, timeout=5):
+    """Poll predicate until it returns a truthy value."""
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        result = predicate()
+        if result:
+            return result
+        time.sleep(0.05)
+    raise AssertionError('condition not reached')
+
+
+def http_get(port, path):
+    """GET on a fresh connection, returns (status, body)."""
+    with contextlib.closing(HTTPConnection('localhost', port, timeout=2)) as conn:
+        conn.request('GET', path)
+        response = conn.getresponse()
+        return response.status, response.read()
+
+
+def http_put(port, path, body, method='PUT'):
+    """PUT/DELETE on a fresh connection, returns the status."""
+    with contextlib.closing(HTTPConnection('localhost', port, timeout=2)) as conn:
+        conn.request(method, path, body)
+        response = conn.getresponse()
+        response.read()
+        return response.status
+
+
+@pytest.mark.timeout(20)
+def test_replication(webserver, port):
+    """
+    Test that followers mirror the primary via snapshot and log and stay read-only
+    """
+
+    replication_port = int(port) + 1
+    follower_ports = [int(port) + 2, int(port) + 3]
+    primary_address = f'127.0.0.1:{replication_port}'
+
+    def follower(follower_port):
+        return webserver('127.0.0.1', f'{follower_port}', '--kv-port', f'{follower_port + 10}',
+                         '--follow', primary_address)
+
+    with webserver('127.0.0.1', f'{port}', '--replicate', f'{replication_port}'):
+        time.sleep(.3)
+        # Stand vor dem Follower kommt per Snapshot
+        for i in range(20):
+            assert http_put(port, f'/dynamic/early-{i}', b'early %d' % i) == 201
+
+        with follower(follower_ports[0]), follower(follower_ports[1]) as second:
+            for follower_port in follower_ports:
+                wait_for(lambda: http_get(follower_port, '/dynamic/early-19') == (200, b'early 19'))
+
+            # Laufende Aenderungen kommen ueber das Log
+            assert http_put(port, '/dynamic/live', b'first') == 201
+            assert http_put(port, '/dynamic/live', b'second') == 204
+            assert http_put(port, '/dynamic/early-0', b'', 'DELETE') == 204
+            for follower_port in follower_ports:
+                wait_for(lambda: http_get(follower_port, '/dynamic/live') == (200, b'second'))
+                wait_for(lambda: http_get(follower_port, '/dynamic/early-0')[0] == 404)
+
+            # Follower sind nur lesbar, ueber HTTP und das binaere Protokoll
+            assert http_put(follower_ports[0], '/dynamic/live', b'local') == 403
+            assert http_put(follower_ports[0], '/dynamic/live', b'', 'DELETE') == 403
+            with socket.create_connection(('localhost', follower_ports[0] + 10)) as sock:
+                sock.sendall(kv_request(KV_SET, 1, b'live', b'x') + kv_request(KV_GET, 2, b'live'))
+                assert kv_read_response(sock) == (KV_SET, 6, 1, b'', b'')
+                assert kv_read_response(sock) == (KV_GET, KV_OK, 2, b'', b'second')
+
+            # Neustart eines Followers: vollstaendiger Stand per Snapshot
+            stop(second)
+            for i in range(10):
+                assert http_put(port, f'/dynamic/late-{i}', b'late %d' % i) == 201
+            with follower(follower_ports[1]):
+                wait_for(lambda: http_get(follower_ports[1], '/dynamic/late-9') == (200, b'late 9'))
+                assert http_get(follower_ports[1], '/dynamic/early-0')[0] == 404
+                assert http_get(follower_ports[1], '/dynamic/early-5') == (200, b'early 5')
+            assert http_get(follower_ports[0], '/dynamic/late-9') == (200, b'late 9')
+
+    # Ohne Primary verbindet sich der Follower weiter und bleibt lesbar
+    with follower(follower_ports[0]):
+        time.sleep(.3)
+        assert http_get(follower_ports[0], '/dynamic/live')[0] == 404
+
+
+def local_keys(port):
+    """Keys stored on this node, from its own export."""
+    status, body = http_get(port, '/admin/export?format=ndjson')
+    assert status == 200
+    return {json.loads(line)['key'] for line in body.decode().splitlines()}
+
+
+@pytest.mark.timeout(20)
+def test_cluster(webserver, port):
+    """
+    Test that keys are sharded over the hash ring and forwarded to their owner
+    """
+
+    ports = [int(port) + i for i in range(3)]
+    nodes = ','.join(f'127.0.0.1:{p}' for p in ports)
+    keys = [f'/dynamic/shard-{i}' for i in range(60)]
+
+    with webserver('127.0.0.1', f'{ports[0]}', '--cluster', nodes, '--cluster-forward'), \
+            webserver('127.0.0.1', f'{ports[1]}', '--cluster', nodes, '--cluster-forward'), \
+            webserver('127.0.0.1', f'{ports[2]}', '--cluster', nodes, '--cluster-forward'):
+        time.sleep(.3)
+        # Ueber einen Knoten geschrieben, ueber die anderen gelesen
+        for key in keys:
+            assert http_put(ports[0], key, key.encode()) == 201
+        for node_port in ports[1:]:
+            for key in keys:
+                assert http_get(node_port, key) == (200, key.encode())
+
+        # Jeder Key liegt genau auf einem Knoten, alle haben einen Anteil
+        shards = [local_keys(node_port) for node_port in ports]
+        assert set().union(*shards) == set(keys)
+        assert sum(len(shard) for shard in shards) == len(keys)
+        assert all(len(shard) >= 5 for shard in shards)
+
+        # ETag und Bedingungen kommen vom Eigentuemer
+        with contextlib.closing(HTTPConnection('localhost', ports[1])) as conn:
+            conn.request('PUT', keys[0], b'updated', headers={'If-Match': '"999999"'})
+            response = conn.getresponse()
+            response.read()
+            assert response.status == 412
+            conn.request('DELETE', keys[0])
+            assert conn.getresponse().status == 204
+        assert http_get(ports[2], keys[0])[0] == 404
+        
+        # Requests ueber HTTP/2 gehen als HTTP/1.1 an den Eigentuemer
+        foreign = [key for key in keys[1:] if key not in shards[0]]
+        with socket.create_connection(('localhost', ports[0])) as sock:
+            conn = H2Connection(sock)
+            sock.sendall(conn.request(1, 'PUT', foreign[0], b'via h2') + conn.request(3, 'GET', foreign[1]))
+            conn.wait([1, 3])
+            assert conn.responses[1]['headers'][':status'] == '204'
+            assert conn.responses[3]['body'] == foreign[1].encode()
+        assert http_get(ports[1], foreign[0]) == (200, b'via h2')
+    
+    # Das Binaerprotokoll kennt keine Eigentuemer
+    with webserver('127.0.0.1', f'{ports[0]}', '--cluster', nodes, '--kv-port', f'{ports[1]}') as server:
+        assert server.wait(timeout=2) != 0
+
+
+def cluster_owners(webserver, port, nodes, keys):
+    """Owner of each key, read from the redirects of a single node."""
+    owners = {}
+    # Ohne --cluster-forward wird umgeleitet
+    with webserver('127.0.0.1', f'{port}', '--cluster', nodes):
+        time.sleep(.3)
+        with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+            for key in keys:
+                conn.request('GET', key)
+                response = conn.getresponse()
+                response.read()
+                if response.status == 307:
+                    location = response.getheader('Location')
+                    assert location.endswith(key)
+                    owners[key] = location[len('http://'):-len(key)]
+                else:
+                    assert response.status == 404
+                    owners[key] = f'127.0.0.1:{port}'
+    return owners
+
+
+@pytest.mark.timeout(10)
+def test_cluster_membership(webserver, port):
+    """
+    Test that adding a node to the ring moves only about 1/N of the keys, all to it
+    """
+
+    keys = [f'/dynamic/member-{i}' for i in range(400)]
+    three = ','.join(f'127.0.0.1:{int(port) + i}' for i in range(3))
+    four = three + f',127.0.0.1:{int(port) + 3}'
+
+    before = cluster_owners(webserver, port, three, keys)
+    after = cluster_owners(webserver, port, four, keys)
+    moved = [key for key in keys if before[key] != after[key]]
+    assert all(after[key] == f'127.0.0.1:{int(port) + 3}' for key in moved)
+    assert 0.15 * len(keys) < len(moved) < 0.35 * len(keys)
+    for node in three.split(','):
+        assert list(before.values()).count(node) > 0.2 * len(keys)
+
+
+class Origin:
+    """Local stand-in for a slow upstream, counting requests per path and connection."""
+
+    def __init__(self, port):
+        import http.server
+        import threading
+        origin = self
+        self.requests = []
+        self.connections = set()
+
+        class Handler(http.server.BaseHTTPRequestHandler):
+            protocol_version = 'HTTP/1.1'
+
+            def log_message(self, *args):
+                pass
+
+            def do_GET(self):
+                origin.requests.append((self.path, self.headers.get('If-None-Match')))
+                origin.connections.add(self.client_address)
+                if self.path == '/static/slow':
+                    time.sleep(.5)
+                if self.path == '/static/missing':
+                    self.send_response(404)
+                    self.send_header('Content-Length', '0')
+                    self.end_headers()
+                    return
+                if self.headers.get('If-None-Match') == '"v1"':
+                    self.send_response(304)
+                    self.send_header('ETag', '"v1"')
+                    self.end_headers()
+                    return
+                body = f'origin {self.path}'.encode()
+                self.send_response(200)
+                self.send_header('ETag', '"v1"')
+                if self.path in ('/static/private', '/static/hop', '/static/huge'):
+                    self.send_header('Cache-Control', 'no-store')
+                if self.path == '/static/hop':
+                    self.send_header('Connection', 'keep-alive, X-Hop')
+                    for name in ('Keep-Alive', 'Proxy-Authenticate', 'TE', 'Trailer', 'Upgrade', 'X-Hop'):
+                        self.send_header(name, 'dropped')
+                    self.send_header('X-End', 'kept')
+                if self.path == '/static/huge':
+                    for i in range(100):
+                        self.send_header(f'X-Filler-{i}', 'f' * 100)
+                if self.path == '/static/chunked':
+                    self.send_header('Transfer-Encoding', 'chunked')
+                    self.end_headers()
+                    for part in (body[:4], body[4:]):
+                        self.wfile.write(b'%x\r\n%s\r\n' % (len(part), part))
+                    self.wfile.write(b'0\r\n\r\n')
+                    return
+                self.send_header('Content-Length', str(len(body)))
+                self.end_headers()
+                self.wfile.write(body)
+
+        self.server = http.server.ThreadingHTTPServer(('127.0.0.1', port), Handler)
+        self.thread = threading.Thread(target=self.server.serve_forever, daemon=True)
+        self.thread.start()
+
+    def count(self, path):
+        return sum(1 for requested, _ in self.requests if requested == path)
+
+    def close(self):
+        self.server.shutdown()
+        self.server.server_close()
+
+
+@pytest.mark.timeout(15)
+def test_proxy(webserver, port):
+    """
+    Test the caching reverse proxy: TTL, revalidation, single-flight and pooling
+    """
+
+    origin_port = int(port) + 1
+    origin = Origin(origin_port)
+    try:
+        with webserver('127.0.0.1', f'{port}', '--proxy', f'127.0.0.1:{origin_port}',
+                       '--proxy-ttl', '1'):
+            time.sleep(.3)
+            # Erster Zugriff vom Upstream, danach aus dem Cache
+            for _ in range(3):
+                assert http_get(port, '/static/foo') == (200, b'origin /static/foo')
+            assert origin.count('/static/foo') == 1
+            assert http_get(port, '/static/chunked') == (200, b'origin /static/chunked')
+            assert http_get(port, '/static/missing')[0] == 404
+            for _ in range(2):
+                assert http_get(port, '/static/private') == (200, b'origin /static/private')
+            assert origin.count('/static/private') == 2
+            # Hop-by-Hop-Header bleiben beim Upstream, ein zu grosser Kopf wird 502
+            with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+                conn.request('GET', '/static/hop')
+                response = conn.getresponse()
+                assert response.read() == b'origin /static/hop'
+                assert response.getheader('X-End') == 'kept'
+                for name in ('Keep-Alive', 'Proxy-Authenticate', 'TE', 'Trailer', 'Upgrade', 'X-Hop'):
+                    assert response.getheader(name) is None
+            assert http_get(port, '/static/huge')[0] == 502
+            assert http_get(port, '/static/foo') == (200, b'origin /static/foo')
+            # Andere Pfade bedient der Server weiter selbst
+            assert http_put(port, '/dynamic/local', b'x') == 201
+            # Der Cache liegt nicht im Store und wird nicht exportiert
+            status, exported = http_get(port, '/admin/export?format=ndjson')
+            assert status == 200 and b'/dynamic/local' in exported and b'/static/' not in exported
+
+            # Gleichzeitige Fehlschlaege: ein einziger Abruf fuer alle
+            clients = []
+            for _ in range(10):
+                sock = socket.create_connection(('localhost', port))
+                sock.sendall(b'GET /static/slow HTTP/1.1\r\nHost: localhost\r\n\r\n')
+                clients.append(sock)
+            for sock in clients:
+                with sock:
+                    reply = read_reply(sock)
+                    assert reply.startswith(b'HTTP/1.1 200') and reply.endswith(b'origin /static/slow')
+            assert origin.count('/static/slow') == 1
+
+            # Nach Ablauf der TTL: Revalidierung mit If-None-Match
+            time.sleep(1.2)
+            assert http_get(port, '/static/foo') == (200, b'origin /static/foo')
+            assert origin.requests[-1] == ('/static/foo', '"v1"')
+            with contextlib.closing(HTTPConnection('localhost', port)) as conn:
+                conn.request('GET', '/static/foo', headers={'If-None-Match': '"v1"'})
+                response = conn.getresponse()
+                response.read()
+                assert response.status == 304
+
+            # Abrufe teilen sich wenige Keep-Alive-Verbindungen
+            assert len(origin.connections) <= 4
+    finally:
+        origin.close()
+
+
+def stats(port):
+    status, body = http_get(port, '/admin/stats')
+    assert status == 200
+    return dict((name, int(value)) for name, value in (line.split() for line in body.decode().splitlines()))
+
+
+@pytest.mark.timeout(10)
+def test_collections(webserver, port, tmp_path):
+    """
+    Test configured collections under /dynamic/<name>/ are limited by their own quotas
+    """
+    
+    with webserver('127.0.0.1', f'{port}', '--quota', '/dynamic/small/=2', '--quota', '*=0,100'):
+        assert http_put(port, '/dynamic/small/a', b'a') == 201
+        assert http_put(port, '/dynamic/small/b', b'b') == 201
+        assert http_put(port, '/dynamic/small/c', b'c') == 507
+        assert http_put(port, '/dynamic/other/x', b'x' * 50) == 201
+        assert http_put(port, '/dynamic/other/y', b'y' * 60) == 507
+        assert http_put(port, '/dynamic/other/x', b'x' * 101) == 507
+        assert http_put(port, '/dynamic/other/x', b'x' * 10) == 204
+        # Nicht genannte Praefixe teilen sich "*" und legen keine Collection an
+        for i in range(20):
+            assert http_put(port, f'/dynamic/junk-{i}/k', b'j' * 10) == (201 if i < 9 else 507)
+        # Ausserhalb von Collections gelten STORE_CAPACITY und die Reserven der anderen
+        assert http_put(port, '/dynamic/top', b't' * 200) == 201
+        assert http_get(port, '/dynamic/other/x') == (200, b'x' * 10)
+        
+        counters = stats(port)
+        assert counters['keys@/dynamic/small/'] == 2
+        assert counters['rejected@/dynamic/small/'] == 1
+        assert counters['bytes@*'] == 100
+        assert counters['rejected@*'] == 13
+        assert counters['keys@/'] == 1
+        assert not any('junk' in name or 'other' in name for name in counters)
+    
+    # Mit kalter Stufe verdraengt eine volle Collection nur eigene Eintraege
+    with webserver('127.0.0.1', f'{port}', '--data-dir', str(tmp_path / 'data'),
+                   '--quota', '/dynamic/small/=2'):
+        assert http_put(port, '/dynamic/top', b't') == 201
+        for name in 'abcd':
+            assert http_put(port, f'/dynamic/small/{name}', name.encode()) == 201
+        for name in 'abcd':
+            assert http_get(port, f'/dynamic/small/{name}') == (200, name.encode())
+        
+        counters = stats(port)
+        assert counters['keys@/dynamic/small/'] == 2
+        assert counters['demoted@/dynamic/small/'] >= 4
+        assert counters['demoted@/'] == 0
+    
+    # Ohne eigene Grenzen teilen sich "/" und "*" den Rest; das unbegrenzte
+    # "/" darf die Reserve der genannten Collection nicht belegen
+    with webserver('127.0.0.1', f'{port}', '--quota', '/dynamic/big/=1000'), contextlib.closing(
+        HTTPConnection('localhost', port)
+    ) as conn:
+        for i in range(14):
+            assert http_put(port, f'/dynamic/t{i}/k', b'x') == (201 if i < 12 else 507)
+        for i in range(14):
+            assert http_put(port, f'/dynamic/top-{i}', b'x') == (201 if i < 12 else 507)
+        for i in range(1000):
+            conn.request('PUT', f'/dynamic/big/{i}', b'x')
+            response = conn.getresponse()
+            response.read()
+            assert response.status == 201
+        assert http_put(port, '/dynamic/big/full', b'x') == 507
+        
+        counters = stats(port)
+        assert counters['rejected@/'] == 2
+        assert counters['rejected@/dynamic/big/'] == 1
+    
+    # Mehr Reserven als Slots sind ein Konfigurationsfehler
+    server = webserver('127.0.0.1', f'{port}', '--quota', '/dynamic/a/=600', '--quota', '/dynamic/b/=600')
+    with server:
+        assert server.wait(timeout=2) != 0
+    
+    # Passt ein Wert der kalten Stufe nicht mehr unter die Grenze seiner
+    # Collection, wird er ohne Platz im Index geliefert
+    data_dir = str(tmp_path / 'shrunk')
+    with webserver('127.0.0.1', f'{port}', '--data-dir', data_dir) as server:
+        assert http_put(port, '/dynamic/small/a', b'a' * 200) == 201
+        assert http_put(port, '/dynamic/small/b', b'b' * 200) == 201
+        stop(server)
+    with webserver('127.0.0.1', f'{port}', '--data-dir', data_dir, '--quota', '/dynamic/small/=0,100'):
+        assert http_get(port, '/dynamic/small/a') == (200, b'a' * 200)
+        assert http_put(port, '/dynamic/small/a', b'a' * 50) == 204
+        assert http_get(port, '/dynamic/small/a') == (200, b'a' * 50)
+        assert http_put(port, '/dynamic/small/b', b'b' * 150) == 507
+        assert http_put(port, '/dynamic/small/b', None, method='DELETE') == 204
+        assert http_get(port, '/dynamic/small/b')[0] == 404
+        
+        counters = stats(port)
+        assert counters['keys@/dynamic/small/'] == 1
+        assert counters['rejected@/dynamic/small/'] == 1
+
+
+@pytest.mark.timeout(5)
+def test_stats(webserver, port):
+    """
+    Test /admin/stats counts requests and connections
+    """
+
+    with webserver('127.0.0.1', f'{port}'):
+        before = stats(port)
+        with socket.create_connection(('localhost', port)) as sock:
+            sock.sendall(b'GET /static/foo HTTP/1.1\r\n\r\n' * 3)
+            sock.shutdown(socket.SHUT_WR)
+            assert read_reply(sock).count(b'HTTP/1.1 200 OK') == 3
+        after = stats(port)
+        # Die Stats-Abfrage zaehlt sich selbst mit
+        assert after['requests'] - before['requests'] == 4
+        assert after['connections'] - before['connections'] == 2
+        # Heap- und Systemaufrufe zaehlt nur der Instrumentierungs-Build
+        assert ('malloc' in after) == ('send' in after)
+
+        assert http_put(port, '/admin/stats', b'', method='POST') == 405
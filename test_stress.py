@@ -0,0 +1,278 @@
+"""
+Stress and soak tests for the webserver
+
+Thousands of concurrent clients run interleaved PUT/GET/DELETE requests on a
+small set of shared keys, deeply pipelined and cut into random TCP segments.
+Every key's history is checked for linearizability afterwards. The sizes
+default to a short run; scale them up and enable the soak run with
+
+    pytest test_stress.py --stress-clients 5000 --soak-seconds 14400
+"""
+
+import asyncio
+import contextlib
+import itertools
+import os
+import random
+import re
+import resource
+import socket
+import subprocess
+import time
+from collections import namedtuple
+from http.client import HTTPConnection
+
+import pytest
+
+from test_server import stop, webserver  # noqa: F401 (Fixture)
+
+KEYS = [f'/dynamic/stress{i}' for i in range(24)]
+PIPELINE_DEPTHS = [1] * 8 + [4, 16, 64, 128]
+CONNECTIONS_PER_CLIENT = 2
+
+# Besuchte Zustaende je Key, bevor die Suche aufgibt
+SEARCH_LIMIT = 200000
+
+# RSS darf nach dem Aufwaermen nur um Rauschen wachsen
+RSS_SLACK_KIB = 2048
+
+Operation = namedtuple('Operation', 'key method value invoked returned status version body')
+
+
+def build_request(method, key, value):
+    if method == 'PUT':
+        return b'PUT %s HTTP/1.1\r\nContent-Length: %d\r\n\r\n%s' % (key.encode(), len(value), value)
+    return b'%s %s HTTP/1.1\r\n\r\n' % (method.encode(), key.encode())
+
+
+async def read_response(reader):
+    """Read one response, returns (status, ETag version or None, body)."""
+    head = await reader.readuntil(b'\r\n\r\n')
+    lines = head.decode('latin-1').split('\r\n')
+    status = int(lines[0].split()[1])
+    length = 0
+    version = None
+    for line in lines[1:]:
+        name, _, value = line.partition(':')
+        if name.lower() == 'content-length':
+            length = int(value)
+        elif name.lower() == 'etag':
+            version = int(value.strip().strip('"'))
+    body = await reader.readexactly(length) if length else b''
+    return status, version, body
+
+
+async def exchange(port, operations, rng):
+    """
+    Send operations pipelined over one connection in random segments, returns
+    the completed Operation tuples.
+    """
+    invoked = [None] * len(operations)
+    reader, writer = await asyncio.open_connection('127.0.0.1', port)
+    writer.get_extra_info('socket').setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    requests = [build_request(method, key, value) for key, method, value in operations]
+    data = b''.join(requests)
+    offsets = list(itertools.accumulate((len(r) for r in requests[:-1]), initial=0))
+
+    async def send():
+        sent = 0
+        next_request = 0
+        while sent < len(data):
+            # Mal einzelne Bytes, mal mehrere Requests in einem Segment
+            size = rng.choice([1, 2, 7, 64, 512, len(data)])
+            while next_request < len(offsets) and offsets[next_request] < sent + size:
+                invoked[next_request] = time.monotonic()
+                next_request += 1
+            writer.write(data[sent:sent + size])
+            sent += size
+            await writer.drain()
+            if rng.random() < 0.05:
+                await asyncio.sleep(0.0005)
+        writer.write_eof()
+
+    sender = asyncio.ensure_future(send())
+    completed = []
+    try:
+        for index, (key, method, value) in enumerate(operations):
+            status, version, body = await read_response(reader)
+            completed.append(Operation(key, method, value, invoked[index], time.monotonic(),
+                                       status, version, body))
+        await sender
+    finally:
+        sender.cancel()
+        writer.close()
+    return completed
+
+
+async def client(port, number, rng, history):
+    """One client: a few connections with random pipeline depth and operations."""
+    for connection in range(CONNECTIONS_PER_CLIENT):
+        operations = []
+        for index in range(rng.choice(PIPELINE_DEPTHS)):
+            roll = rng.random()
+            method = 'GET' if roll < 0.5 else 'PUT' if roll < 0.85 else 'DELETE'
+            # Eindeutige Werte, damit jeder gelesene Wert genau einem PUT gehoert
+            value = b'%d-%d-%d' % (number, connection, index) if method == 'PUT' else None
+            operations.append((rng.choice(KEYS), method, value))
+        history.extend(await exchange(port, operations, rng))
+
+
+async def run_clients(port, clients, seed):
+    history = []
+    rng = random.Random(seed)
+    await asyncio.gather(*(client(port, number, random.Random(rng.random()), history)
+                           for number in range(clients)))
+    return history
+
+
+def clear_keys(port):
+    """Delete all stress keys, so every round starts from absent keys."""
+    with contextlib.closing(HTTPConnection('localhost', port, timeout=5)) as conn:
+        for key in KEYS:
+            conn.request('DELETE', key)
+            conn.getresponse().read()
+
+
+def run_round(port, clients, seed):
+    clear_keys(port)
+    return asyncio.run(run_clients(port, clients, seed))
+
+
+def linearizable(operations):
+    """
+    Search a linearization of one key's history (Wing & Gong with Lowe's
+    memoization). The server's ETag versions fix the order of the PUTs, so the
+    search only has to place the DELETEs; reads that match the current state
+    are taken as soon as they are due.
+    """
+    ops = sorted(operations, key=lambda op: op.invoked)
+    values = {op.version: op.value for op in ops if op.method == 'PUT'}
+    if any(op.method == 'GET' and op.status == 200 and values.get(op.version) != op.body
+           for op in ops):
+        return False
+
+    puts = sorted((i for i, op in enumerate(ops) if op.method == 'PUT'), key=lambda i: ops[i].version)
+    deletes = [i for i, op in enumerate(ops) if op.method == 'DELETE' and op.status == 204]
+    # Lesende Operationen nach dem Zustand, den sie voraussetzen (Version oder None)
+    readers = {}
+    for i, op in enumerate(ops):
+        if op.method == 'GET' or op.status == 404:
+            readers.setdefault(op.version if op.status == 200 else None, []).append(i)
+    by_return = sorted(range(len(ops)), key=lambda i: ops[i].returned)
+
+    # Vor jedem PUT mit 201 ausser dem ersten genau ein DELETE mit 204,
+    # nach dem letzten PUT hoechstens noch eines
+    created = sum(1 for i in puts if ops[i].status == 201)
+    if puts and ops[puts[0]].status != 201 or len(deletes) - created not in (-1, 0):
+        return False
+
+    full = (1 << len(ops)) - 1
+    seen = set()
+    # Linearisierte Operationen, Zustand, naechster PUT, frueheste offene Antwort
+    stack = [(0, None, 0, 0)]
+    while stack and len(seen) < SEARCH_LIMIT:
+        linearized, state, put, first = stack.pop()
+        if linearized == full:
+            return True
+        if (linearized, state) in seen:
+            continue
+        seen.add((linearized, state))
+
+        while linearized >> by_return[first] & 1:
+            first += 1
+        deadline = ops[by_return[first]].returned
+        due = [i for i in readers.get(state, ()) if not linearized >> i & 1 and ops[i].invoked <= deadline]
+        if due:
+            # Lesende Operationen frueh zu linearisieren schadet nie
+            stack.append((linearized | 1 << due[0], state, put, first))
+            continue
+
+        # Ein anderer Zustand macht noch offene Leser von state unerfuellbar
+        if state is not None and any(not linearized >> i & 1 for i in readers.get(state, ())):
+            continue
+        candidates = []
+        if state is not None:
+            candidates = [(ops[i].returned, i, None, put) for i in deletes
+                          if not linearized >> i & 1 and ops[i].invoked <= deadline]
+        if put < len(puts):
+            i = puts[put]
+            if ops[i].invoked <= deadline and (ops[i].status == 201) == (state is None):
+                candidates.append((ops[i].returned, i, ops[i].version, put + 1))
+        # Die zuerst beantwortete Operation wird zuerst versucht
+        for _, i, following, next_put in sorted(candidates, reverse=True):
+            stack.append((linearized | 1 << i, following, next_put, first))
+    return False
+
+
+def check_history(history):
+    expected = {'PUT': {201, 204}, 'GET': {200, 404}, 'DELETE': {204, 404}}
+    for op in history:
+        assert op.status in expected[op.method], op
+    for key in KEYS:
+        assert linearizable([op for op in history if op.key == key]), f'{key} not linearizable'
+
+
+def usage(pid):
+    """Return (open file descriptors, RSS in KiB) of a process."""
+    fds = len(os.listdir(f'/proc/{pid}/fd'))
+    with open(f'/proc/{pid}/status') as status:
+        rss = int(re.search(r'VmRSS:\s+(\d+)', status.read()).group(1))
+    return fds, rss
+
+
+@pytest.fixture
+def stress_clients(request):
+    # Jede Verbindung belegt beim Client einen Deskriptor
+    clients = request.config.getoption('stress_clients')
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if soft < clients + 64 <= hard:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (clients + 64, hard))
+    return clients
+
+
+@pytest.mark.timeout(120)
+def test_stress(webserver, port, stress_clients):
+    """
+    Test concurrent pipelined clients on shared keys see linearizable results
+    and leave no descriptors or memory behind
+    """
+
+    with webserver('127.0.0.1', f'{port}', stdout=subprocess.DEVNULL) as server:
+        check_history(run_round(port, stress_clients, 1))
+        baseline = usage(server.pid)
+
+        history = run_round(port, stress_clients, 2)
+        assert len(history) > 2 * stress_clients
+        assert {op.status for op in history if op.method == 'DELETE'} == {204, 404}
+        check_history(history)
+
+        fds, rss = usage(server.pid)
+        assert fds == baseline[0]
+        assert rss - baseline[1] < RSS_SLACK_KIB
+        stop(server)
+
+
+def test_soak(webserver, port, stress_clients, request):
+    """
+    Test descriptors and RSS stay flat over a long run (--soak-seconds)
+    """
+
+    seconds = request.config.getoption('soak_seconds')
+    if not seconds:
+        pytest.skip('soak run disabled, enable with --soak-seconds')
+
+    with webserver('127.0.0.1', f'{port}', stdout=subprocess.DEVNULL) as server:
+        check_history(run_round(port, stress_clients, 0))
+        baseline = usage(server.pid)
+
+        deadline = time.monotonic() + seconds
+        seed = 1
+        while time.monotonic() < deadline:
+            check_history(run_round(port, stress_clients, seed))
+            fds, rss = usage(server.pid)
+            print(f'round {seed}: {fds} fds, {rss} KiB RSS')
+            assert fds == baseline[0], f'round {seed} leaked descriptors'
+            assert rss - baseline[1] < RSS_SLACK_KIB, f'round {seed} grew RSS'
+            seed += 1
+        stop(server)